@@ -0,0 +1,166 @@
+#include "arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN 16
+
+static size_t align_up(size_t size) {
+  return (size + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+}
+
+srt_arena *srt_arena_new(size_t block_size) {
+  srt_arena *arena = calloc(1, sizeof(*arena));
+  if (!arena) {
+    return NULL;
+  }
+
+  arena->block_size = block_size;
+
+  return arena;
+}
+
+static void free_blocks(srt_arena_block *block) {
+  while (block) {
+    srt_arena_block *next = block->next;
+    free(block);
+    block = next;
+  }
+}
+
+//
+// the list of adopted memory lives in the blocks, so it goes first.
+//
+static void free_owned(srt_arena *arena) {
+  for (srt_arena_owned *o = arena->owned; o; o = o->next) {
+    o->release(o->ptr);
+  }
+
+  arena->owned = NULL;
+}
+
+void srt_arena_free(srt_arena *arena) {
+  if (!arena) {
+    return;
+  }
+
+  free_owned(arena);
+  free_blocks(arena->head);
+  free(arena);
+}
+
+//
+// keeps the largest block so the next instance usually runs without going
+// back to malloc at all.
+//
+void srt_arena_reset(srt_arena *arena) {
+  srt_arena_block *keep = arena->head;
+
+  free_owned(arena);
+
+  arena->allocs = 0;
+  arena->used = 0;
+
+  for (srt_arena_block *b = arena->head; b; b = b->next) {
+    if (b->cap > keep->cap) {
+      keep = b;
+    }
+  }
+
+  if (!keep) {
+    return;
+  }
+
+  for (srt_arena_block **b = &arena->head; *b; b = &(*b)->next) {
+    if (*b == keep) {
+      *b = keep->next;
+      break;
+    }
+  }
+
+  free_blocks(arena->head);
+
+  keep->next = NULL;
+  keep->used = 0;
+  arena->head = keep;
+  arena->reserved = sizeof(*keep) + keep->cap;
+}
+
+static void count(srt_arena *arena, size_t size) {
+  arena->allocs++;
+  arena->used += size;
+  arena->peak = arena->used > arena->peak ? arena->used : arena->peak;
+}
+
+void *srt_arena_alloc(srt_arena *arena, size_t size) {
+  size = align_up(size ? size : 1);
+
+  srt_arena_block *head = arena->head;
+
+  if (!head || head->cap - head->used < size) {
+    const size_t cap = size > arena->block_size ? size : arena->block_size;
+
+    srt_arena_block *block = malloc(sizeof(*block) + cap);
+    if (!block) {
+      return NULL;
+    }
+
+    block->cap = cap;
+    block->used = 0;
+    arena->reserved += sizeof(*block) + cap;
+
+    //
+    // an oversized allocation gets a block of its own behind the head so the
+    // space left in the current block is not thrown away.
+    //
+    if (head && cap == size) {
+      block->next = head->next;
+      head->next = block;
+      block->used = size;
+      count(arena, size);
+      return block->data;
+    }
+
+    block->next = head;
+    arena->head = head = block;
+  }
+
+  void *p = head->data + head->used;
+  head->used += size;
+  count(arena, size);
+
+  return p;
+}
+
+bool srt_arena_adopt(srt_arena *arena, void *ptr) {
+  return srt_arena_defer(arena, free, ptr);
+}
+
+bool srt_arena_defer(srt_arena *arena, void (*release)(void *ptr),
+                     void *ptr) {
+  srt_arena_owned *o = srt_arena_alloc(arena, sizeof(*o));
+
+  if (!o) {
+    return false;
+  }
+
+  o->release = release;
+  o->ptr = ptr;
+  o->next = arena->owned;
+  arena->owned = o;
+
+  return true;
+}
+
+void *srt_arena_calloc(srt_arena *arena, size_t count, size_t size) {
+  if (size && count > SIZE_MAX / size) {
+    return NULL;
+  }
+
+  void *p = srt_arena_alloc(arena, count * size);
+  if (p) {
+    memset(p, 0, count * size);
+  }
+
+  return p;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// bump allocator. allocations are never freed one at a time, the whole arena
+// is rewound by reset or released by free. memory from malloc can be handed
+// to the arena to be freed along with it, and other cleanup deferred to then.
+//
+
+typedef struct srt_arena_block {
+  struct srt_arena_block *next;
+  size_t cap;
+  size_t used;
+  _Alignas(16) unsigned char data[];
+} srt_arena_block;
+
+typedef struct srt_arena_owned {
+  struct srt_arena_owned *next;
+  void (*release)(void *ptr);
+  void *ptr;
+} srt_arena_owned;
+
+//
+// the arena keeps count of what it hands out since it was last reset, of the
+// bytes its blocks hold, and of the most it ever handed out at once, for
+// sizing contexts.
+//
+
+typedef struct srt_arena {
+  srt_arena_block *head;
+  size_t block_size;
+  srt_arena_owned *owned;
+  size_t allocs;
+  size_t used;
+  size_t reserved;
+  size_t peak;
+} srt_arena;
+
+srt_arena *srt_arena_new(size_t block_size);
+
+void srt_arena_free(srt_arena *arena);
+
+void srt_arena_reset(srt_arena *arena);
+
+void *srt_arena_alloc(srt_arena *arena, size_t size);
+
+void *srt_arena_calloc(srt_arena *arena, size_t count, size_t size);
+
+//
+// frees `ptr` when the arena is next reset or freed. false when out of memory,
+// in which case `ptr` is left to the caller.
+//
+bool srt_arena_adopt(srt_arena *arena, void *ptr);
+
+//
+// calls `release` on `ptr` when the arena is next reset or freed, before its
+// blocks go, latest first. false when out of memory.
+//
+bool srt_arena_defer(srt_arena *arena, void (*release)(void *ptr), void *ptr);
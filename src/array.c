@@ -0,0 +1,395 @@
+#include "array.h"
+#include "arena.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define MIN_CAP 8
+
+srt_array *srt_array_new(const void *data, size_t len, srt_arena *arena) {
+  const size_t cap = arena && len < MIN_CAP ? MIN_CAP : len;
+
+  if (cap > (SIZE_MAX - sizeof(srt_array)) / SRT_ARRAY_ELEM) {
+    return NULL;
+  }
+
+  srt_array *array;
+
+  if (arena) {
+    array = srt_arena_alloc(arena, sizeof(*array));
+    void *elems = array ? srt_arena_alloc(arena, cap * SRT_ARRAY_ELEM) : NULL;
+
+    if (!elems) {
+      return NULL;
+    }
+
+    array->data = elems;
+  } else {
+    if (!(array = malloc(sizeof(*array) + cap * SRT_ARRAY_ELEM))) {
+      return NULL;
+    }
+
+    array->data = array + 1;
+  }
+
+  array->len = len;
+  array->cap = cap;
+
+  if (len) {
+    memcpy(array->data, data, len * SRT_ARRAY_ELEM);
+  }
+
+  return array;
+}
+
+srt_array *srt_array_grow(srt_array *array) {
+  const size_t cap = array->cap < MIN_CAP / 2 ? MIN_CAP : array->cap * 2;
+
+  if (cap > (SIZE_MAX - sizeof(*array)) / SRT_ARRAY_ELEM) {
+    return NULL;
+  }
+
+  srt_array *grown = realloc(array, sizeof(*grown) + cap * SRT_ARRAY_ELEM);
+
+  if (grown) {
+    grown->data = grown + 1;
+    grown->cap = cap;
+  }
+
+  return grown;
+}
+
+srt_array *srt_array_view(void *data, size_t len, srt_arena *arena) {
+  srt_array *array = srt_arena_alloc(arena, sizeof(*array));
+
+  if (array) {
+    *array = (srt_array){.len = len, .cap = len, .data = data};
+  }
+
+  return array;
+}
+
+bool srt_array_push(srt_array *array, const void *elem, srt_arena *arena) {
+  if (array->len == array->cap) {
+    const size_t cap = array->cap ? array->cap * 2 : MIN_CAP;
+
+    if (!arena || cap > SIZE_MAX / 2 / SRT_ARRAY_ELEM) {
+      return false;
+    }
+
+    void *data = srt_arena_alloc(arena, cap * SRT_ARRAY_ELEM);
+
+    if (!data) {
+      return false;
+    }
+
+    memcpy(data, array->data, array->len * SRT_ARRAY_ELEM);
+    array->data = data;
+    array->cap = cap;
+  }
+
+  memcpy((unsigned char *)array->data + array->len * SRT_ARRAY_ELEM, elem,
+         SRT_ARRAY_ELEM);
+  array->len++;
+
+  return true;
+}
+
+//
+// the scalar loops finish what the vector loops leave over, one per
+// comparison so the comparison is not decided again for every element.
+//
+
+#define COUNT_FROM(values, i, len, cmp, operand, n)                            \
+  do {                                                                         \
+    switch (cmp) {                                                             \
+    case SRT_CMP_LT:                                                           \
+      for (; i < len; ++i) {                                                   \
+        n += values[i] < operand;                                              \
+      }                                                                        \
+      break;                                                                   \
+    case SRT_CMP_LE:                                                           \
+      for (; i < len; ++i) {                                                   \
+        n += values[i] <= operand;                                             \
+      }                                                                        \
+      break;                                                                   \
+    case SRT_CMP_EQ:                                                           \
+      for (; i < len; ++i) {                                                   \
+        n += values[i] == operand;                                             \
+      }                                                                        \
+      break;                                                                   \
+    case SRT_CMP_NE:                                                           \
+      for (; i < len; ++i) {                                                   \
+        n += values[i] != operand;                                             \
+      }                                                                        \
+      break;                                                                   \
+    case SRT_CMP_GE:                                                           \
+      for (; i < len; ++i) {                                                   \
+        n += values[i] >= operand;                                             \
+      }                                                                        \
+      break;                                                                   \
+    case SRT_CMP_GT:                                                           \
+      for (; i < len; ++i) {                                                   \
+        n += values[i] > operand;                                              \
+      }                                                                        \
+      break;                                                                   \
+    }                                                                          \
+  } while (0)
+
+//
+// int64
+//
+
+int64_t srt_int64_array_sum(const int64_t *values, size_t len) {
+  uint64_t sum = 0;
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  __m128i a = _mm_setzero_si128();
+  __m128i b = _mm_setzero_si128();
+
+  for (; i + 4 <= len; i += 4) {
+    a = _mm_add_epi64(a, _mm_loadu_si128((const __m128i *)(values + i)));
+    b = _mm_add_epi64(b, _mm_loadu_si128((const __m128i *)(values + i + 2)));
+  }
+
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(a, b));
+  sum = lanes[0] + lanes[1];
+#endif
+
+  for (; i < len; ++i) {
+    sum += (uint64_t)values[i];
+  }
+
+  return (int64_t)sum;
+}
+
+#if defined(__AVX2__)
+static int64_t reduce_int64(__m256i acc, bool min) {
+  int64_t lanes[4];
+  _mm256_storeu_si256((__m256i *)lanes, acc);
+
+  int64_t r = lanes[0];
+
+  for (int l = 1; l < 4; ++l) {
+    r = (min ? lanes[l] < r : lanes[l] > r) ? lanes[l] : r;
+  }
+
+  return r;
+}
+#endif
+
+int64_t srt_int64_array_min(const int64_t *values, size_t len) {
+  int64_t min = INT64_MAX;
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  __m256i acc = _mm256_set1_epi64x(INT64_MAX);
+
+  for (; i + 4 <= len; i += 4) {
+    const __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+    acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(acc, v));
+  }
+
+  min = reduce_int64(acc, true);
+#endif
+
+  for (; i < len; ++i) {
+    min = values[i] < min ? values[i] : min;
+  }
+
+  return min;
+}
+
+int64_t srt_int64_array_max(const int64_t *values, size_t len) {
+  int64_t max = INT64_MIN;
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  __m256i acc = _mm256_set1_epi64x(INT64_MIN);
+
+  for (; i + 4 <= len; i += 4) {
+    const __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+    acc = _mm256_blendv_epi8(acc, v, _mm256_cmpgt_epi64(v, acc));
+  }
+
+  max = reduce_int64(acc, false);
+#endif
+
+  for (; i < len; ++i) {
+    max = values[i] > max ? values[i] : max;
+  }
+
+  return max;
+}
+
+size_t srt_int64_array_count_if(const int64_t *values, size_t len, srt_cmp cmp,
+                                int64_t operand) {
+  size_t n = 0;
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  //
+  // AVX2 compares for equal and greater only, the other three count what
+  // the opposite comparison does not.
+  //
+  const __m256i x = _mm256_set1_epi64x(operand);
+  const bool negate =
+      cmp == SRT_CMP_NE || cmp == SRT_CMP_GE || cmp == SRT_CMP_LE;
+  size_t hits = 0;
+
+  for (; i + 4 <= len; i += 4) {
+    const __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+    __m256i mask;
+
+    if (cmp == SRT_CMP_EQ || cmp == SRT_CMP_NE) {
+      mask = _mm256_cmpeq_epi64(v, x);
+    } else if (cmp == SRT_CMP_GT || cmp == SRT_CMP_LE) {
+      mask = _mm256_cmpgt_epi64(v, x);
+    } else {
+      mask = _mm256_cmpgt_epi64(x, v);
+    }
+
+    hits += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+  }
+
+  n = negate ? i - hits : hits;
+#endif
+
+  COUNT_FROM(values, i, len, cmp, operand, n);
+
+  return n;
+}
+
+//
+// double
+//
+
+double srt_double_array_sum(const double *values, size_t len) {
+  double sum = 0;
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  __m128d a = _mm_setzero_pd();
+  __m128d b = _mm_setzero_pd();
+
+  for (; i + 4 <= len; i += 4) {
+    a = _mm_add_pd(a, _mm_loadu_pd(values + i));
+    b = _mm_add_pd(b, _mm_loadu_pd(values + i + 2));
+  }
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, _mm_add_pd(a, b));
+  sum = lanes[0] + lanes[1];
+#endif
+
+  for (; i < len; ++i) {
+    sum += values[i];
+  }
+
+  return sum;
+}
+
+//
+// minpd and maxpd answer with their second operand when either is a NaN, so
+// with the accumulator second a NaN element leaves it alone, as the scalar
+// comparison does.
+//
+
+double srt_double_array_min(const double *values, size_t len) {
+  double min = INFINITY;
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  __m128d acc = _mm_set1_pd(INFINITY);
+
+  for (; i + 2 <= len; i += 2) {
+    acc = _mm_min_pd(_mm_loadu_pd(values + i), acc);
+  }
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  min = lanes[1] < lanes[0] ? lanes[1] : lanes[0];
+#endif
+
+  for (; i < len; ++i) {
+    min = values[i] < min ? values[i] : min;
+  }
+
+  return min;
+}
+
+double srt_double_array_max(const double *values, size_t len) {
+  double max = -INFINITY;
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  __m128d acc = _mm_set1_pd(-INFINITY);
+
+  for (; i + 2 <= len; i += 2) {
+    acc = _mm_max_pd(_mm_loadu_pd(values + i), acc);
+  }
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  max = lanes[1] > lanes[0] ? lanes[1] : lanes[0];
+#endif
+
+  for (; i < len; ++i) {
+    max = values[i] > max ? values[i] : max;
+  }
+
+  return max;
+}
+
+size_t srt_double_array_count_if(const double *values, size_t len,
+                                 srt_cmp cmp, double operand) {
+  size_t n = 0;
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  const __m128d x = _mm_set1_pd(operand);
+
+  for (; i + 2 <= len; i += 2) {
+    const __m128d v = _mm_loadu_pd(values + i);
+    __m128d mask;
+
+    switch (cmp) {
+    case SRT_CMP_LT:
+      mask = _mm_cmplt_pd(v, x);
+      break;
+    case SRT_CMP_LE:
+      mask = _mm_cmple_pd(v, x);
+      break;
+    case SRT_CMP_EQ:
+      mask = _mm_cmpeq_pd(v, x);
+      break;
+    case SRT_CMP_NE:
+      mask = _mm_cmpneq_pd(v, x);
+      break;
+    case SRT_CMP_GE:
+      mask = _mm_cmpge_pd(v, x);
+      break;
+    case SRT_CMP_GT:
+    default:
+      mask = _mm_cmpgt_pd(v, x);
+      break;
+    }
+
+    n += __builtin_popcount(_mm_movemask_pd(mask));
+  }
+#endif
+
+  COUNT_FROM(values, i, len, cmp, operand, n);
+
+  return n;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "types.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct srt_arena srt_arena;
+
+//
+// the elements of an int64 or double array value, side by side so a line
+// item list is walked without a lookup per element. both kinds hold 8 byte
+// elements and share this header, the tag of the value tells them apart.
+//
+
+typedef struct srt_array {
+  size_t len;
+  size_t cap;
+  union {
+    int64_t *int64s;
+    double *doubles;
+    void *data;
+  };
+} srt_array;
+
+#define SRT_ARRAY_ELEM 8
+
+//
+// an array of the `len` elements at `data`. in `arena` it grows there, from
+// malloc it is a single allocation given back with free, grown by
+// srt_array_grow.
+//
+srt_array *srt_array_new(const void *data, size_t len, srt_arena *arena);
+
+//
+// moves an array from malloc to twice the room. NULL, with `array` as it was,
+// when out of memory.
+//
+srt_array *srt_array_grow(srt_array *array);
+
+//
+// an array in `arena` over the `len` elements at `data`, which it reads in
+// place rather than copying and which must outlive it. the first push moves
+// the elements to `arena`, so `data` is never written.
+//
+srt_array *srt_array_view(void *data, size_t len, srt_arena *arena);
+
+//
+// appends the element at `elem`, moving the elements to twice the room in
+// `arena` when they are out of it. false, with the array as it was, when out
+// of memory.
+//
+bool srt_array_push(srt_array *array, const void *elem, srt_arena *arena);
+
+//
+// aggregates for generated code to run over the elements it got from task
+// data. they use SSE2 where the build has it, and AVX2 for the int64
+// comparisons SSE2 lacks, with a scalar loop for the rest.
+//
+// int64 sums wrap around on overflow. double sums are added up in lanes, so
+// the last bits may differ from those of a sum taken in order. NaNs are
+// skipped by min and max and compare false by every comparison but
+// SRT_CMP_NE. the min and max of no elements are the largest and smallest
+// values of the type, the infinities for doubles.
+//
+
+int64_t srt_int64_array_sum(const int64_t *values, size_t len);
+
+int64_t srt_int64_array_min(const int64_t *values, size_t len);
+
+int64_t srt_int64_array_max(const int64_t *values, size_t len);
+
+size_t srt_int64_array_count_if(const int64_t *values, size_t len, srt_cmp cmp,
+                                int64_t operand);
+
+double srt_double_array_sum(const double *values, size_t len);
+
+double srt_double_array_min(const double *values, size_t len);
+
+double srt_double_array_max(const double *values, size_t len);
+
+size_t srt_double_array_count_if(const double *values, size_t len,
+                                 srt_cmp cmp, double operand);
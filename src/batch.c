@@ -0,0 +1,140 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
+#include "arena.h"
+#include "const.h"
+#include "ctx.h"
+#include "json.h"
+#include "log.h"
+#include "suspend.h"
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+bool srt_batch_blank(const char *line, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    if (line[i] != ' ' && line[i] != '\t' && line[i] != '\r' &&
+        line[i] != '\n') {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+//
+// json error and panic messages are fixed ascii strings without quotes or
+// backslashes, and element ids are xml names, so they go out unescaped. the
+// key of a panic may hold anything and is escaped.
+//
+static bool run_line(srt_context *ctx, const char *resume, const char *line,
+                     size_t len, size_t number, FILE *out,
+                     srt_batch_start start, int32_t *result) {
+  srt_json_error error;
+  srt_ctx_reset(ctx);
+
+  if (srt_json_read_mem(line, len, ctx->task_data, &error) != SRT_SUCCESS) {
+    *result = SRT_INVALID_JSON;
+
+    return fprintf(out,
+                   "{\"line\":%zu,\"result\":%d,\"error\":\"%s\","
+                   "\"column\":%zu}\n",
+                   number, *result, error.message, error.column) > 0;
+  }
+
+  //
+  // the panic lives in the arena, so the runner still sees what the accessor
+  // wrote to it once the jump is back here.
+  //
+  srt_panic *panic = srt_arena_alloc(ctx->arena, sizeof(*panic));
+
+  if (panic) {
+    ctx->panic = panic;
+
+    if (setjmp(panic->env)) {
+      ctx->panic = NULL;
+      *result = panic->result;
+      srt_log_flush(ctx->log);
+      fprintf(out, "{\"line\":%zu,\"result\":%d,\"error\":\"%s\",\"key\":",
+              number, *result, panic->message);
+
+      return srt_json_write_str(panic->key, out) == SRT_SUCCESS &&
+             fputs("}\n", out) != EOF;
+    }
+  }
+
+  *result = resume && !srt_ctx_resume_at(ctx, resume) ? SRT_UNKNOWN_ERROR
+                                                      : start(ctx);
+
+  ctx->panic = NULL;
+  srt_log_flush(ctx->log);
+  fprintf(out, "{\"line\":%zu,\"result\":%d,", number, *result);
+
+  if (*result == SRT_SUSPENDED && ctx->suspension &&
+      ctx->suspension->element_id) {
+    fprintf(out, "\"suspended\":\"%s\",", ctx->suspension->element_id);
+  }
+
+  fputs("\"task_data\":", out);
+
+  return srt_json_write_value(ctx->task_data, out) == SRT_SUCCESS &&
+         fputs("}\n", out) != EOF;
+}
+
+bool srt_batch_run_line(srt_context *ctx, const char *line, size_t len,
+                        size_t number, FILE *out, srt_batch_start start,
+                        int32_t *result) {
+  return run_line(ctx, NULL, line, len, number, out, start, result);
+}
+
+bool srt_batch_resume_line(srt_context *ctx, const char *element_id,
+                           const char *line, size_t len, size_t number,
+                           FILE *out, srt_batch_start start, int32_t *result) {
+  return run_line(ctx, element_id, line, len, number, out, start, result);
+}
+
+void srt_batch_count(srt_batch_stats *stats, int32_t result) {
+  stats->instances++;
+  stats->suspended += result == SRT_SUSPENDED;
+  stats->failed += result != SRT_SUCCESS && result != SRT_SUSPENDED;
+}
+
+int32_t srt_batch_run(srt_context *ctx, FILE *in, FILE *out,
+                      srt_batch_start start, srt_batch_stats *stats) {
+  char *line = NULL;
+  size_t cap = 0;
+  size_t number = 0;
+  ssize_t len;
+
+  *stats = (srt_batch_stats){0};
+  const uint64_t start_ns = now_ns();
+
+  while ((len = getline(&line, &cap, in)) != -1) {
+    ++number;
+
+    if (srt_batch_blank(line, len)) {
+      continue;
+    }
+
+    int32_t result;
+
+    if (!srt_batch_run_line(ctx, line, len, number, out, start, &result)) {
+      break;
+    }
+
+    srt_batch_count(stats, result);
+  }
+
+  stats->ns = now_ns() - start_ns;
+  free(line);
+
+  return ferror(in) || fflush(out) != 0 || ferror(out) ? SRT_IO_ERROR
+                                                        : SRT_SUCCESS;
+}
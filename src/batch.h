@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct srt_context srt_context;
+
+//
+// runs one process instance per line of `in`, each line a json object with
+// the initial task data of its instance. one context is reset between
+// instances rather than rebuilt, so after the first few its arena already
+// holds a block big enough and an instance costs no malloc at all.
+//
+// each instance writes a line to `out`, numbered by its line in `in`:
+//
+//   {"line":1,"result":0,"task_data":{...}}
+//   {"line":2,"result":6,"error":"expected an object","column":1}
+//
+// in a suspendable context an instance that stopped at a manual task names
+// the task, and its task data is what resuming it starts from:
+//
+//   {"line":3,"result":9,"suspended":"Task_1","task_data":{...}}
+//
+// blank lines are skipped. a line that is not valid task data is reported
+// with SRT_INVALID_JSON and its instance is not started. an instance whose
+// generated code fails to get or set a var ends there rather than taking the
+// process down, with the result of the accessor and the var it named:
+//
+//   {"line":4,"result":1,"error":"failed to get task data var","key":"n"}
+//
+
+typedef int32_t (*srt_batch_start)(srt_context *ctx);
+
+typedef struct srt_batch_stats {
+  size_t instances;
+  size_t failed;
+  size_t suspended;
+  uint64_t ns;
+} srt_batch_stats;
+
+int32_t srt_batch_run(srt_context *ctx, FILE *in, FILE *out,
+                      srt_batch_start start, srt_batch_stats *stats);
+
+bool srt_batch_blank(const char *line, size_t len);
+
+void srt_batch_count(srt_batch_stats *stats, int32_t result);
+
+//
+// one instance of a batch: resets `ctx`, reads its task data from `line`,
+// runs it and writes its result line to `out`. false when `out` could not be
+// written.
+//
+bool srt_batch_run_line(srt_context *ctx, const char *line, size_t len,
+                        size_t number, FILE *out, srt_batch_start start,
+                        int32_t *result);
+
+//
+// the same for an instance suspended at `element_id`, whose task data with
+// the response to its manual task is in `line`.
+//
+bool srt_batch_resume_line(srt_context *ctx, const char *element_id,
+                           const char *line, size_t len, size_t number,
+                           FILE *out, srt_batch_start start, int32_t *result);
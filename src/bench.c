@@ -0,0 +1,1528 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "arena.h"
+#include "array.h"
+#include "batch.h"
+#include "ctx.h"
+#include "dict.h"
+#include "fixed_dict.h"
+#include "hash.h"
+#include "journal.h"
+#include "pool.h"
+#include "life_cycle.h"
+#include "parallel.h"
+#include "path.h"
+#include "server.h"
+#include "snapshot.h"
+#include "task_data.h"
+#include "trace.h"
+#include "value.h"
+#include <pthread.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BATCH 32
+#define CAPACITY (1 << 16)
+#define OPS (1 << 16)
+#define PASSES 5
+
+//
+// the linear probing table srt_dict used before the swiss table layout, kept
+// here as the baseline: 48 byte items probed one at a time, with a hash
+// compare and strcmp on every occupied slot passed.
+//
+
+typedef struct linear_item {
+  uint64_t hash;
+  union {
+    char *ptr;
+    char buf[SRT_DICT_KEY_INLINE];
+  } key;
+  srt_value value;
+  int state;
+  bool key_inline;
+} linear_item;
+
+typedef struct linear {
+  size_t mask;
+  linear_item *items;
+} linear;
+
+static uint64_t fnv1a(const char *str) {
+  uint64_t hash = 0xcbf29ce484222325;
+  for (const unsigned char *b = (const unsigned char *)str; *b; ++b) {
+    hash ^= *b;
+    hash *= 0x100000001b3;
+  }
+  return hash;
+}
+
+static const char *linear_key(const linear_item *item) {
+  return item->key_inline ? item->key.buf : item->key.ptr;
+}
+
+static linear_item *linear_find(linear *t, const char *key, uint64_t hash,
+                                bool vacant) {
+  for (size_t i = hash & t->mask;; i = (i + 1) & t->mask) {
+    linear_item *item = &t->items[i];
+
+    if (!item->state) {
+      return vacant ? item : NULL;
+    }
+
+    if (item->hash == hash && strcmp(linear_key(item), key) == 0) {
+      return item;
+    }
+  }
+}
+
+static void linear_put(linear *t, const char *key, srt_value value) {
+  const uint64_t hash = fnv1a(key);
+  linear_item *item = linear_find(t, key, hash, true);
+
+  if (!item->state) {
+    const size_t len = strlen(key);
+    char *dst = item->key.buf;
+
+    if (!(item->key_inline = len < SRT_DICT_KEY_INLINE)) {
+      dst = item->key.ptr = malloc(len + 1);
+    }
+
+    memcpy(dst, key, len + 1);
+    item->hash = hash;
+    item->state = 1;
+  }
+
+  item->value = value;
+}
+
+static srt_value *linear_get(linear *t, const char *key) {
+  linear_item *item = linear_find(t, key, fnv1a(key), false);
+  return item ? &item->value : NULL;
+}
+
+static void linear_free(linear *t) {
+  for (size_t i = 0; i <= t->mask; ++i) {
+    if (t->items[i].state && !t->items[i].key_inline) {
+      free(t->items[i].key.ptr);
+    }
+  }
+  free(t->items);
+}
+
+//
+// timing and reporting. every benchmark runs its operation in batches of
+// BATCH and records one sample per batch, so a sample is the mean of BATCH
+// back to back operations and the clock reads stay out of the op cost. the
+// first pass warms caches and is thrown away.
+//
+
+typedef enum format { FORMAT_TEXT, FORMAT_JSON, FORMAT_CSV } format;
+
+typedef struct result {
+  const char *suite;
+  const char *op;
+  const char *variant;
+  size_t keys;
+  size_t key_len;
+  size_t ops;
+  size_t bytes;
+  double mean;
+  double p50;
+  double p99;
+  double mb_s;
+} result;
+
+static format out_format = FORMAT_TEXT;
+static const char *only_suite;
+static const char *last_suite;
+static size_t result_count;
+
+static volatile int64_t sink;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool selected(const char *suite) {
+  return !only_suite || strcmp(only_suite, suite) == 0;
+}
+
+static int compare_samples(const void *a, const void *b) {
+  const double x = *(const double *)a;
+  const double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t count, int p) {
+  return sorted[(count - 1) * p / 100];
+}
+
+static void report(result *r, double *samples, size_t count) {
+  double total = 0;
+  for (size_t i = 0; i < count; ++i) {
+    total += samples[i];
+  }
+
+  qsort(samples, count, sizeof(*samples), compare_samples);
+
+  r->mean = total / count;
+  r->p50 = percentile(samples, count, 50);
+  r->p99 = percentile(samples, count, 99);
+  r->mb_s = r->bytes ? r->bytes / r->p50 * 1000.0 : 0;
+
+  switch (out_format) {
+  case FORMAT_TEXT:
+    if (!last_suite || strcmp(last_suite, r->suite) != 0) {
+      printf("\n%s (ns/op)\n\n", r->suite);
+      printf("op            variant       keys  key_len       ops      mean"
+             "       p50       p99      MB/s\n");
+    }
+    printf("%-12s  %-10s  %7zu  %7zu  %8zu  %8.1f  %8.1f  %8.1f  %8.1f\n",
+           r->op, r->variant, r->keys, r->key_len, r->ops, r->mean, r->p50,
+           r->p99, r->mb_s);
+    break;
+  case FORMAT_JSON:
+    printf("%s\n    {\"suite\": \"%s\", \"op\": \"%s\", \"variant\": \"%s\", "
+           "\"keys\": %zu, \"key_len\": %zu, \"ops\": %zu, \"mean_ns\": %.2f, "
+           "\"p50_ns\": %.2f, \"p99_ns\": %.2f, \"mb_s\": %.2f}",
+           result_count ? "," : "", r->suite, r->op, r->variant, r->keys,
+           r->key_len, r->ops, r->mean, r->p50, r->p99, r->mb_s);
+    break;
+  case FORMAT_CSV:
+    printf("%s,%s,%s,%zu,%zu,%zu,%.2f,%.2f,%.2f,%.2f\n", r->suite, r->op,
+           r->variant, r->keys, r->key_len, r->ops, r->mean, r->p50, r->p99,
+           r->mb_s);
+    break;
+  }
+
+  last_suite = r->suite;
+  result_count++;
+}
+
+//
+// runs `b` for i in [0, n) PASSES + 1 times and reports into `r`, taking one
+// sample per `batch` ops. `setup` runs untimed before every pass, for ops
+// like insert and delete that use up the state they run against.
+//
+#define MEASURE_BATCHED(r, n, batch_ops, setup, b)                             \
+  do {                                                                         \
+    const size_t per_batch = (batch_ops);                                      \
+    const size_t batches = (n) / per_batch;                                    \
+    double *samples = malloc(batches * PASSES * sizeof(*samples));             \
+    size_t taken = 0;                                                          \
+    for (int pass = -1; pass < PASSES; ++pass) {                               \
+      setup;                                                                   \
+      for (size_t batch = 0; batch < batches; ++batch) {                       \
+        const uint64_t start = now_ns();                                       \
+        for (size_t i = batch * per_batch; i < (batch + 1) * per_batch; ++i) { \
+          b;                                                                   \
+        }                                                                      \
+        const uint64_t elapsed = now_ns() - start;                             \
+        if (pass >= 0) {                                                       \
+          samples[taken++] = (double)elapsed / per_batch;                      \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+    (r).ops = batches * per_batch;                                             \
+    report(&(r), samples, taken);                                              \
+    free(samples);                                                             \
+  } while (0)
+
+#define MEASURE(r, n, setup, b) MEASURE_BATCHED(r, n, BATCH, setup, b)
+
+//
+// keys
+//
+
+static char **make_keys(size_t count, const char *prefix) {
+  char **keys = malloc(count * sizeof(*keys));
+  char buf[64];
+
+  for (size_t i = 0; i < count; ++i) {
+    snprintf(buf, sizeof(buf), "%s_%zu", prefix, i);
+    keys[i] = strdup(buf);
+  }
+
+  return keys;
+}
+
+static void free_keys(char **keys, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    free(keys[i]);
+  }
+  free(keys);
+}
+
+//
+// `count` keys of exactly `len` bytes: `prefix` repeated up to the last five
+// bytes, then an underscore and a base36 index. the shared prefix makes
+// every hit pay for a full compare, as long process variable names do.
+//
+static char **make_sized_keys(size_t count, size_t len, const char *prefix) {
+  char **keys = malloc(count * sizeof(*keys));
+  char *storage = malloc(count * (len + 1));
+  const size_t prefix_len = strlen(prefix);
+
+  for (size_t i = 0; i < count; ++i) {
+    char *key = keys[i] = storage + i * (len + 1);
+    size_t id = i;
+
+    for (size_t c = 0; c < len - 5; ++c) {
+      key[c] = prefix[c % prefix_len];
+    }
+    key[len - 5] = '_';
+    for (size_t c = len; c > len - 4; --c, id /= 36) {
+      key[c - 1] = "0123456789abcdefghijklmnopqrstuvwxyz"[id % 36];
+    }
+    key[len] = '\0';
+  }
+
+  return keys;
+}
+
+static void free_sized_keys(char **keys) {
+  free(keys[0]);
+  free(keys);
+}
+
+static const size_t key_counts[] = {16, 1024, 65536};
+static const size_t key_lens[] = {8, 24, 64};
+
+#define KEY_COUNTS (sizeof(key_counts) / sizeof(*key_counts))
+#define KEY_LENS (sizeof(key_lens) / sizeof(*key_lens))
+
+//
+// dict
+//
+
+static void bench_dict_ops(size_t count, size_t len) {
+  char **keys = make_sized_keys(count, len, "order_line_item_");
+  char **misses = make_sized_keys(count, len, "customer_address_");
+  srt_key *handles = malloc(count * sizeof(*handles));
+  const uint64_t seed = srt_hash_seed();
+
+  srt_dict *d = srt_dict_new(16);
+  for (size_t i = 0; i < count; ++i) {
+    srt_dict_put(d, keys[i], SRT_VALUE(SRT_INT64, int64, i));
+    srt_key_init(&handles[i], keys[i]);
+  }
+
+  result r = {.suite = "dict", .keys = count, .key_len = len};
+
+  r.op = "get", r.variant = "hit";
+  MEASURE(r, OPS, (void)0, sink += srt_dict_get(d, keys[i % count])->int64);
+
+  r.op = "get", r.variant = "miss";
+  MEASURE(r, OPS, (void)0, sink += !srt_dict_get(d, misses[i % count]));
+
+  r.op = "get", r.variant = "key";
+  MEASURE(r, OPS, (void)0,
+          sink += srt_dict_get_k(d, &handles[i % count])->int64);
+
+  r.op = "set", r.variant = "overwrite";
+  MEASURE(r, OPS, (void)0,
+          srt_dict_put(d, keys[i % count], SRT_VALUE(SRT_INT64, int64, i)));
+
+  //
+  // inserts and deletes need fresh state every pass, so they run against a
+  // pool of dicts in an arena that is reset between passes, each dict
+  // taking `count` of the ops.
+  //
+  const size_t pool_len = (OPS + count - 1) / count;
+  srt_dict **pool = malloc(pool_len * sizeof(*pool));
+  srt_arena *arena = srt_arena_new(1 << 20);
+
+  r.op = "set", r.variant = "insert";
+  MEASURE(r, OPS,
+          {
+            srt_arena_reset(arena);
+            for (size_t p = 0; p < pool_len; ++p) {
+              pool[p] = srt_dict_new_in(arena, 16, seed);
+            }
+          },
+          srt_dict_put(pool[i / count], keys[i % count],
+                       SRT_VALUE(SRT_INT64, int64, i)));
+
+  r.op = "delete", r.variant = "hit";
+  MEASURE(r, OPS,
+          {
+            srt_arena_reset(arena);
+            for (size_t p = 0; p < pool_len; ++p) {
+              pool[p] = srt_dict_new_in(arena, 16, seed);
+              for (size_t k = 0; k < count; ++k) {
+                srt_dict_put(pool[p], keys[k], SRT_VALUE(SRT_INT64, int64, k));
+              }
+            }
+          },
+          sink += srt_dict_delete(pool[i / count], keys[i % count]));
+
+  srt_arena_free(arena);
+  free(pool);
+  srt_dict_free(d);
+  free(handles);
+  free_sized_keys(keys);
+  free_sized_keys(misses);
+}
+
+//
+// the same lookups against a fixed dict of the keys, and building a record
+// of them both ways.
+//
+static void bench_fixed_dict_ops(size_t count, size_t len) {
+  char **keys = make_sized_keys(count, len, "order_line_item_");
+  char **misses = make_sized_keys(count, len, "customer_address_");
+  srt_key *handles = malloc(count * sizeof(*handles));
+  srt_fixed_dict *d = srt_fixed_dict_new((const char *const *)keys, count);
+
+  for (size_t i = 0; i < count; ++i) {
+    srt_fixed_dict_put(d, keys[i], SRT_VALUE(SRT_INT64, int64, i));
+    srt_key_init(&handles[i], keys[i]);
+  }
+
+  result r = {.suite = "dict", .keys = count, .key_len = len};
+
+  r.op = "get", r.variant = "fixed_hit";
+  MEASURE(r, OPS, (void)0,
+          sink += srt_fixed_dict_get(d, keys[i % count])->int64);
+
+  r.op = "get", r.variant = "fixed_miss";
+  MEASURE(r, OPS, (void)0, sink += !srt_fixed_dict_get(d, misses[i % count]));
+
+  r.op = "get", r.variant = "fixed_key";
+  MEASURE(r, OPS, (void)0,
+          sink += srt_fixed_dict_get_k(d, &handles[i % count])->int64);
+
+  const size_t builds = count < 1024 ? 1024 : 8;
+
+  r.op = "build", r.variant = "dict";
+  MEASURE_BATCHED(r, builds, 1, (void)0, {
+    srt_dict *built = srt_dict_new(16);
+
+    for (size_t k = 0; k < count; ++k) {
+      srt_dict_put(built, keys[k], SRT_VALUE(SRT_INT64, int64, k));
+    }
+
+    srt_dict_free(built);
+  });
+
+  r.op = "build", r.variant = "fixed";
+  MEASURE_BATCHED(r, builds, 1, (void)0, {
+    srt_fixed_dict *built =
+        srt_fixed_dict_new((const char *const *)keys, count);
+
+    for (size_t k = 0; k < count; ++k) {
+      srt_fixed_dict_put(built, keys[k], SRT_VALUE(SRT_INT64, int64, k));
+    }
+
+    srt_fixed_dict_free(built);
+  });
+
+  srt_fixed_dict_free(d);
+  free(handles);
+  free_sized_keys(keys);
+  free_sized_keys(misses);
+}
+
+static void bench_dict(void) {
+  if (!selected("dict")) {
+    return;
+  }
+
+  for (size_t c = 0; c < KEY_COUNTS; ++c) {
+    for (size_t l = 0; l < KEY_LENS; ++l) {
+      bench_dict_ops(key_counts[c], key_lens[l]);
+    }
+
+    bench_fixed_dict_ops(key_counts[c], 24);
+  }
+}
+
+//
+// task data
+//
+
+static void bench_task_data_ops(size_t count, size_t len) {
+  char **keys = make_sized_keys(count, len, "invoice_total_amount_");
+  srt_key *handles = malloc(count * sizeof(*handles));
+  srt_context *ctx = srt_ctx_new(false);
+
+  for (size_t i = 0; i < count; ++i) {
+    srt_task_data_set_int64(ctx, keys[i], i);
+    srt_key_init(&handles[i], keys[i]);
+  }
+
+  result r = {.suite = "task_data", .keys = count, .key_len = len};
+
+  r.op = "get_int64", r.variant = "str";
+  MEASURE(r, OPS, (void)0,
+          sink += srt_task_data_get_int64(ctx, keys[i % count]));
+
+  r.op = "get_int64", r.variant = "key";
+  MEASURE(r, OPS, (void)0,
+          sink += srt_task_data_get_int64_k(ctx, &handles[i % count]));
+
+  r.op = "set_int64", r.variant = "str";
+  MEASURE(r, OPS, (void)0, srt_task_data_set_int64(ctx, keys[i % count], i));
+
+  r.op = "set_int64", r.variant = "key";
+  MEASURE(r, OPS, (void)0,
+          srt_task_data_set_int64_k(ctx, &handles[i % count], i));
+
+  srt_ctx_reset(ctx);
+  for (size_t i = 0; i < count; ++i) {
+    srt_task_data_set_bool(ctx, keys[i], i & 1);
+  }
+
+  r.op = "get_bool", r.variant = "str";
+  MEASURE(r, OPS, (void)0,
+          sink += srt_task_data_get_bool(ctx, keys[i % count]));
+
+  r.op = "set_bool", r.variant = "str";
+  MEASURE(r, OPS, (void)0, srt_task_data_set_bool(ctx, keys[i % count], i & 1));
+
+  //
+  // a status code is stored in the value, a sentence is copied to the arena.
+  //
+  static const char *sentence = "approved by the regional manager";
+
+  r.op = "set_str", r.variant = "short";
+  MEASURE(r, OPS, (void)0,
+          srt_task_data_set_str_k(ctx, &handles[i % count], "APPROVED"));
+
+  r.op = "get_str", r.variant = "short";
+  MEASURE(r, OPS, (void)0,
+          sink += *srt_task_data_get_str_k(ctx, &handles[i % count]));
+
+  r.op = "set_str", r.variant = "long";
+  MEASURE(r, OPS, (void)0,
+          srt_task_data_set_str_k(ctx, &handles[i % count], sentence));
+
+  srt_ctx_free(ctx);
+  free(handles);
+  free_sized_keys(keys);
+}
+
+//
+// order.customer.id, got a level at a time by name and through a path, and
+// the order moved as a whole.
+//
+static void bench_task_data_path(void) {
+  static char doc[] = "{\"order\": {\"total\": 99, \"customer\": "
+                      "{\"name\": \"Zoe\", \"id\": 42}}}";
+  srt_context *ctx = srt_ctx_new(false);
+  FILE *in = fmemopen(doc, sizeof(doc) - 1, "r");
+  srt_task_data_read_json(ctx, in);
+  fclose(in);
+
+  srt_path *path = srt_path_compile("order.customer.id");
+  result r = {.suite = "task_data", .keys = 3, .key_len = 17};
+
+  r.op = "get_nested", r.variant = "str";
+  MEASURE(r, OPS, (void)0, {
+    srt_dict *order = srt_task_data_get_dict(ctx, "order");
+    srt_dict *customer = srt_dict_get(order, "customer")->dict;
+    sink += srt_dict_get(customer, "id")->int64;
+  });
+
+  r.op = "get_nested", r.variant = "path";
+  MEASURE(r, OPS, (void)0, sink += srt_task_data_get_int64_path(ctx, path));
+
+  //
+  // the whole order goes back and forth between two vars.
+  //
+  r.op = "move", r.variant = "dict";
+  MEASURE(r, OPS, (void)0,
+          srt_task_data_move(ctx, i & 1 ? "archived" : "order",
+                             i & 1 ? "order" : "archived"));
+
+  srt_path_free(path);
+  srt_ctx_free(ctx);
+}
+
+//
+// the line items of an order totalled and counted, once as int64 vars named
+// by their index and once as an int64 array. an op covers every item.
+//
+
+#define LINE_ITEMS 1024
+
+static void bench_task_data_array(void) {
+  char **keys = make_keys(LINE_ITEMS, "");
+  srt_context *ctx = srt_ctx_new(false);
+  result r = {.suite = "task_data", .keys = LINE_ITEMS, .key_len = 4};
+
+  for (size_t i = 0; i < LINE_ITEMS; ++i) {
+    srt_task_data_set_int64(ctx, keys[i], i * 37 % 1000);
+    srt_task_data_append_int64(ctx, "items", i * 37 % 1000);
+  }
+
+  r.op = "sum_items", r.variant = "vars";
+  MEASURE_BATCHED(r, OPS / 64, 1, (void)0, {
+    int64_t sum = 0;
+
+    for (size_t k = 0; k < LINE_ITEMS; ++k) {
+      sum += srt_task_data_get_int64(ctx, keys[k]);
+    }
+
+    sink += sum;
+  });
+
+  r.op = "sum_items", r.variant = "array";
+  MEASURE_BATCHED(r, OPS / 64, 1, (void)0, {
+    size_t len;
+    const int64_t *items = srt_task_data_get_int64_array(ctx, "items", &len);
+    sink += srt_int64_array_sum(items, len);
+  });
+
+  r.op = "count_items", r.variant = "vars";
+  MEASURE_BATCHED(r, OPS / 64, 1, (void)0, {
+    size_t n = 0;
+
+    for (size_t k = 0; k < LINE_ITEMS; ++k) {
+      n += srt_task_data_get_int64(ctx, keys[k]) > 500;
+    }
+
+    sink += n;
+  });
+
+  r.op = "count_items", r.variant = "array";
+  MEASURE_BATCHED(r, OPS / 64, 1, (void)0, {
+    size_t len;
+    const int64_t *items = srt_task_data_get_int64_array(ctx, "items", &len);
+    sink += srt_int64_array_count_if(items, len, SRT_CMP_GT, 500);
+  });
+
+  r.op = "append", r.variant = "int64";
+  MEASURE(r, OPS, srt_task_data_try_delete(ctx, "appended"),
+          srt_task_data_append_int64(ctx, "appended", i));
+
+  srt_ctx_free(ctx);
+  free_keys(keys, LINE_ITEMS);
+}
+
+static void bench_task_data(void) {
+  if (!selected("task_data")) {
+    return;
+  }
+
+  for (size_t c = 0; c < KEY_COUNTS; ++c) {
+    for (size_t l = 0; l < KEY_LENS; ++l) {
+      bench_task_data_ops(key_counts[c], key_lens[l]);
+    }
+  }
+
+  bench_task_data_path();
+  bench_task_data_array();
+}
+
+//
+// values and life cycle
+//
+
+static void bench_value(void) {
+  if (!selected("value")) {
+    return;
+  }
+
+  result r = {.suite = "value"};
+
+  r.op = "new_free", r.variant = "bool";
+  MEASURE(r, OPS, (void)0, {
+    srt_value *v = srt_value_new_bool(i & 1);
+    sink += v->b;
+    srt_value_free(v);
+  });
+
+  r.op = "new_free", r.variant = "int64";
+  MEASURE(r, OPS, (void)0, {
+    srt_value *v = srt_value_new_int64(i);
+    sink += v->int64;
+    srt_value_free(v);
+  });
+
+  r.op = "literal", r.variant = "int64";
+  MEASURE(r, OPS, (void)0, {
+    volatile srt_value v = SRT_VALUE(SRT_INT64, int64, i);
+    sink += v.int64;
+  });
+}
+
+static void bench_life_cycle(void) {
+  if (!selected("life_cycle")) {
+    return;
+  }
+
+  srt_context *ctx = srt_ctx_new(false);
+  result r = {.suite = "life_cycle"};
+
+  r.op = "will_run", r.variant = "quiet";
+  MEASURE(r, OPS, (void)0,
+          sink += srt_will_run_element(ctx, "Process_1", "Activity_1x2y3z"));
+
+  r.op = "did_run", r.variant = "quiet";
+  MEASURE(r, OPS, (void)0,
+          sink += srt_did_run_element(ctx, "Process_1", "Activity_1x2y3z"));
+
+  //
+  // a profiled run pairs the hooks, so one op is a will_run and a did_run on
+  // one of four elements.
+  //
+  static const char *elements[] = {"Activity_0", "Activity_1", "Gateway_2",
+                                   "Event_3"};
+  FILE *devnull = fopen("/dev/null", "w");
+  srt_ctx_profile(ctx, devnull);
+
+  r.op = "will_did_run", r.variant = "profiled";
+  MEASURE(r, OPS, (void)0, {
+    const char *element = elements[i % 4];
+    sink += srt_will_run_element(ctx, "Process_1", element);
+    sink += srt_did_run_element(ctx, "Process_1", element);
+  });
+
+  srt_ctx_free(ctx);
+  fclose(devnull);
+
+  //
+  // a traced run only pays for the copy into the ring, the writer thread
+  // takes the file system cost.
+  //
+  srt_trace *trace = srt_trace_open("/dev/null", 1 << 16);
+  ctx = srt_ctx_new(false);
+  srt_ctx_trace(ctx, trace);
+
+  r.op = "will_did_run", r.variant = "traced";
+  MEASURE(r, OPS, (void)0, {
+    const char *element = elements[i % 4];
+    sink += srt_will_run_element(ctx, "Process_1", element);
+    sink += srt_did_run_element(ctx, "Process_1", element);
+  });
+
+  srt_ctx_free(ctx);
+  srt_trace_close(trace);
+}
+
+//
+// task data images: save, load, and a get that faults the value in from the
+// mapping against one that finds it already copied out.
+//
+
+#define IMAGE_PATH "/tmp/srt_bench_task_data.img"
+#define IMAGE_KEYS 100000
+#define IMAGE_LOADS (BATCH * 4)
+
+static void bench_image(void) {
+  if (!selected("image")) {
+    return;
+  }
+
+  char **keys = make_sized_keys(IMAGE_KEYS, 24, "invoice_total_amount_");
+  srt_context *ctx = srt_ctx_new(false);
+  result r = {.suite = "image", .keys = IMAGE_KEYS, .key_len = 24};
+
+  for (size_t i = 0; i < IMAGE_KEYS; ++i) {
+    srt_task_data_set_int64(ctx, keys[i], i);
+  }
+
+  r.op = "save", r.variant = "int64";
+  MEASURE_BATCHED(r, 4, 1, (void)0,
+                  sink += srt_task_data_save(ctx, IMAGE_PATH));
+
+  r.op = "load", r.variant = "int64";
+  MEASURE(r, IMAGE_LOADS, (void)0,
+          sink += srt_task_data_load(ctx, IMAGE_PATH));
+
+  r.op = "get_int64", r.variant = "fault";
+  MEASURE(r, IMAGE_KEYS, srt_task_data_load(ctx, IMAGE_PATH),
+          sink += srt_task_data_get_int64(ctx, keys[i]));
+
+  r.op = "get_int64", r.variant = "copied";
+  MEASURE(r, IMAGE_KEYS, (void)0,
+          sink += srt_task_data_get_int64(ctx, keys[i]));
+
+  srt_ctx_free(ctx);
+  remove(IMAGE_PATH);
+  free_sized_keys(keys);
+}
+
+//
+// json: reading and writing a multi-megabyte document of orders, each with a
+// nested customer and address, from memory and to /dev/null.
+//
+
+#define JSON_ORDERS 32768
+#define JSON_DOCS 3
+
+static char *make_json_doc(size_t orders, size_t *len) {
+  size_t cap = orders * 320 + 16;
+  char *doc = malloc(cap);
+  size_t n = 0;
+
+  n += snprintf(doc + n, cap - n, "{\n");
+  for (size_t i = 0; i < orders; ++i) {
+    n += snprintf(
+        doc + n, cap - n,
+        "  \"order_%06zu\": {\"id\": %zu, \"approved\": %s, "
+        "\"total\": %ld, \"note\": \"gift wrap, \\\"fragile\\\"\\n\", "
+        "\"customer\": {\"name\": \"Customer %zu\", "
+        "\"email\": \"customer.%zu@example.com\", \"address\": "
+        "{\"street\": \"%zu Long Street Name\", \"zip\": %zu}}}%s\n",
+        i, i, i % 3 ? "true" : "false", (long)(i * 7919 % 100000) - 50000, i,
+        i, i % 997, 10000 + i % 89999, i + 1 < orders ? "," : "");
+  }
+  n += snprintf(doc + n, cap - n, "}\n");
+
+  *len = n;
+
+  return doc;
+}
+
+static void bench_json(void) {
+  if (!selected("json")) {
+    return;
+  }
+
+  size_t len;
+  char *doc = make_json_doc(JSON_ORDERS, &len);
+  srt_context *ctx = srt_ctx_new(false);
+  result r = {.suite = "json", .keys = JSON_ORDERS, .bytes = len};
+
+  r.op = "read", r.variant = "orders";
+  MEASURE_BATCHED(r, JSON_DOCS, 1, (void)0, {
+    FILE *in = fmemopen(doc, len, "r");
+    srt_ctx_reset(ctx);
+    sink += srt_task_data_read_json(ctx, in);
+    fclose(in);
+  });
+
+  char *written;
+  FILE *out = open_memstream(&written, &r.bytes);
+  srt_task_data_write_json(ctx, out);
+  fclose(out);
+  free(written);
+
+  r.op = "write", r.variant = "orders";
+  MEASURE_BATCHED(r, JSON_DOCS, 1, (void)0, {
+    FILE *out = fopen("/dev/null", "w");
+    sink += srt_task_data_write_json(ctx, out);
+    fclose(out);
+  });
+
+  srt_ctx_free(ctx);
+  free(doc);
+}
+
+//
+// batch: short instances through one reused context, the cost per instance
+// of reset, parse, run and writing its result line.
+//
+
+#define BATCH_LINES 4096
+
+static int32_t batch_start(srt_context *ctx) {
+  const int64_t order = srt_task_data_get_int64(ctx, "order");
+  srt_task_data_set_bool(ctx, "approved", order & 1);
+
+  return 0;
+}
+
+static void bench_batch(void) {
+  if (!selected("batch")) {
+    return;
+  }
+
+  size_t len = 0;
+  char *lines = malloc(BATCH_LINES * 64);
+
+  for (size_t i = 0; i < BATCH_LINES; ++i) {
+    len += sprintf(lines + len, "{\"order\":%zu,\"customer\":\"c%zu\"}\n", i,
+                   i);
+  }
+
+  srt_context *ctx = srt_ctx_new(false);
+  FILE *out = fopen("/dev/null", "w");
+  srt_batch_stats stats;
+  result r = {
+      .suite = "batch", .keys = BATCH_LINES, .bytes = len / BATCH_LINES};
+
+  //
+  // one op is one instance, the whole file runs on the first op of each
+  // batch so the sample is divided across its lines.
+  //
+  r.op = "run", r.variant = "instance";
+  MEASURE_BATCHED(r, BATCH_LINES * 4, BATCH_LINES, (void)0, {
+    if (i % BATCH_LINES == 0) {
+      FILE *in = fmemopen(lines, len, "r");
+      sink += srt_batch_run(ctx, in, out, batch_start, &stats);
+      fclose(in);
+    }
+  });
+
+  //
+  // the pool on every core, output collected per instance and written in
+  // order at the end.
+  //
+  const size_t jobs = srt_pool_default_jobs();
+  char variant[32];
+  snprintf(variant, sizeof(variant), "pool_%zu", jobs);
+
+  r.op = "run", r.variant = variant;
+  MEASURE_BATCHED(r, BATCH_LINES * 4, BATCH_LINES, (void)0, {
+    if (i % BATCH_LINES == 0) {
+      FILE *in = fmemopen(lines, len, "r");
+      sink += srt_pool_run(ctx, in, out, batch_start, jobs, &stats);
+      fclose(in);
+    }
+  });
+
+  fclose(out);
+  srt_ctx_free(ctx);
+  free(lines);
+}
+
+//
+// parallel gateways: fork and join of branches that each read one key of the
+// parent and write one back, so mostly the cost of threads and the merge.
+//
+
+static int32_t branch_read_write(srt_context *ctx) {
+  const int64_t total = srt_task_data_get_int64(ctx, "order_total");
+  srt_task_data_set_bool(ctx, "approved", total > 100);
+
+  return 0;
+}
+
+static void bench_parallel(void) {
+  if (!selected("parallel")) {
+    return;
+  }
+
+  static const srt_branch branches[] = {branch_read_write, branch_read_write,
+                                        branch_read_write, branch_read_write};
+  static const char *variants[] = {"1_branch", "2_branches", "4_branches"};
+  srt_context *ctx = srt_ctx_new(false);
+  result r = {.suite = "parallel", .op = "fork_join"};
+
+  srt_task_data_set_int64(ctx, "order_total", 250);
+
+  for (size_t v = 0, n = 1; n <= 4; ++v, n *= 2) {
+    r.variant = variants[v];
+    MEASURE_BATCHED(r, 1024, 16, (void)0,
+                    sink += srt_run_parallel(ctx, branches, n,
+                                             SRT_MERGE_LAST_WINS));
+  }
+
+  srt_ctx_free(ctx);
+}
+
+//
+// snapshots: one element's worth of writes followed by a snapshot, against
+// the deep copy of task data that a snapshot took before, and what keeping
+// the persistent copy up to date adds to a set.
+//
+
+#define SNAPSHOT_KEYS 1024
+#define KEPT 64
+
+static srt_dict *copy_task_data(const srt_context *ctx) {
+  srt_dict *copy = srt_dict_new(SNAPSHOT_KEYS * 2);
+  size_t pos = 0;
+
+  for (srt_dict_item *item; (item = srt_dict_next(ctx->task_data, &pos));) {
+    srt_dict_put(copy, srt_dict_item_key(item), item->value);
+  }
+
+  return copy;
+}
+
+static void bench_snapshot(void) {
+  if (!selected("snapshot")) {
+    return;
+  }
+
+  char **keys = make_keys(SNAPSHOT_KEYS, "order_item");
+  srt_context *ctx = srt_ctx_new(false);
+  result r = {.suite = "snapshot", .keys = SNAPSHOT_KEYS, .key_len = 24};
+
+  for (size_t i = 0; i < SNAPSHOT_KEYS; ++i) {
+    srt_task_data_set_int64(ctx, keys[i], i);
+  }
+
+  r.op = "set";
+  r.variant = "plain";
+  MEASURE(r, OPS, (void)0,
+          srt_task_data_set_int64(ctx, keys[i % SNAPSHOT_KEYS], i));
+
+  srt_snapshot_free(srt_ctx_snapshot(ctx));
+
+  r.variant = "history";
+  MEASURE(r, OPS, (void)0,
+          srt_task_data_set_int64(ctx, keys[i % SNAPSHOT_KEYS], i));
+
+  r.op = "set_and_snapshot";
+  r.variant = "deep_copy";
+  MEASURE_BATCHED(r, 4096, 16, (void)0, {
+    srt_task_data_set_int64(ctx, keys[i % SNAPSHOT_KEYS], i);
+    srt_dict_free(copy_task_data(ctx));
+  });
+
+  //
+  // the last KEPT snapshots stay alive, so every set copies its path.
+  //
+  srt_snapshot *kept[KEPT] = {0};
+
+  r.variant = "hamt";
+  MEASURE(r, OPS, (void)0, {
+    srt_task_data_set_int64(ctx, keys[i % SNAPSHOT_KEYS], i);
+    srt_snapshot_free(kept[i % KEPT]);
+    kept[i % KEPT] = srt_ctx_snapshot(ctx);
+  });
+
+  for (size_t i = 0; i < KEPT; ++i) {
+    srt_snapshot_free(kept[i]);
+  }
+
+  srt_ctx_free(ctx);
+  free_keys(keys, SNAPSHOT_KEYS);
+}
+
+//
+// journal: an element that sets ELEMENT_SETS keys and commits, by how many
+// commits share a write and whether the write is synced to disk.
+//
+
+#define JOURNAL_PATH "/tmp/srt_bench.journal"
+#define ELEMENT_SETS 8
+
+static void bench_journal(void) {
+  if (!selected("journal")) {
+    return;
+  }
+
+  static const size_t groups[] = {1, 16, 256};
+  static const char *variants[] = {"group_1", "group_16", "group_256"};
+  static const char *synced_variants[] = {"group_1_sync", "group_16_sync",
+                                          "group_256_sync"};
+  char **keys = make_keys(ELEMENT_SETS, "order_item");
+  result r = {
+      .suite = "journal", .op = "element", .keys = ELEMENT_SETS, .key_len = 24};
+
+  for (int sync = 0; sync < 2; ++sync) {
+    for (size_t g = 0; g < 3; ++g) {
+      srt_context *ctx = srt_ctx_new(false);
+      remove(JOURNAL_PATH);
+      srt_ctx_journal(ctx, JOURNAL_PATH, sync, groups[g]);
+
+      r.variant = sync ? synced_variants[g] : variants[g];
+      MEASURE_BATCHED(r, sync ? 2048 : OPS, 16, (void)0, {
+        for (size_t k = 0; k < ELEMENT_SETS; ++k) {
+          srt_task_data_set_int64(ctx, keys[k], i);
+        }
+        srt_did_run_element(ctx, "Process_1", "Task_1");
+      });
+
+      srt_ctx_free(ctx);
+    }
+  }
+
+  remove(JOURNAL_PATH);
+  free_keys(keys, ELEMENT_SETS);
+}
+
+//
+// server: an instance over a connection to a running server, one request at a
+// time and BATCH_LINES written ahead of their replies, against spawning a
+// process that does nothing, the least a fork and exec per instance costs.
+//
+
+#define SOCKET_PATH "/tmp/srt_bench.sock"
+
+extern char **environ;
+
+static void *serve(void *server) {
+  srt_batch_stats stats;
+  srt_server_run(server, &stats);
+  return NULL;
+}
+
+static int connect_to(const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  strcpy(addr.sun_path, path);
+  connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+
+  return fd;
+}
+
+//
+// reads until `lines` replies have come in, each a line of its own.
+//
+static void read_lines(int fd, size_t lines) {
+  char chunk[64 * 1024];
+
+  while (lines > 0) {
+    const ssize_t n = read(fd, chunk, sizeof(chunk));
+
+    if (n <= 0) {
+      return;
+    }
+
+    for (ssize_t k = 0; k < n; ++k) {
+      lines -= chunk[k] == '\n';
+    }
+  }
+}
+
+static void spawn_true(void) {
+  static char *argv[] = {"true", NULL};
+  pid_t pid;
+
+  if (posix_spawn(&pid, "/bin/true", NULL, NULL, argv, environ) == 0) {
+    waitpid(pid, NULL, 0);
+  }
+}
+
+static void bench_server(void) {
+  if (!selected("server")) {
+    return;
+  }
+
+  static const char request[] = "{\"order\":7,\"customer\":\"c7\"}\n";
+  const size_t request_len = sizeof(request) - 1;
+  char *lines = malloc(BATCH_LINES * request_len);
+
+  for (size_t i = 0; i < BATCH_LINES; ++i) {
+    memcpy(lines + i * request_len, request, request_len);
+  }
+
+  srt_context *ctx = srt_ctx_new(false);
+  srt_server *server = srt_server_open(ctx, SOCKET_PATH, batch_start,
+                                       srt_pool_default_jobs());
+  pthread_t thread;
+
+  if (!server || pthread_create(&thread, NULL, serve, server) != 0) {
+    fprintf(stderr, "cannot start a server on '%s'\n", SOCKET_PATH);
+    exit(1);
+  }
+
+  const int fd = connect_to(SOCKET_PATH);
+  result r = {.suite = "server", .op = "instance", .bytes = request_len};
+
+  r.variant = "round_trip";
+  MEASURE_BATCHED(r, 16384, 16, (void)0, {
+    sink += write(fd, request, request_len);
+    read_lines(fd, 1);
+  });
+
+  r.variant = "pipelined";
+  MEASURE_BATCHED(r, BATCH_LINES * 4, BATCH_LINES, (void)0, {
+    if (i % BATCH_LINES == 0) {
+      sink += write(fd, lines, BATCH_LINES * request_len);
+      read_lines(fd, BATCH_LINES);
+    }
+  });
+
+  r.variant = "spawn";
+  MEASURE_BATCHED(r, 256, 16, (void)0, spawn_true());
+
+  close(fd);
+  srt_server_stop(server);
+  pthread_join(thread, NULL);
+  srt_server_close(server);
+  srt_ctx_free(ctx);
+  free(lines);
+}
+
+//
+// dict layout: srt_dict against the linear probing baseline at a fixed
+// capacity, so the key count sets the load factor.
+//
+
+static void bench_layout_load_factor(double load_factor) {
+  const size_t count = CAPACITY * load_factor;
+  char **keys = make_keys(count, "order_item");
+  char **misses = make_keys(count, "missing");
+  result r = {.suite = "dict_layout",
+              .keys = count,
+              .key_len = strlen(keys[count - 1])};
+
+  linear lt = {.mask = CAPACITY - 1,
+               .items = calloc(CAPACITY, sizeof(linear_item))};
+  for (size_t i = 0; i < count; ++i) {
+    linear_put(&lt, keys[i], SRT_VALUE(SRT_INT64, int64, i));
+  }
+
+  r.variant = "linear";
+  r.op = "hit";
+  MEASURE(r, count, (void)0, sink += linear_get(&lt, keys[i])->int64);
+  r.op = "miss";
+  MEASURE(r, count, (void)0, sink += linear_get(&lt, misses[i]) != NULL);
+  r.op = "set";
+  MEASURE(r, count, (void)0,
+          linear_put(&lt, keys[i], SRT_VALUE(SRT_INT64, int64, i)));
+
+  linear_free(&lt);
+
+  srt_dict *d = srt_dict_new(CAPACITY);
+  for (size_t i = 0; i < count; ++i) {
+    srt_dict_put(d, keys[i], SRT_VALUE(SRT_INT64, int64, i));
+  }
+
+  r.variant = "swiss";
+  r.op = "hit";
+  MEASURE(r, count, (void)0, sink += srt_dict_get(d, keys[i])->int64);
+  r.op = "miss";
+  MEASURE(r, count, (void)0, sink += srt_dict_get(d, misses[i]) != NULL);
+  r.op = "set";
+  MEASURE(r, count, (void)0,
+          srt_dict_put(d, keys[i], SRT_VALUE(SRT_INT64, int64, i)));
+
+  srt_dict_free(d);
+
+  free_keys(keys, count);
+  free_keys(misses, count);
+}
+
+static void bench_layout(void) {
+  if (!selected("dict_layout")) {
+    return;
+  }
+
+  const double load_factors[] = {0.25, 0.5, 0.75, 0.85};
+  for (size_t i = 0; i < sizeof(load_factors) / sizeof(*load_factors); ++i) {
+    bench_layout_load_factor(load_factors[i]);
+  }
+}
+
+//
+// hashing
+//
+
+#define NAME_COUNT 50000
+
+//
+// fnv1a as hash_str had it: the pointer is bumped before the first read, so
+// the first byte never reaches the hash.
+//
+static uint64_t fnv1a_skip_first(const char *str, uint64_t seed) {
+  uint64_t hash = 0xcbf29ce484222325;
+  const unsigned char *bytes = (const unsigned char *)str;
+
+  while (*bytes++) {
+    hash ^= *bytes;
+    hash *= 0x100000001b3;
+  }
+
+  return hash;
+}
+
+static uint64_t fnv1a_seeded(const char *str, uint64_t seed) {
+  return fnv1a(str) ^ seed;
+}
+
+typedef struct hash_fn {
+  const char *name;
+  uint64_t (*fn)(const char *, uint64_t);
+} hash_fn;
+
+static const hash_fn hash_fns[] = {
+    {"fnv1a-old", fnv1a_skip_first},
+    {"fnv1a", fnv1a_seeded},
+    {"srt_hash", srt_hash_str},
+};
+
+//
+// names shaped like what BPMN modelers generate: element ids with a random
+// base36 suffix, and snake_case process variables built from domain words.
+//
+static char **make_bpmn_names(size_t count) {
+  static const char *elements[] = {"Activity", "Event", "Gateway", "Flow",
+                                   "DataObject"};
+  static const char *words[] = {
+      "order",   "customer", "invoice", "amount",  "total",    "status",
+      "approved", "id",      "line",    "items",   "count",    "is",
+      "valid",   "manager",  "review",  "result",  "date",     "due",
+      "payment", "shipping", "address", "risk",    "score",    "level"};
+  const size_t word_count = sizeof(words) / sizeof(*words);
+
+  char **names = malloc(count * sizeof(*names));
+  srt_dict *seen = srt_dict_new(64);
+  uint64_t rng = 0x9e3779b97f4a7c15;
+  char buf[64];
+
+  for (size_t i = 0; i < count;) {
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+
+    if (rng % 3 == 0) {
+      int n = snprintf(buf, sizeof(buf), "%s_", elements[rng % 5]);
+      uint64_t id = rng >> 8;
+      for (int c = 0; c < 7; ++c, id /= 36) {
+        buf[n++] = "0123456789abcdefghijklmnopqrstuvwxyz"[id % 36];
+      }
+      buf[n] = '\0';
+    } else {
+      int n = 0;
+      const int parts = 2 + (rng >> 4) % 3;
+      for (int p = 0; p < parts; ++p) {
+        n += snprintf(buf + n, sizeof(buf) - n, p ? "_%s" : "%s",
+                      words[(rng >> (8 + p * 8)) % word_count]);
+      }
+    }
+
+    if (!srt_dict_get(seen, buf)) {
+      srt_dict_put(seen, buf, SRT_VALUE(SRT_BOOL, b, true));
+      names[i++] = strdup(buf);
+    }
+  }
+
+  srt_dict_free(seen);
+
+  return names;
+}
+
+#define PROBE_BUCKETS 6
+
+static const char *probe_bucket_names[PROBE_BUCKETS] = {"1",   "2",    "3",
+                                                        "4-8", "9-16", ">16"};
+
+static int probe_bucket(size_t len) {
+  return len <= 3 ? len - 1 : len <= 8 ? 3 : len <= 16 ? 4 : 5;
+}
+
+//
+// inserts every name into a linear probing table at 3/4 load and reports how
+// far each one landed from its home slot. `shift` picks which hash bits form
+// the slot index: 0 for the low bits, 7 for the bits srt_dict uses.
+//
+static void probe_distribution(const hash_fn *h, char **names, size_t count,
+                               int shift) {
+  size_t cap = 1;
+  while (cap * 3 < count * 4) {
+    cap <<= 1;
+  }
+
+  const uint64_t seed = srt_hash_seed();
+  bool *used = calloc(cap, sizeof(*used));
+  size_t histogram[PROBE_BUCKETS] = {0};
+  size_t total = 0;
+  size_t max = 0;
+
+  for (size_t i = 0; i < count; ++i) {
+    size_t slot = (h->fn(names[i], seed) >> shift) & (cap - 1);
+    size_t len = 1;
+
+    for (; used[slot]; slot = (slot + 1) & (cap - 1)) {
+      len++;
+    }
+
+    used[slot] = true;
+    total += len;
+    max = len > max ? len : max;
+    histogram[probe_bucket(len)]++;
+  }
+
+  printf("%-10s  %5s  %6.2f  %5zu", h->name, shift ? "high" : "low",
+         (double)total / count, max);
+  for (int b = 0; b < PROBE_BUCKETS; ++b) {
+    printf("  %5.1f%%", 100.0 * histogram[b] / count);
+  }
+  printf("\n");
+
+  free(used);
+}
+
+//
+// counts 64 bit collisions over the names plus a copy of each with the case
+// of its first letter flipped, e.g. order_total and Order_total.
+//
+static size_t full_collisions(const hash_fn *h, char **names, size_t count) {
+  srt_dict *seen = srt_dict_new(64);
+  const uint64_t seed = srt_hash_seed();
+  size_t collisions = 0;
+  char buf[32];
+  char flipped[64];
+
+  for (size_t i = 0; i < count * 2; ++i) {
+    const char *name = names[i % count];
+
+    if (i >= count) {
+      snprintf(flipped, sizeof(flipped), "%s", name);
+      flipped[0] ^= 0x20;
+      name = flipped;
+    }
+
+    snprintf(buf, sizeof(buf), "%016lx", h->fn(name, seed));
+
+    if (srt_dict_get(seen, buf)) {
+      collisions++;
+    } else {
+      srt_dict_put(seen, buf, SRT_VALUE(SRT_BOOL, b, true));
+    }
+  }
+
+  srt_dict_free(seen);
+
+  return collisions;
+}
+
+//
+// copies the names back to back so the timing loop measures hashing rather
+// than cache misses on scattered allocations.
+//
+static char **pack_names(char **names, size_t count, char **storage) {
+  size_t bytes = 0;
+  for (size_t i = 0; i < count; ++i) {
+    bytes += strlen(names[i]) + 1;
+  }
+
+  char **packed = malloc(count * sizeof(*packed));
+  char *p = *storage = malloc(bytes);
+
+  for (size_t i = 0; i < count; ++i) {
+    const size_t len = strlen(names[i]) + 1;
+    memcpy(p, names[i], len);
+    packed[i] = p;
+    p += len;
+  }
+
+  return packed;
+}
+
+static void bench_hash(void) {
+  if (!selected("hash")) {
+    return;
+  }
+
+  char **names = make_bpmn_names(NAME_COUNT);
+  const size_t hash_fn_count = sizeof(hash_fns) / sizeof(*hash_fns);
+  size_t bytes = 0;
+
+  for (size_t i = 0; i < NAME_COUNT; ++i) {
+    bytes += strlen(names[i]);
+  }
+
+  char *storage;
+  char **packed = pack_names(names, NAME_COUNT, &storage);
+  result r = {.suite = "hash",
+              .op = "hash_str",
+              .keys = NAME_COUNT,
+              .key_len = (bytes + NAME_COUNT / 2) / NAME_COUNT};
+
+  for (size_t f = 0; f < hash_fn_count; ++f) {
+    const hash_fn *h = &hash_fns[f];
+
+    r.variant = h->name;
+    MEASURE(r, NAME_COUNT, (void)0, sink += h->fn(packed[i], i));
+  }
+
+  free(packed);
+  free(storage);
+
+  //
+  // collisions and probe lengths are not timings, they only make it into the
+  // human readable report.
+  //
+  if (out_format == FORMAT_TEXT) {
+    printf("\nhash quality (%d bpmn names)\n\n", NAME_COUNT);
+    printf("hash        collisions\n");
+    for (size_t f = 0; f < hash_fn_count; ++f) {
+      printf("%-10s  %10zu\n", hash_fns[f].name,
+             full_collisions(&hash_fns[f], names, NAME_COUNT));
+    }
+
+    printf("\nprobe length at 0.75 load\n\n");
+    printf("hash         bits    mean    max");
+    for (int b = 0; b < PROBE_BUCKETS; ++b) {
+      printf("  %6s", probe_bucket_names[b]);
+    }
+    printf("\n");
+
+    for (size_t f = 0; f < hash_fn_count; ++f) {
+      probe_distribution(&hash_fns[f], names, NAME_COUNT, 0);
+      probe_distribution(&hash_fns[f], names, NAME_COUNT, 7);
+    }
+  }
+
+  free_keys(names, NAME_COUNT);
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--format text|json|csv] [--suite name]\n\n"
+          "suites: dict, task_data, value, life_cycle, image, json, batch, "
+          "parallel, snapshot, journal, server, dict_layout, hash\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      const char *f = argv[++i];
+      if (strcmp(f, "text") == 0) {
+        out_format = FORMAT_TEXT;
+      } else if (strcmp(f, "json") == 0) {
+        out_format = FORMAT_JSON;
+      } else if (strcmp(f, "csv") == 0) {
+        out_format = FORMAT_CSV;
+      } else {
+        usage(argv[0]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--suite") == 0 && i + 1 < argc) {
+      only_suite = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  switch (out_format) {
+  case FORMAT_TEXT:
+    printf("libsrt_cli.a benchmarks\n");
+    break;
+  case FORMAT_JSON:
+    printf("{\n  \"unit\": \"ns/op\",\n  \"batch\": %d,\n  \"passes\": %d,\n"
+           "  \"results\": [",
+           BATCH, PASSES);
+    break;
+  case FORMAT_CSV:
+    printf("suite,op,variant,keys,key_len,ops,mean_ns,p50_ns,p99_ns,mb_s\n");
+    break;
+  }
+
+  bench_dict();
+  bench_task_data();
+  bench_value();
+  bench_life_cycle();
+  bench_image();
+  bench_json();
+  bench_batch();
+  bench_parallel();
+  bench_snapshot();
+  bench_journal();
+  bench_server();
+  bench_layout();
+  bench_hash();
+
+  if (out_format == FORMAT_JSON) {
+    printf("\n  ]\n}\n");
+  } else if (out_format == FORMAT_TEXT) {
+    printf("\n");
+  }
+
+  return 0;
+}
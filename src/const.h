@@ -1,3 +1,5 @@
+#pragma once
+
 #include <stdint.h>
 
 #define RESULT(n, v) static const uint32_t SRT_##n = v
@@ -6,3 +8,9 @@ RESULT(SUCCESS, 0);
 RESULT(UNKNOWN_KEY, 1);
 RESULT(KEY_TYPE_MISMATCH, 2);
 RESULT(UNKNOWN_ERROR, 3);
+RESULT(IO_ERROR, 4);
+RESULT(INVALID_IMAGE, 5);
+RESULT(INVALID_JSON, 6);
+RESULT(MERGE_CONFLICT, 7);
+RESULT(INVALID_JOURNAL, 8);
+RESULT(SUSPENDED, 9);
@@ -1,27 +1,276 @@
 #include "ctx.h"
+#include "arena.h"
+#include "array.h"
 #include "dict.h"
+#include "hash.h"
+#include "image.h"
+#include "journal.h"
+#include "log.h"
+#include "overlay.h"
+#include "profile.h"
+#include "snapshot.h"
+#include "suspend.h"
+#include "trace.h"
 #include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define TASK_DATA_CAPACITY 64
+#define MAX_DEPTH 64
 
 srt_context *srt_ctx_new(bool verbose) {
+  return srt_ctx_new_seeded(verbose, srt_hash_seed());
+}
+
+srt_context *srt_ctx_new_seeded(bool verbose, uint64_t seed) {
   srt_context *ctx = calloc(1, sizeof(*ctx));
   if (!ctx) {
     return NULL;
   }
 
-  ctx->verbose = verbose;
+  ctx->seed = seed;
+  ctx->out = stdout;
+
+  ctx->arena = srt_arena_new(ARENA_BLOCK_SIZE);
+  if (!ctx->arena) {
+    free(ctx);
+    return NULL;
+  }
 
-  ctx->task_data = srt_dict_new(64);
+  ctx->task_data = srt_dict_new_in(ctx->arena, TASK_DATA_CAPACITY, seed);
   if (!ctx->task_data) {
+    srt_arena_free(ctx->arena);
     free(ctx);
     return NULL;
   }
 
+  if (verbose && !srt_ctx_log(ctx, SRT_LOG_DEBUG, stdout)) {
+    srt_ctx_free(ctx);
+    return NULL;
+  }
+
   return ctx;
 }
 
+void srt_ctx_report_stats(const srt_context *ctx, FILE *out) {
+  srt_ctx_stats s;
+  srt_dict_stats d;
+
+  srt_ctx_get_stats(ctx, &s);
+  srt_dict_get_stats(ctx->task_data, &d);
+
+  fprintf(out,
+          "memory: %zu vars, %zu dicts, %zu key bytes, %zu value bytes, "
+          "%zu dict bytes\n",
+          s.vars, s.dicts, s.key_bytes, s.value_bytes, s.dict_bytes);
+  fprintf(out,
+          "arena: %zu bytes in %zu allocations, %zu reserved, %zu peak\n",
+          s.arena_bytes, s.allocs, s.reserved_bytes, s.peak_bytes);
+  fprintf(out,
+          "task data dict: capacity %zu, load %.2f, %zu tombstones, "
+          "probes avg %.2f max %zu, histogram",
+          d.capacity, d.load_factor, d.tombstones, d.avg_probe, d.max_probe);
+
+  for (int i = 0; i < SRT_DICT_PROBE_HISTOGRAM; ++i) {
+    fprintf(out, " %zu", d.probe_histogram[i]);
+  }
+
+  fprintf(out, "\n");
+}
+
+//
+// everything task data allocated lives in the arena, so teardown is a walk of
+// its blocks rather than of every key and value. a profiled context reports
+// the memory of its last instance along with the timings. branches and
+// workers hand their profiles over before they go, so only the context that
+// owns a run reports.
+//
 void srt_ctx_free(srt_context *ctx) {
-  srt_dict_free(ctx->task_data);
+  srt_log_free(ctx->log);
+
+  if (ctx->profile) {
+    srt_profile_report(ctx->profile);
+    srt_ctx_report_stats(ctx, ctx->profile->out);
+    srt_profile_free(ctx->profile);
+  }
+
+  srt_journal_close(ctx->journal);
+  srt_history_free(ctx->history);
+  srt_suspension_free(ctx->suspension);
+  srt_overlay_free(ctx->overlay);
+  srt_image_close(ctx->image);
+  srt_arena_free(ctx->arena);
   free(ctx);
 }
 
-bool srt_ctx_verbose(const srt_context *ctx) { return ctx->verbose; }
+//
+// a worker shares the trace of its parent but nothing it writes to itself,
+// its log goes to `out` along with its manual task output.
+//
+srt_context *srt_ctx_new_worker(const srt_context *parent, FILE *out) {
+  srt_context *ctx = srt_ctx_new_seeded(false, parent->seed);
+
+  if (!ctx) {
+    return NULL;
+  }
+
+  ctx->out = out;
+  srt_ctx_trace(ctx, parent->trace);
+
+  if ((parent->suspension && !srt_ctx_suspendable(ctx)) ||
+      (parent->log_level != SRT_LOG_OFF &&
+       !srt_ctx_log(ctx, parent->log_level, out)) ||
+      (parent->profile && !srt_ctx_profile(ctx, NULL))) {
+    srt_ctx_free(ctx);
+    return NULL;
+  }
+
+  return ctx;
+}
+
+void srt_ctx_free_worker(srt_context *ctx, srt_context *parent) {
+  if (ctx && ctx->profile) {
+    srt_profile_merge(parent->profile, ctx->profile);
+    srt_profile_free(ctx->profile);
+    ctx->profile = NULL;
+  }
+
+  if (ctx) {
+    srt_ctx_free(ctx);
+  }
+}
+
+void srt_ctx_reset(srt_context *ctx) {
+  srt_image_close(ctx->image);
+  ctx->image = NULL;
+
+  srt_history_invalidate(ctx->history);
+  srt_journal_reset(ctx->journal);
+  srt_suspension_reset(ctx->suspension);
+
+  if (ctx->profile) {
+    srt_profile_abandon(ctx->profile);
+  }
+
+  srt_arena_reset(ctx->arena);
+  ctx->task_data = srt_dict_new_in(ctx->arena, TASK_DATA_CAPACITY, ctx->seed);
+}
+
+//
+// the key is copied into the arena, it may live in a frame the jump leaves.
+//
+void srt_ctx_panic(const srt_context *ctx, int32_t result, const char *func,
+                   const char *message, const char *key) {
+  srt_panic *panic = ctx->panic;
+
+  if (panic) {
+    const size_t len = strlen(key) + 1;
+    char *copy = srt_arena_alloc(ctx->arena, len);
+
+    panic->result = result;
+    panic->message = message;
+    panic->key = copy ? memcpy(copy, key, len) : "";
+    SRT_LOG(ctx, SRT_LOG_ERROR, "%s '%s'\n", message, key);
+    longjmp(panic->env, 1);
+  }
+
+  srt_log_flush(ctx->log);
+  fprintf(stderr, "Panic in %s: %s '%s'\n", func, message, key);
+  exit(result);
+}
+
+bool srt_ctx_verbose(const srt_context *ctx) {
+  return ctx->log_level >= SRT_LOG_INFO;
+}
+
+//
+// sends diagnostics up to `level` to `out`. verbose contexts log everything
+// to stdout, SRT_LOG_OFF silences a context without giving up its buffer.
+//
+bool srt_ctx_log(srt_context *ctx, srt_log_level level, FILE *out) {
+  if (ctx->log) {
+    srt_log_flush(ctx->log);
+    ctx->log->out = out;
+  } else if (!(ctx->log = srt_log_new(out))) {
+    return false;
+  }
+
+  ctx->log_level = level;
+
+  return true;
+}
+
+//
+// times every element run through the life-cycle hooks from here on and
+// writes a summary to `out` when the context is freed. the timings carry over
+// srt_ctx_reset, so a context reused across instances reports all of them.
+//
+bool srt_ctx_profile(srt_context *ctx, FILE *out) {
+  if (ctx->profile) {
+    ctx->profile->out = out;
+    return true;
+  }
+
+  return (ctx->profile = srt_profile_new(out)) != NULL;
+}
+
+//
+// the trace is not owned by the context, several contexts may share one. it
+// must stay open until every context writing to it is freed or detached with
+// a NULL trace. each context attached gets an id of its own for its events.
+//
+void srt_ctx_trace(srt_context *ctx, srt_trace *trace) {
+  ctx->trace = trace;
+  ctx->trace_id = trace ? srt_trace_new_id(trace) : 0;
+}
+
+srt_dict *srt_ctx_dict_new(const srt_context *ctx, size_t capacity) {
+  return srt_dict_new_in(ctx->arena, capacity, ctx->seed);
+}
+
+static void measure(const srt_dict *dict, srt_ctx_stats *stats, int depth) {
+  srt_dict_stats d;
+  size_t pos = 0;
+
+  srt_dict_get_stats(dict, &d);
+  stats->dicts++;
+  stats->dict_bytes += d.bytes;
+
+  for (srt_dict_item *item; (item = srt_dict_next(dict, &pos));) {
+    const srt_value *v = &item->value;
+
+    if (!item->key_inline) {
+      stats->key_bytes += strlen(item->key.ptr) + 1;
+    }
+
+    switch (v->tag) {
+    case SRT_STR:
+      stats->value_bytes += v->str_inline || !v->str ? 0 : strlen(v->str) + 1;
+      break;
+    case SRT_INT64_ARRAY:
+    case SRT_DOUBLE_ARRAY:
+      stats->value_bytes +=
+          sizeof(*v->array) + v->array->cap * SRT_ARRAY_ELEM;
+      break;
+    case SRT_DICT:
+      if (v->dict && depth < MAX_DEPTH) {
+        measure(v->dict, stats, depth + 1);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void srt_ctx_get_stats(const srt_context *ctx, srt_ctx_stats *stats) {
+  *stats = (srt_ctx_stats){
+      .vars = srt_dict_len(ctx->task_data),
+      .allocs = ctx->arena->allocs,
+      .arena_bytes = ctx->arena->used,
+      .reserved_bytes = ctx->arena->reserved,
+      .peak_bytes = ctx->arena->peak,
+  };
+
+  measure(ctx->task_data, stats, 0);
+}
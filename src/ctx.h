@@ -1,14 +1,103 @@
+#pragma once
+
+#include "log.h"
+#include "types.h"
+#include <setjmp.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
+typedef struct srt_arena srt_arena;
 typedef struct srt_dict srt_dict;
+typedef struct srt_history srt_history;
+typedef struct srt_image srt_image;
+typedef struct srt_journal srt_journal;
+typedef struct srt_overlay srt_overlay;
+typedef struct srt_profile srt_profile;
+typedef struct srt_suspension srt_suspension;
+typedef struct srt_trace srt_trace;
+
+//
+// where a failed get or set of the panicking task data accessors goes while
+// a batch runs an instance: back to the runner, which reports the failure in
+// the result line of the instance and carries on with the next.
+//
+
+typedef struct srt_panic {
+  jmp_buf env;
+  int32_t result;
+  const char *message;
+  const char *key;
+} srt_panic;
 
 typedef struct srt_context {
-  bool verbose;
+  srt_log_level log_level;
+  uint64_t seed;
+  srt_arena *arena;
   srt_dict *task_data;
+  srt_image *image;
+  srt_overlay *overlay;
+  srt_profile *profile;
+  srt_trace *trace;
+  uint32_t trace_id;
+  srt_log *log;
+  srt_history *history;
+  srt_journal *journal;
+  srt_suspension *suspension;
+  srt_panic *panic;
+  FILE *out;
 } srt_context;
 
 srt_context *srt_ctx_new(bool verbose);
 
+srt_context *srt_ctx_new_seeded(bool verbose, uint64_t seed);
+
 void srt_ctx_free(srt_context *ctx);
 
+void srt_ctx_reset(srt_context *ctx);
+
+//
+// a context for a worker thread, set up like `parent` with its seed, log
+// level, trace, profiling and suspension but writing to `out`. freeing it
+// merges its profile into the one of `parent`.
+//
+srt_context *srt_ctx_new_worker(const srt_context *parent, FILE *out);
+
+void srt_ctx_free_worker(srt_context *ctx, srt_context *parent);
+
+//
+// ends the instance on `ctx` with `result`: through its panic when it has
+// one, else by exiting the process.
+//
+_Noreturn void srt_ctx_panic(const srt_context *ctx, int32_t result,
+                             const char *func, const char *message,
+                             const char *key);
+
 bool srt_ctx_verbose(const srt_context *ctx);
+
+bool srt_ctx_log(srt_context *ctx, srt_log_level level, FILE *out);
+
+bool srt_ctx_profile(srt_context *ctx, FILE *out);
+
+void srt_ctx_trace(srt_context *ctx, srt_trace *trace);
+
+srt_dict *srt_ctx_dict_new(const srt_context *ctx, size_t capacity);
+
+//
+// the memory of an instance. keys, values and dicts are counted by walking
+// task data, wherever they live: long keys and strs and the elements of
+// arrays out of their slots, the tables of task data and every dict nested
+// in it. the arena counts what it handed out and in how many allocations
+// since the instance began, the bytes its blocks hold, and the most it ever
+// handed out at once over the life of the context. snapshots, journals and
+// branch overlays are not counted.
+//
+
+void srt_ctx_get_stats(const srt_context *ctx, srt_ctx_stats *stats);
+
+//
+// writes the stats of the context and of its task data dict to `out`, a line
+// each, as a profiled context does when it is freed.
+//
+void srt_ctx_report_stats(const srt_context *ctx, FILE *out);
@@ -1,4 +1,6 @@
 #include "dict.h"
+#include "arena.h"
+#include "hash.h"
 #include "value.h"
 #include <stdarg.h>
 #include <stddef.h>
@@ -7,44 +9,163 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define PROBE(f, b)                                                            \
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+//
+// grow once live + deleted slots pass 7/8 of the table, and move at most
+// this many old slots per operation while a rehash is in flight.
+//
+#define LOAD_FACTOR_NUM 7
+#define LOAD_FACTOR_DEN 8
+#define REHASH_STEP 32
+
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xfe
+
+#define H1(h) ((h) >> 7)
+#define H2(h) ((uint8_t)((h) & 0x7f))
+
+#define FULL(c) ((c) < CTRL_EMPTY)
+
+//
+// visits the groups of a table in triangular order, which reaches every group
+// when the group count is a power of two. `group` is the first slot index of
+// the group and `ctrl` its control bytes.
+//
+#define PROBE(t, h, b)                                                         \
   do {                                                                         \
-    const uint64_t hash = hash_str(key);                                       \
-    const size_t slot = hash & dict->mask;                                     \
-    size_t i = slot;                                                           \
-    do {                                                                       \
-      srt_dict_item *item = &dict->items[i];                                   \
+    size_t g = H1(h) & (t)->mask;                                              \
+    for (size_t n = 1; n <= (t)->mask + 1; g = (g + n++) & (t)->mask) {        \
+      const size_t group = g * SRT_DICT_GROUP;                                 \
+      const uint8_t *ctrl = &(t)->ctrl[group];                                 \
       b;                                                                       \
-      i = (i + 1) & dict->mask;                                                \
-      if (i == slot) {                                                         \
-        return f;                                                              \
-      }                                                                        \
-    } while (1);                                                               \
+    }                                                                          \
   } while (0)
 
-srt_dict *srt_dict_new(const size_t capacity) {
+#define EACH_BIT(m, b)                                                         \
+  for (uint32_t bits = (m); bits; bits &= bits - 1) {                          \
+    const size_t bit = __builtin_ctz(bits);                                    \
+    b;                                                                         \
+  }
+
+#if defined(__SSE2__)
+
+static uint32_t group_match(const uint8_t *ctrl, const uint8_t h2) {
+  const __m128i group = _mm_load_si128((const __m128i *)ctrl);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+}
+
+//
+// empty and deleted are the only control bytes with the high bit set.
+//
+static uint32_t group_match_vacant(const uint8_t *ctrl) {
+  return _mm_movemask_epi8(_mm_load_si128((const __m128i *)ctrl));
+}
+
+#else
+
+static uint32_t group_match(const uint8_t *ctrl, const uint8_t h2) {
+  uint32_t mask = 0;
+  for (int i = 0; i < SRT_DICT_GROUP; ++i) {
+    mask |= (uint32_t)(ctrl[i] == h2) << i;
+  }
+  return mask;
+}
+
+static uint32_t group_match_vacant(const uint8_t *ctrl) {
+  uint32_t mask = 0;
+  for (int i = 0; i < SRT_DICT_GROUP; ++i) {
+    mask |= (uint32_t)(ctrl[i] >> 7) << i;
+  }
+  return mask;
+}
+
+#endif
+
+static uint32_t group_match_empty(const uint8_t *ctrl) {
+  return group_match(ctrl, CTRL_EMPTY);
+}
+
+static uint32_t group_match_full(const uint8_t *ctrl) {
+  return ~group_match_vacant(ctrl) & ((1u << SRT_DICT_GROUP) - 1);
+}
+
+static void *dict_alloc(const srt_dict *dict, size_t size) {
+  return dict->arena ? srt_arena_alloc(dict->arena, size) : malloc(size);
+}
+
+static void dict_release(const srt_dict *dict, void *p) {
+  if (!dict->arena) {
+    free(p);
+  }
+}
+
+//
+// control bytes and items share one allocation, control bytes first so both
+// stay 16 byte aligned.
+//
+static bool table_init(const srt_dict *dict, srt_dict_table *table,
+                       size_t capacity) {
+  if (capacity < SRT_DICT_GROUP) {
+    capacity = SRT_DICT_GROUP;
+  }
+
+  uint8_t *ctrl =
+      dict_alloc(dict, capacity + capacity * sizeof(srt_dict_item));
+  if (!ctrl) {
+    return false;
+  }
+
+  memset(ctrl, CTRL_EMPTY, capacity);
+
+  table->cap = capacity;
+  table->mask = capacity / SRT_DICT_GROUP - 1;
+  table->used = 0;
+  table->ctrl = ctrl;
+  table->items = (srt_dict_item *)(ctrl + capacity);
+
+  return true;
+}
+
+//
+// every dict starts at a generation no other dict in the process has used,
+// high bits from a counter and low bits left for its own changes, so a key
+// handle that cached a slot in a freed dict misses in one reusing its memory.
+//
+
+static _Atomic uint64_t dicts;
+
+srt_dict *srt_dict_new_in(srt_arena *arena, const size_t capacity,
+                          const uint64_t seed) {
   if (capacity == 0 || ((capacity & (capacity - 1)) != 0)) {
     return NULL;
   }
 
-  srt_dict *dict = calloc(1, sizeof(*dict));
+  srt_dict *dict = arena ? srt_arena_calloc(arena, 1, sizeof(*dict))
+                         : calloc(1, sizeof(*dict));
   if (!dict) {
     return NULL;
   }
 
-  srt_dict_item *items = calloc(capacity, sizeof(*items));
-  if (!items) {
-    free(dict);
+  dict->arena = arena;
+  dict->seed = seed;
+  dict->gen = atomic_fetch_add_explicit(&dicts, 1, memory_order_relaxed) << 32;
+  atomic_init(&dict->refs, arena ? 0 : 1);
+
+  if (!table_init(dict, &dict->table, capacity)) {
+    dict_release(dict, dict);
     return NULL;
   }
 
-  dict->cap = capacity;
-  dict->mask = capacity - 1;
-  dict->items = items;
-
   return dict;
 }
 
+srt_dict *srt_dict_new(const size_t capacity) {
+  return srt_dict_new_in(NULL, capacity, srt_hash_seed());
+}
+
 //
 // https://jameshfisher.com/2018/03/30/round-up-power-2/
 //
@@ -82,103 +203,622 @@ srt_dict *srt_dict_new_with_kvs(uint64_t kv_count, const char *key1,
   return dict;
 }
 
-static void srt_dict_item_free(srt_dict_item *item) {
-  free(item->key);
-  srt_value_free(item->value);
+static const char *item_key(const srt_dict_item *item) {
+  return item->key_inline ? item->key.buf : item->key.ptr;
+}
+
+//
+// a long key handed over in `owned` is kept as it is rather than copied, and
+// `owned` is cleared to say so. an arena dict hands it on to its arena.
+//
+static bool item_key_init(const srt_dict *dict, srt_dict_item *item,
+                          const char *key, char **owned) {
+  const size_t len = strlen(key);
+
+  if (len < SRT_DICT_KEY_INLINE) {
+    memcpy(item->key.buf, key, len + 1);
+    item->key_inline = true;
+    return true;
+  }
+
+  if (owned && (!dict->arena || srt_arena_adopt(dict->arena, *owned))) {
+    item->key.ptr = *owned;
+    item->key_inline = false;
+    *owned = NULL;
+    return true;
+  }
+
+  if (!(item->key.ptr = dict_alloc(dict, len + 1))) {
+    return false;
+  }
+
+  memcpy(item->key.ptr, key, len + 1);
+  item->key_inline = false;
+
+  return true;
+}
+
+static void table_free(const srt_dict *dict, srt_dict_table *table) {
+  for (size_t i = 0; i < table->cap; ++i) {
+    if (FULL(table->ctrl[i]) && !table->items[i].key_inline) {
+      dict_release(dict, table->items[i].key.ptr);
+    }
+  }
 
-  item->key = NULL;
-  item->value = NULL;
-  item->live = false;
+  dict_release(dict, table->ctrl);
+  table->ctrl = NULL;
+  table->items = NULL;
 }
 
-void srt_dict_free(srt_dict *dict) {
-  if (!dict) {
-    return;
+//
+// counting
+//
+
+static bool counted(const srt_value *value) {
+  return value->tag == SRT_DICT && value->dict && !value->dict->arena;
+}
+
+static bool owns(const srt_value *value) {
+  return counted(value) || (value->tag != SRT_DICT && value->owned);
+}
+
+void srt_dict_drop(const srt_value *value) {
+  if (counted(value)) {
+    srt_dict_free(value->dict);
+  } else if (value->tag == SRT_STR && value->owned) {
+    free(value->str);
+  } else if (value->tag != SRT_DICT && value->owned) {
+    free(value->array);
   }
+}
 
-  for (int i = 0; i < dict->cap; ++i) {
-    srt_dict_item_free(&dict->items[i]);
+static void drop_values_of(const srt_dict_table *table) {
+  for (size_t i = 0; table->ctrl && i < table->cap; ++i) {
+    if (FULL(table->ctrl[i])) {
+      srt_dict_drop(&table->items[i].value);
+    }
   }
+}
 
-  free(dict->items);
-  free(dict);
+static void drop_values(void *dict) {
+  drop_values_of(&((srt_dict *)dict)->table);
+  drop_values_of(&((srt_dict *)dict)->old);
 }
 
-static uint64_t hash_str(const char *str) {
-  const uint64_t prime = 0x100000001b3;
-  uint64_t hash = 0xcbf29ce484222325;
-  unsigned char *bytes = (unsigned char *)str;
+//
+// an arena dict asks its arena to drop what it holds once, when it first
+// takes a counted dict or an owned str or array. false, with nothing changed,
+// when that fails.
+//
+static bool hold(srt_dict *dict, const srt_value *value) {
+  if (!dict->arena || dict->releases || !owns(value)) {
+    return true;
+  }
+
+  return dict->releases = srt_arena_defer(dict->arena, drop_values, dict);
+}
 
-  while (*bytes++) {
-    hash ^= (uint64_t)*bytes;
-    hash *= prime;
+//
+// a dict or an owned str or array put where it already is stays there.
+//
+static bool same(const srt_value *a, const srt_value *b) {
+  if (a->tag != b->tag) {
+    return false;
   }
 
-  return hash;
+  switch (a->tag) {
+  case SRT_DICT:
+    return a->dict == b->dict;
+  case SRT_STR:
+    return a->owned && a->str == b->str;
+  case SRT_INT64_ARRAY:
+  case SRT_DOUBLE_ARRAY:
+    return a->owned && a->array == b->array;
+  default:
+    return false;
+  }
 }
 
-srt_value *srt_dict_get(const srt_dict *dict, const char *key) {
-  PROBE(NULL, {
-    if (!item->key) {
-      return NULL;
-    }
+void srt_dict_assign(srt_value *to, srt_value value) {
+  const srt_value old = *to;
+
+  *to = value;
+
+  if (!same(&old, &value)) {
+    srt_dict_drop(&old);
+  }
+}
+
+srt_dict *srt_dict_share(srt_dict *dict) {
+  if (dict && !dict->arena) {
+    atomic_fetch_add_explicit(&dict->refs, 1, memory_order_relaxed);
+  }
+
+  return dict;
+}
+
+void srt_dict_free(srt_dict *dict) {
+  if (!dict || dict->arena ||
+      atomic_fetch_sub_explicit(&dict->refs, 1, memory_order_acq_rel) > 1) {
+    return;
+  }
+
+  drop_values(dict);
+
+  table_free(dict, &dict->table);
+  if (dict->old.ctrl) {
+    table_free(dict, &dict->old);
+  }
+
+  free(dict);
+}
+
+static srt_dict_item *find(srt_dict_table *table, const char *key,
+                           const uint64_t hash) {
+  PROBE(table, hash, {
+    EACH_BIT(group_match(ctrl, H2(hash)), {
+      srt_dict_item *item = &table->items[group + bit];
 
-    if (strcmp(item->key, key) == 0) {
-      if (item->live) {
-        return item->value;
+      if (item->hash == hash && strcmp(item_key(item), key) == 0) {
+        return item;
       }
+    });
 
+    if (group_match_empty(ctrl)) {
       return NULL;
     }
   });
+
+  return NULL;
+}
+
+//
+// slot for a key known to be absent from the table. takes the first empty or
+// deleted slot on the probe sequence.
+//
+static size_t vacant(srt_dict_table *table, const uint64_t hash) {
+  PROBE(table, hash, {
+    const uint32_t mask = group_match_vacant(ctrl);
+
+    if (mask) {
+      return group + __builtin_ctz(mask);
+    }
+  });
+
+  return table->cap;
+}
+
+static void occupy(srt_dict_table *table, const size_t slot,
+                   const srt_dict_item *item) {
+  if (table->ctrl[slot] == CTRL_EMPTY) {
+    table->used++;
+  }
+
+  table->ctrl[slot] = H2(item->hash);
+  table->items[slot] = *item;
+}
+
+//
+// a slot can go straight back to empty when its group still has an empty
+// slot: no probe has ever continued past that group, so nothing relies on
+// this slot being occupied.
+//
+static void vacate(srt_dict_table *table, const size_t slot) {
+  const size_t group = slot & ~(size_t)(SRT_DICT_GROUP - 1);
+
+  if (group_match_empty(&table->ctrl[group])) {
+    table->ctrl[slot] = CTRL_EMPTY;
+    table->used--;
+  } else {
+    table->ctrl[slot] = CTRL_DELETED;
+  }
+}
+
+static size_t slot_of(const srt_dict_table *table, const srt_dict_item *item) {
+  return item - table->items;
 }
 
-static bool set(srt_dict_item *item, const char *key, srt_value *value) {
-  if (!(item->key = strdup(key))) {
+static bool in_table(const srt_dict_table *table, const srt_dict_item *item) {
+  return item >= table->items && item < table->items + table->cap;
+}
+
+static bool rehashing(const srt_dict *dict) { return dict->old.ctrl != NULL; }
+
+static void rehash_step(srt_dict *dict, size_t slots) {
+  srt_dict_table *old = &dict->old;
+
+  while (slots-- && dict->rehash_pos < old->cap) {
+    const size_t slot = dict->rehash_pos++;
+
+    if (FULL(old->ctrl[slot])) {
+      srt_dict_item *item = &old->items[slot];
+
+      occupy(&dict->table, vacant(&dict->table, item->hash), item);
+      old->ctrl[slot] = CTRL_DELETED;
+      dict->gen++;
+    }
+  }
+
+  if (dict->rehash_pos == old->cap) {
+    dict_release(dict, old->ctrl);
+    *old = (srt_dict_table){0};
+    dict->rehash_pos = 0;
+  }
+}
+
+static void maybe_grow(srt_dict *dict) {
+  srt_dict_table *table = &dict->table;
+
+  if (table->used * LOAD_FACTOR_DEN < table->cap * LOAD_FACTOR_NUM) {
+    return;
+  }
+
+  if (rehashing(dict)) {
+    rehash_step(dict, dict->old.cap);
+  }
+
+  //
+  // a table that is mostly deleted slots is rebuilt at the same size.
+  //
+  size_t capacity = table->cap;
+  while (dict->len * 2 >= capacity) {
+    capacity <<= 1;
+  }
+
+  srt_dict_table next;
+  if (!table_init(dict, &next, capacity)) {
+    return;
+  }
+
+  dict->old = *table;
+  dict->table = next;
+  dict->rehash_pos = 0;
+  dict->gen++;
+}
+
+static srt_dict_item *lookup(srt_dict *dict, const char *key,
+                             const uint64_t hash) {
+  if (rehashing(dict)) {
+    rehash_step(dict, REHASH_STEP);
+  }
+
+  srt_dict_item *item = find(&dict->table, key, hash);
+
+  if (!item && rehashing(dict)) {
+    item = find(&dict->old, key, hash);
+  }
+
+  return item;
+}
+
+static bool put(srt_dict *dict, const char *key, const uint64_t hash,
+                srt_value value, char **owned) {
+  if (!hold(dict, &value)) {
+    return false;
+  }
+
+  if (rehashing(dict)) {
+    rehash_step(dict, REHASH_STEP);
+  }
+
+  srt_dict_item *item = find(&dict->table, key, hash);
+
+  if (item) {
+    srt_dict_assign(&item->value, value);
+    return true;
+  }
+
+  srt_dict_item *old_item =
+      rehashing(dict) ? find(&dict->old, key, hash) : NULL;
+
+  size_t slot = vacant(&dict->table, hash);
+  if (slot == dict->table.cap && rehashing(dict)) {
+    rehash_step(dict, dict->old.cap);
+    old_item = NULL;
+    item = find(&dict->table, key, hash);
+
+    if (item) {
+      srt_dict_assign(&item->value, value);
+      return true;
+    }
+
+    slot = vacant(&dict->table, hash);
+  }
+
+  if (slot == dict->table.cap) {
+    return false;
+  }
+
+  if (old_item) {
+    occupy(&dict->table, slot, old_item);
+    srt_dict_assign(&dict->table.items[slot].value, value);
+    dict->old.ctrl[slot_of(&dict->old, old_item)] = CTRL_DELETED;
+    dict->gen++;
+    return true;
+  }
+
+  srt_dict_item placed = {.hash = hash, .value = value};
+  if (!item_key_init(dict, &placed, key, owned)) {
     return false;
   }
 
-  item->value = value;
-  item->live = true;
+  occupy(&dict->table, slot, &placed);
+  dict->len++;
+  dict->gen++;
+
+  maybe_grow(dict);
 
   return true;
 }
 
+static void remove_item(srt_dict *dict, srt_dict_item *item) {
+  srt_dict_table *table =
+      in_table(&dict->table, item) ? &dict->table : &dict->old;
+
+  if (!item->key_inline) {
+    dict_release(dict, item->key.ptr);
+  }
+
+  vacate(table, slot_of(table, item));
+  dict->len--;
+  dict->gen++;
+}
+
+srt_value *srt_dict_get(srt_dict *dict, const char *key) {
+  srt_dict_item *item = lookup(dict, key, srt_hash_str(key, dict->seed));
+
+  return item ? &item->value : NULL;
+}
+
 bool srt_dict_set(srt_dict *dict, const char *key, srt_value *value) {
-  PROBE(false, {
-    if (!item->key) {
-      if (set(item, key, value)) {
-        dict->len++;
-        return true;
-      }
+  if (!srt_dict_put(dict, key, *value)) {
+    return false;
+  }
+
+  srt_value_free(value);
+
+  return true;
+}
+
+bool srt_dict_put(srt_dict *dict, const char *key, srt_value value) {
+  return put(dict, key, srt_hash_str(key, dict->seed), value, NULL);
+}
+
+bool srt_dict_put_take(srt_dict *dict, char *key, srt_value value) {
+  char *owned = key;
+  const bool ok = put(dict, key, srt_hash_str(key, dict->seed), value, &owned);
+
+  free(owned);
+
+  return ok;
+}
+
+bool srt_dict_set_take(srt_dict *dict, char *key, srt_value *value) {
+  if (!srt_dict_put_take(dict, key, *value)) {
+    return false;
+  }
+
+  srt_value_free(value);
+
+  return true;
+}
+
+bool srt_dict_delete(srt_dict *dict, const char *key) {
+  srt_value value;
+
+  if (!srt_dict_take(dict, key, &value)) {
+    return false;
+  }
+
+  srt_dict_drop(&value);
+
+  return true;
+}
 
-      return false;
+bool srt_dict_take(srt_dict *dict, const char *key, srt_value *value) {
+  srt_dict_item *item = lookup(dict, key, srt_hash_str(key, dict->seed));
+
+  if (!item) {
+    return false;
+  }
+
+  *value = item->value;
+  remove_item(dict, item);
+
+  return true;
+}
+
+//
+// the probe of get without the rehash step, so a dict nobody writes to can be
+// read from several threads at once.
+//
+const srt_value *srt_dict_peek(const srt_dict *dict, const char *key) {
+  const uint64_t hash = srt_hash_str(key, dict->seed);
+  srt_dict_item *item = find((srt_dict_table *)&dict->table, key, hash);
+
+  if (!item && rehashing(dict)) {
+    item = find((srt_dict_table *)&dict->old, key, hash);
+  }
+
+  return item ? &item->value : NULL;
+}
+
+size_t srt_dict_len(const srt_dict *dict) { return dict->len; }
+
+//
+// `pos` runs over the slots of the table and then over those of the table
+// being rehashed. migrated slots are marked deleted, so every item is seen
+// exactly once. both capacities are multiples of the group size, so a group
+// never straddles the two and empty groups are skipped whole.
+//
+srt_dict_item *srt_dict_next(const srt_dict *dict, size_t *pos) {
+  while (*pos < dict->table.cap + dict->old.cap) {
+    const bool in_old = *pos >= dict->table.cap;
+    const srt_dict_table *t = in_old ? &dict->old : &dict->table;
+    const size_t slot = in_old ? *pos - dict->table.cap : *pos;
+    const size_t offset = slot % SRT_DICT_GROUP;
+    const uint32_t full = group_match_full(&t->ctrl[slot - offset]) >> offset;
+
+    if (!full) {
+      *pos += SRT_DICT_GROUP - offset;
+      continue;
     }
 
-    if (!item->live || strcmp(item->key, key) == 0) {
-      srt_dict_item_free(item);
-      if (set(item, key, value)) {
-        dict->len++;
-        return true;
-      }
+    const size_t skip = __builtin_ctz(full);
+    *pos += skip + 1;
+
+    return &t->items[slot + skip];
+  }
+
+  return NULL;
+}
+
+const char *srt_dict_item_key(const srt_dict_item *item) {
+  return item_key(item);
+}
+
+//
+// stats
+//
+
+static size_t probe_length(const srt_dict_table *table, uint64_t hash,
+                           size_t slot) {
+  size_t length = 0;
 
-      return false;
+  PROBE(table, hash, {
+    (void)ctrl;
+    length++;
+
+    if (group == slot - slot % SRT_DICT_GROUP) {
+      return length;
     }
   });
+
+  return length;
 }
 
-bool srt_dict_delete(srt_dict *dict, const char *key) {
-  PROBE(false, {
-    if (!item->key) {
-      return false;
+static size_t table_bytes(const srt_dict_table *table) {
+  return table->cap + table->cap * sizeof(srt_dict_item);
+}
+
+void srt_dict_get_stats(const srt_dict *dict, srt_dict_stats *stats) {
+  const srt_dict_table *table = &dict->table;
+  size_t probed = 0;
+  size_t total = 0;
+
+  *stats = (srt_dict_stats){
+      .len = dict->len,
+      .capacity = table->cap,
+      .bytes = sizeof(*dict) + table_bytes(table) + table_bytes(&dict->old),
+  };
+
+  for (size_t slot = 0; slot < table->cap; ++slot) {
+    if (table->ctrl[slot] == CTRL_DELETED) {
+      stats->tombstones++;
     }
 
-    if (strcmp(item->key, key) == 0) {
-      srt_dict_item_free(item);
-      dict->len--;
-      return true;
+    if (!FULL(table->ctrl[slot])) {
+      continue;
     }
-  });
+
+    const size_t length = probe_length(table, table->items[slot].hash, slot);
+    const size_t bucket = length < SRT_DICT_PROBE_HISTOGRAM
+                              ? length - 1
+                              : SRT_DICT_PROBE_HISTOGRAM - 1;
+
+    probed++;
+    total += length;
+    stats->max_probe = length > stats->max_probe ? length : stats->max_probe;
+    stats->probe_histogram[bucket]++;
+  }
+
+  stats->migrating = dict->len - probed;
+  stats->load_factor = table->cap ? (double)probed / table->cap : 0;
+  stats->avg_probe = probed ? (double)total / probed : 0;
 }
 
-size_t srt_dict_len(const srt_dict *dict) { return dict->len; }
+//
+// key handles
+//
+
+void srt_key_init(srt_key *key, const char *str) { *key = SRT_KEY(str); }
+
+static srt_dict_item *lookup_k(srt_dict *dict, srt_key *key) {
+  if (!key->hashed || key->seed != dict->seed) {
+    key->hash = srt_hash_str(key->str, dict->seed);
+    key->seed = dict->seed;
+    key->hashed = true;
+    key->dict = NULL;
+  }
+
+  if (key->dict == dict && key->gen == dict->gen &&
+      key->slot < dict->table.cap) {
+    srt_dict_item *item = &dict->table.items[key->slot];
+
+    if (FULL(dict->table.ctrl[key->slot]) && item->hash == key->hash) {
+      return item;
+    }
+  }
+
+  srt_dict_item *item = lookup(dict, key->str, key->hash);
+
+  if (item && in_table(&dict->table, item)) {
+    key->dict = dict;
+    key->gen = dict->gen;
+    key->slot = slot_of(&dict->table, item);
+  }
+
+  return item;
+}
+
+srt_value *srt_dict_get_k(srt_dict *dict, srt_key *key) {
+  srt_dict_item *item = lookup_k(dict, key);
+
+  return item ? &item->value : NULL;
+}
+
+bool srt_dict_set_k(srt_dict *dict, srt_key *key, srt_value *value) {
+  if (!srt_dict_put_k(dict, key, *value)) {
+    return false;
+  }
+
+  srt_value_free(value);
+
+  return true;
+}
+
+bool srt_dict_put_k(srt_dict *dict, srt_key *key, srt_value value) {
+  srt_dict_item *item = lookup_k(dict, key);
+
+  if (item && hold(dict, &value)) {
+    srt_dict_assign(&item->value, value);
+    return true;
+  }
+
+  return !item && put(dict, key->str, key->hash, value, NULL);
+}
+
+bool srt_dict_delete_k(srt_dict *dict, srt_key *key) {
+  srt_value value;
+
+  if (!srt_dict_take_k(dict, key, &value)) {
+    return false;
+  }
+
+  srt_dict_drop(&value);
+
+  return true;
+}
+
+bool srt_dict_take_k(srt_dict *dict, srt_key *key, srt_value *value) {
+  srt_dict_item *item = lookup_k(dict, key);
+
+  if (!item) {
+    return false;
+  }
+
+  *value = item->value;
+  remove_item(dict, item);
+
+  return true;
+}
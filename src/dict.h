@@ -1,32 +1,180 @@
+#pragma once
+
+#include "types.h"
+#include "value.h"
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+//
+// values live in the slot itself and keys shorter than SRT_DICT_KEY_INLINE
+// are copied into it, so setting a scalar under a short key never allocates.
+//
 
-typedef struct srt_value srt_value;
+#define SRT_DICT_KEY_INLINE 16
 
 typedef struct srt_dict_item {
-  char *key;
-  srt_value *value;
-  bool live;
+  uint64_t hash;
+  union {
+    char *ptr;
+    char buf[SRT_DICT_KEY_INLINE];
+  } key;
+  srt_value value;
+  bool key_inline;
 } srt_dict_item;
 
-typedef struct srt_dict {
+//
+// swiss table layout. each slot has a control byte, kept apart from the items,
+// holding either 7 bits of the key's hash or an empty/deleted marker. probes
+// scan SRT_DICT_GROUP control bytes at a time and only touch items whose
+// control byte matches.
+//
+
+#define SRT_DICT_GROUP 16
+
+typedef struct srt_dict_table {
   size_t cap;
-  size_t len;
   size_t mask;
+  size_t used;
+  uint8_t *ctrl;
   srt_dict_item *items;
+} srt_dict_table;
+
+//
+// when the table passes its load factor a larger one is allocated and the
+// live items of the old table are migrated a few slots at a time by each
+// following get/set/delete, so no single call pays for the whole rehash.
+//
+
+typedef struct srt_arena srt_arena;
+
+//
+// a dict from malloc is counted. it starts out with one reference, owned by
+// whoever created it, and is freed with the last. a dict owns a reference to
+// each counted dict among its values: put and set take over the one of the
+// caller, and replacing or deleting the value drops it, so a whole tree goes
+// with its root and moving a subtree between items is O(1). a dict in an
+// arena is not counted, it lives as long as the arena, and drops the counted
+// dicts it still holds when the arena is reset or freed. a dict must not end
+// up among its own values, however deep.
+//
+
+typedef struct srt_dict {
+  srt_arena *arena;
+  uint64_t seed;
+  size_t len;
+  uint64_t gen;
+  srt_dict_table table;
+  srt_dict_table old;
+  size_t rehash_pos;
+  atomic_size_t refs;
+  bool releases;
 } srt_dict;
 
 srt_dict *srt_dict_new(const size_t capacity);
 
+//
+// a dict created in an arena allocates its tables and keys there. freeing it
+// is a no-op, the memory goes away when the arena is reset or freed.
+//
+
+srt_dict *srt_dict_new_in(srt_arena *arena, const size_t capacity,
+                          const uint64_t seed);
+
 srt_dict *srt_dict_new_with_kvs(const size_t kv_count, const char *key1,
                                 srt_value *value1, ...);
 
+//
+// drops a reference, freeing the dict and dropping the references it holds
+// when it was the last. share hands out another reference, for a second
+// item or a second owner, that is dropped the same way.
+//
+
 void srt_dict_free(srt_dict *dict);
 
-srt_value *srt_dict_get(const srt_dict *dict, const char *key);
+srt_dict *srt_dict_share(srt_dict *dict);
+
+//
+// the ownership of values, shared with fixed dicts. drop releases what a value
+// owns: the reference of a counted dict, an owned str or array. assign stores
+// `value` in `to` and drops the one it replaces, unless that is the same
+// dict, owned str or array put where it already is.
+//
+
+void srt_dict_drop(const srt_value *value);
+
+void srt_dict_assign(srt_value *to, srt_value value);
+
+//
+// the value returned by get points into the table and is only valid until the
+// next call on the dict. put stores a value in place, set takes ownership of a
+// heap value and frees the wrapper.
+//
+
+srt_value *srt_dict_get(srt_dict *dict, const char *key);
 
 bool srt_dict_set(srt_dict *dict, const char *key, srt_value *value);
 
+bool srt_dict_put(srt_dict *dict, const char *key, srt_value value);
+
+//
+// these take `key`, a str from malloc, instead of copying it. it is kept as
+// the key of a new item unless short enough to go inline, and freed
+// otherwise, also when the call fails.
+//
+
+bool srt_dict_set_take(srt_dict *dict, char *key, srt_value *value);
+
+bool srt_dict_put_take(srt_dict *dict, char *key, srt_value value);
+
 bool srt_dict_delete(srt_dict *dict, const char *key);
 
+//
+// removes an item like delete but hands its value to the caller, along with
+// the reference to a counted dict or an owned str or array, instead of
+// dropping it.
+//
+
+bool srt_dict_take(srt_dict *dict, const char *key, srt_value *value);
+
+//
+// a get that leaves the dict untouched, for dicts shared read only between
+// threads.
+//
+
+const srt_value *srt_dict_peek(const srt_dict *dict, const char *key);
+
 size_t srt_dict_len(const srt_dict *dict);
+
+//
+// iterates the items in no particular order. start with `pos` at 0 and call
+// until NULL comes back. the dict must not change while iterating.
+//
+
+srt_dict_item *srt_dict_next(const srt_dict *dict, size_t *pos);
+
+//
+// how full a dict is and how far lookups go. the probe length of an item is
+// the number of groups a lookup scans to reach it, 1 in its home group, and
+// bucket i of the histogram counts the items found after i + 1 groups, the
+// last also those further out. items still waiting in the old table of a
+// rehash are counted as migrating rather than probed. bytes are those of the
+// tables, keys and values are not included.
+//
+
+void srt_dict_get_stats(const srt_dict *dict, srt_dict_stats *stats);
+
+const char *srt_dict_item_key(const srt_dict_item *item);
+
+void srt_key_init(srt_key *key, const char *str);
+
+srt_value *srt_dict_get_k(srt_dict *dict, srt_key *key);
+
+bool srt_dict_set_k(srt_dict *dict, srt_key *key, srt_value *value);
+
+bool srt_dict_put_k(srt_dict *dict, srt_key *key, srt_value value);
+
+bool srt_dict_delete_k(srt_dict *dict, srt_key *key);
+
+bool srt_dict_take_k(srt_dict *dict, srt_key *key, srt_value *value);
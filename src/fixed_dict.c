@@ -0,0 +1,358 @@
+#include "fixed_dict.h"
+#include "hash.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// displacements tried per bucket before the whole set is hashed again with
+// another seed, and how many seeds are tried before giving up.
+//
+#define MAX_DISP (1u << 20)
+#define MAX_SEEDS 16
+#define NO_KEY SIZE_MAX
+
+//
+// the slot of a key, from its hash and the displacement of its bucket. the
+// mix spreads the displaced hash over the upper 32 bits, which are scaled to
+// the slot count with a multiply instead of a division.
+//
+static size_t slot_of(uint64_t hash, uint32_t disp, size_t len) {
+  uint64_t h = hash ^ disp * 0x9e3779b97f4a7c15ull;
+
+  h ^= h >> 32;
+  h *= 0xd6e8feb86659fd93ull;
+  h ^= h >> 32;
+
+  return (size_t)(((h & 0xffffffff) * len) >> 32);
+}
+
+static uint64_t bucket_count(size_t len) {
+  uint64_t count = 1;
+
+  while (count * 2 < len) {
+    count *= 2;
+  }
+
+  return count;
+}
+
+typedef struct build {
+  const char *const *keys;
+  size_t len;
+  uint64_t seed;
+  uint64_t mask;
+  uint64_t *hashes;
+  size_t *order;
+  size_t *start;
+  size_t *taken;
+  uint32_t *disps;
+  bool duplicate;
+} build;
+
+//
+// the keys of bucket `b` with displacement `disp` land on slots that are
+// free and apart from each other.
+//
+static bool fits(const build *b, size_t bucket, uint32_t disp) {
+  for (size_t i = b->start[bucket]; i < b->start[bucket + 1]; ++i) {
+    const size_t slot = slot_of(b->hashes[b->order[i]], disp, b->len);
+
+    if (b->taken[slot] != NO_KEY) {
+      return false;
+    }
+
+    for (size_t j = b->start[bucket]; j < i; ++j) {
+      if (slot_of(b->hashes[b->order[j]], disp, b->len) == slot) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+//
+// keys with the same hash can never be told apart. when they are the same
+// key the set is rejected, otherwise another seed will do.
+//
+static bool apart(build *b, size_t bucket) {
+  for (size_t i = b->start[bucket]; i < b->start[bucket + 1]; ++i) {
+    for (size_t j = b->start[bucket]; j < i; ++j) {
+      const size_t x = b->order[i];
+      const size_t y = b->order[j];
+
+      if (b->hashes[x] == b->hashes[y]) {
+        b->duplicate |= strcmp(b->keys[x], b->keys[y]) == 0;
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+//
+// buckets are placed largest first, while most slots are still free.
+//
+static bool place(build *b) {
+  const size_t buckets = b->mask + 1;
+  size_t *by_size = malloc(buckets * sizeof(*by_size));
+  size_t largest = 0;
+
+  if (!by_size) {
+    return false;
+  }
+
+  for (size_t i = 0; i < b->len; ++i) {
+    b->hashes[i] = srt_hash_str(b->keys[i], b->seed);
+    b->taken[i] = NO_KEY;
+  }
+
+  memset(b->start, 0, (buckets + 1) * sizeof(*b->start));
+
+  for (size_t i = 0; i < b->len; ++i) {
+    b->start[(b->hashes[i] & b->mask) + 1]++;
+  }
+
+  for (size_t i = 0; i < buckets; ++i) {
+    const size_t size = b->start[i + 1];
+    largest = size > largest ? size : largest;
+    b->start[i + 1] += b->start[i];
+  }
+
+  size_t *fill = by_size;
+  memcpy(fill, b->start, buckets * sizeof(*fill));
+
+  for (size_t i = 0; i < b->len; ++i) {
+    b->order[fill[b->hashes[i] & b->mask]++] = i;
+  }
+
+  size_t n = 0;
+
+  for (size_t size = largest; size > 0; --size) {
+    for (size_t i = 0; i < buckets; ++i) {
+      if (b->start[i + 1] - b->start[i] == size) {
+        by_size[n++] = i;
+      }
+    }
+  }
+
+  bool ok = true;
+
+  for (size_t i = 0; ok && i < n; ++i) {
+    const size_t bucket = by_size[i];
+    uint32_t disp = 0;
+
+    if (!(ok = apart(b, bucket))) {
+      break;
+    }
+
+    while (disp < MAX_DISP && !fits(b, bucket, disp)) {
+      disp++;
+    }
+
+    if (!(ok = disp < MAX_DISP)) {
+      break;
+    }
+
+    b->disps[bucket] = disp;
+
+    for (size_t k = b->start[bucket]; k < b->start[bucket + 1]; ++k) {
+      b->taken[slot_of(b->hashes[b->order[k]], disp, b->len)] = b->order[k];
+    }
+  }
+
+  free(by_size);
+
+  return ok;
+}
+
+static srt_fixed_dict *lay_out(const build *b) {
+  const size_t buckets = b->mask + 1;
+  size_t size = sizeof(srt_fixed_dict) + b->len * sizeof(srt_fixed_dict_slot) +
+                buckets * sizeof(uint32_t);
+
+  for (size_t i = 0; i < b->len; ++i) {
+    size += strlen(b->keys[i]) + 1;
+  }
+
+  srt_fixed_dict *dict = malloc(size);
+
+  if (!dict) {
+    return NULL;
+  }
+
+  uint32_t *disps = (uint32_t *)&dict->slots[b->len];
+  char *key = (char *)&disps[buckets];
+
+  dict->seed = b->seed;
+  dict->len = b->len;
+  dict->bucket_mask = b->mask;
+  dict->disps = memcpy(disps, b->disps, buckets * sizeof(uint32_t));
+
+  for (size_t i = 0; i < b->len; ++i) {
+    const size_t k = b->taken[i];
+    const size_t len = strlen(b->keys[k]) + 1;
+
+    dict->slots[i] = (srt_fixed_dict_slot){
+        .hash = b->hashes[k],
+        .key = memcpy(key, b->keys[k], len),
+    };
+    key += len;
+  }
+
+  return dict;
+}
+
+srt_fixed_dict *srt_fixed_dict_new(const char *const *keys, size_t len) {
+  if (!len || len > UINT32_MAX) {
+    return NULL;
+  }
+
+  const uint64_t buckets = bucket_count(len);
+  build b = {
+      .keys = keys,
+      .len = len,
+      .seed = srt_hash_seed(),
+      .mask = buckets - 1,
+      .hashes = malloc(len * sizeof(*b.hashes)),
+      .order = malloc(len * sizeof(*b.order)),
+      .start = malloc((buckets + 1) * sizeof(*b.start)),
+      .taken = malloc(len * sizeof(*b.taken)),
+      .disps = malloc(buckets * sizeof(*b.disps)),
+  };
+  srt_fixed_dict *dict = NULL;
+
+  if (b.hashes && b.order && b.start && b.taken && b.disps) {
+    for (int i = 0; i < MAX_SEEDS && !b.duplicate; ++i, ++b.seed) {
+      if (place(&b)) {
+        dict = lay_out(&b);
+        break;
+      }
+    }
+  }
+
+  free(b.hashes);
+  free(b.order);
+  free(b.start);
+  free(b.taken);
+  free(b.disps);
+
+  return dict;
+}
+
+srt_fixed_dict *srt_fixed_dict_new_with_kvs(const size_t kv_count,
+                                            const char *key1,
+                                            srt_value *value1, ...) {
+  if (!kv_count) {
+    return NULL;
+  }
+
+  const char **keys = malloc(kv_count * sizeof(*keys));
+  srt_value **values = malloc(kv_count * sizeof(*values));
+  srt_fixed_dict *dict = NULL;
+
+  if (keys && values) {
+    keys[0] = key1;
+    values[0] = value1;
+
+    va_list ap;
+    va_start(ap, value1);
+
+    for (size_t i = 1; i < kv_count; ++i) {
+      keys[i] = va_arg(ap, char *);
+      values[i] = va_arg(ap, srt_value *);
+    }
+
+    va_end(ap);
+
+    if ((dict = srt_fixed_dict_new(keys, kv_count))) {
+      for (size_t i = 0; i < kv_count; ++i) {
+        srt_fixed_dict_set(dict, keys[i], values[i]);
+      }
+    }
+  }
+
+  free(keys);
+  free(values);
+
+  return dict;
+}
+
+void srt_fixed_dict_free(srt_fixed_dict *dict) {
+  if (!dict) {
+    return;
+  }
+
+  for (size_t i = 0; i < dict->len; ++i) {
+    if (dict->slots[i].set) {
+      srt_dict_drop(&dict->slots[i].value);
+    }
+  }
+
+  free(dict);
+}
+
+static srt_fixed_dict_slot *find(srt_fixed_dict *dict, const char *key,
+                                 uint64_t hash) {
+  const uint32_t disp = dict->disps[hash & dict->bucket_mask];
+  srt_fixed_dict_slot *slot = &dict->slots[slot_of(hash, disp, dict->len)];
+
+  return slot->hash == hash && strcmp(slot->key, key) == 0 ? slot : NULL;
+}
+
+srt_value *srt_fixed_dict_get(srt_fixed_dict *dict, const char *key) {
+  srt_fixed_dict_slot *slot = find(dict, key, srt_hash_str(key, dict->seed));
+
+  return slot && slot->set ? &slot->value : NULL;
+}
+
+srt_value *srt_fixed_dict_get_k(srt_fixed_dict *dict, srt_key *key) {
+  if (!key->hashed || key->seed != dict->seed) {
+    key->hash = srt_hash_str(key->str, dict->seed);
+    key->seed = dict->seed;
+    key->hashed = true;
+    key->dict = NULL;
+  }
+
+  srt_fixed_dict_slot *slot = find(dict, key->str, key->hash);
+
+  return slot && slot->set ? &slot->value : NULL;
+}
+
+bool srt_fixed_dict_put(srt_fixed_dict *dict, const char *key,
+                        srt_value value) {
+  srt_fixed_dict_slot *slot = find(dict, key, srt_hash_str(key, dict->seed));
+
+  if (!slot) {
+    return false;
+  }
+
+  if (slot->set) {
+    srt_dict_assign(&slot->value, value);
+  } else {
+    slot->value = value;
+    slot->set = true;
+  }
+
+  return true;
+}
+
+bool srt_fixed_dict_set(srt_fixed_dict *dict, const char *key,
+                        srt_value *value) {
+  if (!srt_fixed_dict_put(dict, key, *value)) {
+    return false;
+  }
+
+  srt_value_free(value);
+
+  return true;
+}
+
+size_t srt_fixed_dict_len(const srt_fixed_dict *dict) { return dict->len; }
+
+const srt_fixed_dict_slot *srt_fixed_dict_at(const srt_fixed_dict *dict,
+                                             size_t i) {
+  return &dict->slots[i];
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "dict.h"
+#include "value.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// a dict whose keys are fixed when it is built, for records of a shape the
+// process code knows up front. the keys get a minimal perfect hash, computed
+// once by hash and displace: the hash picks a bucket, the displacement of the
+// bucket moves its keys to slots no other key has, so a lookup is one slot
+// and one key compare, with no probing and no chains. the slots, the
+// displacements and the keys share a single allocation.
+//
+// the values can change, the keys cannot. a key outside the set is not
+// found, and put and set fail for it. values follow the rules of srt_dict:
+// put takes over the reference to a counted dict and an owned str or array,
+// replacing the value drops it, and so does freeing the dict.
+//
+
+typedef struct srt_fixed_dict_slot {
+  uint64_t hash;
+  const char *key;
+  srt_value value;
+  bool set;
+} srt_fixed_dict_slot;
+
+typedef struct srt_fixed_dict {
+  uint64_t seed;
+  size_t len;
+  uint64_t bucket_mask;
+  const uint32_t *disps;
+  srt_fixed_dict_slot slots[];
+} srt_fixed_dict;
+
+//
+// NULL when `keys` has none or a duplicate. every key starts out unset, get
+// finds nothing there until it is put.
+//
+srt_fixed_dict *srt_fixed_dict_new(const char *const *keys, size_t len);
+
+//
+// like srt_dict_new_with_kvs, the keys are the set and the values are taken
+// over as srt_dict_set takes them.
+//
+srt_fixed_dict *srt_fixed_dict_new_with_kvs(const size_t kv_count,
+                                            const char *key1,
+                                            srt_value *value1, ...);
+
+void srt_fixed_dict_free(srt_fixed_dict *dict);
+
+srt_value *srt_fixed_dict_get(srt_fixed_dict *dict, const char *key);
+
+srt_value *srt_fixed_dict_get_k(srt_fixed_dict *dict, srt_key *key);
+
+bool srt_fixed_dict_put(srt_fixed_dict *dict, const char *key,
+                        srt_value value);
+
+bool srt_fixed_dict_set(srt_fixed_dict *dict, const char *key,
+                        srt_value *value);
+
+size_t srt_fixed_dict_len(const srt_fixed_dict *dict);
+
+//
+// the slots in the order of the hash, for walking every key. `i` is below
+// srt_fixed_dict_len.
+//
+const srt_fixed_dict_slot *srt_fixed_dict_at(const srt_fixed_dict *dict,
+                                             size_t i);
@@ -0,0 +1,455 @@
+#include "hamt.h"
+#include "array.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BITS 5
+#define MASK 31
+#define BUCKET ((UINT64_C(1) << 60) - 1)
+
+typedef enum kind { NODE, LEAF } kind;
+
+struct srt_hamt {
+  uint32_t refs;
+  kind kind;
+};
+
+//
+// a node has a slot for each of the 32 values its 5 bits of hash can take,
+// only the ones in use are stored, in bitmap order.
+//
+
+typedef struct node {
+  srt_hamt hdr;
+  uint32_t bitmap;
+  srt_hamt *slots[];
+} node;
+
+//
+// the leaves of keys that share a slot at the bottom level are a list, and the
+// list is copied up to the leaf that changes like any other path.
+//
+
+typedef struct leaf {
+  srt_hamt hdr;
+  uint64_t hash;
+  struct leaf *next;
+  srt_hamt_value value;
+  char key[];
+} leaf;
+
+static uint32_t bit_of(uint64_t hash, int shift) {
+  return UINT32_C(1) << ((hash >> shift) & MASK);
+}
+
+static uint32_t pos_of(uint32_t bitmap, uint32_t bit) {
+  return __builtin_popcount(bitmap & (bit - 1));
+}
+
+static bool same_bucket(uint64_t a, uint64_t b) {
+  return ((a ^ b) & BUCKET) == 0;
+}
+
+static uint32_t count_of(const node *n) {
+  return __builtin_popcount(n->bitmap);
+}
+
+srt_hamt *srt_hamt_retain(srt_hamt *root) {
+  if (root) {
+    root->refs++;
+  }
+
+  return root;
+}
+
+void srt_hamt_value_release(srt_hamt_value *value) {
+  if (value->tag == SRT_STR) {
+    free(value->str);
+  } else if (value->tag == SRT_INT64_ARRAY || value->tag == SRT_DOUBLE_ARRAY) {
+    free(value->array);
+  } else if (value->tag == SRT_DICT) {
+    srt_hamt_release(value->dict);
+  }
+}
+
+void srt_hamt_release(srt_hamt *root) {
+  if (!root || --root->refs > 0) {
+    return;
+  }
+
+  if (root->kind == NODE) {
+    node *n = (node *)root;
+
+    for (uint32_t i = 0; i < count_of(n); ++i) {
+      srt_hamt_release(n->slots[i]);
+    }
+  } else {
+    leaf *l = (leaf *)root;
+    srt_hamt_release((srt_hamt *)l->next);
+    srt_hamt_value_release(&l->value);
+  }
+
+  free(root);
+}
+
+static node *node_new(uint32_t bitmap) {
+  const size_t count = __builtin_popcount(bitmap);
+  node *n = malloc(sizeof(*n) + count * sizeof(srt_hamt *));
+
+  if (n) {
+    n->hdr = (srt_hamt){.refs = 1, .kind = NODE};
+    n->bitmap = bitmap;
+  }
+
+  return n;
+}
+
+static leaf *leaf_new(const char *key, uint64_t hash, srt_hamt_value value) {
+  const size_t size = strlen(key) + 1;
+  leaf *l = malloc(sizeof(*l) + size);
+
+  if (!l) {
+    srt_hamt_value_release(&value);
+    return NULL;
+  }
+
+  l->hdr = (srt_hamt){.refs = 1, .kind = LEAF};
+  l->hash = hash;
+  l->next = NULL;
+  l->value = value;
+  memcpy(l->key, key, size);
+
+  return l;
+}
+
+//
+// a copy of leaf `l` in front of `next`, which it takes over. the string or
+// array of the value is copied, a nested map is shared.
+//
+static leaf *leaf_copy(const leaf *l, leaf *next) {
+  srt_hamt_value value = l->value;
+  bool ok = true;
+
+  if (value.tag == SRT_STR && value.str) {
+    ok = (value.str = strdup(value.str)) != NULL;
+  } else if (value.tag == SRT_INT64_ARRAY || value.tag == SRT_DOUBLE_ARRAY) {
+    value.array = srt_array_new(value.array->data, value.array->len, NULL);
+    ok = value.array != NULL;
+  } else if (value.tag == SRT_DICT) {
+    srt_hamt_retain(value.dict);
+  }
+
+  leaf *copy = ok ? leaf_new(l->key, l->hash, value) : NULL;
+
+  if (!copy) {
+    srt_hamt_release((srt_hamt *)next);
+    return NULL;
+  }
+
+  copy->next = next;
+
+  return copy;
+}
+
+static bool is_key(const leaf *l, const char *key, uint64_t hash) {
+  return l->hash == hash && strcmp(l->key, key) == 0;
+}
+
+//
+// the list `l` without `key`, sharing the part after it. `*out` is NULL when
+// nothing is left.
+//
+static bool without(leaf *l, const char *key, uint64_t hash, leaf **out) {
+  if (!l) {
+    *out = NULL;
+    return true;
+  }
+
+  if (is_key(l, key, hash)) {
+    *out = (leaf *)srt_hamt_retain((srt_hamt *)l->next);
+    return true;
+  }
+
+  leaf *rest;
+
+  if (!without(l->next, key, hash, &rest)) {
+    return false;
+  }
+
+  return (*out = leaf_copy(l, rest)) != NULL;
+}
+
+static bool in_list(const leaf *l, const char *key, uint64_t hash) {
+  for (; l; l = l->next) {
+    if (is_key(l, key, hash)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//
+// a node holding the list `a` and the new leaf `b`, from different buckets,
+// with as many nodes in between as the bits their hashes share.
+//
+static srt_hamt *join(leaf *a, leaf *b, int shift) {
+  const uint32_t bit_a = bit_of(a->hash, shift);
+  const uint32_t bit_b = bit_of(b->hash, shift);
+  node *n = node_new(bit_a | bit_b);
+
+  if (!n) {
+    srt_hamt_release(&a->hdr);
+    srt_hamt_release(&b->hdr);
+    return NULL;
+  }
+
+  if (bit_a == bit_b) {
+    if (!(n->slots[0] = join(a, b, shift + BITS))) {
+      free(n);
+      return NULL;
+    }
+  } else {
+    n->slots[bit_a < bit_b ? 0 : 1] = &a->hdr;
+    n->slots[bit_a < bit_b ? 1 : 0] = &b->hdr;
+  }
+
+  return &n->hdr;
+}
+
+//
+// `h` with the new leaf `l` in place of any leaf with its key, `l` is taken
+// over. nodes on a path that only the caller holds are `owned` and updated in
+// place, the others are copied.
+//
+static srt_hamt *insert(srt_hamt *h, int shift, leaf *l, bool owned) {
+  if (!h) {
+    return &l->hdr;
+  }
+
+  if (h->kind == LEAF) {
+    leaf *list = (leaf *)h;
+
+    if (!same_bucket(list->hash, l->hash)) {
+      return join((leaf *)srt_hamt_retain(h), l, shift);
+    }
+
+    if (!without(list, l->key, l->hash, &l->next)) {
+      srt_hamt_release(&l->hdr);
+      return NULL;
+    }
+
+    return &l->hdr;
+  }
+
+  node *n = (node *)h;
+  const uint32_t bit = bit_of(l->hash, shift);
+  const uint32_t pos = pos_of(n->bitmap, bit);
+  const uint32_t count = count_of(n);
+  const bool taken = n->bitmap & bit;
+
+  if (owned && h->refs == 1 && taken) {
+    srt_hamt *child = insert(n->slots[pos], shift + BITS, l, true);
+
+    if (!child) {
+      return NULL;
+    }
+
+    srt_hamt_release(n->slots[pos]);
+    n->slots[pos] = child;
+
+    return srt_hamt_retain(h);
+  }
+
+  node *copy = node_new(n->bitmap | bit);
+
+  if (!copy) {
+    srt_hamt_release(&l->hdr);
+    return NULL;
+  }
+
+  srt_hamt *child =
+      insert(taken ? n->slots[pos] : NULL, shift + BITS, l, false);
+
+  if (!child) {
+    free(copy);
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!taken || i != pos) {
+      const uint32_t j = taken || i < pos ? i : i + 1;
+      copy->slots[j] = srt_hamt_retain(n->slots[i]);
+    }
+  }
+
+  copy->slots[pos] = child;
+
+  return &copy->hdr;
+}
+
+bool srt_hamt_set(srt_hamt *root, const char *key, uint64_t hash,
+                  srt_hamt_value value, srt_hamt **out) {
+  leaf *l = leaf_new(key, hash, value);
+  return l && (*out = insert(root, 0, l, true)) != NULL;
+}
+
+//
+// `*out` is `h` with `key` removed, retained again when `key` is not in it.
+//
+static bool remove_from(srt_hamt *h, int shift, const char *key, uint64_t hash,
+                        srt_hamt **out) {
+  if (!h) {
+    *out = NULL;
+    return true;
+  }
+
+  if (h->kind == LEAF) {
+    if (!in_list((leaf *)h, key, hash)) {
+      *out = srt_hamt_retain(h);
+      return true;
+    }
+
+    leaf *rest;
+    const bool ok = without((leaf *)h, key, hash, &rest);
+    *out = (srt_hamt *)rest;
+
+    return ok;
+  }
+
+  node *n = (node *)h;
+  const uint32_t bit = bit_of(hash, shift);
+  const uint32_t pos = pos_of(n->bitmap, bit);
+
+  if (!(n->bitmap & bit)) {
+    *out = srt_hamt_retain(h);
+    return true;
+  }
+
+  srt_hamt *child;
+
+  if (!remove_from(n->slots[pos], shift + BITS, key, hash, &child)) {
+    return false;
+  }
+
+  if (child == n->slots[pos]) {
+    srt_hamt_release(child);
+    *out = srt_hamt_retain(h);
+    return true;
+  }
+
+  const uint32_t count = count_of(n);
+
+  //
+  // a node left with a single leaf is replaced by it, so lookups do not walk
+  // through nodes that no longer branch.
+  //
+  if (!child && count == 2 && n->slots[1 - pos]->kind == LEAF) {
+    *out = srt_hamt_retain(n->slots[1 - pos]);
+    return true;
+  }
+
+  if (count == 1 && (!child || child->kind == LEAF)) {
+    *out = child;
+    return true;
+  }
+
+  node *copy = node_new(child ? n->bitmap : n->bitmap & ~bit);
+
+  if (!copy) {
+    srt_hamt_release(child);
+    return false;
+  }
+
+  for (uint32_t i = 0, j = 0; i < count; ++i) {
+    if (i != pos) {
+      copy->slots[j++] = srt_hamt_retain(n->slots[i]);
+    } else if (child) {
+      copy->slots[j++] = child;
+    }
+  }
+
+  *out = &copy->hdr;
+
+  return true;
+}
+
+bool srt_hamt_delete(srt_hamt *root, const char *key, uint64_t hash,
+                     srt_hamt **out) {
+  return remove_from(root, 0, key, hash, out);
+}
+
+const srt_hamt_value *srt_hamt_get(const srt_hamt *root, const char *key,
+                                   uint64_t hash) {
+  int shift = 0;
+
+  while (root && root->kind == NODE) {
+    const node *n = (const node *)root;
+    const uint32_t bit = bit_of(hash, shift);
+
+    if (!(n->bitmap & bit)) {
+      return NULL;
+    }
+
+    root = n->slots[pos_of(n->bitmap, bit)];
+    shift += BITS;
+  }
+
+  for (const leaf *l = (const leaf *)root; l; l = l->next) {
+    if (is_key(l, key, hash)) {
+      return &l->value;
+    }
+  }
+
+  return NULL;
+}
+
+size_t srt_hamt_len(const srt_hamt *root) {
+  if (!root) {
+    return 0;
+  }
+
+  size_t len = 0;
+
+  if (root->kind == LEAF) {
+    for (const leaf *l = (const leaf *)root; l; l = l->next) {
+      ++len;
+    }
+
+    return len;
+  }
+
+  const node *n = (const node *)root;
+
+  for (uint32_t i = 0; i < count_of(n); ++i) {
+    len += srt_hamt_len(n->slots[i]);
+  }
+
+  return len;
+}
+
+bool srt_hamt_each(const srt_hamt *root, srt_hamt_fn fn, void *arg) {
+  if (!root) {
+    return true;
+  }
+
+  if (root->kind == LEAF) {
+    for (const leaf *l = (const leaf *)root; l; l = l->next) {
+      if (!fn(arg, l->key, &l->value)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  const node *n = (const node *)root;
+
+  for (uint32_t i = 0; i < count_of(n); ++i) {
+    if (!srt_hamt_each(n->slots[i], fn, arg)) {
+      return false;
+    }
+  }
+
+  return true;
+}
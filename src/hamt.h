@@ -0,0 +1,71 @@
+#pragma once
+
+#include "value.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// persistent hash array mapped trie. a map is a pointer to its root, NULL
+// when empty, and a root never changes once built: set and delete return a
+// new root that shares every node off the changed path with the old one, so
+// keeping a version costs a reference and changing one costs O(log n) nodes.
+//
+// each level takes 5 bits of the 64 bit hash of a key. keys whose hashes
+// agree on all 60 bits the 12 levels use share a leaf list at the bottom.
+//
+// nodes are reference counted without atomics. a root from set or delete, or
+// one passed to retain, is released with srt_hamt_release. set updates the
+// nodes of a root that nobody else holds in place rather than copying them,
+// so a version that is to be kept must be retained before it is set.
+//
+
+typedef struct srt_hamt srt_hamt;
+
+//
+// a frozen srt_value: the map owns the string and the array, a single block
+// from srt_array_new without an arena, and holds a reference to a nested map
+// where task data would have a dict.
+//
+
+typedef struct srt_hamt_value {
+  srt_value_tag tag;
+  union {
+    srt_array *array;
+    bool b;
+    srt_hamt *dict;
+    int64_t int64;
+    char *str;
+  };
+} srt_hamt_value;
+
+srt_hamt *srt_hamt_retain(srt_hamt *root);
+
+void srt_hamt_release(srt_hamt *root);
+
+void srt_hamt_value_release(srt_hamt_value *value);
+
+const srt_hamt_value *srt_hamt_get(const srt_hamt *root, const char *key,
+                                   uint64_t hash);
+
+//
+// both take ownership of `value`, also when they fail. `root` is left as it
+// was and the new version is stored in `out`.
+//
+
+bool srt_hamt_set(srt_hamt *root, const char *key, uint64_t hash,
+                  srt_hamt_value value, srt_hamt **out);
+
+bool srt_hamt_delete(srt_hamt *root, const char *key, uint64_t hash,
+                     srt_hamt **out);
+
+size_t srt_hamt_len(const srt_hamt *root);
+
+//
+// calls `fn` for every key in no particular order until it returns false.
+//
+
+typedef bool (*srt_hamt_fn)(void *arg, const char *key,
+                            const srt_hamt_value *value);
+
+bool srt_hamt_each(const srt_hamt *root, srt_hamt_fn fn, void *arg);
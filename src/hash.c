@@ -0,0 +1,96 @@
+#include "hash.h"
+#include <pthread.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
+
+#define P0 0xa0761d6478bd642full
+#define P1 0xe7037ed1a0b428dbull
+#define P2 0x8ebc6af09c88c6e3ull
+
+__extension__ typedef unsigned __int128 u128;
+
+//
+// 64x64 -> 128 bit multiply folded back to 64 bits, as in wyhash.
+//
+static uint64_t mum(const uint64_t a, const uint64_t b) {
+  const u128 r = (u128)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
+}
+
+static uint64_t load64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint64_t load32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+//
+// reads 1-8 bytes with fixed size loads that may overlap but never touch
+// memory past the end.
+//
+static uint64_t load_tail(const uint8_t *p, const size_t n) {
+  if (n >= 4) {
+    return load32(p) << 32 | load32(p + n - 4);
+  }
+
+  return (uint64_t)p[0] << 16 | (uint64_t)p[n >> 1] << 8 | p[n - 1];
+}
+
+uint64_t srt_hash_bytes(const void *data, size_t len, uint64_t seed) {
+  const uint8_t *p = data;
+  uint64_t h = seed ^ P0;
+  size_t n = len;
+
+  //
+  // the seed goes into both sides of every multiply. with it on one side
+  // only, a word equal to the constant on the other zeroes the product
+  // whatever the seed, and such keys collide under every seed.
+  //
+  const uint64_t s = seed ^ P1;
+
+  while (n > 16) {
+    h = mum(load64(p) ^ s, load64(p + 8) ^ h);
+    p += 16;
+    n -= 16;
+  }
+
+  uint64_t a = 0;
+  uint64_t b = 0;
+
+  if (n > 8) {
+    a = load64(p);
+    b = load64(p + n - 8);
+  } else if (n) {
+    a = load_tail(p, n);
+  }
+
+  return mum(P2 ^ len, mum(a ^ s, b ^ h));
+}
+
+uint64_t srt_hash_str(const char *str, uint64_t seed) {
+  return srt_hash_bytes(str, strlen(str), seed);
+}
+
+static uint64_t process_seed;
+static pthread_once_t process_seed_once = PTHREAD_ONCE_INIT;
+
+static void init_process_seed(void) {
+  if (getrandom(&process_seed, sizeof(process_seed), GRND_NONBLOCK) !=
+      sizeof(process_seed)) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    process_seed = mum((uint64_t)ts.tv_nsec ^ P0,
+                       (uint64_t)ts.tv_sec ^ (uintptr_t)&ts);
+  }
+}
+
+uint64_t srt_hash_seed(void) {
+  pthread_once(&process_seed_once, init_process_seed);
+  return process_seed;
+}
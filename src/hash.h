@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// 64 bit string hash that consumes 8 bytes per step. the seed is mixed into
+// every step, so tables seeded at random cannot be flooded with colliding
+// keys chosen ahead of time.
+//
+
+uint64_t srt_hash_bytes(const void *data, size_t len, uint64_t seed);
+
+uint64_t srt_hash_str(const char *str, uint64_t seed);
+
+//
+// random seed chosen once per process, the default for new dicts.
+//
+
+uint64_t srt_hash_seed(void);
@@ -0,0 +1,527 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "image.h"
+#include "array.h"
+#include "const.h"
+#include "hash.h"
+#include "value.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ALIGN 8
+#define MIN_CAP 8
+#define MAX_DEPTH 64
+
+static size_t align_up(size_t size) {
+  return (size + ALIGN - 1) & ~(size_t)(ALIGN - 1);
+}
+
+//
+// writing
+//
+
+typedef struct image_buf {
+  unsigned char *data;
+  size_t len;
+  size_t cap;
+} image_buf;
+
+#define AT(b, t, off) ((t *)((b)->data + (off)))
+
+//
+// reserves `size` zeroed bytes at the next aligned offset and returns that
+// offset, 0 on failure. index slots hold 32 bit offsets, which caps an image
+// at 4GB.
+//
+static uint64_t reserve(image_buf *b, size_t size) {
+  const size_t off = align_up(b->len);
+  const size_t end = off + size;
+
+  if (end > UINT32_MAX) {
+    return 0;
+  }
+
+  if (end > b->cap) {
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap < end) {
+      cap *= 2;
+    }
+
+    unsigned char *data = realloc(b->data, cap);
+    if (!data) {
+      return 0;
+    }
+
+    b->data = data;
+    b->cap = cap;
+  }
+
+  memset(b->data + b->len, 0, end - b->len);
+  b->len = end;
+
+  return off;
+}
+
+static uint64_t write_dict(image_buf *b, const srt_dict *dict, uint64_t seed);
+
+static bool write_value(image_buf *b, const srt_value *value, uint64_t seed,
+                        uint64_t *payload) {
+  switch (value->tag) {
+  case SRT_BOOL:
+    *payload = value->b;
+    return true;
+  case SRT_INT64:
+    *payload = (uint64_t)value->int64;
+    return true;
+  case SRT_STR: {
+    const char *str = srt_value_str(value);
+
+    if (!str) {
+      *payload = 0;
+      return true;
+    }
+
+    const size_t len = strlen(str) + 1;
+    if (!(*payload = reserve(b, len))) {
+      return false;
+    }
+
+    memcpy(b->data + *payload, str, len);
+    return true;
+  }
+  case SRT_DICT:
+    if (!value->dict) {
+      *payload = 0;
+      return true;
+    }
+
+    return (*payload = write_dict(b, value->dict, seed)) != 0;
+  case SRT_INT64_ARRAY:
+  case SRT_DOUBLE_ARRAY: {
+    const srt_array *array = value->array;
+    const size_t size = array->len * SRT_ARRAY_ELEM;
+
+    if (!(*payload = reserve(b, sizeof(uint64_t) + size))) {
+      return false;
+    }
+
+    *AT(b, uint64_t, *payload) = array->len;
+    memcpy(b->data + *payload + sizeof(uint64_t), array->data, size);
+    return true;
+  }
+  }
+
+  return false;
+}
+
+//
+// the index is sized to at most half full so a probe in the mapping rarely
+// walks more than a slot or two. nested values are written right behind the
+// entry that holds them, which moves the buffer, so everything is addressed
+// by offset.
+//
+static uint64_t write_dict(image_buf *b, const srt_dict *dict, uint64_t seed) {
+  const size_t len = srt_dict_len(dict);
+  size_t cap = MIN_CAP;
+  while (cap < len * 2) {
+    cap <<= 1;
+  }
+
+  const uint64_t off =
+      reserve(b, sizeof(srt_image_dict) + cap * sizeof(uint32_t));
+  if (!off) {
+    return 0;
+  }
+
+  AT(b, srt_image_dict, off)->cap = cap;
+  AT(b, srt_image_dict, off)->len = len;
+
+  size_t pos = 0;
+  for (srt_dict_item *item; (item = srt_dict_next(dict, &pos));) {
+    const char *key = srt_dict_item_key(item);
+    const size_t key_len = strlen(key);
+    const uint64_t hash = srt_hash_str(key, seed);
+    const uint64_t entry = reserve(b, sizeof(srt_image_entry) + key_len + 1);
+    uint64_t payload;
+
+    if (!entry || !write_value(b, &item->value, seed, &payload)) {
+      return 0;
+    }
+
+    srt_image_entry *e = AT(b, srt_image_entry, entry);
+    e->hash = hash;
+    e->payload = payload;
+    e->tag = item->value.tag;
+    e->key_len = key_len;
+    memcpy(e->key, key, key_len + 1);
+
+    uint32_t *index = AT(b, srt_image_dict, off)->index;
+    size_t slot = hash & (cap - 1);
+    while (index[slot]) {
+      slot = (slot + 1) & (cap - 1);
+    }
+    index[slot] = entry;
+  }
+
+  return off;
+}
+
+//
+// the image goes to a temporary file that is renamed over `path` once it is
+// on disk, so a crash never leaves a torn image behind and an image mapped
+// from `path` keeps its old contents.
+//
+static int32_t write_file(const image_buf *b, const char *path) {
+  const size_t path_len = strlen(path);
+  char *tmp = malloc(path_len + sizeof(".tmp"));
+  if (!tmp) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  memcpy(tmp, path, path_len);
+  memcpy(tmp + path_len, ".tmp", sizeof(".tmp"));
+
+  FILE *f = fopen(tmp, "wb");
+  if (!f) {
+    free(tmp);
+    return SRT_IO_ERROR;
+  }
+
+  bool ok = fwrite(b->data, 1, b->len, f) == b->len && fflush(f) == 0 &&
+            fsync(fileno(f)) == 0;
+  ok = fclose(f) == 0 && ok;
+  ok = ok && rename(tmp, path) == 0;
+
+  if (!ok) {
+    remove(tmp);
+  }
+
+  free(tmp);
+
+  return ok ? SRT_SUCCESS : SRT_IO_ERROR;
+}
+
+int32_t srt_image_save(const srt_dict *dict, uint64_t seed, const char *path) {
+  image_buf b = {0};
+
+  reserve(&b, sizeof(srt_image_header));
+  if (!b.data) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  const uint64_t root = write_dict(&b, dict, seed);
+  if (!root) {
+    free(b.data);
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  srt_image_header *header = AT(&b, srt_image_header, 0);
+  memcpy(header->magic, SRT_IMAGE_MAGIC, sizeof(header->magic));
+  header->version = SRT_IMAGE_VERSION;
+  header->seed = seed;
+  header->size = b.len;
+  header->root = root;
+
+  const int32_t result = write_file(&b, path);
+  free(b.data);
+
+  return result;
+}
+
+//
+// reading. nothing but the header is checked up front, every offset is
+// bounds checked when it is followed so a damaged image reads as missing keys
+// rather than faulting.
+//
+
+static const srt_image_dict *dict_at(const srt_image *image, uint64_t off) {
+  if (!off || off % ALIGN || off > image->size - sizeof(srt_image_dict)) {
+    return NULL;
+  }
+
+  const srt_image_dict *d = (const void *)(image->base + off);
+  const size_t room = (image->size - off - sizeof(*d)) / sizeof(uint32_t);
+
+  if (!d->cap || d->cap & (d->cap - 1) || d->cap > room) {
+    return NULL;
+  }
+
+  return d;
+}
+
+static const srt_image_entry *entry_at(const srt_image *image, uint64_t off) {
+  if (off < sizeof(srt_image_header) || off % ALIGN ||
+      off > image->size - sizeof(srt_image_entry)) {
+    return NULL;
+  }
+
+  const srt_image_entry *e = (const void *)(image->base + off);
+
+  if (e->key_len >= image->size - off - sizeof(*e) || e->key[e->key_len]) {
+    return NULL;
+  }
+
+  return e;
+}
+
+static uint64_t *array_at(const srt_image *image, uint64_t off) {
+  if (!off || off % ALIGN || off > image->size - sizeof(uint64_t)) {
+    return NULL;
+  }
+
+  uint64_t *len = (void *)(image->base + off);
+  const size_t room = (image->size - off - sizeof(*len)) / SRT_ARRAY_ELEM;
+
+  return *len <= room ? len : NULL;
+}
+
+static const srt_image_entry *find(const srt_image *image,
+                                   const srt_image_dict *dict, const char *key,
+                                   uint64_t hash, size_t *slot) {
+  const size_t mask = dict->cap - 1;
+
+  for (size_t i = hash & mask, n = 0; n < dict->cap; i = (i + 1) & mask, ++n) {
+    if (!dict->index[i]) {
+      return NULL;
+    }
+
+    const srt_image_entry *e = entry_at(image, dict->index[i]);
+    if (!e) {
+      return NULL;
+    }
+
+    if (e->hash == hash && strcmp(e->key, key) == 0) {
+      *slot = i;
+      return e;
+    }
+  }
+
+  return NULL;
+}
+
+static bool shadowed(const srt_image *image, size_t slot) {
+  return image->shadow[slot / 64] & (uint64_t)1 << slot % 64;
+}
+
+static void shadow(srt_image *image, size_t slot) {
+  image->shadow[slot / 64] |= (uint64_t)1 << slot % 64;
+}
+
+static const srt_image_entry *find_key(const srt_image *image, srt_key *key,
+                                       size_t *slot) {
+  const uint64_t hash = key->hashed && key->seed == image->seed
+                            ? key->hash
+                            : srt_hash_str(key->str, image->seed);
+  const srt_image_entry *e = find(image, image->root, key->str, hash, slot);
+
+  return e && !shadowed(image, *slot) ? e : NULL;
+}
+
+static bool value_of(const srt_image *image, const srt_image_entry *e,
+                     const srt_dict *into, int depth, srt_value *value);
+
+static srt_dict *dict_of(const srt_image *image, uint64_t off,
+                         const srt_dict *into, int depth) {
+  const srt_image_dict *d = dict_at(image, off);
+  if (!d || depth > MAX_DEPTH) {
+    return NULL;
+  }
+
+  srt_dict *dict = srt_dict_new_in(into->arena, d->cap, into->seed);
+  if (!dict) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < d->cap; ++i) {
+    if (!d->index[i]) {
+      continue;
+    }
+
+    const srt_image_entry *e = entry_at(image, d->index[i]);
+    srt_value value;
+
+    if (!e || !value_of(image, e, dict, depth + 1, &value) ||
+        !srt_dict_put(dict, e->key, value)) {
+      srt_dict_free(dict);
+      return NULL;
+    }
+  }
+
+  return dict;
+}
+
+static bool value_of(const srt_image *image, const srt_image_entry *e,
+                     const srt_dict *into, int depth, srt_value *value) {
+  switch (e->tag) {
+  case SRT_BOOL:
+    *value = SRT_VALUE(SRT_BOOL, b, e->payload != 0);
+    return true;
+  case SRT_INT64:
+    *value = SRT_VALUE(SRT_INT64, int64, (int64_t)e->payload);
+    return true;
+  case SRT_STR: {
+    char *str = NULL;
+
+    if (e->payload) {
+      if (e->payload >= image->size ||
+          !memchr(image->base + e->payload, '\0', image->size - e->payload)) {
+        return false;
+      }
+
+      str = (char *)image->base + e->payload;
+    }
+
+    *value = SRT_VALUE(SRT_STR, str, str);
+    return true;
+  }
+  case SRT_DICT: {
+    srt_dict *dict = NULL;
+
+    if (e->payload && !(dict = dict_of(image, e->payload, into, depth))) {
+      return false;
+    }
+
+    *value = SRT_VALUE(SRT_DICT, dict, dict);
+    return true;
+  }
+  case SRT_INT64_ARRAY:
+  case SRT_DOUBLE_ARRAY: {
+    uint64_t *len = array_at(image, e->payload);
+    srt_array *array;
+
+    if (!len || !into->arena ||
+        !(array = srt_array_view(len + 1, *len, into->arena))) {
+      return false;
+    }
+
+    *value = (srt_value){.tag = e->tag, .array = array};
+    return true;
+  }
+  }
+
+  return false;
+}
+
+//
+// the mapping is private and writable so strings handed out as char * can be
+// written through without touching the file.
+//
+int32_t srt_image_open(const char *path, srt_image **image) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return SRT_IO_ERROR;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return SRT_IO_ERROR;
+  }
+
+  if ((size_t)st.st_size < sizeof(srt_image_header)) {
+    close(fd);
+    return SRT_INVALID_IMAGE;
+  }
+
+  void *base =
+      mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (base == MAP_FAILED) {
+    return SRT_IO_ERROR;
+  }
+
+  srt_image *img = calloc(1, sizeof(*img));
+  if (!img) {
+    munmap(base, st.st_size);
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  img->base = base;
+  img->size = st.st_size;
+
+  const srt_image_header *header = base;
+
+  if (memcmp(header->magic, SRT_IMAGE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != SRT_IMAGE_VERSION || header->size != img->size ||
+      !(img->root = dict_at(img, header->root))) {
+    srt_image_close(img);
+    return SRT_INVALID_IMAGE;
+  }
+
+  img->seed = header->seed;
+  img->shadow = calloc((img->root->cap + 63) / 64, sizeof(*img->shadow));
+
+  if (!img->shadow) {
+    srt_image_close(img);
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  *image = img;
+
+  return SRT_SUCCESS;
+}
+
+void srt_image_close(srt_image *image) {
+  if (!image) {
+    return;
+  }
+
+  munmap(image->base, image->size);
+  free(image->shadow);
+  free(image);
+}
+
+srt_value *srt_image_fault(srt_image *image, srt_dict *dict, srt_key *key) {
+  size_t slot;
+  srt_value value;
+  const srt_image_entry *e = find_key(image, key, &slot);
+
+  if (!e || !value_of(image, e, dict, 0, &value) ||
+      !srt_dict_put_k(dict, key, value)) {
+    return NULL;
+  }
+
+  shadow(image, slot);
+
+  return srt_dict_get_k(dict, key);
+}
+
+bool srt_image_shadow(srt_image *image, srt_key *key) {
+  size_t slot;
+
+  if (!find_key(image, key, &slot)) {
+    return false;
+  }
+
+  shadow(image, slot);
+
+  return true;
+}
+
+bool srt_image_fault_all(srt_image *image, srt_dict *dict) {
+  const srt_image_dict *root = image->root;
+
+  for (size_t i = 0; i < root->cap; ++i) {
+    if (!root->index[i] || shadowed(image, i)) {
+      continue;
+    }
+
+    const srt_image_entry *e = entry_at(image, root->index[i]);
+    srt_value value;
+
+    if (!e || !value_of(image, e, dict, 0, &value) ||
+        !srt_dict_put(dict, e->key, value)) {
+      return false;
+    }
+
+    shadow(image, i);
+  }
+
+  return true;
+}
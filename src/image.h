@@ -0,0 +1,90 @@
+#pragma once
+
+#include "dict.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// a dict written out in a form that is read in place through mmap. the file
+// holds the dict as an open addressed index of entry offsets, so opening an
+// image costs a header check and a key costs one probe of the mapping, no
+// matter how many entries the image holds. integers are in native byte
+// order, images are not meant to move between architectures.
+//
+//   header   magic, version, hash seed, file size, offset of the root dict
+//   dict     capacity, length, capacity u32 entry offsets (0 when empty)
+//   entry    hash, payload, tag, key length, nul terminated key
+//
+// bool and int64 payloads are the value itself. str and dict payloads are
+// the offset of the nul terminated string or of the nested dict, 0 for NULL.
+// array payloads are the offset of a u64 count followed by the elements.
+// every record starts 8 byte aligned.
+//
+
+#define SRT_IMAGE_MAGIC "SRTI"
+#define SRT_IMAGE_VERSION 1
+
+typedef struct srt_image_header {
+  char magic[4];
+  uint32_t version;
+  uint64_t seed;
+  uint64_t size;
+  uint64_t root;
+} srt_image_header;
+
+typedef struct srt_image_dict {
+  uint32_t cap;
+  uint32_t len;
+  uint32_t index[];
+} srt_image_dict;
+
+typedef struct srt_image_entry {
+  uint64_t hash;
+  uint64_t payload;
+  uint32_t tag;
+  uint32_t key_len;
+  char key[];
+} srt_image_entry;
+
+//
+// an open image keeps one shadow bit per slot of the root index. the bit is
+// set once the entry has been copied out or replaced, after which the image
+// answers as if the key were not there.
+//
+
+typedef struct srt_image {
+  unsigned char *base;
+  size_t size;
+  uint64_t seed;
+  const srt_image_dict *root;
+  uint64_t *shadow;
+} srt_image;
+
+int32_t srt_image_save(const srt_dict *dict, uint64_t seed, const char *path);
+
+int32_t srt_image_open(const char *path, srt_image **image);
+
+void srt_image_close(srt_image *image);
+
+//
+// copies the value of `key` out of the image into `dict` and returns it as
+// srt_dict_get_k would. NULL when the image does not have the key or it has
+// been shadowed. nested dicts are created in the arena of `dict`, strings
+// and the elements of arrays point into the mapping and live as long as the
+// image.
+//
+
+srt_value *srt_image_fault(srt_image *image, srt_dict *dict, srt_key *key);
+
+//
+// hides the image copy of `key`. true when there was one to hide.
+//
+
+bool srt_image_shadow(srt_image *image, srt_key *key);
+
+//
+// copies every entry not yet shadowed into `dict`.
+//
+
+bool srt_image_fault_all(srt_image *image, srt_dict *dict);
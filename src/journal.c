@@ -0,0 +1,680 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "journal.h"
+#include "arena.h"
+#include "array.h"
+#include "const.h"
+#include "image.h"
+#include "value.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BUFFER_LIMIT (1 << 20)
+#define TOUCHED_CAPACITY 16
+#define NULL_LEN UINT32_MAX
+#define MAX_DEPTH 64
+
+typedef enum record {
+  RECORD_SET = 1,
+  RECORD_DELETE,
+  RECORD_RESET,
+  RECORD_COMMIT
+} record;
+
+typedef struct journal_header {
+  char magic[4];
+  uint32_t version;
+} journal_header;
+
+//
+// writing
+//
+
+static bool put(srt_journal *j, const void *data, size_t len) {
+  if (j->failed) {
+    return false;
+  }
+
+  if (j->len + len > j->cap) {
+    size_t cap = j->cap ? j->cap : 64 * 1024;
+
+    while (cap < j->len + len) {
+      cap *= 2;
+    }
+
+    unsigned char *buf = realloc(j->buf, cap);
+
+    if (!buf) {
+      j->failed = true;
+      return false;
+    }
+
+    j->buf = buf;
+    j->cap = cap;
+  }
+
+  memcpy(j->buf + j->len, data, len);
+  j->len += len;
+  j->txn_len += len;
+
+  return true;
+}
+
+static bool put_u8(srt_journal *j, uint8_t x) { return put(j, &x, sizeof(x)); }
+
+static bool put_u32(srt_journal *j, uint32_t x) {
+  return put(j, &x, sizeof(x));
+}
+
+static bool put_u64(srt_journal *j, uint64_t x) {
+  return put(j, &x, sizeof(x));
+}
+
+static bool put_str(srt_journal *j, const char *str) {
+  if (!str) {
+    return put_u32(j, NULL_LEN);
+  }
+
+  const size_t len = strlen(str);
+
+  return put_u32(j, len) && put(j, str, len);
+}
+
+static bool put_array(srt_journal *j, const srt_array *array) {
+  return put_u64(j, array->len) &&
+         put(j, array->data, array->len * SRT_ARRAY_ELEM);
+}
+
+static bool put_value(srt_journal *j, const srt_value *value);
+
+static bool put_dict(srt_journal *j, const srt_dict *dict) {
+  if (!dict) {
+    return put_u32(j, NULL_LEN);
+  }
+
+  bool ok = put_u32(j, srt_dict_len(dict));
+  size_t pos = 0;
+
+  for (srt_dict_item *item; ok && (item = srt_dict_next(dict, &pos));) {
+    ok = put_str(j, srt_dict_item_key(item)) && put_value(j, &item->value);
+  }
+
+  return ok;
+}
+
+static bool put_value(srt_journal *j, const srt_value *value) {
+  if (!put_u8(j, value->tag)) {
+    return false;
+  }
+
+  switch (value->tag) {
+  case SRT_BOOL:
+    return put_u8(j, value->b);
+  case SRT_DICT:
+    return put_dict(j, value->dict);
+  case SRT_INT64:
+    return put(j, &value->int64, sizeof(value->int64));
+  case SRT_STR:
+    return put_str(j, srt_value_str(value));
+  case SRT_INT64_ARRAY:
+  case SRT_DOUBLE_ARRAY:
+    return put_array(j, value->array);
+  }
+
+  return false;
+}
+
+static bool put_set(srt_journal *j, const char *key, const srt_value *value) {
+  return put_u8(j, RECORD_SET) && put_str(j, key) && put_value(j, value);
+}
+
+static bool write_out(srt_journal *j) {
+  for (size_t off = 0; !j->failed && off < j->len;) {
+    const ssize_t n = write(j->fd, j->buf + off, j->len - off);
+
+    if (n < 0 && errno != EINTR) {
+      j->failed = true;
+    }
+
+    off += n > 0 ? n : 0;
+  }
+
+  j->len = 0;
+
+  return !j->failed;
+}
+
+static bool flush(srt_journal *j, bool sync) {
+  j->commits = 0;
+
+  if (!write_out(j) || (sync && fdatasync(j->fd) != 0)) {
+    j->failed = true;
+  }
+
+  return !j->failed;
+}
+
+//
+// records of a transaction that outgrow the buffer are written before its
+// commit, recovery drops them if the commit never follows.
+//
+static void spill(srt_journal *j) {
+  if (j->len >= BUFFER_LIMIT) {
+    write_out(j);
+  }
+}
+
+static bool untouch_all(srt_journal *j) {
+  if (srt_dict_len(j->touched) == 0) {
+    return true;
+  }
+
+  srt_dict_free(j->touched);
+
+  if (!(j->touched = srt_dict_new(TOUCHED_CAPACITY))) {
+    j->failed = true;
+  }
+
+  return !j->failed;
+}
+
+static bool put_whole(const srt_context *ctx, srt_journal *j) {
+  if (ctx->image && !srt_image_fault_all(ctx->image, ctx->task_data)) {
+    j->failed = true;
+    return false;
+  }
+
+  bool ok = put_u8(j, RECORD_RESET);
+  size_t pos = 0;
+
+  for (srt_dict_item *item;
+       ok && (item = srt_dict_next(ctx->task_data, &pos));) {
+    ok = put_set(j, srt_dict_item_key(item), &item->value);
+    spill(j);
+  }
+
+  j->whole = false;
+
+  return ok;
+}
+
+static bool put_touched(const srt_context *ctx, srt_journal *j) {
+  bool ok = true;
+  size_t pos = 0;
+
+  for (srt_dict_item *item; ok && (item = srt_dict_next(j->touched, &pos));) {
+    const char *key = srt_dict_item_key(item);
+    const srt_value *v = srt_dict_peek(ctx->task_data, key);
+
+    if (v && srt_value_in_place(v)) {
+      ok = put_set(j, key, v);
+      spill(j);
+    }
+  }
+
+  return ok;
+}
+
+static bool commit(const srt_context *ctx, srt_journal *j) {
+  if (!(j->whole ? put_whole(ctx, j) : put_touched(ctx, j)) ||
+      !untouch_all(j)) {
+    return false;
+  }
+
+  const uint64_t txn_len = j->txn_len;
+
+  if (!put_u8(j, RECORD_COMMIT) || !put_u64(j, ++j->seq) ||
+      !put_u64(j, txn_len)) {
+    return false;
+  }
+
+  j->txn_len = 0;
+
+  const bool sync = j->sync == SRT_JOURNAL_SYNC_GROUP;
+
+  return ++j->commits < j->group || flush(j, sync);
+}
+
+//
+// keeping up with task data
+//
+
+void srt_journal_set(const srt_context *ctx, srt_key *key,
+                     const srt_value *value) {
+  srt_journal *j = ctx->journal;
+
+  if (j->whole) {
+    return;
+  }
+
+  if (srt_value_in_place(value)) {
+    srt_journal_touch(ctx, key);
+    return;
+  }
+
+  put_set(j, key->str, value);
+  spill(j);
+}
+
+void srt_journal_delete(const srt_context *ctx, srt_key *key) {
+  srt_journal *j = ctx->journal;
+
+  if (!j->whole && put_u8(j, RECORD_DELETE) && put_str(j, key->str)) {
+    spill(j);
+  }
+}
+
+void srt_journal_touch(const srt_context *ctx, srt_key *key) {
+  srt_journal *j = ctx->journal;
+
+  if (!j->whole && !j->failed &&
+      !srt_dict_put(j->touched, key->str, SRT_VALUE(SRT_BOOL, b, true))) {
+    j->failed = true;
+  }
+}
+
+void srt_journal_reset(srt_journal *journal) {
+  if (journal) {
+    journal->whole = true;
+  }
+}
+
+bool srt_journal_commit(const srt_context *ctx) {
+  return commit(ctx, ctx->journal);
+}
+
+//
+// reading
+//
+
+typedef struct reader {
+  const unsigned char *p;
+  const unsigned char *end;
+} reader;
+
+static bool get(reader *r, void *out, size_t len) {
+  if ((size_t)(r->end - r->p) < len) {
+    return false;
+  }
+
+  memcpy(out, r->p, len);
+  r->p += len;
+
+  return true;
+}
+
+//
+// a NULL `ctx` only checks that the records are whole, otherwise they are
+// decoded into its arena.
+//
+static bool get_str(reader *r, const srt_context *ctx, char **out) {
+  uint32_t len;
+  *out = NULL;
+
+  if (!get(r, &len, sizeof(len))) {
+    return false;
+  }
+
+  if (len == NULL_LEN) {
+    return true;
+  }
+
+  if ((size_t)(r->end - r->p) < len) {
+    return false;
+  }
+
+  if (ctx) {
+    if (!(*out = srt_arena_alloc(ctx->arena, len + 1))) {
+      return false;
+    }
+
+    memcpy(*out, r->p, len);
+    (*out)[len] = '\0';
+  }
+
+  r->p += len;
+
+  return true;
+}
+
+//
+// a str value short enough is decoded into the value itself.
+//
+static bool get_str_value(reader *r, const srt_context *ctx,
+                          srt_value *out) {
+  uint32_t len;
+
+  if (!get(r, &len, sizeof(len))) {
+    return false;
+  }
+
+  if (len != NULL_LEN && (size_t)(r->end - r->p) < len) {
+    return false;
+  }
+
+  const char *str = len == NULL_LEN ? NULL : (const char *)r->p;
+  r->p += len == NULL_LEN ? 0 : len;
+
+  return !ctx || srt_value_set_str(out, str, len, ctx->arena);
+}
+
+static bool get_array(reader *r, const srt_context *ctx, srt_array **out) {
+  uint64_t len;
+
+  if (!get(r, &len, sizeof(len)) ||
+      len > (size_t)(r->end - r->p) / SRT_ARRAY_ELEM) {
+    return false;
+  }
+
+  const unsigned char *data = r->p;
+  r->p += len * SRT_ARRAY_ELEM;
+
+  return !ctx || (*out = srt_array_new(data, len, ctx->arena));
+}
+
+static bool get_key(reader *r, const srt_context *ctx, char **out) {
+  uint32_t len;
+
+  if ((size_t)(r->end - r->p) < sizeof(len)) {
+    return false;
+  }
+
+  memcpy(&len, r->p, sizeof(len));
+
+  return len != NULL_LEN && get_str(r, ctx, out);
+}
+
+static bool get_value(reader *r, const srt_context *ctx, size_t depth,
+                      srt_value *out);
+
+static bool get_dict(reader *r, const srt_context *ctx, size_t depth,
+                     srt_dict **out) {
+  uint32_t len;
+  *out = NULL;
+
+  if (!get(r, &len, sizeof(len)) || depth > MAX_DEPTH) {
+    return false;
+  }
+
+  if (len == NULL_LEN) {
+    return true;
+  }
+
+  if (ctx && !(*out = srt_ctx_dict_new(ctx, len < 8 ? 16 : len * 2))) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < len; ++i) {
+    char *key;
+    srt_value value;
+
+    if (!get_key(r, ctx, &key) || !get_value(r, ctx, depth + 1, &value) ||
+        (ctx && !srt_dict_put(*out, key, value))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool get_value(reader *r, const srt_context *ctx, size_t depth,
+                      srt_value *out) {
+  uint8_t tag;
+
+  if (!get(r, &tag, sizeof(tag))) {
+    return false;
+  }
+
+  *out = (srt_value){.tag = tag};
+
+  switch (out->tag) {
+  case SRT_BOOL: {
+    uint8_t b = 0;
+    const bool ok = get(r, &b, sizeof(b));
+    out->b = b;
+    return ok;
+  }
+  case SRT_DICT:
+    return get_dict(r, ctx, depth, &out->dict);
+  case SRT_INT64:
+    return get(r, &out->int64, sizeof(out->int64));
+  case SRT_STR:
+    return get_str_value(r, ctx, out);
+  case SRT_INT64_ARRAY:
+  case SRT_DOUBLE_ARRAY:
+    return get_array(r, ctx, &out->array);
+  }
+
+  return false;
+}
+
+static bool get_record(reader *r, srt_context *ctx, uint64_t *seq,
+                       const unsigned char **txn) {
+  uint8_t type;
+  char *key;
+  srt_value value;
+
+  if (!get(r, &type, sizeof(type))) {
+    return false;
+  }
+
+  switch (type) {
+  case RECORD_SET:
+    return get_key(r, ctx, &key) && get_value(r, ctx, 0, &value) &&
+           (!ctx || srt_dict_put(ctx->task_data, key, value));
+  case RECORD_DELETE:
+    if (!get_key(r, ctx, &key)) {
+      return false;
+    }
+    if (ctx) {
+      srt_dict_delete(ctx->task_data, key);
+    }
+    return true;
+  case RECORD_RESET:
+    if (ctx) {
+      srt_ctx_reset(ctx);
+    }
+    return true;
+  case RECORD_COMMIT: {
+    const uint64_t len = r->p - 1 - *txn;
+    uint64_t n;
+    uint64_t txn_len;
+
+    if (!get(r, &n, sizeof(n)) || !get(r, &txn_len, sizeof(txn_len)) ||
+        n != *seq + 1 || txn_len != len) {
+      return false;
+    }
+
+    *seq = n;
+    *txn = r->p;
+    return true;
+  }
+  }
+
+  return false;
+}
+
+//
+// the length of the part of `data` that ends with a whole transaction.
+//
+static size_t committed(const unsigned char *data, size_t len) {
+  const unsigned char *txn = data + sizeof(journal_header);
+  reader r = {txn, data + len};
+  uint64_t seq = 0;
+
+  while (r.p < r.end && get_record(&r, NULL, &seq, &txn)) {
+  }
+
+  return txn - data;
+}
+
+static bool replay(srt_context *ctx, const unsigned char *data, size_t len) {
+  const unsigned char *txn = data + sizeof(journal_header);
+  reader r = {txn, data + len};
+  uint64_t seq = 0;
+
+  while (r.p < r.end) {
+    if (!get_record(&r, ctx, &seq, &txn)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static int32_t read_file(const char *path, unsigned char **data, size_t *len) {
+  FILE *in = fopen(path, "rb");
+  *data = NULL;
+  *len = 0;
+
+  if (!in) {
+    return errno == ENOENT ? SRT_SUCCESS : SRT_IO_ERROR;
+  }
+
+  size_t cap = 0;
+  bool ok = true;
+
+  while (ok && !feof(in)) {
+    if (*len == cap) {
+      cap = cap ? cap * 2 : 64 * 1024;
+      unsigned char *grown = realloc(*data, cap);
+      ok = grown != NULL;
+      *data = ok ? grown : *data;
+    }
+
+    *len += ok ? fread(*data + *len, 1, cap - *len, in) : 0;
+    ok = ok && !ferror(in);
+  }
+
+  fclose(in);
+
+  return ok ? SRT_SUCCESS : SRT_IO_ERROR;
+}
+
+static int32_t recover(srt_context *ctx, const char *path) {
+  unsigned char *data;
+  size_t len;
+  int32_t result = read_file(path, &data, &len);
+  journal_header header;
+
+  if (result != SRT_SUCCESS || len == 0) {
+    free(data);
+    return result;
+  }
+
+  if (len >= sizeof(header)) {
+    memcpy(&header, data, sizeof(header));
+  }
+
+  if (len < sizeof(header) ||
+      memcmp(header.magic, SRT_JOURNAL_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != SRT_JOURNAL_VERSION) {
+    result = SRT_INVALID_JOURNAL;
+  } else if (!replay(ctx, data, committed(data, len))) {
+    result = SRT_UNKNOWN_ERROR;
+  }
+
+  free(data);
+
+  return result;
+}
+
+//
+// opening and closing
+//
+
+//
+// the recovered task data goes to a temporary file, as one transaction, that
+// is renamed over `path` once it is on disk. the descriptor stays open and
+// appends to the journal from then on.
+//
+static int32_t compact(srt_context *ctx, srt_journal *j, const char *path) {
+  const size_t path_len = strlen(path);
+  char *tmp = malloc(path_len + sizeof(".tmp"));
+  if (!tmp) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  memcpy(tmp, path, path_len);
+  memcpy(tmp + path_len, ".tmp", sizeof(".tmp"));
+
+  journal_header header = {.version = SRT_JOURNAL_VERSION};
+  memcpy(header.magic, SRT_JOURNAL_MAGIC, sizeof(header.magic));
+
+  j->fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  bool ok = j->fd >= 0 && put(j, &header, sizeof(header));
+  j->txn_len = 0;
+
+  ok = ok && commit(ctx, j) && flush(j, true) && rename(tmp, path) == 0;
+
+  if (!ok && j->fd >= 0) {
+    remove(tmp);
+  }
+
+  free(tmp);
+
+  return ok ? SRT_SUCCESS : SRT_IO_ERROR;
+}
+
+int32_t srt_ctx_journal(srt_context *ctx, const char *path,
+                        srt_journal_sync sync, size_t group) {
+  if (ctx->journal) {
+    srt_journal_close(ctx->journal);
+    ctx->journal = NULL;
+  }
+
+  int32_t result = recover(ctx, path);
+
+  if (result != SRT_SUCCESS) {
+    return result;
+  }
+
+  srt_journal *j = calloc(1, sizeof(*j));
+
+  if (!j || !(j->touched = srt_dict_new(TOUCHED_CAPACITY))) {
+    free(j);
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  j->fd = -1;
+  j->sync = sync;
+  j->group = group ? group : 1;
+  j->whole = true;
+
+  if ((result = compact(ctx, j, path)) != SRT_SUCCESS) {
+    srt_journal_close(j);
+    return result;
+  }
+
+  ctx->journal = j;
+
+  return SRT_SUCCESS;
+}
+
+//
+// records after the last commit are written too, they are dropped again on
+// recovery.
+//
+bool srt_journal_close(srt_journal *journal) {
+  if (!journal) {
+    return true;
+  }
+
+  bool ok = journal->fd < 0 ||
+            flush(journal, journal->sync == SRT_JOURNAL_SYNC_GROUP);
+
+  if (journal->fd >= 0) {
+    ok = close(journal->fd) == 0 && ok;
+  }
+
+  srt_dict_free(journal->touched);
+  free(journal->buf);
+  free(journal);
+
+  return ok;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ctx.h"
+#include "dict.h"
+#include "types.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// an append only journal of task data changes, so a process that dies
+// partway through can be picked up from its last finished element. every set
+// and delete appends a record, and srt_did_run_element appends a commit that
+// closes the element's records into one transaction. on recovery the
+// transactions are replayed in order and records after the last commit are
+// dropped.
+//
+// records are buffered and written with one write per `group` commits. with
+// SRT_JOURNAL_SYNC_GROUP each such write is followed by an fdatasync, so at
+// most the last `group` elements are lost to a crash of the machine rather
+// than of the process.
+//
+//   header   magic, version
+//   set      type, key length, key, value
+//   delete   type, key length, key
+//   reset    type
+//   commit   type, sequence number, byte length of the transaction
+//
+// a value is its tag followed by a bool byte, an int64, a u32 length and
+// the bytes of a str, a u32 count and the key and value of each item of a
+// dict, or a u64 count and the elements of an array. a NULL str or dict has
+// the length UINT32_MAX. numbers are in native byte order, like images.
+//
+// dicts handed out by a get or set and arrays appended to can change after
+// the record was written, so their keys are noted as touched and their values
+// written again at the commit. task data replaced wholesale, by
+// srt_ctx_reset, a load or a json read, is written out whole at the next
+// commit after a reset record.
+//
+
+#define SRT_JOURNAL_MAGIC "SRTJ"
+#define SRT_JOURNAL_VERSION 1
+
+typedef struct srt_journal {
+  int fd;
+  srt_journal_sync sync;
+  size_t group;
+  size_t commits;
+  uint64_t seq;
+  unsigned char *buf;
+  size_t len;
+  size_t cap;
+  size_t txn_len;
+  srt_dict *touched;
+  bool whole;
+  bool failed;
+} srt_journal;
+
+//
+// replays the journal at `path` into `ctx`, if there is one, and rewrites it
+// as a single transaction holding the task data of `ctx` before journaling
+// to it from then on. the journal belongs to `ctx` and is flushed and synced
+// when the context is freed.
+//
+int32_t srt_ctx_journal(srt_context *ctx, const char *path,
+                        srt_journal_sync sync, size_t group);
+
+bool srt_journal_close(srt_journal *journal);
+
+void srt_journal_set(const srt_context *ctx, srt_key *key,
+                     const srt_value *value);
+
+void srt_journal_delete(const srt_context *ctx, srt_key *key);
+
+void srt_journal_touch(const srt_context *ctx, srt_key *key);
+
+void srt_journal_reset(srt_journal *journal);
+
+bool srt_journal_commit(const srt_context *ctx);
@@ -0,0 +1,834 @@
+#include "json.h"
+#include "array.h"
+#include "const.h"
+#include "value.h"
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define READ_BUF (64 * 1024)
+#define WRITE_BUF (64 * 1024)
+#define MAX_DEPTH 256
+#define DICT_CAPACITY 16
+
+//
+// reading
+//
+
+typedef struct json_buf {
+  char *data;
+  size_t len;
+  size_t cap;
+} json_buf;
+
+typedef struct reader {
+  FILE *in;
+  unsigned char *buf;
+  size_t pos;
+  size_t len;
+  size_t line;
+  const unsigned char *line_start;
+  size_t line_carry;
+  json_buf key;
+  json_buf str;
+  srt_json_error *error;
+} reader;
+
+static bool fail(reader *r, const char *message) {
+  if (!r->error->message) {
+    r->error->message = message;
+    r->error->line = r->line;
+    r->error->column =
+        r->line_carry + (size_t)(r->buf + r->pos - r->line_start) + 1;
+  }
+
+  return false;
+}
+
+static bool fill(reader *r) {
+  if (!r->in) {
+    return false;
+  }
+
+  r->line_carry += r->buf + r->len - r->line_start;
+  r->line_start = r->buf;
+  r->pos = 0;
+  r->len = fread(r->buf, 1, READ_BUF, r->in);
+
+  return r->len > 0;
+}
+
+static int peek(reader *r) {
+  if (r->pos == r->len && !fill(r)) {
+    return EOF;
+  }
+
+  return r->buf[r->pos];
+}
+
+static int next(reader *r) {
+  const int c = peek(r);
+  if (c != EOF) {
+    r->pos++;
+  }
+
+  return c;
+}
+
+static void skip_space(reader *r) {
+  for (int c; (c = peek(r)) != EOF; r->pos++) {
+    if (c == '\n') {
+      r->line++;
+      r->line_carry = 0;
+      r->line_start = r->buf + r->pos + 1;
+    } else if (c != ' ' && c != '\t' && c != '\r') {
+      return;
+    }
+  }
+}
+
+static bool expect(reader *r, int c, const char *message) {
+  skip_space(r);
+  return next(r) == c || fail(r, message);
+}
+
+static bool buf_append(json_buf *b, const void *data, size_t len) {
+  if (b->len + len + 1 > b->cap) {
+    size_t cap = b->cap ? b->cap : 256;
+    while (cap < b->len + len + 1) {
+      cap *= 2;
+    }
+
+    char *p = realloc(b->data, cap);
+    if (!p) {
+      return false;
+    }
+
+    b->data = p;
+    b->cap = cap;
+  }
+
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+  b->data[b->len] = '\0';
+
+  return true;
+}
+
+static bool append_utf8(json_buf *b, uint32_t cp) {
+  char out[4];
+  size_t n;
+
+  if (cp < 0x80) {
+    out[0] = cp;
+    n = 1;
+  } else if (cp < 0x800) {
+    out[0] = 0xc0 | cp >> 6;
+    out[1] = 0x80 | (cp & 0x3f);
+    n = 2;
+  } else if (cp < 0x10000) {
+    out[0] = 0xe0 | cp >> 12;
+    out[1] = 0x80 | (cp >> 6 & 0x3f);
+    out[2] = 0x80 | (cp & 0x3f);
+    n = 3;
+  } else {
+    out[0] = 0xf0 | cp >> 18;
+    out[1] = 0x80 | (cp >> 12 & 0x3f);
+    out[2] = 0x80 | (cp >> 6 & 0x3f);
+    out[3] = 0x80 | (cp & 0x3f);
+    n = 4;
+  }
+
+  return buf_append(b, out, n);
+}
+
+static bool read_hex4(reader *r, uint32_t *cp) {
+  *cp = 0;
+
+  for (int i = 0; i < 4; ++i) {
+    const int c = next(r);
+    int digit;
+
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return fail(r, "bad \\u escape");
+    }
+
+    *cp = *cp << 4 | digit;
+  }
+
+  return true;
+}
+
+static bool read_escape(reader *r, json_buf *b) {
+  const int c = next(r);
+  uint32_t cp;
+
+  switch (c) {
+  case '"':
+  case '\\':
+  case '/':
+    return buf_append(b, &(char){c}, 1);
+  case 'b':
+    return buf_append(b, "\b", 1);
+  case 'f':
+    return buf_append(b, "\f", 1);
+  case 'n':
+    return buf_append(b, "\n", 1);
+  case 'r':
+    return buf_append(b, "\r", 1);
+  case 't':
+    return buf_append(b, "\t", 1);
+  case 'u':
+    if (!read_hex4(r, &cp)) {
+      return false;
+    }
+
+    if (cp >= 0xd800 && cp < 0xdc00) {
+      uint32_t low;
+
+      if (next(r) != '\\' || next(r) != 'u' || !read_hex4(r, &low) ||
+          low < 0xdc00 || low >= 0xe000) {
+        return fail(r, "unpaired surrogate");
+      }
+
+      cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+    } else if (cp >= 0xdc00 && cp < 0xe000) {
+      return fail(r, "unpaired surrogate");
+    }
+
+    if (cp == 0) {
+      return fail(r, "\\u0000 cannot be held in a string");
+    }
+
+    return append_utf8(b, cp) || fail(r, "out of memory");
+  }
+
+  return fail(r, "bad escape");
+}
+
+//
+// copies runs of plain bytes straight out of the read buffer and only drops
+// to a byte at a time for escapes.
+//
+static bool read_string(reader *r, json_buf *b) {
+  b->len = 0;
+  if (!buf_append(b, "", 0)) {
+    return fail(r, "out of memory");
+  }
+
+  for (;;) {
+    if (peek(r) == EOF) {
+      return fail(r, "unterminated string");
+    }
+
+    const unsigned char *start = r->buf + r->pos;
+    const unsigned char *end = r->buf + r->len;
+    const unsigned char *p = start;
+
+    while (p < end && *p != '"' && *p != '\\' && *p >= 0x20) {
+      p++;
+    }
+
+    if (!buf_append(b, start, p - start)) {
+      return fail(r, "out of memory");
+    }
+
+    r->pos += p - start;
+
+    if (p == end) {
+      continue;
+    }
+
+    r->pos++;
+
+    if (*p == '"') {
+      return true;
+    }
+
+    if (*p != '\\') {
+      return fail(r, "control character in string");
+    }
+
+    if (!read_escape(r, b)) {
+      return false;
+    }
+  }
+}
+
+static bool read_int64(reader *r, int64_t *value) {
+  const bool negative = peek(r) == '-';
+  if (negative) {
+    r->pos++;
+  }
+
+  uint64_t magnitude = 0;
+  const uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : INT64_MAX;
+  int digits = 0;
+
+  for (int c; (c = peek(r)) >= '0' && c <= '9'; r->pos++, ++digits) {
+    if (digits == 1 && magnitude == 0) {
+      return fail(r, "leading zero in number");
+    }
+
+    if (magnitude > (limit - (c - '0')) / 10) {
+      return fail(r, "number does not fit in int64");
+    }
+
+    magnitude = magnitude * 10 + (c - '0');
+  }
+
+  if (!digits) {
+    return fail(r, "bad number");
+  }
+
+  const int c = peek(r);
+  if (c == '.' || c == 'e' || c == 'E') {
+    return fail(r, "fractional numbers are not supported");
+  }
+
+  *value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+
+  return true;
+}
+
+static bool read_literal(reader *r, const char *literal) {
+  for (const char *l = literal; *l; ++l) {
+    if (next(r) != *l) {
+      return fail(r, "bad literal");
+    }
+  }
+
+  return true;
+}
+
+//
+// an element of an array, gathered into r->str so it can be handed to strtoll
+// or strtod. `fraction` says which of `int64` and `dbl` was read.
+//
+static bool read_number(reader *r, int64_t *int64, double *dbl,
+                        bool *fraction) {
+  r->str.len = 0;
+  *fraction = false;
+
+  for (int c; (c = peek(r)) != EOF && strchr("+-.0123456789eE", c); r->pos++) {
+    *fraction |= c == '.' || c == 'e' || c == 'E';
+
+    if (!buf_append(&r->str, &(char){c}, 1)) {
+      return fail(r, "out of memory");
+    }
+  }
+
+  const char *str = r->str.data;
+  const char *digits = str && *str == '-' ? str + 1 : str;
+
+  if (!digits || !(*digits >= '0' && *digits <= '9')) {
+    return fail(r, "bad number");
+  }
+
+  if (digits[0] == '0' && digits[1] >= '0' && digits[1] <= '9') {
+    return fail(r, "leading zero in number");
+  }
+
+  char *end;
+  errno = 0;
+
+  if (*fraction) {
+    *dbl = strtod(str, &end);
+  } else {
+    *int64 = strtoll(str, &end, 10);
+  }
+
+  if (end != str + r->str.len) {
+    return fail(r, "bad number");
+  }
+
+  return !errno || fail(r, *fraction ? "number does not fit in a double"
+                                     : "number does not fit in int64");
+}
+
+//
+// elements are int64 until one with a fraction or an exponent turns up, when
+// those read so far become doubles in place, both being 8 bytes. null, which
+// a NaN is written as, makes a double array too.
+//
+static bool read_array(reader *r, srt_arena *arena, srt_value *value) {
+  srt_array *array = srt_array_new(NULL, 0, arena);
+  srt_value_tag tag = SRT_INT64_ARRAY;
+
+  if (!array) {
+    return fail(r, "out of memory");
+  }
+
+  skip_space(r);
+
+  if (peek(r) == ']') {
+    r->pos++;
+    *value = (srt_value){.tag = tag, .array = array};
+    return true;
+  }
+
+  for (;;) {
+    int64_t int64 = 0;
+    double dbl = NAN;
+    bool fraction = true;
+
+    skip_space(r);
+
+    if (peek(r) == 'n' ? !read_literal(r, "null")
+                       : !read_number(r, &int64, &dbl, &fraction)) {
+      return false;
+    }
+
+    if (fraction && tag == SRT_INT64_ARRAY) {
+      for (size_t i = 0; i < array->len; ++i) {
+        array->doubles[i] = (double)array->int64s[i];
+      }
+
+      tag = SRT_DOUBLE_ARRAY;
+    } else if (!fraction && tag == SRT_DOUBLE_ARRAY) {
+      dbl = (double)int64;
+    }
+
+    if (!srt_array_push(array, tag == SRT_INT64_ARRAY ? (void *)&int64 : &dbl,
+                        arena)) {
+      return fail(r, "out of memory");
+    }
+
+    skip_space(r);
+
+    switch (next(r)) {
+    case ',':
+      continue;
+    case ']':
+      *value = (srt_value){.tag = tag, .array = array};
+      return true;
+    default:
+      return fail(r, "expected ',' or ']'");
+    }
+  }
+}
+
+static bool read_object(reader *r, srt_dict *dict, int depth);
+
+//
+// the key stays in r->key while the value is read. a nested object is put
+// into its parent before it is filled, so the nested keys are free to reuse
+// the buffer.
+//
+static bool read_member(reader *r, srt_dict *dict, int depth) {
+  if (!expect(r, '"', "expected a key") || !read_string(r, &r->key) ||
+      !expect(r, ':', "expected ':'")) {
+    return false;
+  }
+
+  skip_space(r);
+
+  srt_value value;
+  int64_t int64;
+
+  switch (peek(r)) {
+  case '{': {
+    r->pos++;
+
+    srt_dict *nested = srt_dict_new_in(dict->arena, DICT_CAPACITY, dict->seed);
+    if (!nested ||
+        !srt_dict_put(dict, r->key.data, SRT_VALUE(SRT_DICT, dict, nested))) {
+      return fail(r, "out of memory");
+    }
+
+    return read_object(r, nested, depth + 1);
+  }
+  case '"': {
+    r->pos++;
+
+    if (!read_string(r, &r->str)) {
+      return false;
+    }
+
+    if (!srt_value_set_str(&value, r->str.data, r->str.len, dict->arena)) {
+      return fail(r, "out of memory");
+    }
+
+    break;
+  }
+  case 't':
+  case 'f': {
+    const bool b = peek(r) == 't';
+
+    if (!read_literal(r, b ? "true" : "false")) {
+      return false;
+    }
+
+    value = SRT_VALUE(SRT_BOOL, b, b);
+    break;
+  }
+  case 'n':
+    if (!read_literal(r, "null")) {
+      return false;
+    }
+
+    value = SRT_VALUE(SRT_STR, str, NULL);
+    break;
+  case '[':
+    r->pos++;
+
+    if (!read_array(r, dict->arena, &value)) {
+      return false;
+    }
+
+    break;
+  default:
+    if (!read_int64(r, &int64)) {
+      return false;
+    }
+
+    value = SRT_VALUE(SRT_INT64, int64, int64);
+    break;
+  }
+
+  return srt_dict_put(dict, r->key.data, value) || fail(r, "out of memory");
+}
+
+//
+// the opening brace has been consumed.
+//
+static bool read_object(reader *r, srt_dict *dict, int depth) {
+  if (depth > MAX_DEPTH) {
+    return fail(r, "objects nested too deep");
+  }
+
+  skip_space(r);
+  if (peek(r) == '}') {
+    r->pos++;
+    return true;
+  }
+
+  for (;;) {
+    if (!read_member(r, dict, depth)) {
+      return false;
+    }
+
+    skip_space(r);
+
+    switch (next(r)) {
+    case ',':
+      continue;
+    case '}':
+      return true;
+    default:
+      return fail(r, "expected ',' or '}'");
+    }
+  }
+}
+
+static bool read_document(reader *r, srt_dict *dict) {
+  r->line_start = r->buf;
+
+  bool ok = expect(r, '{', "expected an object") && read_object(r, dict, 0);
+
+  if (ok) {
+    skip_space(r);
+    ok = peek(r) == EOF || fail(r, "trailing data after the object");
+  }
+
+  if (ok && r->in && ferror(r->in)) {
+    ok = fail(r, "read error");
+  }
+
+  free(r->key.data);
+  free(r->str.data);
+
+  return ok;
+}
+
+int32_t srt_json_read(FILE *in, srt_dict *dict, srt_json_error *error) {
+  reader r = {.in = in, .line = 1, .error = error};
+  *error = (srt_json_error){0};
+
+  if (!(r.buf = malloc(READ_BUF))) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  const bool ok = read_document(&r, dict);
+  free(r.buf);
+
+  return ok ? SRT_SUCCESS : SRT_INVALID_JSON;
+}
+
+//
+// the buffer is parsed in place, there is nothing to refill it from.
+//
+int32_t srt_json_read_mem(const char *data, size_t len, srt_dict *dict,
+                          srt_json_error *error) {
+  reader r = {.buf = (unsigned char *)data, .len = len, .line = 1,
+              .error = error};
+  *error = (srt_json_error){0};
+
+  return read_document(&r, dict) ? SRT_SUCCESS : SRT_INVALID_JSON;
+}
+
+//
+// writing
+//
+
+typedef struct writer {
+  FILE *out;
+  char *buf;
+  size_t len;
+  bool failed;
+} writer;
+
+static void flush(writer *w) {
+  if (w->len && fwrite(w->buf, 1, w->len, w->out) != w->len) {
+    w->failed = true;
+  }
+
+  w->len = 0;
+}
+
+static void put(writer *w, const char *data, size_t len) {
+  if (w->len + len > WRITE_BUF) {
+    flush(w);
+
+    if (len > WRITE_BUF) {
+      w->failed |= fwrite(data, 1, len, w->out) != len;
+      return;
+    }
+  }
+
+  memcpy(w->buf + w->len, data, len);
+  w->len += len;
+}
+
+static void put_char(writer *w, char c) {
+  if (w->len == WRITE_BUF) {
+    flush(w);
+  }
+
+  w->buf[w->len++] = c;
+}
+
+static void write_str(writer *w, const char *str) {
+  static const char hex[] = "0123456789abcdef";
+
+  put_char(w, '"');
+
+  for (const char *p = str;;) {
+    const char *start = p;
+
+    while (*p && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20) {
+      p++;
+    }
+
+    put(w, start, p - start);
+
+    if (!*p) {
+      break;
+    }
+
+    switch (*p) {
+    case '"':
+      put(w, "\\\"", 2);
+      break;
+    case '\\':
+      put(w, "\\\\", 2);
+      break;
+    case '\n':
+      put(w, "\\n", 2);
+      break;
+    case '\r':
+      put(w, "\\r", 2);
+      break;
+    case '\t':
+      put(w, "\\t", 2);
+      break;
+    default:
+      put(w, "\\u00", 4);
+      put_char(w, hex[*p >> 4]);
+      put_char(w, hex[*p & 0xf]);
+      break;
+    }
+
+    p++;
+  }
+
+  put_char(w, '"');
+}
+
+static void write_int64(writer *w, int64_t value) {
+  char digits[20];
+  size_t n = 0;
+  uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+
+  do {
+    digits[n++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude);
+
+  if (value < 0) {
+    put_char(w, '-');
+  }
+
+  while (n) {
+    put_char(w, digits[--n]);
+  }
+}
+
+//
+// the shortest form that reads back to the same bits, with a fraction or an
+// exponent so it reads back as a double. json has no NaN or infinities, they
+// are written as null.
+//
+static void write_double(writer *w, double value) {
+  char str[32];
+
+  if (!isfinite(value)) {
+    put(w, "null", 4);
+    return;
+  }
+
+  int len = 0;
+
+  for (int digits = 15; digits <= 17; ++digits) {
+    len = snprintf(str, sizeof(str), "%.*g", digits, value);
+
+    if (strtod(str, NULL) == value) {
+      break;
+    }
+  }
+
+  put(w, str, len);
+
+  if (!strpbrk(str, ".e")) {
+    put(w, ".0", 2);
+  }
+}
+
+static void write_array(writer *w, const srt_value *value) {
+  const srt_array *array = value->array;
+
+  put_char(w, '[');
+
+  for (size_t i = 0; i < array->len; ++i) {
+    if (i) {
+      put_char(w, ',');
+    }
+
+    if (value->tag == SRT_INT64_ARRAY) {
+      write_int64(w, array->int64s[i]);
+    } else {
+      write_double(w, array->doubles[i]);
+    }
+  }
+
+  put_char(w, ']');
+}
+
+static void write_dict(writer *w, const srt_dict *dict) {
+  size_t pos = 0;
+  bool first = true;
+
+  put_char(w, '{');
+
+  for (srt_dict_item *item; (item = srt_dict_next(dict, &pos));) {
+    const srt_value *value = &item->value;
+
+    if (!first) {
+      put_char(w, ',');
+    }
+    first = false;
+
+    write_str(w, srt_dict_item_key(item));
+    put_char(w, ':');
+
+    switch (value->tag) {
+    case SRT_BOOL:
+      if (value->b) {
+        put(w, "true", 4);
+      } else {
+        put(w, "false", 5);
+      }
+      break;
+    case SRT_DICT:
+      if (value->dict) {
+        write_dict(w, value->dict);
+      } else {
+        put(w, "null", 4);
+      }
+      break;
+    case SRT_INT64:
+      write_int64(w, value->int64);
+      break;
+    case SRT_STR:
+      if (srt_value_str(value)) {
+        write_str(w, srt_value_str(value));
+      } else {
+        put(w, "null", 4);
+      }
+      break;
+    case SRT_INT64_ARRAY:
+    case SRT_DOUBLE_ARRAY:
+      write_array(w, value);
+      break;
+    }
+  }
+
+  put_char(w, '}');
+}
+
+//
+// a document ends in a newline and is flushed out of the stream. a value is
+// left in the stream buffer, so a caller writing many small ones does not
+// pay a write for each.
+//
+static int32_t write_object(const srt_dict *dict, FILE *out, bool document) {
+  writer w = {.out = out};
+
+  if (!(w.buf = malloc(WRITE_BUF))) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  write_dict(&w, dict);
+  if (document) {
+    put_char(&w, '\n');
+  }
+  flush(&w);
+  free(w.buf);
+
+  if (document && fflush(out) != 0) {
+    return SRT_IO_ERROR;
+  }
+
+  return w.failed || ferror(out) ? SRT_IO_ERROR : SRT_SUCCESS;
+}
+
+int32_t srt_json_write(const srt_dict *dict, FILE *out) {
+  return write_object(dict, out, true);
+}
+
+int32_t srt_json_write_value(const srt_dict *dict, FILE *out) {
+  return write_object(dict, out, false);
+}
+
+int32_t srt_json_write_str(const char *str, FILE *out) {
+  writer w = {.out = out};
+
+  if (!(w.buf = malloc(WRITE_BUF))) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  write_str(&w, str);
+  flush(&w);
+  free(w.buf);
+
+  return w.failed || ferror(out) ? SRT_IO_ERROR : SRT_SUCCESS;
+}
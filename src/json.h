@@ -0,0 +1,41 @@
+#pragma once
+
+#include "dict.h"
+#include <stdint.h>
+#include <stdio.h>
+
+//
+// streaming json for task data. the reader puts values into a dict as it
+// parses, without building a document first: objects become nested dicts in
+// the arena of the dict being filled, strings are copied into the same arena,
+// integers are int64, true and false are bool and null is a NULL str.
+// arrays of numbers become int64 arrays, or double arrays when an element has
+// a fraction or an exponent, with null for a NaN. other arrays and fractional
+// numbers outside an array have no srt_value to map to and are rejected.
+//
+// the writer is the inverse, with output buffered into large writes.
+//
+
+typedef struct srt_json_error {
+  size_t line;
+  size_t column;
+  const char *message;
+} srt_json_error;
+
+int32_t srt_json_read(FILE *in, srt_dict *dict, srt_json_error *error);
+
+int32_t srt_json_read_mem(const char *data, size_t len, srt_dict *dict,
+                          srt_json_error *error);
+
+int32_t srt_json_write(const srt_dict *dict, FILE *out);
+
+//
+// the object alone, for embedding in a larger document. it has no trailing
+// newline and is not flushed, the caller flushes `out` when it is done.
+//
+int32_t srt_json_write_value(const srt_dict *dict, FILE *out);
+
+//
+// a string, quoted and escaped, for embedding the same way.
+//
+int32_t srt_json_write_str(const char *str, FILE *out);
@@ -1,11 +1,29 @@
+#include "const.h"
 #include "ctx.h"
+#include "journal.h"
+#include "life_cycle.h"
+#include "log.h"
+#include "profile.h"
+#include "suspend.h"
+#include "trace.h"
 #include <stdint.h>
-#include <stdio.h>
 
 int32_t srt_will_run_element(const srt_context *ctx, const char *process_id,
                              const char *element_id) {
-  if (srt_ctx_verbose(ctx)) {
-    printf("will run %s_%s\n", process_id, element_id);
+  srt_suspension_enter(ctx, element_id);
+  SRT_LOG(ctx, SRT_LOG_INFO, "will run %s_%s\n", process_id, element_id);
+
+  if (ctx->trace) {
+    srt_trace_event(ctx->trace, ctx->trace_id, SRT_TRACE_WILL_RUN, process_id,
+                    element_id, NULL, 0);
+  }
+
+  //
+  // last in and first out, so the profile times the element rather than the
+  // other hooks.
+  //
+  if (ctx->profile) {
+    srt_profile_will_run(ctx->profile, process_id, element_id);
   }
 
   return 0;
@@ -13,9 +31,23 @@ int32_t srt_will_run_element(const srt_context *ctx, const char *process_id,
 
 int32_t srt_did_run_element(const srt_context *ctx, const char *process_id,
                             const char *element_id) {
-  if (srt_ctx_verbose(ctx)) {
-    printf("did run %s_%s\n", process_id, element_id);
+  if (ctx->profile) {
+    srt_profile_did_run(ctx->profile, process_id, element_id);
   }
 
+  if (ctx->journal && !srt_journal_commit(ctx)) {
+    SRT_LOG(ctx, SRT_LOG_ERROR, "failed to journal %s_%s\n", process_id,
+            element_id);
+
+    return SRT_IO_ERROR;
+  }
+
+  if (ctx->trace) {
+    srt_trace_event(ctx->trace, ctx->trace_id, SRT_TRACE_DID_RUN, process_id,
+                    element_id, NULL, 0);
+  }
+
+  SRT_LOG(ctx, SRT_LOG_INFO, "did run %s_%s\n", process_id, element_id);
+
   return 0;
 }
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "ctx.h"
+#include <stdint.h>
+
+int32_t srt_will_run_element(const srt_context *ctx, const char *process_id,
+                             const char *element_id);
+
+int32_t srt_did_run_element(const srt_context *ctx, const char *process_id,
+                            const char *element_id);
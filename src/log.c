@@ -0,0 +1,97 @@
+#include "log.h"
+#include "array.h"
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdlib.h>
+
+srt_log *srt_log_new(FILE *out) {
+  srt_log *log = malloc(sizeof(*log));
+  if (!log) {
+    return NULL;
+  }
+
+  log->out = out;
+  log->len = 0;
+
+  return log;
+}
+
+void srt_log_free(srt_log *log) {
+  if (!log) {
+    return;
+  }
+
+  srt_log_flush(log);
+  free(log);
+}
+
+void srt_log_flush(srt_log *log) {
+  if (!log || log->len == 0) {
+    return;
+  }
+
+  fwrite(log->buf, 1, log->len, log->out);
+  fflush(log->out);
+  log->len = 0;
+}
+
+//
+// formats straight into the free end of the buffer. a line that does not fit
+// flushes what is there and is formatted again, and one larger than the
+// whole buffer goes to stdio on its own.
+//
+void srt_log_printf(srt_log *log, const char *format, ...) {
+  va_list args;
+
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    const size_t room = SRT_LOG_BUFFER_SIZE - log->len;
+
+    va_start(args, format);
+    const int n = vsnprintf(log->buf + log->len, room, format, args);
+    va_end(args);
+
+    if (n < 0) {
+      return;
+    }
+
+    if ((size_t)n < room) {
+      log->len += n;
+      return;
+    }
+
+    srt_log_flush(log);
+  }
+
+  va_start(args, format);
+  vfprintf(log->out, format, args);
+  va_end(args);
+}
+
+void srt_log_value(srt_log *log, const srt_value *value) {
+  if (!value) {
+    srt_log_printf(log, "<NULL>");
+    return;
+  }
+
+  switch (value->tag) {
+  case SRT_BOOL:
+    srt_log_printf(log, "bool = %s", value->b ? "true" : "false");
+    break;
+  case SRT_DICT:
+    srt_log_printf(log, "dict = %p", (void *)value->dict);
+    break;
+  case SRT_INT64:
+    srt_log_printf(log, "int64 = %" PRId64, value->int64);
+    break;
+  case SRT_STR:
+    srt_log_printf(log, "str = %s",
+                   srt_value_str(value) ? srt_value_str(value) : "<NULL>");
+    break;
+  case SRT_INT64_ARRAY:
+    srt_log_printf(log, "int64 array = [%zu]", value->array->len);
+    break;
+  case SRT_DOUBLE_ARRAY:
+    srt_log_printf(log, "double array = [%zu]", value->array->len);
+    break;
+  }
+}
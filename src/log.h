@@ -0,0 +1,51 @@
+#pragma once
+
+#include "types.h"
+#include "value.h"
+#include <stddef.h>
+#include <stdio.h>
+
+//
+// graded diagnostics. a call above SRT_LOG_MAX_LEVEL is a constant false
+// branch the compiler drops along with its arguments, so a release build with
+// -DSRT_LOG_MAX_LEVEL=SRT_LOG_WARN carries no debug logging in the task data
+// hot path at all. below that a call costs one compare against the level of
+// the context.
+//
+// output is formatted into a per context buffer and handed to stdio a buffer
+// at a time. it is flushed when full, before a manual task prompts, on a
+// panic and when the context is freed.
+//
+
+#ifndef SRT_LOG_MAX_LEVEL
+#define SRT_LOG_MAX_LEVEL SRT_LOG_DEBUG
+#endif
+
+#define SRT_LOG_BUFFER_SIZE (16 * 1024)
+
+typedef struct srt_log {
+  FILE *out;
+  size_t len;
+  char buf[SRT_LOG_BUFFER_SIZE];
+} srt_log;
+
+#define SRT_LOG_ENABLED(ctx, level)                                            \
+  ((level) <= SRT_LOG_MAX_LEVEL && (level) <= (ctx)->log_level)
+
+#define SRT_LOG(ctx, level, ...)                                               \
+  do {                                                                         \
+    if (SRT_LOG_ENABLED(ctx, level)) {                                         \
+      srt_log_printf((ctx)->log, __VA_ARGS__);                                 \
+    }                                                                          \
+  } while (0)
+
+srt_log *srt_log_new(FILE *out);
+
+void srt_log_free(srt_log *log);
+
+void srt_log_flush(srt_log *log);
+
+void srt_log_printf(srt_log *log, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+void srt_log_value(srt_log *log, const srt_value *value);
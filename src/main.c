@@ -1,24 +1,382 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
+#include "const.h"
 #include "ctx.h"
+#include "journal.h"
+#include "pool.h"
+#include "server.h"
+#include "suspend.h"
+#include "task_data.h"
+#include "trace.h"
+#include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#define TRACE_CAPACITY (1 << 16)
+
 int32_t spiff_process_start(srt_context *ctx);
 
+//
+// --data-in and --data-out take a path, or - for stdin and stdout. --profile
+// writes per element timings to stderr when the run ends, --profile-out to a
+// file instead. --trace writes a binary event trace for build/trace_decode.
+// --log-level is one of error, warn, info or debug, -v is the same as debug.
+//
+// --batch takes a jsonl file, or -, with the task data of one instance per
+// line and runs them all in this process. a result line per instance goes to
+// --data-out or stdout and a summary to stderr. --jobs sets how many threads
+// run instances, by default one per core.
+//
+// --journal journals task data changes to a file and, when the file is left
+// from an earlier run, starts from the task data it holds instead. writes go
+// out once per --journal-group elements, 1 by default, and --journal-sync
+// group syncs each one to disk.
+//
+// --serve runs instances for clients on a unix domain socket until it is
+// interrupted, see server.h for what they send, with --jobs warm contexts.
+//
+// --suspend stops an instance at its first manual task instead of waiting on
+// it, exits with SRT_SUSPENDED and names the task on stderr, or in the result
+// line of a batch instance. --data-out keeps its task data, and --resume with
+// the task name picks it up again from that file given as --data-in. this
+// needs a process whose generated code asks srt_ctx_resume_point where to
+// re-enter. one that does not is stopped, with an error, before it runs its
+// first element again.
+//
+
+static const char *log_levels[] = {"off", "error", "warn", "info", "debug"};
+
+static bool parse_log_level(const char *name, srt_log_level *level) {
+  for (size_t i = 0; i < sizeof(log_levels) / sizeof(*log_levels); ++i) {
+    if (strcmp(name, log_levels[i]) == 0) {
+      *level = (srt_log_level)i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool parse_journal_sync(const char *name, srt_journal_sync *sync) {
+  if (strcmp(name, "none") == 0) {
+    *sync = SRT_JOURNAL_SYNC_NONE;
+  } else if (strcmp(name, "group") == 0) {
+    *sync = SRT_JOURNAL_SYNC_GROUP;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+static bool read_data(srt_context *ctx, const char *path) {
+  FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+  if (!in) {
+    fprintf(stderr, "cannot open '%s' for reading\n", path);
+    return false;
+  }
+
+  const int32_t result = srt_task_data_read_json(ctx, in);
+
+  if (in != stdin) {
+    fclose(in);
+  }
+
+  if (result != 0) {
+    fprintf(stderr, "failed to read task data from '%s'\n", path);
+  }
+
+  return result == 0;
+}
+
+static bool write_data(srt_context *ctx, const char *path) {
+  FILE *out = strcmp(path, "-") == 0 ? stdout : fopen(path, "wb");
+  if (!out) {
+    fprintf(stderr, "cannot open '%s' for writing\n", path);
+    return false;
+  }
+
+  int32_t result = srt_task_data_write_json(ctx, out);
+
+  if (out != stdout && fclose(out) != 0) {
+    result = result ? result : 1;
+  }
+
+  if (result != 0) {
+    fprintf(stderr, "failed to write task data to '%s'\n", path);
+  }
+
+  return result == 0;
+}
+
+static bool open_journal(srt_context *ctx, const char *path,
+                         srt_journal_sync sync, size_t group) {
+  const int32_t result = srt_ctx_journal(ctx, path, sync, group);
+
+  if (result != 0) {
+    fprintf(stderr, "cannot recover or open journal '%s'\n", path);
+  }
+
+  return result == 0;
+}
+
+static void print_stats(const srt_batch_stats *stats, size_t jobs) {
+  const double seconds = stats->ns / 1e9;
+
+  fprintf(stderr,
+          "%zu instances, %zu failed, %zu suspended, %zu jobs, %.3f s, "
+          "%.0f instances/sec\n",
+          stats->instances, stats->failed, stats->suspended, jobs, seconds,
+          seconds > 0 ? stats->instances / seconds : 0.0);
+}
+
+static int run_batch(srt_context *ctx, const char *path, const char *out_path,
+                     size_t jobs) {
+  FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+  if (!in) {
+    fprintf(stderr, "cannot open '%s' for reading\n", path);
+    return 1;
+  }
+
+  FILE *out = !out_path || strcmp(out_path, "-") == 0 ? stdout
+                                                      : fopen(out_path, "w");
+  if (!out) {
+    fprintf(stderr, "cannot open '%s' for writing\n", out_path);
+    if (in != stdin) {
+      fclose(in);
+    }
+    return 1;
+  }
+
+  srt_batch_stats stats;
+  int32_t result =
+      jobs > 1 ? srt_pool_run(ctx, in, out, spiff_process_start, jobs, &stats)
+               : srt_batch_run(ctx, in, out, spiff_process_start, &stats);
+
+  if (in != stdin) {
+    fclose(in);
+  }
+
+  if (out != stdout && fclose(out) != 0) {
+    result = result ? result : 1;
+  }
+
+  print_stats(&stats, jobs);
+
+  if (result != 0) {
+    fprintf(stderr, "batch stopped on an error\n");
+  }
+
+  return result != 0 || stats.failed != 0;
+}
+
+static srt_server *serving;
+
+static void stop_serving(int signal) {
+  (void)signal;
+  srt_server_stop(serving);
+}
+
+static void on_stop(void (*handler)(int)) {
+  struct sigaction sa = {.sa_handler = handler};
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+}
+
+static int run_server(srt_context *ctx, const char *path, size_t jobs) {
+  if (!(serving = srt_server_open(ctx, path, spiff_process_start, jobs))) {
+    fprintf(stderr, "cannot listen on '%s'\n", path);
+    return 1;
+  }
+
+  srt_batch_stats stats;
+
+  on_stop(stop_serving);
+  const int32_t result = srt_server_run(serving, &stats);
+  on_stop(SIG_DFL);
+
+  srt_server_close(serving);
+  serving = NULL;
+
+  print_stats(&stats, jobs);
+
+  if (result != 0) {
+    fprintf(stderr, "server stopped on an error\n");
+  }
+
+  return result != 0;
+}
+
 int main(int argc, char *argv[]) {
-  bool verbose = false;
+  srt_log_level log_level = SRT_LOG_OFF;
+  bool profile = false;
+  const char *data_in = NULL;
+  const char *data_out = NULL;
+  const char *profile_out = NULL;
+  const char *trace_out = NULL;
+  const char *batch = NULL;
+  const char *journal = NULL;
+  const char *serve = NULL;
+  srt_journal_sync journal_sync = SRT_JOURNAL_SYNC_NONE;
+  size_t journal_group = 1;
+  size_t jobs = srt_pool_default_jobs();
+  bool suspend = false;
+  const char *resume = NULL;
 
   for (int i = 1; i < argc; ++i) {
     if (strcmp(argv[i], "-v") == 0) {
-      verbose = true;
-      break;
+      log_level = SRT_LOG_DEBUG;
+    } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+      if (!parse_log_level(argv[++i], &log_level)) {
+        fprintf(stderr, "unknown log level '%s'\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--data-in") == 0 && i + 1 < argc) {
+      data_in = argv[++i];
+    } else if (strcmp(argv[i], "--data-out") == 0 && i + 1 < argc) {
+      data_out = argv[++i];
+    } else if (strcmp(argv[i], "--profile") == 0) {
+      profile = true;
+    } else if (strcmp(argv[i], "--profile-out") == 0 && i + 1 < argc) {
+      profile = true;
+      profile_out = argv[++i];
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      trace_out = argv[++i];
+    } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      batch = argv[++i];
+    } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      char *end;
+      const long n = strtol(argv[++i], &end, 10);
+
+      if (*end != '\0' || n < 1) {
+        fprintf(stderr, "--jobs takes a count of at least 1\n");
+        return 1;
+      }
+
+      jobs = n;
+    } else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc) {
+      journal = argv[++i];
+    } else if (strcmp(argv[i], "--journal-sync") == 0 && i + 1 < argc) {
+      if (!parse_journal_sync(argv[++i], &journal_sync)) {
+        fprintf(stderr, "unknown journal sync '%s'\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--journal-group") == 0 && i + 1 < argc) {
+      char *end;
+      const long n = strtol(argv[++i], &end, 10);
+
+      if (*end != '\0' || n < 1) {
+        fprintf(stderr, "--journal-group takes a count of at least 1\n");
+        return 1;
+      }
+
+      journal_group = n;
+    } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+      serve = argv[++i];
+    } else if (strcmp(argv[i], "--suspend") == 0) {
+      suspend = true;
+    } else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+      suspend = true;
+      resume = argv[++i];
     }
   }
 
-  srt_context *ctx = srt_ctx_new(verbose);
-  const int result = spiff_process_start(ctx);
+  if (serve && (batch || data_in || data_out || journal || resume)) {
+    fprintf(stderr, "--serve takes instances from its clients alone\n");
+    return 1;
+  }
+
+  if (batch && resume) {
+    fprintf(stderr, "batch instances start afresh, drop --resume\n");
+    return 1;
+  }
+
+  if (batch && data_in) {
+    fprintf(stderr, "--batch reads its own task data, drop --data-in\n");
+    return 1;
+  }
+
+  if (batch && journal) {
+    fprintf(stderr, "batch instances are not journaled, drop --journal\n");
+    return 1;
+  }
+
+  srt_trace *trace = NULL;
+
+  if (trace_out && !(trace = srt_trace_open(trace_out, TRACE_CAPACITY))) {
+    fprintf(stderr, "cannot open trace '%s'\n", trace_out);
+    return 1;
+  }
+
+  FILE *profile_file = stderr;
+
+  if (profile_out && !(profile_file = fopen(profile_out, "w"))) {
+    fprintf(stderr, "cannot open '%s' for writing\n", profile_out);
+    srt_trace_close(trace);
+    return 1;
+  }
+
+  srt_context *ctx = srt_ctx_new(false);
+  int result = 1;
+
+  if (log_level != SRT_LOG_OFF) {
+    srt_ctx_log(ctx, log_level, stdout);
+  }
+
+  if (profile) {
+    srt_ctx_profile(ctx, profile_file);
+  }
+
+  srt_ctx_trace(ctx, trace);
+
+  if (suspend) {
+    srt_ctx_suspendable(ctx);
+  }
+
+  if (serve) {
+    result = run_server(ctx, serve, jobs);
+  } else if (batch) {
+    result = run_batch(ctx, batch, data_out, jobs);
+  } else if ((!data_in || read_data(ctx, data_in)) &&
+             (!journal || open_journal(ctx, journal, journal_sync,
+                                       journal_group)) &&
+             (!resume || srt_ctx_resume_at(ctx, resume))) {
+    result = spiff_process_start(ctx);
+
+    if (result == SRT_SUSPENDED && ctx->suspension->element_id) {
+      fprintf(stderr, "suspended at manual task %s\n",
+              ctx->suspension->element_id);
+    }
+
+    if (data_out && !write_data(ctx, data_out) && result == 0) {
+      result = 1;
+    }
+  }
+
+  //
+  // a verbose run ends its log with the memory it used. the contexts of
+  // branches and workers are part of the run and not reported apart.
+  //
+  if (srt_ctx_verbose(ctx)) {
+    srt_log_flush(ctx->log);
+    srt_ctx_report_stats(ctx, stdout);
+  }
 
   srt_ctx_free(ctx);
 
+  if (trace && !srt_trace_close(trace)) {
+    fprintf(stderr, "failed to write trace '%s'\n", trace_out);
+    result = result ? result : 1;
+  }
+
+  if (profile_file != stderr) {
+    fclose(profile_file);
+  }
+
   return result;
 }
@@ -1,21 +1,42 @@
 #include "ctx.h"
+#include "log.h"
+#include "suspend.h"
+#include "trace.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <unistd.h>
 
 int32_t srt_handle_manual_task(const srt_context *ctx, const char *element_id,
                                const char *instructions) {
-  printf("Manual Task %s\n", element_id);
+  if (ctx->trace) {
+    srt_trace_event(ctx->trace, ctx->trace_id, SRT_TRACE_MANUAL_TASK,
+                    element_id, instructions, NULL, 0);
+  }
+
+  if (ctx->suspension) {
+    return srt_suspension_reach(ctx, element_id, instructions);
+  }
+
+  //
+  // the prompt is not a diagnostic and goes straight to the output of the
+  // context, so anything logged ahead of it has to be out first. a context
+  // writing somewhere other than stdout, such as a pool worker, never waits
+  // on the terminal.
+  //
+  srt_log_flush(ctx->log);
+
+  fprintf(ctx->out, "Manual Task %s\n", element_id);
 
   if (instructions && *instructions != '\0') {
-    printf("  * %s\n", instructions);
+    fprintf(ctx->out, "  * %s\n", instructions);
   }
 
-  if (isatty(STDIN_FILENO)) {
+  if (ctx->out == stdout && isatty(STDIN_FILENO)) {
     printf("Press enter to continue.\n");
     getchar();
   } else {
-    printf(
+    fprintf(
+        ctx->out,
         "Not in interactive mode, automatically completing manual task...\n");
   }
 
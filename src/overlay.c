@@ -0,0 +1,325 @@
+#include "overlay.h"
+#include "arena.h"
+#include "array.h"
+#include "const.h"
+#include "journal.h"
+#include "snapshot.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CHANGES_CAPACITY 16
+
+bool srt_overlay_attach(srt_context *branch, const srt_context *parent) {
+  srt_overlay *overlay = malloc(sizeof(*overlay));
+  if (!overlay) {
+    return false;
+  }
+
+  overlay->parent = parent;
+  overlay->changes = srt_dict_new(CHANGES_CAPACITY);
+
+  if (!overlay->changes) {
+    free(overlay);
+    return false;
+  }
+
+  branch->overlay = overlay;
+
+  return true;
+}
+
+void srt_overlay_free(srt_overlay *overlay) {
+  if (!overlay) {
+    return;
+  }
+
+  srt_dict_free(overlay->changes);
+  free(overlay);
+}
+
+static srt_overlay_change change_of(const srt_overlay *overlay,
+                                    const char *key) {
+  const srt_value *change = srt_dict_peek(overlay->changes, key);
+  return change ? (srt_overlay_change)change->int64 : 0;
+}
+
+static void mark(const srt_context *ctx, const char *key,
+                 srt_overlay_change change) {
+  srt_dict_put(ctx->overlay->changes, key,
+               SRT_VALUE(SRT_INT64, int64, change));
+}
+
+//
+// the value `key` has for `ctx`, looking through the parents of a branch
+// until one holds the key or deleted it.
+//
+static const srt_value *visible(const srt_context *ctx, const char *key) {
+  for (; ctx; ctx = ctx->overlay->parent) {
+    const srt_value *v = srt_dict_peek(ctx->task_data, key);
+
+    if (v || !ctx->overlay ||
+        change_of(ctx->overlay, key) == SRT_OVERLAY_DELETED) {
+      return v;
+    }
+  }
+
+  return NULL;
+}
+
+//
+// copies
+//
+
+static bool copy_value(const srt_context *ctx, const srt_value *from,
+                       srt_value *to);
+
+static srt_dict *copy_dict(const srt_context *ctx, const srt_dict *from) {
+  const size_t len = srt_dict_len(from);
+  srt_dict *dict = srt_ctx_dict_new(ctx, len < 8 ? 16 : len * 2);
+  size_t pos = 0;
+
+  for (srt_dict_item *item; dict && (item = srt_dict_next(from, &pos));) {
+    srt_value value;
+
+    if (!copy_value(ctx, &item->value, &value) ||
+        !srt_dict_put(dict, srt_dict_item_key(item), value)) {
+      return NULL;
+    }
+  }
+
+  return dict;
+}
+
+static bool copy_value(const srt_context *ctx, const srt_value *from,
+                       srt_value *to) {
+  *to = *from;
+  to->owned = false;
+
+  if (from->tag == SRT_STR && !from->str_inline && from->str) {
+    return srt_value_set_str(to, from->str, strlen(from->str), ctx->arena);
+  } else if (from->tag == SRT_DICT && from->dict) {
+    return (to->dict = copy_dict(ctx, from->dict)) != NULL;
+  } else if (from->tag == SRT_INT64_ARRAY || from->tag == SRT_DOUBLE_ARRAY) {
+    return (to->array = srt_array_new(from->array->data, from->array->len,
+                                      ctx->arena)) != NULL;
+  }
+
+  return true;
+}
+
+static bool equal(const srt_value *a, const srt_value *b);
+
+static bool dict_equal(const srt_dict *a, const srt_dict *b) {
+  if (a == b) {
+    return true;
+  }
+
+  if (!a || !b || srt_dict_len(a) != srt_dict_len(b)) {
+    return false;
+  }
+
+  size_t pos = 0;
+
+  for (srt_dict_item *item; (item = srt_dict_next(a, &pos));) {
+    if (!equal(&item->value, srt_dict_peek(b, srt_dict_item_key(item)))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool equal(const srt_value *a, const srt_value *b) {
+  if (!a || !b || a->tag != b->tag) {
+    return a == b;
+  }
+
+  switch (a->tag) {
+  case SRT_BOOL:
+    return a->b == b->b;
+  case SRT_DICT:
+    return dict_equal(a->dict, b->dict);
+  case SRT_INT64:
+    return a->int64 == b->int64;
+  case SRT_STR: {
+    const char *sa = srt_value_str(a);
+    const char *sb = srt_value_str(b);
+
+    return sa == sb || (sa && sb && strcmp(sa, sb) == 0);
+  }
+  case SRT_INT64_ARRAY:
+  case SRT_DOUBLE_ARRAY:
+    //
+    // elements compare by their bits, so an unchanged NaN is no conflict.
+    //
+    return a->array->len == b->array->len &&
+           memcmp(a->array->data, b->array->data,
+                  a->array->len * SRT_ARRAY_ELEM) == 0;
+  }
+
+  return false;
+}
+
+//
+// the view of a branch
+//
+
+srt_value *srt_overlay_fault(const srt_context *ctx, srt_key *key) {
+  if (change_of(ctx->overlay, key->str) == SRT_OVERLAY_DELETED) {
+    return NULL;
+  }
+
+  const srt_value *v = visible(ctx->overlay->parent, key->str);
+  srt_value copy;
+
+  if (!v || !copy_value(ctx, v, &copy) ||
+      !srt_dict_put_k(ctx->task_data, key, copy)) {
+    return NULL;
+  }
+
+  if (copy.tag == SRT_DICT) {
+    mark(ctx, key->str, SRT_OVERLAY_TOUCHED);
+  }
+
+  return srt_dict_get_k(ctx->task_data, key);
+}
+
+bool srt_overlay_visible(const srt_context *ctx, srt_key *key) {
+  return change_of(ctx->overlay, key->str) != SRT_OVERLAY_DELETED &&
+         visible(ctx->overlay->parent, key->str) != NULL;
+}
+
+void srt_overlay_set(const srt_context *ctx, srt_key *key) {
+  mark(ctx, key->str, SRT_OVERLAY_SET);
+}
+
+void srt_overlay_delete(const srt_context *ctx, srt_key *key) {
+  mark(ctx, key->str, SRT_OVERLAY_DELETED);
+}
+
+//
+// merge
+//
+
+typedef struct write {
+  const char *key;
+  const srt_value *value;
+} write;
+
+static bool same(const write *a, const write *b) {
+  return a->value == b->value || equal(a->value, b->value);
+}
+
+//
+// the write `item` of a branch stands for, false when it left the key as the
+// parent has it.
+//
+static bool write_of(const srt_context *ctx, const srt_context *branch,
+                     const srt_dict_item *item, write *w) {
+  w->key = srt_dict_item_key(item);
+  w->value = item->value.int64 == SRT_OVERLAY_DELETED
+                 ? NULL
+                 : srt_dict_peek(branch->task_data, w->key);
+
+  return item->value.int64 != SRT_OVERLAY_TOUCHED ||
+         !equal(w->value, visible(ctx, w->key));
+}
+
+static bool apply(const srt_context *ctx, const write *w) {
+  srt_key key;
+  srt_key_init(&key, w->key);
+
+  if (!w->value) {
+    srt_dict_delete_k(ctx->task_data, &key);
+  } else {
+    srt_value copy;
+
+    if (!copy_value(ctx, w->value, &copy) ||
+        !srt_dict_put_k(ctx->task_data, &key, copy)) {
+      return false;
+    }
+  }
+
+  if (ctx->overlay) {
+    mark(ctx, w->key, w->value ? SRT_OVERLAY_SET : SRT_OVERLAY_DELETED);
+  }
+
+  if (ctx->history && w->value) {
+    srt_history_set(ctx, &key, w->value);
+  } else if (ctx->history) {
+    srt_history_delete(ctx, &key);
+  }
+
+  if (ctx->journal && w->value) {
+    srt_journal_set(ctx, &key, w->value);
+  } else if (ctx->journal) {
+    srt_journal_delete(ctx, &key);
+  }
+
+  return true;
+}
+
+//
+// the writes are gathered branch by branch into one list, indexed by key,
+// before any is applied, so a conflict can still leave the parent untouched.
+//
+int32_t srt_overlay_merge(const srt_context *ctx, srt_context **branches,
+                          size_t n, srt_merge_policy policy) {
+  srt_dict *index = srt_dict_new(CHANGES_CAPACITY);
+  write *writes = NULL;
+  size_t len = 0;
+  size_t cap = 0;
+  bool ok = index != NULL;
+  bool conflict = false;
+
+  for (size_t b = 0; ok && b < n; ++b) {
+    size_t pos = 0;
+
+    for (srt_dict_item *item;
+         ok && (item = srt_dict_next(branches[b]->overlay->changes, &pos));) {
+      write w;
+
+      if (!write_of(ctx, branches[b], item, &w)) {
+        continue;
+      }
+
+      const srt_value *at = srt_dict_peek(index, w.key);
+
+      if (at) {
+        write *prev = &writes[at->int64];
+
+        if (!same(prev, &w)) {
+          conflict |= policy == SRT_MERGE_FAIL;
+          *prev = policy == SRT_MERGE_LAST_WINS ? w : *prev;
+        }
+
+        continue;
+      }
+
+      if (len == cap) {
+        cap = cap ? cap * 2 : CHANGES_CAPACITY;
+        write *grown = realloc(writes, cap * sizeof(*writes));
+        ok = grown != NULL;
+        writes = ok ? grown : writes;
+      }
+
+      if (ok) {
+        ok = srt_dict_put(index, w.key, SRT_VALUE(SRT_INT64, int64, len));
+        writes[len++] = w;
+      }
+    }
+  }
+
+  for (size_t i = 0; ok && !conflict && i < len; ++i) {
+    ok = apply(ctx, &writes[i]);
+  }
+
+  srt_dict_free(index);
+  free(writes);
+
+  if (!ok) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  return conflict ? SRT_MERGE_CONFLICT : SRT_SUCCESS;
+}
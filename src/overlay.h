@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ctx.h"
+#include "dict.h"
+#include "types.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// copy on write task data for the branches of a parallel gateway. a branch
+// context starts with empty task data over the task data of its parent, and a
+// key it reads is copied in from the parent the first time, dicts deeply, so
+// nothing the branch does reaches the parent before the join. the parent is
+// only read while its branches run, through lookups that leave it untouched.
+//
+// the overlay records which keys the branch set or deleted. a dict that was
+// copied in is recorded too, since it can be changed in place, and only
+// counts as written if it no longer equals the parent's at the join.
+//
+
+typedef enum srt_overlay_change {
+  SRT_OVERLAY_SET = 1,
+  SRT_OVERLAY_DELETED,
+  SRT_OVERLAY_TOUCHED,
+} srt_overlay_change;
+
+typedef struct srt_overlay {
+  const srt_context *parent;
+  srt_dict *changes;
+} srt_overlay;
+
+bool srt_overlay_attach(srt_context *branch, const srt_context *parent);
+
+void srt_overlay_free(srt_overlay *overlay);
+
+srt_value *srt_overlay_fault(const srt_context *ctx, srt_key *key);
+
+bool srt_overlay_visible(const srt_context *ctx, srt_key *key);
+
+void srt_overlay_set(const srt_context *ctx, srt_key *key);
+
+void srt_overlay_delete(const srt_context *ctx, srt_key *key);
+
+//
+// folds the writes of `branches` into `ctx`. keys written by more than one
+// branch with different results conflict, and `policy` picks the lowest or
+// highest branch or fails the merge with SRT_MERGE_CONFLICT, leaving `ctx`
+// as it was. the outcome never depends on the order the branches finished.
+//
+int32_t srt_overlay_merge(const srt_context *ctx, srt_context **branches,
+                          size_t n, srt_merge_policy policy);
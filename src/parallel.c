@@ -0,0 +1,126 @@
+#include "parallel.h"
+#include "const.h"
+#include "image.h"
+#include "log.h"
+#include "profile.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct branch_run {
+  srt_branch fn;
+  srt_context *ctx;
+  int32_t result;
+  pthread_t thread;
+  bool started;
+} branch_run;
+
+static void *run_branch(void *arg) {
+  branch_run *run = arg;
+  run->result = run->fn(run->ctx);
+
+  return NULL;
+}
+
+static srt_context *branch_new(const srt_context *parent) {
+  srt_context *ctx = srt_ctx_new_seeded(false, parent->seed);
+  if (!ctx) {
+    return NULL;
+  }
+
+  ctx->out = parent->out;
+  srt_ctx_trace(ctx, parent->trace);
+
+  if (!srt_overlay_attach(ctx, parent) ||
+      (parent->log && !srt_ctx_log(ctx, parent->log_level, parent->log->out)) ||
+      (parent->profile && !srt_ctx_profile(ctx, NULL))) {
+    srt_ctx_free(ctx);
+    return NULL;
+  }
+
+  return ctx;
+}
+
+static void branch_free(const srt_context *parent, srt_context *ctx) {
+  if (!ctx) {
+    return;
+  }
+
+  if (ctx->profile) {
+    srt_profile_merge(parent->profile, ctx->profile);
+    srt_profile_free(ctx->profile);
+    ctx->profile = NULL;
+  }
+
+  srt_ctx_free(ctx);
+}
+
+//
+// a branch whose thread cannot be started runs on the calling thread once the
+// others are under way.
+//
+static void run_all(branch_run *runs, size_t n) {
+  for (size_t i = 1; i < n; ++i) {
+    runs[i].started =
+        pthread_create(&runs[i].thread, NULL, run_branch, &runs[i]) == 0;
+  }
+
+  run_branch(&runs[0]);
+
+  for (size_t i = 1; i < n; ++i) {
+    if (runs[i].started) {
+      pthread_join(runs[i].thread, NULL);
+    } else {
+      run_branch(&runs[i]);
+    }
+  }
+}
+
+//
+// the branches only ever read the task data of `ctx`, so an image behind it
+// is faulted in whole first rather than from several threads.
+//
+int32_t srt_run_parallel(const srt_context *ctx, const srt_branch *branches,
+                         size_t n, srt_merge_policy policy) {
+  if (n == 0) {
+    return SRT_SUCCESS;
+  }
+
+  if (ctx->image && !srt_image_fault_all(ctx->image, ctx->task_data)) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  srt_log_flush(ctx->log);
+
+  branch_run *runs = calloc(n, sizeof(*runs));
+  srt_context **contexts = calloc(n, sizeof(*contexts));
+  bool ok = runs && contexts;
+
+  for (size_t i = 0; ok && i < n; ++i) {
+    runs[i].fn = branches[i];
+    ok = (runs[i].ctx = contexts[i] = branch_new(ctx)) != NULL;
+  }
+
+  int32_t result = ok ? SRT_SUCCESS : SRT_UNKNOWN_ERROR;
+
+  if (ok) {
+    run_all(runs, n);
+
+    for (size_t i = 0; i < n && result == SRT_SUCCESS; ++i) {
+      result = runs[i].result;
+    }
+  }
+
+  if (result == SRT_SUCCESS) {
+    result = srt_overlay_merge(ctx, contexts, n, policy);
+  }
+
+  for (size_t i = 0; contexts && i < n; ++i) {
+    branch_free(ctx, contexts[i]);
+  }
+
+  free(contexts);
+  free(runs);
+
+  return result;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "ctx.h"
+#include "overlay.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// runs the branches of a parallel gateway at the same time, one thread each
+// with the calling thread taking the first. every branch gets a context of
+// its own over a copy on write view of the task data of `ctx`, see overlay.h,
+// and shares its trace, log level and output. profiles are merged back.
+//
+// when every branch returns 0 their writes are merged into `ctx` under
+// `policy`. otherwise nothing is merged and the result of the first failing
+// branch, by position, is returned. `ctx` must not be used by anything else
+// until the call returns.
+//
+
+typedef int32_t (*srt_branch)(srt_context *ctx);
+
+int32_t srt_run_parallel(const srt_context *ctx, const srt_branch *branches,
+                         size_t n, srt_merge_policy policy);
@@ -0,0 +1,95 @@
+#include "path.h"
+#include "const.h"
+#include <stdlib.h>
+#include <string.h>
+
+srt_path *srt_path_compile(const char *str) {
+  size_t len = 1;
+
+  for (const char *c = str; *c; c++) {
+    len += *c == '.';
+  }
+
+  const size_t size = strlen(str) + 1;
+  srt_path *path =
+      malloc(sizeof(*path) + len * sizeof(path->segments[0]) + size * 2);
+
+  if (!path) {
+    return NULL;
+  }
+
+  //
+  // the copy that is split into segments follows the handles, the one the
+  // path is known by comes last.
+  //
+  char *segments = (char *)&path->segments[len];
+  memcpy(segments, str, size);
+  path->str = memcpy(segments + size, str, size);
+  path->len = len;
+
+  for (size_t i = 0; i < len; i++) {
+    char *end = strchr(segments, '.');
+
+    if (end) {
+      *end = '\0';
+    }
+
+    if (!*segments) {
+      free(path);
+      return NULL;
+    }
+
+    srt_key_init(&path->segments[i], segments);
+    segments += strlen(segments) + 1;
+  }
+
+  return path;
+}
+
+void srt_path_free(srt_path *path) { free(path); }
+
+int32_t srt_path_resolve(srt_dict *dict, srt_path *path, size_t from,
+                         bool shared, srt_value **value) {
+  srt_value *v = NULL;
+
+  for (size_t i = from; i < path->len; i++) {
+    if (i > from && v->tag != SRT_DICT) {
+      return SRT_KEY_TYPE_MISMATCH;
+    }
+
+    if (i > from) {
+      dict = v->dict;
+    }
+
+    if (!dict) {
+      return SRT_UNKNOWN_KEY;
+    }
+
+    srt_key *key = &path->segments[i];
+    srt_key private;
+
+    if (shared) {
+      srt_key_init(&private, key->str);
+      key = &private;
+    }
+
+    if (!(v = srt_dict_get_k(dict, key))) {
+      return SRT_UNKNOWN_KEY;
+    }
+  }
+
+  if (!v) {
+    return SRT_UNKNOWN_KEY;
+  }
+
+  *value = v;
+
+  return SRT_SUCCESS;
+}
+
+srt_value *srt_dict_get_path(srt_dict *dict, srt_path *path) {
+  srt_value *value;
+
+  return srt_path_resolve(dict, path, 0, false, &value) == SRT_SUCCESS ? value
+                                                                       : NULL;
+}
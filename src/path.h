@@ -0,0 +1,45 @@
+#pragma once
+
+#include "dict.h"
+#include "value.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// a dotted path into nested dicts, like `order.customer.id`, compiled once
+// into a key handle per segment. each handle keeps its hash and the slot it
+// was last found in along with the generation of that dict, so a repeat walk
+// down the same dicts compares a few words per level instead of hashing and
+// probing. the dict under a segment is read afresh on every walk and a
+// handle only trusts its slot when it was cached in that very dict, at its
+// current generation and inside its current table. generations start from a
+// process-wide counter, so a nested dict replaced by one at the same address
+// never matches, and the slot is probed again.
+//
+
+typedef struct srt_path {
+  const char *str;
+  size_t len;
+  srt_key segments[];
+} srt_path;
+
+//
+// NULL when `str` is empty or has an empty segment. the path keeps a copy of
+// `str`, and lives in a single allocation.
+//
+srt_path *srt_path_compile(const char *str);
+
+void srt_path_free(srt_path *path);
+
+//
+// walks the segments of `path` from `from` on, starting at `dict`. every
+// segment but the last must name a dict, and a NULL dict on the way has no
+// keys, so the path is unknown past it. with `shared`, the path may be used
+// by other threads at the same time and the walk leaves the handles alone,
+// hashing each segment again instead.
+//
+int32_t srt_path_resolve(srt_dict *dict, srt_path *path, size_t from,
+                         bool shared, srt_value **value);
+
+srt_value *srt_dict_get_path(srt_dict *dict, srt_path *path);
@@ -0,0 +1,410 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "pool.h"
+#include "const.h"
+#include "ctx.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define EMPTY -1
+#define ABORT -2
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//
+// a chase-lev deque of instance indices, with the c11 orderings of le et al.
+// the owner takes from the bottom and thieves steal from the top. every index
+// is in place before the workers start and none is added later, so the array
+// is fixed and read without atomics.
+//
+
+typedef struct deque {
+  _Atomic int64_t top;
+  char pad[64 - sizeof(int64_t)];
+  _Atomic int64_t bottom;
+  const int64_t *items;
+} deque;
+
+static int64_t take(deque *d) {
+  const int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+  if (t > b) {
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    return EMPTY;
+  }
+
+  int64_t x = d->items[b];
+
+  //
+  // the last item may be stolen at the same time, whoever moves top first
+  // gets it.
+  //
+  if (t == b) {
+    if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+      x = EMPTY;
+    }
+
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+  }
+
+  return x;
+}
+
+static int64_t steal(deque *d) {
+  int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  const int64_t b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+  if (t >= b) {
+    return EMPTY;
+  }
+
+  const int64_t x = d->items[t];
+
+  if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                               memory_order_seq_cst,
+                                               memory_order_relaxed)) {
+    return ABORT;
+  }
+
+  return x;
+}
+
+//
+// instances and workers
+//
+
+typedef struct instance {
+  size_t offset;
+  size_t len;
+  size_t number;
+  char *out;
+  size_t out_len;
+  bool done;
+  int32_t result;
+} instance;
+
+typedef struct worker worker;
+
+typedef struct pool {
+  char *text;
+  instance *instances;
+  size_t count;
+  srt_batch_start start;
+  worker *workers;
+  size_t jobs;
+  pthread_mutex_t lock;
+  size_t next;
+  FILE *out;
+  srt_batch_stats *stats;
+  bool failed;
+} pool;
+
+struct worker {
+  deque deque;
+  pool *pool;
+  size_t id;
+  pthread_t thread;
+  bool started;
+  srt_context *ctx;
+  FILE *out;
+  char *buf;
+  size_t len;
+  uint64_t rng;
+  bool failed;
+};
+
+//
+// the input is read whole, the instances point into it by offset.
+//
+static bool read_input(FILE *in, pool *p) {
+  char *line = NULL;
+  size_t line_cap = 0;
+  size_t text_len = 0;
+  size_t text_cap = 0;
+  size_t cap = 0;
+  size_t number = 0;
+  ssize_t len;
+  bool ok = true;
+
+  while (ok && (len = getline(&line, &line_cap, in)) != -1) {
+    ++number;
+
+    if (srt_batch_blank(line, len)) {
+      continue;
+    }
+
+    if (text_len + len > text_cap) {
+      text_cap = text_cap ? text_cap * 2 : 64 * 1024;
+      text_cap = text_cap < text_len + len ? text_len + len : text_cap;
+      char *text = realloc(p->text, text_cap);
+      ok = text != NULL;
+      p->text = ok ? text : p->text;
+    }
+
+    if (ok && p->count == cap) {
+      cap = cap ? cap * 2 : 1024;
+      instance *instances = realloc(p->instances, cap * sizeof(*instances));
+      ok = instances != NULL;
+      p->instances = ok ? instances : p->instances;
+    }
+
+    if (ok) {
+      memcpy(p->text + text_len, line, len);
+      p->instances[p->count++] =
+          (instance){.offset = text_len, .len = len, .number = number};
+      text_len += len;
+    }
+  }
+
+  free(line);
+
+  return ok && !ferror(in);
+}
+
+static bool worker_init(worker *w, const srt_context *parent) {
+  w->out = open_memstream(&w->buf, &w->len);
+  w->ctx = w->out ? srt_ctx_new_worker(parent, w->out) : NULL;
+  w->rng = parent->seed ^ (w->id + 1) * 0x9e3779b97f4a7c15;
+
+  return w->ctx != NULL;
+}
+
+static void worker_free(worker *w, srt_context *parent) {
+  srt_ctx_free_worker(w->ctx, parent);
+
+  if (w->out) {
+    fclose(w->out);
+  }
+}
+
+static uint64_t next_random(uint64_t *state) {
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+
+  return *state = x;
+}
+
+//
+// no instance is added once the workers start, so a sweep that finds every
+// deque empty, rather than lost a race on one, means the batch is done.
+//
+static int64_t steal_any(worker *w) {
+  const pool *p = w->pool;
+
+  for (;;) {
+    const size_t first = next_random(&w->rng) % p->jobs;
+    bool contended = false;
+
+    for (size_t k = 0; k < p->jobs; ++k) {
+      worker *victim = &p->workers[(first + k) % p->jobs];
+
+      if (victim == w) {
+        continue;
+      }
+
+      const int64_t x = steal(&victim->deque);
+
+      if (x >= 0) {
+        return x;
+      }
+
+      contended |= x == ABORT;
+    }
+
+    if (!contended) {
+      return EMPTY;
+    }
+  }
+}
+
+static void emit(pool *p, const char *buf, size_t len, int32_t result) {
+  p->failed |= len && fwrite(buf, 1, len, p->out) != len;
+  srt_batch_count(p->stats, result);
+  p->next++;
+}
+
+//
+// output goes to `out` in input order as soon as it can. an instance whose
+// turn it is goes straight from the buffer of its worker, followed by those
+// after it that finished earlier. those were copied aside, the buffer being
+// rewound for the next instance of their worker.
+//
+static void deliver(worker *w, size_t at) {
+  pool *p = w->pool;
+  instance *it = &p->instances[at];
+
+  pthread_mutex_lock(&p->lock);
+
+  if (at == p->next) {
+    emit(p, w->buf, w->len, it->result);
+
+    while (p->next < p->count && p->instances[p->next].done) {
+      instance *done = &p->instances[p->next];
+      emit(p, done->out, done->out_len, done->result);
+      free(done->out);
+      done->out = NULL;
+    }
+  } else if ((it->out = malloc(w->len ? w->len : 1))) {
+    memcpy(it->out, w->buf, w->len);
+    it->out_len = w->len;
+    it->done = true;
+  } else {
+    w->failed = true;
+  }
+
+  pthread_mutex_unlock(&p->lock);
+}
+
+static void run(worker *w, size_t at) {
+  const pool *p = w->pool;
+  instance *it = &p->instances[at];
+
+  rewind(w->out);
+
+  if (!srt_batch_run_line(w->ctx, p->text + it->offset, it->len, it->number,
+                          w->out, p->start, &it->result) ||
+      fflush(w->out) != 0) {
+    w->failed = true;
+  }
+
+  deliver(w, at);
+}
+
+static void *work(void *arg) {
+  worker *w = arg;
+
+  for (;;) {
+    int64_t x = take(&w->deque);
+
+    if (x == EMPTY && (x = steal_any(w)) == EMPTY) {
+      return NULL;
+    }
+
+    run(w, x);
+  }
+}
+
+size_t srt_pool_default_jobs(void) {
+  const long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (size_t)n : 1;
+}
+
+//
+// each worker is dealt a contiguous run of lines, stored back to front so the
+// owner walks it forwards from the bottom while thieves take from its end.
+//
+static bool deal(pool *p, int64_t *items, srt_context *ctx) {
+  bool ok = true;
+
+  for (size_t i = 0; i < p->jobs; ++i) {
+    worker *w = &p->workers[i];
+    const size_t lo = i * p->count / p->jobs;
+    const size_t hi = (i + 1) * p->count / p->jobs;
+
+    for (size_t k = 0; k < hi - lo; ++k) {
+      items[lo + k] = hi - 1 - k;
+    }
+
+    w->pool = p;
+    w->id = i;
+    w->deque.items = items + lo;
+    atomic_init(&w->deque.top, 0);
+    atomic_init(&w->deque.bottom, hi - lo);
+
+    ok = worker_init(w, ctx) && ok;
+  }
+
+  return ok;
+}
+
+//
+// the calling thread works as worker 0. if a thread cannot be started the
+// others steal its lines.
+//
+static void run_workers(pool *p) {
+  for (size_t i = 1; i < p->jobs; ++i) {
+    worker *w = &p->workers[i];
+    w->started = pthread_create(&w->thread, NULL, work, w) == 0;
+  }
+
+  work(&p->workers[0]);
+
+  for (size_t i = 1; i < p->jobs; ++i) {
+    if (p->workers[i].started) {
+      pthread_join(p->workers[i].thread, NULL);
+    }
+  }
+}
+
+int32_t srt_pool_run(srt_context *ctx, FILE *in, FILE *out,
+                     srt_batch_start start, size_t jobs,
+                     srt_batch_stats *stats) {
+  *stats = (srt_batch_stats){0};
+  const uint64_t start_ns = now_ns();
+
+  pool p = {.start = start, .out = out, .stats = stats};
+
+  if (!read_input(in, &p)) {
+    free(p.text);
+    free(p.instances);
+    return SRT_IO_ERROR;
+  }
+
+  p.jobs = jobs < 1 ? 1 : jobs;
+  p.jobs = p.count && p.jobs > p.count ? p.count : p.jobs;
+  p.workers = calloc(p.jobs, sizeof(*p.workers));
+  int64_t *items = malloc((p.count ? p.count : 1) * sizeof(*items));
+
+  int32_t result = p.workers && items && deal(&p, items, ctx)
+                       ? SRT_SUCCESS
+                       : SRT_UNKNOWN_ERROR;
+
+  if (result == SRT_SUCCESS) {
+    pthread_mutex_init(&p.lock, NULL);
+    run_workers(&p);
+    pthread_mutex_destroy(&p.lock);
+  }
+
+  for (size_t i = 0; p.workers && i < p.jobs; ++i) {
+    worker_free(&p.workers[i], ctx);
+    result = p.workers[i].failed ? SRT_UNKNOWN_ERROR : result;
+  }
+
+  if (result == SRT_SUCCESS && (p.failed || fflush(out) != 0 || ferror(out))) {
+    result = SRT_IO_ERROR;
+  }
+
+  for (size_t i = 0; p.workers && i < p.jobs; ++i) {
+    free(p.workers[i].buf);
+  }
+
+  for (size_t i = 0; i < p.count; ++i) {
+    free(p.instances[i].out);
+  }
+
+  stats->ns = now_ns() - start_ns;
+
+  free(items);
+  free(p.workers);
+  free(p.instances);
+  free(p.text);
+
+  return result;
+}
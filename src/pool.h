@@ -0,0 +1,27 @@
+#pragma once
+
+#include "batch.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//
+// srt_batch_run spread over `jobs` threads. each worker has a context of its
+// own, set up like `ctx` with its seed, log level, trace and profiling, so
+// workers share nothing but the input and the trace. the lines are dealt out
+// in contiguous runs, one work stealing deque per worker, and a worker whose
+// deque runs dry steals from the far end of another's.
+//
+// an instance writes its log, manual task output and result line to a buffer
+// of its worker, which goes to `out` as soon as every instance before it has
+// gone, so the output is the same as that of srt_batch_run and a run that is
+// cut short keeps the results it finished in order. only instances that
+// finish ahead of their turn are held, in a copy of their own. the profiles
+// of the workers are merged into the one of `ctx`.
+//
+
+int32_t srt_pool_run(srt_context *ctx, FILE *in, FILE *out,
+                     srt_batch_start start, size_t jobs,
+                     srt_batch_stats *stats);
+
+size_t srt_pool_default_jobs(void);
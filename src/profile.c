@@ -0,0 +1,299 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "profile.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define INITIAL_CAP 64
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool index_init(srt_profile *profile, size_t cap) {
+  uint32_t *index = calloc(cap * 2, sizeof(*index));
+  if (!index) {
+    return false;
+  }
+
+  free(profile->index);
+  profile->index = index;
+  profile->index_mask = cap * 2 - 1;
+
+  return true;
+}
+
+srt_profile *srt_profile_new(FILE *out) {
+  srt_profile *profile = calloc(1, sizeof(*profile));
+  if (!profile) {
+    return NULL;
+  }
+
+  profile->out = out;
+  profile->cap = INITIAL_CAP;
+  profile->elements = malloc(INITIAL_CAP * sizeof(*profile->elements));
+
+  if (!profile->elements || !index_init(profile, INITIAL_CAP)) {
+    srt_profile_free(profile);
+    return NULL;
+  }
+
+  profile->start_ns = now_ns();
+
+  return profile;
+}
+
+void srt_profile_free(srt_profile *profile) {
+  if (!profile) {
+    return;
+  }
+
+  for (size_t i = 0; i < profile->len; ++i) {
+    free(profile->elements[i].process_id);
+    free(profile->elements[i].element_id);
+  }
+
+  free(profile->elements);
+  free(profile->index);
+  free(profile);
+}
+
+static size_t home(const srt_profile *profile, const char *process_key,
+                   const char *element_key) {
+  uint64_t h = (uintptr_t)process_key * 0x9e3779b97f4a7c15 ^
+               (uintptr_t)element_key * 0xc2b2ae3d27d4eb4f;
+  h ^= h >> 32;
+
+  return h & profile->index_mask;
+}
+
+static void index_put(srt_profile *profile, size_t at) {
+  const srt_profile_element *e = &profile->elements[at];
+  size_t i = home(profile, e->process_key, e->element_key);
+
+  while (profile->index[i]) {
+    i = (i + 1) & profile->index_mask;
+  }
+
+  profile->index[i] = at + 1;
+}
+
+//
+// the index is kept at most half full and rebuilt when the elements array
+// doubles.
+//
+static srt_profile_element *add(srt_profile *profile, const char *process_key,
+                                const char *element_key) {
+  if (profile->len == profile->cap) {
+    const size_t cap = profile->cap * 2;
+    srt_profile_element *elements =
+        realloc(profile->elements, cap * sizeof(*elements));
+    if (!elements) {
+      return NULL;
+    }
+
+    profile->elements = elements;
+    profile->cap = cap;
+
+    if (!index_init(profile, cap)) {
+      return NULL;
+    }
+
+    for (size_t i = 0; i < profile->len; ++i) {
+      index_put(profile, i);
+    }
+  }
+
+  srt_profile_element *e = &profile->elements[profile->len];
+  *e = (srt_profile_element){
+      .process_key = process_key,
+      .element_key = element_key,
+      .process_id = strdup(process_key ? process_key : ""),
+      .element_id = strdup(element_key ? element_key : ""),
+  };
+
+  if (!e->process_id || !e->element_id) {
+    free(e->process_id);
+    free(e->element_id);
+    return NULL;
+  }
+
+  index_put(profile, profile->len++);
+
+  return e;
+}
+
+static srt_profile_element *element(srt_profile *profile,
+                                    const char *process_key,
+                                    const char *element_key) {
+  for (size_t i = home(profile, process_key, element_key);;
+       i = (i + 1) & profile->index_mask) {
+    const uint32_t at = profile->index[i];
+
+    if (!at) {
+      return add(profile, process_key, element_key);
+    }
+
+    srt_profile_element *e = &profile->elements[at - 1];
+
+    if (e->process_key == process_key && e->element_key == element_key) {
+      return e;
+    }
+  }
+}
+
+//
+// the clock is read after the lookup on the way in and before it on the way
+// out, so the bookkeeping stays out of the measured time. an element entered
+// again before it finished, e.g. a call activity that reaches itself, is
+// timed from its outermost entry.
+//
+void srt_profile_will_run(srt_profile *profile, const char *process_id,
+                          const char *element_id) {
+  srt_profile_element *e = element(profile, process_id, element_id);
+
+  if (e && e->depth++ == 0) {
+    e->start_ns = now_ns();
+  }
+}
+
+static int bucket(uint64_t ns) {
+  const int b = ns ? 64 - __builtin_clzll(ns) : 0;
+  return b < SRT_PROFILE_BUCKETS ? b : SRT_PROFILE_BUCKETS - 1;
+}
+
+void srt_profile_did_run(srt_profile *profile, const char *process_id,
+                         const char *element_id) {
+  const uint64_t end = now_ns();
+  srt_profile_element *e = element(profile, process_id, element_id);
+
+  if (!e || !e->depth || --e->depth) {
+    return;
+  }
+
+  const uint64_t elapsed = end - e->start_ns;
+
+  e->count++;
+  e->total_ns += elapsed;
+  e->max_ns = elapsed > e->max_ns ? elapsed : e->max_ns;
+  e->histogram[bucket(elapsed)]++;
+}
+
+void srt_profile_abandon(srt_profile *profile) {
+  for (size_t i = 0; i < profile->len; ++i) {
+    profile->elements[i].depth = 0;
+  }
+}
+
+//
+// summary
+//
+
+static int by_name(const void *a, const void *b) {
+  const srt_profile_element *x = a;
+  const srt_profile_element *y = b;
+  const int c = strcmp(x->process_id, y->process_id);
+
+  return c ? c : strcmp(x->element_id, y->element_id);
+}
+
+static int by_total(const void *a, const void *b) {
+  const srt_profile_element *x = a;
+  const srt_profile_element *y = b;
+
+  return (x->total_ns < y->total_ns) - (x->total_ns > y->total_ns);
+}
+
+//
+// the upper bound of the bucket holding the p-th percentile run, capped by
+// the slowest run seen.
+//
+static double percentile_us(const srt_profile_element *e, int p) {
+  const uint64_t rank = (e->count * p + 99) / 100;
+  uint64_t seen = 0;
+
+  for (int b = 0; b < SRT_PROFILE_BUCKETS; ++b) {
+    seen += e->histogram[b];
+
+    if (seen >= rank) {
+      const uint64_t bound = b ? (uint64_t)1 << b : 0;
+      return (bound < e->max_ns ? bound : e->max_ns) / 1000.0;
+    }
+  }
+
+  return e->max_ns / 1000.0;
+}
+
+void srt_profile_report(const srt_profile *profile) {
+  const uint64_t wall = now_ns() - profile->start_ns;
+  srt_profile_element *rows = malloc((profile->len + 1) * sizeof(*rows));
+  size_t n = 0;
+
+  if (!rows) {
+    return;
+  }
+
+  memcpy(rows, profile->elements, profile->len * sizeof(*rows));
+  qsort(rows, profile->len, sizeof(*rows), by_name);
+
+  for (size_t i = 0; i < profile->len; ++i) {
+    if (n && by_name(&rows[n - 1], &rows[i]) == 0) {
+      srt_profile_element *row = &rows[n - 1];
+
+      row->count += rows[i].count;
+      row->total_ns += rows[i].total_ns;
+      row->max_ns = rows[i].max_ns > row->max_ns ? rows[i].max_ns : row->max_ns;
+      for (int b = 0; b < SRT_PROFILE_BUCKETS; ++b) {
+        row->histogram[b] += rows[i].histogram[b];
+      }
+    } else if (rows[i].count) {
+      rows[n++] = rows[i];
+    }
+  }
+
+  qsort(rows, n, sizeof(*rows), by_total);
+
+  fprintf(profile->out, "profile: %zu elements, %.3f ms wall\n\n", n,
+          wall / 1e6);
+  fprintf(profile->out,
+          "%-20s  %-24s  %8s  %10s  %6s  %10s  %10s  %10s  %10s\n", "process",
+          "element", "count", "total ms", "wall %", "mean us", "p50 us",
+          "p99 us", "max us");
+
+  for (size_t i = 0; i < n; ++i) {
+    const srt_profile_element *e = &rows[i];
+
+    fprintf(profile->out,
+            "%-20s  %-24s  %8lu  %10.3f  %6.2f  %10.2f  %10.2f  %10.2f  "
+            "%10.2f\n",
+            e->process_id, e->element_id, e->count, e->total_ns / 1e6,
+            wall ? 100.0 * e->total_ns / wall : 0,
+            e->total_ns / 1000.0 / e->count, percentile_us(e, 50),
+            percentile_us(e, 99), e->max_ns / 1000.0);
+  }
+
+  fflush(profile->out);
+  free(rows);
+}
+
+void srt_profile_merge(srt_profile *into, const srt_profile *from) {
+  for (size_t i = 0; i < from->len; ++i) {
+    const srt_profile_element *f = &from->elements[i];
+    srt_profile_element *e = element(into, f->process_key, f->element_key);
+
+    if (!e) {
+      continue;
+    }
+
+    e->count += f->count;
+    e->total_ns += f->total_ns;
+    e->max_ns = f->max_ns > e->max_ns ? f->max_ns : e->max_ns;
+    for (int b = 0; b < SRT_PROFILE_BUCKETS; ++b) {
+      e->histogram[b] += f->histogram[b];
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+//
+// per element timing for the life-cycle hooks. elements are found by the
+// address of their process and element id, which generated code passes as
+// string literals, so the hooks never hash or compare a string. ids that
+// arrive through different pointers are merged by name in the summary.
+//
+// latencies go into log2 buckets, bucket b counting runs that took
+// [2^(b-1), 2^b) ns.
+//
+
+#define SRT_PROFILE_BUCKETS 64
+
+typedef struct srt_profile_element {
+  const char *process_key;
+  const char *element_key;
+  char *process_id;
+  char *element_id;
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t start_ns;
+  uint32_t depth;
+  uint64_t histogram[SRT_PROFILE_BUCKETS];
+} srt_profile_element;
+
+typedef struct srt_profile {
+  FILE *out;
+  uint64_t start_ns;
+  size_t len;
+  size_t cap;
+  srt_profile_element *elements;
+  uint32_t *index;
+  size_t index_mask;
+} srt_profile;
+
+srt_profile *srt_profile_new(FILE *out);
+
+void srt_profile_free(srt_profile *profile);
+
+void srt_profile_will_run(srt_profile *profile, const char *process_id,
+                          const char *element_id);
+
+void srt_profile_did_run(srt_profile *profile, const char *process_id,
+                         const char *element_id);
+
+//
+// forgets the runs still in flight, e.g. of elements an instance left with
+// an error or a suspension, so they are timed afresh when entered again.
+//
+void srt_profile_abandon(srt_profile *profile);
+
+void srt_profile_report(const srt_profile *profile);
+
+//
+// adds the finished runs of `from` to `into`, for profiles kept per thread.
+// runs still in flight in `from` are not carried over.
+//
+void srt_profile_merge(srt_profile *into, const srt_profile *from);
@@ -0,0 +1,744 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "server.h"
+#include "const.h"
+#include "ctx.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 64
+#define READ_SIZE (64 * 1024)
+#define MAX_LINE (16 * 1024 * 1024)
+#define BACKLOG 128
+#define RESUME "resume "
+#define ERROR_REPLY "{\"line\":%zu,\"result\":%d,\"error\":\"%s\"}\n"
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+typedef struct buffer {
+  char *data;
+  size_t len;
+  size_t cap;
+} buffer;
+
+static bool buffer_append(buffer *b, const char *data, size_t len) {
+  if (len == 0) {
+    return true;
+  }
+
+  if (b->len + len > b->cap) {
+    size_t cap = b->cap ? b->cap * 2 : READ_SIZE;
+    cap = cap < b->len + len ? b->len + len : cap;
+    char *grown = realloc(b->data, cap);
+
+    if (!grown) {
+      return false;
+    }
+
+    b->data = grown;
+    b->cap = cap;
+  }
+
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+
+  return true;
+}
+
+static void buffer_consume(buffer *b, size_t len) {
+  if (len == 0) {
+    return;
+  }
+
+  memmove(b->data, b->data + len, b->len - len);
+  b->len -= len;
+}
+
+//
+// a connection stays allocated while it has requests in flight, even once
+// its socket is closed, so the replies that come back have somewhere to land.
+//
+
+typedef struct conn {
+  struct conn *prev;
+  struct conn *next;
+  int fd;
+  uint32_t events;
+  buffer in;
+  buffer out;
+  size_t number;
+  size_t pending;
+  bool eof;
+  bool closed;
+} conn;
+
+typedef struct job {
+  struct job *next;
+  conn *conn;
+  size_t number;
+  char *line;
+  size_t len;
+  char *reply;
+  size_t reply_len;
+  int32_t result;
+} job;
+
+typedef struct worker {
+  srt_server *server;
+  pthread_t thread;
+  bool started;
+  srt_context *ctx;
+  FILE *out;
+  char *buf;
+  size_t len;
+} worker;
+
+//
+// the loop hands jobs to the workers through a queue and gets them back
+// through a list that it is woken to drain, both under one lock.
+//
+
+struct srt_server {
+  srt_context *ctx;
+  char *path;
+  srt_batch_start start;
+  int listen_fd;
+  int wake_fd;
+  int epoll_fd;
+  atomic_bool stopping;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+  job *head;
+  job *tail;
+  job *done;
+  bool quit;
+  conn *conns;
+  worker *workers;
+  size_t jobs;
+};
+
+static void job_free(job *j) {
+  free(j->line);
+  free(j->reply);
+  free(j);
+}
+
+static void wake(srt_server *server) {
+  const uint64_t one = 1;
+  ssize_t n;
+
+  do {
+    n = write(server->wake_fd, &one, sizeof(one));
+  } while (n < 0 && errno == EINTR);
+}
+
+//
+// workers
+//
+
+static bool reply_error(FILE *out, size_t number, int32_t result,
+                        const char *message) {
+  return fprintf(out, ERROR_REPLY, number, result, message) > 0;
+}
+
+//
+// the line of a resume request is split in place into the element id and the
+// task data that follows it.
+//
+static bool run_request(worker *w, job *j) {
+  const srt_server *server = w->server;
+  const size_t resume_len = strlen(RESUME);
+
+  if (j->len < resume_len || memcmp(j->line, RESUME, resume_len) != 0) {
+    return srt_batch_run_line(w->ctx, j->line, j->len, j->number, w->out,
+                              server->start, &j->result);
+  }
+
+  char *element = j->line + resume_len;
+  char *data = memchr(element, ' ', j->len - resume_len);
+
+  if (!server->ctx->suspension) {
+    j->result = SRT_UNKNOWN_ERROR;
+    return reply_error(w->out, j->number, j->result,
+                       "resuming needs a suspendable server");
+  }
+
+  if (!data || data == element) {
+    j->result = SRT_INVALID_JSON;
+    return reply_error(w->out, j->number, j->result,
+                       "expected an element id and task data");
+  }
+
+  *data++ = '\0';
+
+  return srt_batch_resume_line(w->ctx, element, data,
+                               j->len - (data - j->line), j->number, w->out,
+                               server->start, &j->result);
+}
+
+//
+// the output of the worker is rewound for every job, what the job wrote is
+// copied out as its reply.
+//
+static void run(worker *w, job *j) {
+  rewind(w->out);
+
+  const bool ok = run_request(w, j) && fflush(w->out) == 0;
+  const off_t len = ftello(w->out);
+
+  if (ok && len > 0 && (j->reply = malloc(len))) {
+    memcpy(j->reply, w->buf, len);
+    j->reply_len = len;
+  }
+}
+
+static job *next_job(srt_server *server) {
+  pthread_mutex_lock(&server->lock);
+
+  while (!server->quit && !server->head) {
+    pthread_cond_wait(&server->ready, &server->lock);
+  }
+
+  job *j = server->quit ? NULL : server->head;
+
+  if (j && !(server->head = j->next)) {
+    server->tail = NULL;
+  }
+
+  pthread_mutex_unlock(&server->lock);
+
+  return j;
+}
+
+static void *work(void *arg) {
+  worker *w = arg;
+  srt_server *server = w->server;
+
+  for (job *j; (j = next_job(server));) {
+    run(w, j);
+
+    pthread_mutex_lock(&server->lock);
+    j->next = server->done;
+    server->done = j;
+    pthread_mutex_unlock(&server->lock);
+
+    wake(server);
+  }
+
+  return NULL;
+}
+
+//
+// connections
+//
+
+static void conn_free(srt_server *server, conn *c) {
+  if (c->prev) {
+    c->prev->next = c->next;
+  } else {
+    server->conns = c->next;
+  }
+
+  if (c->next) {
+    c->next->prev = c->prev;
+  }
+
+  free(c->in.data);
+  free(c->out.data);
+  free(c);
+}
+
+static void drop(srt_server *server, conn *c) {
+  close(c->fd);
+  c->closed = true;
+
+  if (c->pending == 0) {
+    conn_free(server, c);
+  }
+}
+
+static bool submit(srt_server *server, conn *c, const char *line, size_t len) {
+  job *j = calloc(1, sizeof(*j));
+
+  if (!j || !(j->line = malloc(len + 1))) {
+    free(j);
+    return false;
+  }
+
+  memcpy(j->line, line, len);
+  j->line[len] = '\0';
+  j->len = len;
+  j->conn = c;
+  j->number = c->number;
+  c->pending++;
+
+  pthread_mutex_lock(&server->lock);
+
+  if (server->tail) {
+    server->tail->next = j;
+  } else {
+    server->head = j;
+  }
+
+  server->tail = j;
+  pthread_cond_signal(&server->ready);
+  pthread_mutex_unlock(&server->lock);
+
+  return true;
+}
+
+//
+// a line with no newline at the end of the input is a request all the same,
+// like the last line of a batch file.
+//
+static bool submit_lines(srt_server *server, conn *c) {
+  size_t start = 0;
+
+  while (start < c->in.len) {
+    const char *nl = memchr(c->in.data + start, '\n', c->in.len - start);
+
+    if (!nl && !c->eof) {
+      break;
+    }
+
+    const size_t end = nl ? (size_t)(nl - c->in.data) + 1 : c->in.len;
+
+    const char *line = c->in.data + start;
+    ++c->number;
+
+    if (!srt_batch_blank(line, end - start) &&
+        !submit(server, c, line, end - start)) {
+      return false;
+    }
+
+    start = end;
+  }
+
+  buffer_consume(&c->in, start);
+
+  return true;
+}
+
+static bool append_error(buffer *b, size_t number, int32_t result,
+                         const char *message) {
+  char reply[128];
+  const int len =
+      snprintf(reply, sizeof(reply), ERROR_REPLY, number, result, message);
+
+  return buffer_append(b, reply, len);
+}
+
+static bool flush(conn *c) {
+  size_t sent = 0;
+
+  while (sent < c->out.len) {
+    const ssize_t n =
+        send(c->fd, c->out.data + sent, c->out.len - sent, MSG_NOSIGNAL);
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0) {
+      buffer_consume(&c->out, sent);
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    sent += n;
+  }
+
+  c->out.len = 0;
+
+  return true;
+}
+
+//
+// a request too long to be real ends the connection, there is no telling
+// where the next one would start.
+//
+static bool read_requests(srt_server *server, conn *c) {
+  char chunk[READ_SIZE];
+
+  while (!c->eof) {
+    const ssize_t n = read(c->fd, chunk, sizeof(chunk));
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    c->eof = n == 0;
+
+    if (!buffer_append(&c->in, chunk, n) || !submit_lines(server, c)) {
+      return false;
+    }
+
+    if (c->in.len > MAX_LINE) {
+      c->eof = true;
+      c->in.len = 0;
+      return append_error(&c->out, c->number + 1, SRT_INVALID_JSON,
+                          "request too long");
+    }
+  }
+
+  return true;
+}
+
+//
+// a connection is done once the client will send nothing more and has been
+// sent everything it is owed.
+//
+static void update(srt_server *server, conn *c) {
+  if (c->eof && c->pending == 0 && c->out.len == 0) {
+    drop(server, c);
+    return;
+  }
+
+  const uint32_t events = (c->eof ? 0 : EPOLLIN) | (c->out.len ? EPOLLOUT : 0);
+
+  if (events != c->events) {
+    struct epoll_event ev = {.events = events, .data.ptr = c};
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = events;
+  }
+}
+
+//
+// a hang up means the client closed its end entirely and can no longer read
+// any replies.
+//
+static void serve(srt_server *server, conn *c, uint32_t events) {
+  if ((events & (EPOLLERR | EPOLLHUP)) ||
+      ((events & EPOLLIN) && !read_requests(server, c)) || !flush(c)) {
+    drop(server, c);
+    return;
+  }
+
+  update(server, c);
+}
+
+static bool nonblocking(int fd) {
+  const int flags = fcntl(fd, F_GETFL);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static void accept_all(srt_server *server) {
+  for (;;) {
+    const int fd = accept(server->listen_fd, NULL, NULL);
+
+    if (fd < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (fd < 0) {
+      return;
+    }
+
+    conn *c = calloc(1, sizeof(*c));
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+
+    if (!c || !nonblocking(fd) ||
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      free(c);
+      close(fd);
+      continue;
+    }
+
+    c->fd = fd;
+    c->events = EPOLLIN;
+    c->next = server->conns;
+
+    if (c->next) {
+      c->next->prev = c;
+    }
+
+    server->conns = c;
+  }
+}
+
+//
+// finished jobs come back in reverse, they are turned around so the replies
+// to a connection go out in the order their jobs finished.
+//
+static void deliver(srt_server *server, srt_batch_stats *stats) {
+  uint64_t count;
+
+  while (read(server->wake_fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+  }
+
+  pthread_mutex_lock(&server->lock);
+  job *done = server->done;
+  server->done = NULL;
+  pthread_mutex_unlock(&server->lock);
+
+  job *ordered = NULL;
+
+  while (done) {
+    job *next = done->next;
+    done->next = ordered;
+    ordered = done;
+    done = next;
+  }
+
+  while (ordered) {
+    job *j = ordered;
+    conn *c = j->conn;
+    ordered = j->next;
+
+    c->pending--;
+    srt_batch_count(stats, j->result);
+
+    if (c->closed) {
+      if (c->pending == 0) {
+        conn_free(server, c);
+      }
+    } else if (!(j->reply ? buffer_append(&c->out, j->reply, j->reply_len)
+                          : append_error(&c->out, j->number, SRT_UNKNOWN_ERROR,
+                                         "out of memory")) ||
+               !flush(c)) {
+      drop(server, c);
+    } else {
+      update(server, c);
+    }
+
+    job_free(j);
+  }
+}
+
+//
+// the socket
+//
+
+//
+// a socket at `path` that nothing answers on is left from a server that is
+// gone, one that answers belongs to a live server and is kept.
+//
+static bool clear_stale(const char *path, const struct sockaddr_un *addr) {
+  struct stat st;
+
+  if (lstat(path, &st) != 0) {
+    return errno == ENOENT;
+  }
+
+  if (!S_ISSOCK(st.st_mode)) {
+    return false;
+  }
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  const bool live =
+      fd >= 0 &&
+      connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) == 0;
+
+  if (fd >= 0) {
+    close(fd);
+  }
+
+  return !live && unlink(path) == 0;
+}
+
+static int listen_on(const char *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    return -1;
+  }
+
+  strcpy(addr.sun_path, path);
+
+  if (!clear_stale(path, &addr)) {
+    return -1;
+  }
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (fd >= 0 &&
+      (bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+       listen(fd, BACKLOG) != 0 || !nonblocking(fd))) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static bool watch(srt_server *server, int *fd) {
+  struct epoll_event ev = {.events = EPOLLIN, .data.ptr = fd};
+  return epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, *fd, &ev) == 0;
+}
+
+static bool start_workers(srt_server *server, size_t jobs) {
+  if (!(server->workers = calloc(jobs, sizeof(*server->workers)))) {
+    return false;
+  }
+
+  server->jobs = jobs;
+
+  for (size_t i = 0; i < jobs; ++i) {
+    worker *w = &server->workers[i];
+    w->server = server;
+
+    if (!(w->out = open_memstream(&w->buf, &w->len)) ||
+        !(w->ctx = srt_ctx_new_worker(server->ctx, w->out)) ||
+        !(w->started = pthread_create(&w->thread, NULL, work, w) == 0)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+srt_server *srt_server_open(srt_context *ctx, const char *path,
+                            srt_batch_start start, size_t jobs) {
+  srt_server *server = calloc(1, sizeof(*server));
+
+  if (!server) {
+    return NULL;
+  }
+
+  server->ctx = ctx;
+  server->start = start;
+  server->listen_fd = server->wake_fd = server->epoll_fd = -1;
+  atomic_init(&server->stopping, false);
+  pthread_mutex_init(&server->lock, NULL);
+  pthread_cond_init(&server->ready, NULL);
+
+  if (!(server->path = strdup(path)) ||
+      (server->listen_fd = listen_on(path)) < 0 ||
+      (server->wake_fd = eventfd(0, EFD_NONBLOCK)) < 0 ||
+      (server->epoll_fd = epoll_create1(0)) < 0 ||
+      !watch(server, &server->listen_fd) || !watch(server, &server->wake_fd) ||
+      !start_workers(server, jobs < 1 ? 1 : jobs)) {
+    srt_server_close(server);
+    return NULL;
+  }
+
+  return server;
+}
+
+//
+// finished jobs are delivered after the other events of a round, as a reply
+// that cannot be sent frees its connection and that connection may still be
+// further down the list.
+//
+int32_t srt_server_run(srt_server *server, srt_batch_stats *stats) {
+  struct epoll_event events[MAX_EVENTS];
+  const uint64_t start_ns = now_ns();
+  int32_t result = SRT_SUCCESS;
+
+  *stats = (srt_batch_stats){0};
+
+  while (!atomic_load(&server->stopping)) {
+    const int n = epoll_wait(server->epoll_fd, events, MAX_EVENTS, -1);
+    bool woken = false;
+
+    if (n < 0 && errno != EINTR) {
+      result = SRT_IO_ERROR;
+      break;
+    }
+
+    for (int i = 0; i < n; ++i) {
+      void *ptr = events[i].data.ptr;
+
+      if (ptr == &server->listen_fd) {
+        accept_all(server);
+      } else if (ptr == &server->wake_fd) {
+        woken = true;
+      } else {
+        serve(server, ptr, events[i].events);
+      }
+    }
+
+    if (woken) {
+      deliver(server, stats);
+    }
+  }
+
+  stats->ns = now_ns() - start_ns;
+
+  return result;
+}
+
+void srt_server_stop(srt_server *server) {
+  atomic_store(&server->stopping, true);
+  wake(server);
+}
+
+static void free_jobs(job *j) {
+  while (j) {
+    job *next = j->next;
+    job_free(j);
+    j = next;
+  }
+}
+
+void srt_server_close(srt_server *server) {
+  pthread_mutex_lock(&server->lock);
+  server->quit = true;
+  pthread_cond_broadcast(&server->ready);
+  pthread_mutex_unlock(&server->lock);
+
+  for (size_t i = 0; server->workers && i < server->jobs; ++i) {
+    worker *w = &server->workers[i];
+
+    if (w->started) {
+      pthread_join(w->thread, NULL);
+    }
+
+    srt_ctx_free_worker(w->ctx, server->ctx);
+
+    if (w->out) {
+      fclose(w->out);
+    }
+
+    free(w->buf);
+  }
+
+  free_jobs(server->head);
+  free_jobs(server->done);
+
+  while (server->conns) {
+    if (!server->conns->closed) {
+      close(server->conns->fd);
+    }
+
+    conn_free(server, server->conns);
+  }
+
+  if (server->listen_fd >= 0) {
+    close(server->listen_fd);
+    unlink(server->path);
+  }
+
+  if (server->wake_fd >= 0) {
+    close(server->wake_fd);
+  }
+
+  if (server->epoll_fd >= 0) {
+    close(server->epoll_fd);
+  }
+
+  pthread_cond_destroy(&server->ready);
+  pthread_mutex_destroy(&server->lock);
+  free(server->workers);
+  free(server->path);
+  free(server);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "batch.h"
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// a daemon that runs instances for clients on a unix domain socket, so each
+// instance costs a line of json rather than an exec and a fresh context. one
+// thread runs an epoll loop over the listening socket and the connections,
+// and `jobs` workers each keep a warm context, set up like `ctx` the same way
+// as the workers of srt_pool_run, that is reset between instances.
+//
+// a client writes one request per line:
+//
+//   {"n": 1}                          starts an instance with this task data
+//   resume Task_1 {"approved": true}  picks up one suspended at Task_1
+//
+// and reads back what srt_batch_run writes for it, numbered by the line of
+// the request on its connection: its log and manual task output, then its
+// result line. requests run concurrently, so replies on one connection come
+// back in the order they finish, each in one piece. resuming needs a
+// suspendable `ctx`, whose instances reply with the manual task they stopped
+// at instead of completing it. a client that shuts down its side of the
+// connection gets the replies still due before the server closes it. an
+// instance that fails to get or set a var replies with the failure, as in a
+// batch, and its worker goes on with the next request.
+//
+
+typedef struct srt_server srt_server;
+
+//
+// listens on `path`, replacing a socket left there by an earlier server but
+// nothing else. NULL when the socket or the workers cannot be set up.
+//
+srt_server *srt_server_open(srt_context *ctx, const char *path,
+                            srt_batch_start start, size_t jobs);
+
+//
+// serves until srt_server_stop, counting the instances run into `stats`.
+//
+int32_t srt_server_run(srt_server *server, srt_batch_stats *stats);
+
+//
+// safe to call from any thread and from a signal handler.
+//
+void srt_server_stop(srt_server *server);
+
+//
+// waits for the instances that are running, drops the requests not yet
+// started and removes the socket. the profiles of the workers are merged
+// into the one of `ctx`.
+//
+void srt_server_close(srt_server *server);
@@ -0,0 +1,322 @@
+#include "snapshot.h"
+#include "array.h"
+#include "const.h"
+#include "hash.h"
+#include "image.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TOUCHED_CAPACITY 16
+
+static srt_history *history_new(void) {
+  srt_history *history = calloc(1, sizeof(*history));
+
+  if (history && !(history->touched = srt_dict_new(TOUCHED_CAPACITY))) {
+    free(history);
+    return NULL;
+  }
+
+  if (history) {
+    history->stale = true;
+  }
+
+  return history;
+}
+
+void srt_history_free(srt_history *history) {
+  if (!history) {
+    return;
+  }
+
+  srt_hamt_release(history->root);
+  srt_dict_free(history->touched);
+  free(history);
+}
+
+void srt_history_invalidate(srt_history *history) {
+  if (history) {
+    history->stale = true;
+  }
+}
+
+static bool untouch_all(srt_history *history) {
+  if (srt_dict_len(history->touched) == 0) {
+    return true;
+  }
+
+  srt_dict_free(history->touched);
+  history->touched = srt_dict_new(TOUCHED_CAPACITY);
+
+  return history->touched != NULL;
+}
+
+static uint64_t hash_of(const srt_context *ctx, const srt_key *key) {
+  return key->hashed && key->seed == ctx->seed
+             ? key->hash
+             : srt_hash_str(key->str, ctx->seed);
+}
+
+//
+// freezing
+//
+
+static bool freeze(const srt_value *from, uint64_t seed, srt_hamt_value *to);
+
+//
+// a dict is frozen by setting its items one by one into an empty map, the
+// versions in between are dropped as soon as the next one is built.
+//
+static bool freeze_dict(const srt_dict *dict, uint64_t seed, srt_hamt **out) {
+  srt_hamt *root = NULL;
+  size_t pos = 0;
+
+  for (srt_dict_item *item; dict && (item = srt_dict_next(dict, &pos));) {
+    const char *key = srt_dict_item_key(item);
+    srt_hamt_value value;
+    srt_hamt *next;
+
+    if (!freeze(&item->value, seed, &value) ||
+        !srt_hamt_set(root, key, srt_hash_str(key, seed), value, &next)) {
+      srt_hamt_release(root);
+      return false;
+    }
+
+    srt_hamt_release(root);
+    root = next;
+  }
+
+  *out = root;
+
+  return true;
+}
+
+static bool freeze(const srt_value *from, uint64_t seed, srt_hamt_value *to) {
+  to->tag = from->tag;
+
+  switch (from->tag) {
+  case SRT_BOOL:
+    to->b = from->b;
+    return true;
+  case SRT_DICT:
+    return freeze_dict(from->dict, seed, &to->dict);
+  case SRT_INT64:
+    to->int64 = from->int64;
+    return true;
+  case SRT_STR: {
+    const char *str = srt_value_str(from);
+    to->str = str ? strdup(str) : NULL;
+    return !str || to->str;
+  }
+  case SRT_INT64_ARRAY:
+  case SRT_DOUBLE_ARRAY:
+    to->array = srt_array_new(from->array->data, from->array->len, NULL);
+    return to->array != NULL;
+  }
+
+  return false;
+}
+
+static void put(srt_history *history, const char *key, uint64_t hash,
+                const srt_value *value, uint64_t seed) {
+  srt_hamt_value frozen;
+  srt_hamt *next;
+
+  if (!freeze(value, seed, &frozen) ||
+      !srt_hamt_set(history->root, key, hash, frozen, &next)) {
+    history->stale = true;
+    return;
+  }
+
+  srt_hamt_release(history->root);
+  history->root = next;
+}
+
+//
+// keeping up with task data
+//
+
+void srt_history_set(const srt_context *ctx, srt_key *key,
+                     const srt_value *value) {
+  if (ctx->history->stale) {
+    return;
+  }
+
+  if (srt_value_in_place(value)) {
+    srt_history_touch(ctx, key);
+    return;
+  }
+
+  put(ctx->history, key->str, hash_of(ctx, key), value, ctx->seed);
+}
+
+void srt_history_delete(const srt_context *ctx, srt_key *key) {
+  srt_history *history = ctx->history;
+  srt_hamt *next;
+
+  if (history->stale) {
+    return;
+  }
+
+  if (!srt_hamt_delete(history->root, key->str, hash_of(ctx, key), &next)) {
+    history->stale = true;
+    return;
+  }
+
+  srt_hamt_release(history->root);
+  history->root = next;
+}
+
+void srt_history_touch(const srt_context *ctx, srt_key *key) {
+  srt_history *history = ctx->history;
+
+  if (!history->stale &&
+      !srt_dict_put(history->touched, key->str, SRT_VALUE(SRT_BOOL, b, true))) {
+    history->stale = true;
+  }
+}
+
+//
+// the touched keys that still hold dicts or arrays are frozen again, the
+// others were set to something else or deleted since and are up to date.
+//
+static bool catch_up(const srt_context *ctx) {
+  srt_history *history = ctx->history;
+  size_t pos = 0;
+
+  for (srt_dict_item *item;
+       !history->stale && (item = srt_dict_next(history->touched, &pos));) {
+    const char *key = srt_dict_item_key(item);
+    const srt_value *v = srt_dict_peek(ctx->task_data, key);
+
+    if (v && srt_value_in_place(v)) {
+      put(history, key, srt_hash_str(key, ctx->seed), v, ctx->seed);
+    }
+  }
+
+  return untouch_all(history) && !history->stale;
+}
+
+static bool rebuild(const srt_context *ctx) {
+  srt_history *history = ctx->history;
+  srt_hamt *root;
+
+  if ((ctx->image && !srt_image_fault_all(ctx->image, ctx->task_data)) ||
+      !freeze_dict(ctx->task_data, ctx->seed, &root)) {
+    return false;
+  }
+
+  srt_hamt_release(history->root);
+  history->root = root;
+  history->stale = false;
+
+  return untouch_all(history);
+}
+
+srt_snapshot *srt_ctx_snapshot(srt_context *ctx) {
+  if (ctx->overlay || (!ctx->history && !(ctx->history = history_new()))) {
+    return NULL;
+  }
+
+  if (!(!ctx->history->stale && catch_up(ctx)) && !rebuild(ctx)) {
+    ctx->history->stale = true;
+    return NULL;
+  }
+
+  srt_snapshot *snapshot = malloc(sizeof(*snapshot));
+
+  if (snapshot) {
+    snapshot->root = srt_hamt_retain(ctx->history->root);
+    snapshot->seed = ctx->seed;
+  }
+
+  return snapshot;
+}
+
+void srt_snapshot_free(srt_snapshot *snapshot) {
+  if (snapshot) {
+    srt_hamt_release(snapshot->root);
+    free(snapshot);
+  }
+}
+
+//
+// thawing
+//
+
+typedef struct thaw {
+  const srt_context *ctx;
+  srt_dict *dict;
+} thaw;
+
+static bool thaw_item(void *arg, const char *key,
+                      const srt_hamt_value *value);
+
+static srt_dict *thaw_dict(const srt_context *ctx, const srt_hamt *root) {
+  const size_t len = srt_hamt_len(root);
+  srt_dict *dict = srt_ctx_dict_new(ctx, len < 8 ? 16 : len * 2);
+
+  return dict && srt_hamt_each(root, thaw_item, &(thaw){ctx, dict}) ? dict
+                                                                     : NULL;
+}
+
+static bool thaw_item(void *arg, const char *key,
+                      const srt_hamt_value *value) {
+  const thaw *t = arg;
+  srt_value v = {.tag = value->tag};
+
+  switch (value->tag) {
+  case SRT_BOOL:
+    v.b = value->b;
+    break;
+  case SRT_DICT:
+    if (!(v.dict = thaw_dict(t->ctx, value->dict))) {
+      return false;
+    }
+    break;
+  case SRT_INT64:
+    v.int64 = value->int64;
+    break;
+  case SRT_STR:
+    if (value->str && !srt_value_set_str(&v, value->str, strlen(value->str),
+                                         t->ctx->arena)) {
+      return false;
+    }
+    break;
+  case SRT_INT64_ARRAY:
+  case SRT_DOUBLE_ARRAY:
+    if (!(v.array = srt_array_new(value->array->data, value->array->len,
+                                  t->ctx->arena))) {
+      return false;
+    }
+    break;
+  }
+
+  return srt_dict_put(t->dict, key, v);
+}
+
+//
+// the snapshot becomes the current version again when it was taken with the
+// same seed, so its hashes hold for `ctx`.
+//
+int32_t srt_ctx_restore(srt_context *ctx, const srt_snapshot *snapshot) {
+  if (ctx->overlay) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  srt_ctx_reset(ctx);
+
+  if (!srt_hamt_each(snapshot->root, thaw_item,
+                     &(thaw){ctx, ctx->task_data})) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  if (snapshot->seed == ctx->seed &&
+      (ctx->history || (ctx->history = history_new())) &&
+      untouch_all(ctx->history)) {
+    srt_hamt_release(ctx->history->root);
+    ctx->history->root = srt_hamt_retain(snapshot->root);
+    ctx->history->stale = false;
+  }
+
+  return SRT_SUCCESS;
+}
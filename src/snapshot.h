@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ctx.h"
+#include "dict.h"
+#include "hamt.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// snapshots of task data. once a context has taken one it keeps a persistent
+// copy of its task data, a hamt that each set and delete moves to a new
+// version in O(log n), and a snapshot is a reference to the current version.
+// versions share whatever they did not change, so keeping one per element run
+// costs the paths that element wrote.
+//
+// a dict in task data can change through the pointer a get handed out, and
+// an array by an append, so keys whose dicts were set or fetched or whose
+// arrays were set or appended to are only recorded as touched and their
+// values are copied in at the next snapshot. changes through a dict pointer
+// kept from before a snapshot are seen once it is fetched again.
+//
+// task data replaced wholesale, by srt_ctx_reset, a load or a json read,
+// leaves the copy stale, and the next snapshot builds it again from scratch.
+//
+
+typedef struct srt_history {
+  srt_hamt *root;
+  srt_dict *touched;
+  bool stale;
+} srt_history;
+
+typedef struct srt_snapshot {
+  srt_hamt *root;
+  uint64_t seed;
+} srt_snapshot;
+
+void srt_history_free(srt_history *history);
+
+void srt_history_invalidate(srt_history *history);
+
+void srt_history_set(const srt_context *ctx, srt_key *key,
+                     const srt_value *value);
+
+void srt_history_delete(const srt_context *ctx, srt_key *key);
+
+void srt_history_touch(const srt_context *ctx, srt_key *key);
+
+//
+// NULL when out of memory or in the branch of a parallel gateway, whose task
+// data is a partial view of its parent's.
+//
+srt_snapshot *srt_ctx_snapshot(srt_context *ctx);
+
+//
+// replaces the task data of `ctx` with the one `snapshot` was taken of, which
+// may be another context. like srt_ctx_reset it ends the current instance.
+//
+int32_t srt_ctx_restore(srt_context *ctx, const srt_snapshot *snapshot);
+
+void srt_snapshot_free(srt_snapshot *snapshot);
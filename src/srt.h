@@ -1,6 +1,9 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+
+#include "types.h"
 
 /*
  * Constants
@@ -11,6 +14,12 @@ static const uint32_t SRT_SUCCESS = 0;
 static const uint32_t SRT_UNKNOWN_KEY = 1;
 static const uint32_t SRT_KEY_TYPE_MISMATCH = 2;
 static const uint32_t SRT_UNKNOWN_ERROR = 3;
+static const uint32_t SRT_IO_ERROR = 4;
+static const uint32_t SRT_INVALID_IMAGE = 5;
+static const uint32_t SRT_INVALID_JSON = 6;
+static const uint32_t SRT_MERGE_CONFLICT = 7;
+static const uint32_t SRT_INVALID_JOURNAL = 8;
+static const uint32_t SRT_SUSPENDED = 9;
 
 /*
  * Types
@@ -19,8 +28,16 @@ static const uint32_t SRT_UNKNOWN_ERROR = 3;
 
 typedef struct srt_context srt_context;
 typedef struct srt_dict srt_dict;
+typedef struct srt_fixed_dict srt_fixed_dict;
+typedef struct srt_path srt_path;
 typedef struct srt_value srt_value;
 
+//
+// srt_key, in types.h, is a task data key hashed once, for generated code
+// that knows its variable names up front. declare one per name with SRT_KEY
+// and reuse it on every access.
+//
+
 /*
  * Context
  *
@@ -28,10 +45,117 @@ typedef struct srt_value srt_value;
 
 srt_context *srt_ctx_new(bool verbose);
 
+srt_context *srt_ctx_new_seeded(bool verbose, uint64_t seed);
+
 void srt_ctx_free(srt_context *ctx);
 
+void srt_ctx_reset(srt_context *ctx);
+
 bool srt_ctx_verbose(const srt_context *ctx);
 
+//
+// logs diagnostics up to `level` to `out`, through a buffer that is flushed
+// when the context is freed. a verbose context logs everything to stdout.
+// levels above SRT_LOG_MAX_LEVEL, a compile time define, are not built in.
+//
+
+bool srt_ctx_log(srt_context *ctx, srt_log_level level, FILE *out);
+
+//
+// times each element between the life-cycle hooks and writes a summary of
+// counts and latencies per element to `out` when the context is freed.
+//
+
+bool srt_ctx_profile(srt_context *ctx, FILE *out);
+
+//
+// writes life-cycle, task data and manual task events to a binary trace that
+// build/trace_decode turns back into text. a trace is drained to its file by
+// a background thread and can be shared by several contexts, whose events
+// carry an id per context. `capacity` is the number of events buffered before
+// new ones are dropped, a power of two.
+//
+
+typedef struct srt_trace srt_trace;
+
+srt_trace *srt_trace_open(const char *path, size_t capacity);
+
+bool srt_trace_close(srt_trace *trace);
+
+void srt_ctx_trace(srt_context *ctx, srt_trace *trace);
+
+srt_dict *srt_ctx_dict_new(const srt_context *ctx, size_t capacity);
+
+//
+// the memory of an instance: the bytes of its keys, values and dicts, and
+// what the arena handed out, in how many allocations, and at most over the
+// life of the context. snapshots, journals and branches are not counted.
+// report writes them as text, which a profiled context does when it is freed.
+//
+
+void srt_ctx_get_stats(const srt_context *ctx, srt_ctx_stats *stats);
+
+void srt_ctx_report_stats(const srt_context *ctx, FILE *out);
+
+//
+// snapshots of task data, for rollback and audit. the first one copies task
+// data into a persistent map that later sets and deletes update, after that a
+// snapshot costs O(1) plus copying the dicts fetched or set since the last
+// one, and snapshots share everything they have in common. restore replaces
+// the instance like srt_ctx_reset. neither works in a gateway branch.
+//
+
+typedef struct srt_snapshot srt_snapshot;
+
+srt_snapshot *srt_ctx_snapshot(srt_context *ctx);
+
+int32_t srt_ctx_restore(srt_context *ctx, const srt_snapshot *snapshot);
+
+void srt_snapshot_free(srt_snapshot *snapshot);
+
+//
+// journals every task data change to `path`, with a commit per element run,
+// after replaying what an earlier run left there into `ctx`. changes are
+// written once per `group` commits, and SRT_JOURNAL_SYNC_GROUP syncs each
+// write to disk. a commit that cannot be written fails srt_did_run_element
+// with SRT_IO_ERROR.
+//
+
+int32_t srt_ctx_journal(srt_context *ctx, const char *path,
+                        srt_journal_sync sync, size_t group);
+
+//
+// lets instances suspend at manual tasks instead of waiting on them. a
+// suspendable context returns SRT_SUSPENDED from srt_handle_manual_task, and
+// srt_ctx_suspend then takes the continuation of the instance, its task data
+// and the task it stopped at, leaving the context free for other instances.
+// resuming a continuation restores its task data, and the instance started
+// again re-enters at srt_ctx_resume_point, where the manual task completes.
+// generated code that runs an element before asking for its resume point
+// panics there rather than run it again. manual tasks in gateway branches do
+// not suspend.
+//
+
+typedef struct srt_continuation srt_continuation;
+
+bool srt_ctx_suspendable(srt_context *ctx);
+
+srt_continuation *srt_ctx_suspend(srt_context *ctx);
+
+int32_t srt_ctx_resume(srt_context *ctx,
+                       const srt_continuation *continuation);
+
+bool srt_ctx_resume_at(srt_context *ctx, const char *element_id);
+
+const char *srt_ctx_resume_point(const srt_context *ctx);
+
+const char *srt_continuation_element(const srt_continuation *continuation);
+
+const char *
+srt_continuation_instructions(const srt_continuation *continuation);
+
+void srt_continuation_free(srt_continuation *continuation);
+
 /*
  * Value
  *
@@ -46,6 +170,13 @@ void srt_value_free(srt_value *value);
 
 void srt_value_print(srt_value *value);
 
+//
+// strs of fewer than 16 bytes are stored in the value itself, so a value's
+// str is read through this rather than its str member.
+//
+
+const char *srt_value_str(const srt_value *value);
+
 /*
  * Dict
  *
@@ -56,16 +187,90 @@ srt_dict *srt_dict_new(size_t capacity);
 srt_dict *srt_dict_new_with_kvs(const size_t kv_count, const char *key1,
                                 srt_value *value1, ...);
 
+//
+// a dict from srt_dict_new is reference counted and owns the dicts among its
+// values: setting one hands it the reference of the caller, and it is dropped
+// when the value is replaced or deleted or the dict goes. free drops a
+// reference, share hands out another one.
+//
+
 void srt_dict_free(srt_dict *dict);
 
-srt_value *srt_dict_get(const srt_dict *dict, const char *key);
+srt_dict *srt_dict_share(srt_dict *dict);
+
+srt_value *srt_dict_get(srt_dict *dict, const char *key);
 
 bool srt_dict_set(srt_dict *dict, const char *key, srt_value *value);
 
 bool srt_dict_delete(srt_dict *dict, const char *key);
 
+//
+// removes an item and hands its value to the caller instead of dropping it.
+//
+
+bool srt_dict_take(srt_dict *dict, const char *key, srt_value *value);
+
+//
+// takes `key`, from malloc, rather than copying it. it is freed whenever it
+// is not kept, also when the set fails.
+//
+
+bool srt_dict_set_take(srt_dict *dict, char *key, srt_value *value);
+
 size_t srt_dict_len(const srt_dict *dict);
 
+//
+// how full a dict is and how many groups of slots lookups scan, 1 for an item
+// in its home group. bucket i of the histogram counts items reached after
+// i + 1 groups, the last bucket also those further out.
+//
+
+void srt_dict_get_stats(const srt_dict *dict, srt_dict_stats *stats);
+
+void srt_key_init(srt_key *key, const char *str);
+
+srt_value *srt_dict_get_k(srt_dict *dict, srt_key *key);
+
+bool srt_dict_set_k(srt_dict *dict, srt_key *key, srt_value *value);
+
+bool srt_dict_delete_k(srt_dict *dict, srt_key *key);
+
+//
+// a dict for records whose keys are known up front, with a perfect hash of
+// the keys computed once when it is built. a lookup is a single probe and the
+// dict a single allocation. values can be put under the keys it was built
+// with, others are not found. NULL for no keys or a duplicate key.
+//
+
+srt_fixed_dict *srt_fixed_dict_new(const char *const *keys, size_t len);
+
+srt_fixed_dict *srt_fixed_dict_new_with_kvs(const size_t kv_count,
+                                            const char *key1,
+                                            srt_value *value1, ...);
+
+void srt_fixed_dict_free(srt_fixed_dict *dict);
+
+srt_value *srt_fixed_dict_get(srt_fixed_dict *dict, const char *key);
+
+srt_value *srt_fixed_dict_get_k(srt_fixed_dict *dict, srt_key *key);
+
+bool srt_fixed_dict_set(srt_fixed_dict *dict, const char *key,
+                        srt_value *value);
+
+size_t srt_fixed_dict_len(const srt_fixed_dict *dict);
+
+//
+// a dotted path into nested dicts, like "order.customer.id", hashed once per
+// segment. keep one per path and reuse it, repeat walks skip the probes.
+// NULL for an empty path or one with an empty segment.
+//
+
+srt_path *srt_path_compile(const char *str);
+
+void srt_path_free(srt_path *path);
+
+srt_value *srt_dict_get_path(srt_dict *dict, srt_path *path);
+
 /*
  * Life Cyle
  *
@@ -85,6 +290,24 @@ int32_t srt_did_run_element(const srt_context *ctx, const char *process_id,
 int32_t srt_handle_manual_task(const srt_context *ctx, const char *element_id,
                                const char *instructions);
 
+/*
+ * Parallel Gateways
+ *
+ */
+
+//
+// runs each branch on a thread of its own, with a copy on write view of the
+// task data of `ctx`. when all branches return 0 their writes are merged back
+// in branch order. keys left with different values by several branches are a
+// conflict, resolved by `policy` or failed with SRT_MERGE_CONFLICT. otherwise
+// the result of the first failing branch is returned and nothing is merged.
+//
+
+typedef int32_t (*srt_branch)(srt_context *ctx);
+
+int32_t srt_run_parallel(const srt_context *ctx, const srt_branch *branches,
+                         size_t n, srt_merge_policy policy);
+
 /*
  * Task Data
  *
@@ -114,6 +337,209 @@ int32_t srt_task_data_try_set_int64(const srt_context *ctx, const char *key,
 
 int32_t srt_task_data_try_delete(const srt_context *ctx, const char *key);
 
+//
+// strs. a str got from task data is only valid until the next call on the
+// context. set copies `value`, set_take takes a str from malloc and frees it
+// when the var is set again or deleted or the instance ends, or straight away
+// if it is short enough to be copied into the value. NULL is a str value too,
+// the null of json.
+//
+
+int32_t srt_task_data_try_get_str(const srt_context *ctx, const char *key,
+                                  const char **value);
+
+int32_t srt_task_data_try_set_str(const srt_context *ctx, const char *key,
+                                  const char *value);
+
+int32_t srt_task_data_try_set_str_take(const srt_context *ctx,
+                                       const char *key, char *value);
+
+const char *srt_task_data_get_str(const srt_context *ctx, const char *key);
+
+void srt_task_data_set_str(const srt_context *ctx, const char *key,
+                           const char *value);
+
+void srt_task_data_set_str_take(const srt_context *ctx, const char *key,
+                                char *value);
+
+int32_t srt_task_data_try_get_str_k(const srt_context *ctx, srt_key *key,
+                                    const char **value);
+
+int32_t srt_task_data_try_set_str_k(const srt_context *ctx, srt_key *key,
+                                    const char *value);
+
+int32_t srt_task_data_try_set_str_take_k(const srt_context *ctx,
+                                         srt_key *key, char *value);
+
+const char *srt_task_data_get_str_k(const srt_context *ctx, srt_key *key);
+
+void srt_task_data_set_str_k(const srt_context *ctx, srt_key *key,
+                             const char *value);
+
+void srt_task_data_set_str_take_k(const srt_context *ctx, srt_key *key,
+                                  char *value);
+
+//
+// a dict set in task data is owned by it from then on, get only lends it out.
+// take removes the var and hands the dict over to the caller, share hands
+// out a reference and leaves the var as it is, and either is given back with
+// srt_dict_free. move makes the value of one var the value of another in
+// O(1), however large the dict. a dict from srt_ctx_dict_new is not counted
+// and lasts until the instance ends, whoever has it.
+//
+
+int32_t srt_task_data_try_take_dict(const srt_context *ctx, const char *key,
+                                    srt_dict **value);
+
+int32_t srt_task_data_try_share_dict(const srt_context *ctx, const char *key,
+                                     srt_dict **value);
+
+int32_t srt_task_data_try_move(const srt_context *ctx, const char *from,
+                               const char *to);
+
+srt_dict *srt_task_data_take_dict(const srt_context *ctx, const char *key);
+
+srt_dict *srt_task_data_share_dict(const srt_context *ctx, const char *key);
+
+void srt_task_data_move(const srt_context *ctx, const char *from,
+                        const char *to);
+
+int32_t srt_task_data_try_take_dict_k(const srt_context *ctx, srt_key *key,
+                                      srt_dict **value);
+
+int32_t srt_task_data_try_share_dict_k(const srt_context *ctx, srt_key *key,
+                                       srt_dict **value);
+
+int32_t srt_task_data_try_move_k(const srt_context *ctx, srt_key *from,
+                                 srt_key *to);
+
+srt_dict *srt_task_data_take_dict_k(const srt_context *ctx, srt_key *key);
+
+srt_dict *srt_task_data_share_dict_k(const srt_context *ctx, srt_key *key);
+
+void srt_task_data_move_k(const srt_context *ctx, srt_key *from,
+                          srt_key *to);
+
+//
+// int64 and double arrays hold their elements side by side, so a line item
+// list is walked without a lookup per element. the elements got are only
+// valid until the next call on the context. set copies `values`, append adds
+// one element in amortized O(1) and starts an array when the var is not set.
+//
+
+int32_t srt_task_data_try_get_int64_array_k(const srt_context *ctx,
+                                            srt_key *key,
+                                            const int64_t **values,
+                                            size_t *len);
+
+int32_t srt_task_data_try_get_int64_array(const srt_context *ctx,
+                                          const char *key,
+                                          const int64_t **values,
+                                          size_t *len);
+
+const int64_t *srt_task_data_get_int64_array_k(const srt_context *ctx,
+                                               srt_key *key, size_t *len);
+
+const int64_t *srt_task_data_get_int64_array(const srt_context *ctx,
+                                             const char *key, size_t *len);
+
+int32_t srt_task_data_try_set_int64_array_k(const srt_context *ctx,
+                                            srt_key *key,
+                                            const int64_t *values,
+                                            size_t len);
+
+int32_t srt_task_data_try_set_int64_array(const srt_context *ctx,
+                                          const char *key,
+                                          const int64_t *values, size_t len);
+
+void srt_task_data_set_int64_array_k(const srt_context *ctx, srt_key *key,
+                                     const int64_t *values, size_t len);
+
+void srt_task_data_set_int64_array(const srt_context *ctx, const char *key,
+                                   const int64_t *values, size_t len);
+
+int32_t srt_task_data_try_append_int64_k(const srt_context *ctx,
+                                         srt_key *key, int64_t value);
+
+int32_t srt_task_data_try_append_int64(const srt_context *ctx,
+                                       const char *key, int64_t value);
+
+void srt_task_data_append_int64_k(const srt_context *ctx, srt_key *key,
+                                  int64_t value);
+
+void srt_task_data_append_int64(const srt_context *ctx, const char *key,
+                                int64_t value);
+
+int32_t srt_task_data_try_get_double_array_k(const srt_context *ctx,
+                                             srt_key *key,
+                                             const double **values,
+                                             size_t *len);
+
+int32_t srt_task_data_try_get_double_array(const srt_context *ctx,
+                                           const char *key,
+                                           const double **values,
+                                           size_t *len);
+
+const double *srt_task_data_get_double_array_k(const srt_context *ctx,
+                                               srt_key *key, size_t *len);
+
+const double *srt_task_data_get_double_array(const srt_context *ctx,
+                                             const char *key, size_t *len);
+
+int32_t srt_task_data_try_set_double_array_k(const srt_context *ctx,
+                                             srt_key *key,
+                                             const double *values,
+                                             size_t len);
+
+int32_t srt_task_data_try_set_double_array(const srt_context *ctx,
+                                           const char *key,
+                                           const double *values, size_t len);
+
+void srt_task_data_set_double_array_k(const srt_context *ctx, srt_key *key,
+                                      const double *values, size_t len);
+
+void srt_task_data_set_double_array(const srt_context *ctx, const char *key,
+                                    const double *values, size_t len);
+
+int32_t srt_task_data_try_append_double_k(const srt_context *ctx,
+                                          srt_key *key, double value);
+
+int32_t srt_task_data_try_append_double(const srt_context *ctx,
+                                        const char *key, double value);
+
+void srt_task_data_append_double_k(const srt_context *ctx, srt_key *key,
+                                   double value);
+
+void srt_task_data_append_double(const srt_context *ctx, const char *key,
+                                 double value);
+
+//
+// aggregates over the elements of an array, vectorized where the build
+// allows. int64 sums wrap around on overflow and double sums are added up in
+// lanes, so their last bits may differ from those of a sum taken in order.
+// NaNs are skipped by min and max and compare false by every comparison but
+// SRT_CMP_NE. the min and max of no elements are the largest and smallest
+// values of the type, the infinities for doubles.
+//
+
+int64_t srt_int64_array_sum(const int64_t *values, size_t len);
+
+int64_t srt_int64_array_min(const int64_t *values, size_t len);
+
+int64_t srt_int64_array_max(const int64_t *values, size_t len);
+
+size_t srt_int64_array_count_if(const int64_t *values, size_t len, srt_cmp cmp,
+                                int64_t operand);
+
+double srt_double_array_sum(const double *values, size_t len);
+
+double srt_double_array_min(const double *values, size_t len);
+
+double srt_double_array_max(const double *values, size_t len);
+
+size_t srt_double_array_count_if(const double *values, size_t len,
+                                 srt_cmp cmp, double operand);
+
 //
 // these flavors attempt the operation and panic if unsuccessful.
 //
@@ -134,3 +560,95 @@ void srt_task_data_set_int64(const srt_context *ctx, const char *key,
                              int64_t value);
 
 void srt_task_data_delete(const srt_context *ctx, const char *key);
+
+//
+// these flavors take a key handle instead of a string.
+//
+
+int32_t srt_task_data_try_get_bool_k(const srt_context *ctx, srt_key *key,
+                                     bool *value);
+
+int32_t srt_task_data_try_set_bool_k(const srt_context *ctx, srt_key *key,
+                                     bool value);
+
+int32_t srt_task_data_try_get_dict_k(const srt_context *ctx, srt_key *key,
+                                     srt_dict **value);
+
+int32_t srt_task_data_try_set_dict_k(const srt_context *ctx, srt_key *key,
+                                     srt_dict *value);
+
+int32_t srt_task_data_try_get_int64_k(const srt_context *ctx, srt_key *key,
+                                      int64_t *value);
+
+int32_t srt_task_data_try_set_int64_k(const srt_context *ctx, srt_key *key,
+                                      int64_t value);
+
+int32_t srt_task_data_try_delete_k(const srt_context *ctx, srt_key *key);
+
+bool srt_task_data_get_bool_k(const srt_context *ctx, srt_key *key);
+
+void srt_task_data_set_bool_k(const srt_context *ctx, srt_key *key,
+                              bool value);
+
+srt_dict *srt_task_data_get_dict_k(const srt_context *ctx, srt_key *key);
+
+void srt_task_data_set_dict_k(const srt_context *ctx, srt_key *key,
+                              srt_dict *value);
+
+int64_t srt_task_data_get_int64_k(const srt_context *ctx, srt_key *key);
+
+void srt_task_data_set_int64_k(const srt_context *ctx, srt_key *key,
+                               int64_t value);
+
+void srt_task_data_delete_k(const srt_context *ctx, srt_key *key);
+
+//
+// these flavors read a value nested in the dicts of task data.
+//
+
+int32_t srt_task_data_try_get_bool_path(const srt_context *ctx,
+                                        srt_path *path, bool *value);
+
+int32_t srt_task_data_try_get_dict_path(const srt_context *ctx,
+                                        srt_path *path, srt_dict **value);
+
+int32_t srt_task_data_try_get_int64_path(const srt_context *ctx,
+                                         srt_path *path, int64_t *value);
+
+int32_t srt_task_data_try_get_str_path(const srt_context *ctx,
+                                       srt_path *path, const char **value);
+
+bool srt_task_data_get_bool_path(const srt_context *ctx, srt_path *path);
+
+srt_dict *srt_task_data_get_dict_path(const srt_context *ctx,
+                                      srt_path *path);
+
+int64_t srt_task_data_get_int64_path(const srt_context *ctx,
+                                     srt_path *path);
+
+const char *srt_task_data_get_str_path(const srt_context *ctx,
+                                       srt_path *path);
+
+//
+// these save task data to a binary image and load it back. load replaces the
+// instance like srt_ctx_reset and maps the image instead of reading it, so it
+// takes the same time whatever the size of the task data. values are copied
+// out of the image as they are first accessed.
+//
+
+int32_t srt_task_data_save(const srt_context *ctx, const char *path);
+
+int32_t srt_task_data_load(srt_context *ctx, const char *path);
+
+//
+// these read task data from a json object and write it back out as one. the
+// reader streams, values are set as they are parsed. objects map to dicts,
+// integers to int64 and null to a NULL str. arrays of numbers map to int64
+// arrays, or to double arrays when an element has a fraction or an exponent.
+// other arrays and fractional numbers outside one are rejected with
+// SRT_INVALID_JSON.
+//
+
+int32_t srt_task_data_read_json(const srt_context *ctx, FILE *in);
+
+int32_t srt_task_data_write_json(const srt_context *ctx, FILE *out);
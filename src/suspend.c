@@ -0,0 +1,148 @@
+#include "suspend.h"
+#include "const.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool srt_ctx_suspendable(srt_context *ctx) {
+  if (!ctx->suspension) {
+    ctx->suspension = calloc(1, sizeof(*ctx->suspension));
+  }
+
+  return ctx->suspension != NULL;
+}
+
+static void clear(char **str) {
+  free(*str);
+  *str = NULL;
+}
+
+void srt_suspension_free(srt_suspension *suspension) {
+  srt_suspension_reset(suspension);
+  free(suspension);
+}
+
+void srt_suspension_reset(srt_suspension *suspension) {
+  if (!suspension) {
+    return;
+  }
+
+  clear(&suspension->element_id);
+  clear(&suspension->instructions);
+  clear(&suspension->resume_at);
+  suspension->asked = false;
+  suspension->suspended = false;
+}
+
+static char *copy(const char *str) {
+  return str ? strdup(str) : NULL;
+}
+
+//
+// a task that cannot be noted still suspends, its continuation is what fails
+// for want of memory.
+//
+int32_t srt_suspension_reach(const srt_context *ctx, const char *element_id,
+                             const char *instructions) {
+  srt_suspension *suspension = ctx->suspension;
+
+  if (suspension->resume_at && strcmp(suspension->resume_at, element_id) == 0) {
+    clear(&suspension->resume_at);
+    return SRT_SUCCESS;
+  }
+
+  clear(&suspension->element_id);
+  clear(&suspension->instructions);
+  suspension->element_id = copy(element_id);
+  suspension->instructions = copy(instructions);
+  suspension->suspended = true;
+
+  return SRT_SUSPENDED;
+}
+
+void srt_suspension_enter(const srt_context *ctx, const char *element_id) {
+  const srt_suspension *suspension = ctx->suspension;
+
+  if (suspension && suspension->resume_at && !suspension->asked) {
+    srt_ctx_panic(ctx, SRT_UNKNOWN_ERROR, __func__,
+                  "resumed instance did not ask for its resume point before",
+                  element_id);
+  }
+}
+
+srt_continuation *srt_ctx_suspend(srt_context *ctx) {
+  srt_suspension *suspension = ctx->suspension;
+
+  if (!suspension || !suspension->suspended || !suspension->element_id) {
+    return NULL;
+  }
+
+  srt_continuation *continuation = malloc(sizeof(*continuation));
+
+  if (!continuation) {
+    return NULL;
+  }
+
+  if (!(continuation->task_data = srt_ctx_snapshot(ctx))) {
+    free(continuation);
+    return NULL;
+  }
+
+  continuation->element_id = suspension->element_id;
+  continuation->instructions = suspension->instructions;
+  suspension->element_id = NULL;
+  suspension->instructions = NULL;
+  suspension->suspended = false;
+
+  return continuation;
+}
+
+int32_t srt_ctx_resume(srt_context *ctx,
+                       const srt_continuation *continuation) {
+  const int32_t result = srt_ctx_restore(ctx, continuation->task_data);
+
+  if (result != SRT_SUCCESS) {
+    return result;
+  }
+
+  return srt_ctx_resume_at(ctx, continuation->element_id) ? SRT_SUCCESS
+                                                          : SRT_UNKNOWN_ERROR;
+}
+
+bool srt_ctx_resume_at(srt_context *ctx, const char *element_id) {
+  if (!srt_ctx_suspendable(ctx)) {
+    return false;
+  }
+
+  clear(&ctx->suspension->resume_at);
+  ctx->suspension->asked = false;
+
+  return (ctx->suspension->resume_at = strdup(element_id)) != NULL;
+}
+
+const char *srt_ctx_resume_point(const srt_context *ctx) {
+  if (!ctx->suspension) {
+    return NULL;
+  }
+
+  ctx->suspension->asked = true;
+
+  return ctx->suspension->resume_at;
+}
+
+const char *srt_continuation_element(const srt_continuation *continuation) {
+  return continuation->element_id;
+}
+
+const char *
+srt_continuation_instructions(const srt_continuation *continuation) {
+  return continuation->instructions;
+}
+
+void srt_continuation_free(srt_continuation *continuation) {
+  if (continuation) {
+    srt_snapshot_free(continuation->task_data);
+    free(continuation->element_id);
+    free(continuation->instructions);
+    free(continuation);
+  }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "ctx.h"
+#include "snapshot.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+//
+// suspendable instances, so a manual task does not hold a thread while it
+// waits on a person. in a suspendable context srt_handle_manual_task notes
+// the task and returns SRT_SUSPENDED, which generated code passes back up
+// like any other failure. whoever started the instance then takes its
+// continuation, a snapshot of task data and the element it stopped at, and
+// the context is free for the next instance.
+//
+// when the response arrives the continuation is resumed into any context,
+// the response is set in task data and the instance is started again.
+// generated code re-enters at srt_ctx_resume_point, and the manual task there
+// completes instead of suspending a second time. a waiting instance costs its
+// task data, shared with other snapshots of it, and two strings.
+//
+// resuming needs generated code that asks for its resume point before it runs
+// an element. code that does not would run the elements before the manual
+// task a second time, so a resumed instance that enters an element without
+// having asked panics there instead, see srt_suspension_enter.
+//
+
+typedef struct srt_suspension {
+  char *element_id;
+  char *instructions;
+  char *resume_at;
+  bool asked;
+  bool suspended;
+} srt_suspension;
+
+typedef struct srt_continuation {
+  srt_snapshot *task_data;
+  char *element_id;
+  char *instructions;
+} srt_continuation;
+
+bool srt_ctx_suspendable(srt_context *ctx);
+
+void srt_suspension_free(srt_suspension *suspension);
+
+void srt_suspension_reset(srt_suspension *suspension);
+
+//
+// SRT_SUCCESS when the instance is resuming at `element_id`, otherwise
+// SRT_SUSPENDED with the task noted for srt_ctx_suspend.
+//
+int32_t srt_suspension_reach(const srt_context *ctx, const char *element_id,
+                             const char *instructions);
+
+//
+// called as an element is entered, panics when the instance was resumed and
+// has not asked for its resume point.
+//
+void srt_suspension_enter(const srt_context *ctx, const char *element_id);
+
+//
+// the continuation of an instance that returned SRT_SUSPENDED, NULL when it
+// did not or when out of memory.
+//
+srt_continuation *srt_ctx_suspend(srt_context *ctx);
+
+//
+// restores the task data of `continuation` into `ctx` and sets its resume
+// point. like srt_ctx_reset it ends the current instance.
+//
+int32_t srt_ctx_resume(srt_context *ctx,
+                       const srt_continuation *continuation);
+
+//
+// sets the resume point alone, for task data restored some other way such
+// as a json read.
+//
+bool srt_ctx_resume_at(srt_context *ctx, const char *element_id);
+
+//
+// the element a resumed instance re-enters at, NULL for one started afresh
+// and once the manual task there has completed.
+//
+const char *srt_ctx_resume_point(const srt_context *ctx);
+
+const char *srt_continuation_element(const srt_continuation *continuation);
+
+const char *
+srt_continuation_instructions(const srt_continuation *continuation);
+
+void srt_continuation_free(srt_continuation *continuation);
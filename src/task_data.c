@@ -1,78 +1,147 @@
+#include "arena.h"
+#include "array.h"
 #include "const.h"
 #include "ctx.h"
 #include "dict.h"
+#include "image.h"
+#include "journal.h"
+#include "json.h"
+#include "log.h"
+#include "overlay.h"
+#include "path.h"
+#include "snapshot.h"
+#include "task_data.h"
+#include "trace.h"
 #include "value.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define PANIC_UNLESS(a, e, s)                                                  \
+#define PANIC_UNLESS(a, e, s, k)                                               \
   if ((a) != (e)) {                                                            \
-    fprintf(stderr, "Panic in %s: " s " '%s'\n", __func__, key);               \
-    exit(a);                                                                   \
+    srt_ctx_panic(ctx, a, __func__, s, k);                                     \
   }
 
-#define GET_PANIC_UNLESS(a)                                                    \
-  PANIC_UNLESS(a, SRT_SUCCESS, "failed to get task data var")
+#define GET_PANIC_UNLESS(a, k)                                                 \
+  PANIC_UNLESS(a, SRT_SUCCESS, "failed to get task data var", k)
 
-#define SET_PANIC_UNLESS(a)                                                    \
-  PANIC_UNLESS(a, SRT_SUCCESS, "failed to set task data var")
+#define SET_PANIC_UNLESS(a, k)                                                 \
+  PANIC_UNLESS(a, SRT_SUCCESS, "failed to set task data var", k)
 
-#define LOG_K(m, k)                                                            \
-  if (ctx->verbose) {                                                          \
-    printf(m " '%s'\n", k);                                                    \
+#define LOG_K(l, m, k) SRT_LOG(ctx, l, m " '%s'\n", k)
+
+#define TRACE(t, k, v, r)                                                      \
+  if (ctx->trace) {                                                            \
+    srt_trace_event(ctx->trace, ctx->trace_id, t, k, NULL, v, r);              \
+  }
+
+#define LOG_KV(l, m, k, v)                                                     \
+  if (SRT_LOG_ENABLED(ctx, l)) {                                               \
+    srt_log_printf(ctx->log, m " '%s: ", k);                                   \
+    srt_log_value(ctx->log, v);                                                \
+    srt_log_printf(ctx->log, "'\n");                                           \
+  }
+
+//
+// key handles may be shared by branches running on other threads, so in a
+// branch the lookup goes through a private copy rather than updating the
+// cache of the handle.
+//
+#define BRANCH_KEY(key)                                                        \
+  srt_key branch_key;                                                          \
+  if (ctx->overlay) {                                                          \
+    srt_key_init(&branch_key, key->str);                                       \
+    key = &branch_key;                                                         \
+  }
+
+//
+// the value of `key` in task data, faulted in from the image or the parent
+// branch when it is not there yet.
+//
+static srt_value *find_value(const srt_context *ctx, srt_key *key) {
+  srt_value *v = srt_dict_get_k(ctx->task_data, key);
+
+  if (!v && ctx->image) {
+    v = srt_image_fault(ctx->image, ctx->task_data, key);
   }
 
-#define LOG_KV(m, k, v)                                                        \
-  if (ctx->verbose) {                                                          \
-    printf(m " '%s: ", k);                                                     \
-    srt_value_print(v);                                                        \
-    printf("'\n");                                                             \
+  if (!v && ctx->overlay) {
+    v = srt_overlay_fault(ctx, key);
   }
 
-static int32_t try_get_value(const srt_context *ctx, const char *key,
+  return v;
+}
+
+static int32_t try_get_value(const srt_context *ctx, srt_key *key,
                              srt_value_tag tag, srt_value **value) {
-  LOG_K("will get task_data var", key);
+  BRANCH_KEY(key);
+  LOG_K(SRT_LOG_DEBUG, "will get task_data var", key->str);
 
-  srt_value *v = srt_dict_get(ctx->task_data, key);
+  srt_value *v = find_value(ctx, key);
 
   if (!v) {
-    LOG_K("unknown task_data var", key);
+    LOG_K(SRT_LOG_DEBUG, "unknown task_data var", key->str);
+    TRACE(SRT_TRACE_GET, key->str, NULL, SRT_UNKNOWN_KEY);
 
     return SRT_UNKNOWN_KEY;
   }
 
   if (v->tag != tag) {
-    LOG_K("type mismatch for task_data var", key);
+    LOG_K(SRT_LOG_WARN, "type mismatch for task_data var", key->str);
+    TRACE(SRT_TRACE_GET, key->str, v, SRT_KEY_TYPE_MISMATCH);
 
     return SRT_KEY_TYPE_MISMATCH;
   }
 
+  if (ctx->history && tag == SRT_DICT) {
+    srt_history_touch(ctx, key);
+  }
+
+  if (ctx->journal && tag == SRT_DICT) {
+    srt_journal_touch(ctx, key);
+  }
+
   *value = v;
 
-  LOG_KV("did get task_data var", key, v);
+  LOG_KV(SRT_LOG_DEBUG, "did get task_data var", key->str, v);
+  TRACE(SRT_TRACE_GET, key->str, v, SRT_SUCCESS);
 
   return SRT_SUCCESS;
 }
 
-static int32_t try_set_value(const srt_context *ctx, const char *key,
-                             srt_value *value) {
+static int32_t try_set_value(const srt_context *ctx, srt_key *key,
+                             const srt_value *value) {
+  BRANCH_KEY(key);
 
-  LOG_KV("will set task_data var", key, value);
+  LOG_KV(SRT_LOG_DEBUG, "will set task_data var", key->str, value);
 
-  if (value && srt_dict_set(ctx->task_data, key, value)) {
-    LOG_KV("did set task_data var", key, value);
+  if (srt_dict_put_k(ctx->task_data, key, *value)) {
+    if (ctx->image) {
+      srt_image_shadow(ctx->image, key);
+    }
 
-    return SRT_SUCCESS;
-  }
+    if (ctx->overlay) {
+      srt_overlay_set(ctx, key);
+    }
 
-  LOG_KV("failed to set task_data var", key, value);
+    if (ctx->history) {
+      srt_history_set(ctx, key, value);
+    }
 
-  if (value) {
-    srt_value_free(value);
+    if (ctx->journal) {
+      srt_journal_set(ctx, key, value);
+    }
+
+    LOG_KV(SRT_LOG_DEBUG, "did set task_data var", key->str, value);
+    TRACE(SRT_TRACE_SET, key->str, value, SRT_SUCCESS);
+
+    return SRT_SUCCESS;
   }
 
+  LOG_KV(SRT_LOG_ERROR, "failed to set task_data var", key->str, value);
+  TRACE(SRT_TRACE_SET, key->str, value, SRT_UNKNOWN_ERROR);
+
   return SRT_UNKNOWN_ERROR;
 }
 
@@ -80,8 +149,8 @@ static int32_t try_set_value(const srt_context *ctx, const char *key,
 // bool
 //
 
-int32_t srt_task_data_try_get_bool(const srt_context *ctx, const char *key,
-                                   bool *value) {
+int32_t srt_task_data_try_get_bool_k(const srt_context *ctx, srt_key *key,
+                                     bool *value) {
   srt_value *v;
   const uint32_t result = try_get_value(ctx, key, SRT_BOOL, &v);
 
@@ -92,31 +161,70 @@ int32_t srt_task_data_try_get_bool(const srt_context *ctx, const char *key,
   return result;
 }
 
-bool srt_task_data_get_bool(const srt_context *ctx, const char *key) {
+int32_t srt_task_data_try_get_bool(const srt_context *ctx, const char *key,
+                                   bool *value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_get_bool_k(ctx, &k, value);
+}
+
+bool srt_task_data_get_bool_k(const srt_context *ctx, srt_key *key) {
   bool value;
-  const int32_t result = srt_task_data_try_get_bool(ctx, key, &value);
+  const int32_t result = srt_task_data_try_get_bool_k(ctx, key, &value);
 
-  GET_PANIC_UNLESS(result);
+  GET_PANIC_UNLESS(result, key->str);
 
   return value;
 }
 
+bool srt_task_data_get_bool(const srt_context *ctx, const char *key) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_get_bool_k(ctx, &k);
+}
+
+int32_t srt_task_data_try_set_bool_k(const srt_context *ctx, srt_key *key,
+                                     bool value) {
+  return try_set_value(ctx, key, &SRT_VALUE(SRT_BOOL, b, value));
+}
+
 int32_t srt_task_data_try_set_bool(const srt_context *ctx, const char *key,
                                    bool value) {
-  return try_set_value(ctx, key, srt_value_new(value));
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_set_bool_k(ctx, &k, value);
+}
+
+void srt_task_data_set_bool_k(const srt_context *ctx, srt_key *key,
+                              bool value) {
+  SET_PANIC_UNLESS(srt_task_data_try_set_bool_k(ctx, key, value), key->str);
 }
 
 void srt_task_data_set_bool(const srt_context *ctx, const char *key,
                             bool value) {
-  SET_PANIC_UNLESS(srt_task_data_try_set_bool(ctx, key, value));
+  srt_key k;
+  srt_key_init(&k, key);
+
+  srt_task_data_set_bool_k(ctx, &k, value);
 }
 
 //
 // dict
 //
+// get lends out the dict of a var, which stays owned by task data. set hands
+// task data the reference of the caller to a dict from srt_dict_new, dropped
+// when the var is set to something else, deleted or the instance ends. take
+// removes the var and hands its reference to the caller, share hands out a
+// further one and leaves the var as it is. a dict from the arena of the
+// context is not counted, and whoever takes or shares it can only use it until
+// the instance ends.
+//
 
-int32_t srt_task_data_try_get_dict(const srt_context *ctx, const char *key,
-                                   srt_dict **value) {
+int32_t srt_task_data_try_get_dict_k(const srt_context *ctx, srt_key *key,
+                                     srt_dict **value) {
   srt_value *v;
   const uint32_t result = try_get_value(ctx, key, SRT_DICT, &v);
 
@@ -127,31 +235,139 @@ int32_t srt_task_data_try_get_dict(const srt_context *ctx, const char *key,
   return result;
 }
 
-srt_dict *srt_task_data_get_dict(const srt_context *ctx, const char *key) {
+int32_t srt_task_data_try_get_dict(const srt_context *ctx, const char *key,
+                                   srt_dict **value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_get_dict_k(ctx, &k, value);
+}
+
+srt_dict *srt_task_data_get_dict_k(const srt_context *ctx, srt_key *key) {
   srt_dict *value;
-  const int32_t result = srt_task_data_try_get_dict(ctx, key, &value);
+  const int32_t result = srt_task_data_try_get_dict_k(ctx, key, &value);
 
-  GET_PANIC_UNLESS(result);
+  GET_PANIC_UNLESS(result, key->str);
 
   return value;
 }
 
+srt_dict *srt_task_data_get_dict(const srt_context *ctx, const char *key) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_get_dict_k(ctx, &k);
+}
+
+int32_t srt_task_data_try_set_dict_k(const srt_context *ctx, srt_key *key,
+                                     srt_dict *value) {
+  return try_set_value(ctx, key, &SRT_VALUE(SRT_DICT, dict, value));
+}
+
 int32_t srt_task_data_try_set_dict(const srt_context *ctx, const char *key,
                                    srt_dict *value) {
-  return try_set_value(ctx, key, srt_value_new(value));
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_set_dict_k(ctx, &k, value);
+}
+
+void srt_task_data_set_dict_k(const srt_context *ctx, srt_key *key,
+                              srt_dict *value) {
+  SET_PANIC_UNLESS(srt_task_data_try_set_dict_k(ctx, key, value), key->str);
 }
 
 void srt_task_data_set_dict(const srt_context *ctx, const char *key,
                             srt_dict *value) {
-  SET_PANIC_UNLESS(srt_task_data_try_set_dict(ctx, key, value));
+  srt_key k;
+  srt_key_init(&k, key);
+
+  srt_task_data_set_dict_k(ctx, &k, value);
+}
+
+static int32_t try_delete_value(const srt_context *ctx, srt_key *key,
+                                srt_value *taken);
+
+int32_t srt_task_data_try_take_dict_k(const srt_context *ctx, srt_key *key,
+                                      srt_dict **value) {
+  srt_value *v;
+  srt_value taken;
+  int32_t result = try_get_value(ctx, key, SRT_DICT, &v);
+
+  if (result == SRT_SUCCESS &&
+      (result = try_delete_value(ctx, key, &taken)) == SRT_SUCCESS) {
+    *value = taken.dict;
+  }
+
+  return result;
+}
+
+int32_t srt_task_data_try_take_dict(const srt_context *ctx, const char *key,
+                                    srt_dict **value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_take_dict_k(ctx, &k, value);
+}
+
+srt_dict *srt_task_data_take_dict_k(const srt_context *ctx, srt_key *key) {
+  srt_dict *value;
+  const int32_t result = srt_task_data_try_take_dict_k(ctx, key, &value);
+
+  GET_PANIC_UNLESS(result, key->str);
+
+  return value;
+}
+
+srt_dict *srt_task_data_take_dict(const srt_context *ctx, const char *key) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_take_dict_k(ctx, &k);
+}
+
+int32_t srt_task_data_try_share_dict_k(const srt_context *ctx, srt_key *key,
+                                       srt_dict **value) {
+  srt_value *v;
+  const int32_t result = try_get_value(ctx, key, SRT_DICT, &v);
+
+  if (result == SRT_SUCCESS) {
+    *value = srt_dict_share(v->dict);
+  }
+
+  return result;
+}
+
+int32_t srt_task_data_try_share_dict(const srt_context *ctx, const char *key,
+                                     srt_dict **value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_share_dict_k(ctx, &k, value);
+}
+
+srt_dict *srt_task_data_share_dict_k(const srt_context *ctx, srt_key *key) {
+  srt_dict *value;
+  const int32_t result = srt_task_data_try_share_dict_k(ctx, key, &value);
+
+  GET_PANIC_UNLESS(result, key->str);
+
+  return value;
+}
+
+srt_dict *srt_task_data_share_dict(const srt_context *ctx, const char *key) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_share_dict_k(ctx, &k);
 }
 
 //
 // int64
 //
 
-int32_t srt_task_data_try_get_int64(const srt_context *ctx, const char *key,
-                                    int64_t *value) {
+int32_t srt_task_data_try_get_int64_k(const srt_context *ctx, srt_key *key,
+                                      int64_t *value) {
   srt_value *v;
   const uint32_t result = try_get_value(ctx, key, SRT_INT64, &v);
 
@@ -162,43 +378,850 @@ int32_t srt_task_data_try_get_int64(const srt_context *ctx, const char *key,
   return result;
 }
 
-int64_t srt_task_data_get_int64(const srt_context *ctx, const char *key) {
+int32_t srt_task_data_try_get_int64(const srt_context *ctx, const char *key,
+                                    int64_t *value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_get_int64_k(ctx, &k, value);
+}
+
+int64_t srt_task_data_get_int64_k(const srt_context *ctx, srt_key *key) {
   int64_t value;
-  const int32_t result = srt_task_data_try_get_int64(ctx, key, &value);
+  const int32_t result = srt_task_data_try_get_int64_k(ctx, key, &value);
 
-  GET_PANIC_UNLESS(result);
+  GET_PANIC_UNLESS(result, key->str);
 
   return value;
 }
 
+int64_t srt_task_data_get_int64(const srt_context *ctx, const char *key) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_get_int64_k(ctx, &k);
+}
+
+int32_t srt_task_data_try_set_int64_k(const srt_context *ctx, srt_key *key,
+                                      int64_t value) {
+  return try_set_value(ctx, key, &SRT_VALUE(SRT_INT64, int64, value));
+}
+
 int32_t srt_task_data_try_set_int64(const srt_context *ctx, const char *key,
                                     int64_t value) {
-  return try_set_value(ctx, key, srt_value_new(value));
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_set_int64_k(ctx, &k, value);
+}
+
+void srt_task_data_set_int64_k(const srt_context *ctx, srt_key *key,
+                               int64_t value) {
+  SET_PANIC_UNLESS(srt_task_data_try_set_int64_k(ctx, key, value), key->str);
 }
 
 void srt_task_data_set_int64(const srt_context *ctx, const char *key,
                              int64_t value) {
-  SET_PANIC_UNLESS(srt_task_data_try_set_int64(ctx, key, value));
+  srt_key k;
+  srt_key_init(&k, key);
+
+  srt_task_data_set_int64_k(ctx, &k, value);
+}
+
+//
+// str
+//
+// a str that is got lives in task data, inline in its slot when it is short,
+// and is only valid until the next call on the context. set copies a long str
+// into memory from malloc, set_take keeps a str from malloc without copying
+// it, and either way the var owns it, see srt_value.
+//
+
+int32_t srt_task_data_try_get_str_k(const srt_context *ctx, srt_key *key,
+                                    const char **value) {
+  srt_value *v;
+  const uint32_t result = try_get_value(ctx, key, SRT_STR, &v);
+
+  if (result == SRT_SUCCESS) {
+    *value = srt_value_str(v);
+  }
+
+  return result;
+}
+
+int32_t srt_task_data_try_get_str(const srt_context *ctx, const char *key,
+                                  const char **value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_get_str_k(ctx, &k, value);
+}
+
+const char *srt_task_data_get_str_k(const srt_context *ctx, srt_key *key) {
+  const char *value;
+  const int32_t result = srt_task_data_try_get_str_k(ctx, key, &value);
+
+  GET_PANIC_UNLESS(result, key->str);
+
+  return value;
+}
+
+const char *srt_task_data_get_str(const srt_context *ctx, const char *key) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_get_str_k(ctx, &k);
+}
+
+//
+// a long str is freed when the var is set again or deleted rather than when
+// the instance ends, so a var set over and over does not grow the instance.
+//
+int32_t srt_task_data_try_set_str_k(const srt_context *ctx, srt_key *key,
+                                    const char *value) {
+  srt_value v;
+
+  if (!srt_value_set_str(&v, value, value ? strlen(value) : 0, NULL)) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  const int32_t result = try_set_value(ctx, key, &v);
+
+  if (result != SRT_SUCCESS && v.owned) {
+    free(v.str);
+  }
+
+  return result;
+}
+
+int32_t srt_task_data_try_set_str(const srt_context *ctx, const char *key,
+                                  const char *value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_set_str_k(ctx, &k, value);
+}
+
+void srt_task_data_set_str_k(const srt_context *ctx, srt_key *key,
+                             const char *value) {
+  SET_PANIC_UNLESS(srt_task_data_try_set_str_k(ctx, key, value), key->str);
+}
+
+void srt_task_data_set_str(const srt_context *ctx, const char *key,
+                           const char *value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  srt_task_data_set_str_k(ctx, &k, value);
+}
+
+//
+// a short str is copied inline and freed straight away, a long one is owned
+// by the var from then on. `value` is taken even when the set fails.
+//
+int32_t srt_task_data_try_set_str_take_k(const srt_context *ctx,
+                                         srt_key *key, char *value) {
+  const size_t len = value ? strlen(value) : 0;
+  srt_value v = SRT_VALUE(SRT_STR, str, value);
+
+  if (value && len < SRT_VALUE_STR_INLINE) {
+    srt_value_set_str(&v, value, len, NULL);
+    free(value);
+  } else {
+    v.owned = value != NULL;
+  }
+
+  const int32_t result = try_set_value(ctx, key, &v);
+
+  if (result != SRT_SUCCESS && v.owned) {
+    free(v.str);
+  }
+
+  return result;
+}
+
+int32_t srt_task_data_try_set_str_take(const srt_context *ctx,
+                                       const char *key, char *value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_set_str_take_k(ctx, &k, value);
+}
+
+void srt_task_data_set_str_take_k(const srt_context *ctx, srt_key *key,
+                                  char *value) {
+  SET_PANIC_UNLESS(srt_task_data_try_set_str_take_k(ctx, key, value),
+                   key->str);
+}
+
+void srt_task_data_set_str_take(const srt_context *ctx, const char *key,
+                                char *value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  srt_task_data_set_str_take_k(ctx, &k, value);
+}
+
+//
+// arrays
+//
+// the elements got from an int64 or double array live in task data and are
+// only valid until the next call on the context. the var owns its array, see
+// srt_value: set copies the elements over those it has when they fit and
+// into a new array otherwise, append adds one in place, doubling the room for
+// them as it runs out, and starts an array when the var is not set. an array
+// from the arena or an image is copied out on the first append. an append is
+// recorded like a set, so snapshots, journals and branches see it.
+//
+
+static int32_t try_get_array(const srt_context *ctx, srt_key *key,
+                             srt_value_tag tag, const void **values,
+                             size_t *len) {
+  srt_value *v;
+  const int32_t result = try_get_value(ctx, key, tag, &v);
+
+  if (result == SRT_SUCCESS) {
+    *values = v->array->data;
+    *len = v->array->len;
+  }
+
+  return result;
+}
+
+static int32_t try_set_array(const srt_context *ctx, srt_key *key,
+                             srt_value_tag tag, const void *values,
+                             size_t len) {
+  BRANCH_KEY(key);
+
+  srt_value *old = srt_dict_get_k(ctx->task_data, key);
+
+  //
+  // the elements may be those of the array itself, got earlier.
+  //
+  if (old && old->tag == tag && old->owned && old->array->cap >= len) {
+    if (len) {
+      memmove(old->array->data, values, len * SRT_ARRAY_ELEM);
+    }
+
+    old->array->len = len;
+
+    return try_set_value(ctx, key, old);
+  }
+
+  srt_value v = {.tag = tag, .owned = true};
+
+  if (!(v.array = srt_array_new(values, len, NULL))) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  const int32_t result = try_set_value(ctx, key, &v);
+
+  if (result != SRT_SUCCESS) {
+    free(v.array);
+  }
+
+  return result;
+}
+
+static int32_t try_append(const srt_context *ctx, srt_key *key,
+                          srt_value_tag tag, const void *elem) {
+  BRANCH_KEY(key);
+
+  srt_value *v = find_value(ctx, key);
+
+  if (!v) {
+    return try_set_array(ctx, key, tag, elem, 1);
+  }
+
+  if (v->tag != tag) {
+    LOG_K(SRT_LOG_WARN, "type mismatch for task_data var", key->str);
+    TRACE(SRT_TRACE_SET, key->str, v, SRT_KEY_TYPE_MISMATCH);
+
+    return SRT_KEY_TYPE_MISMATCH;
+  }
+
+  const bool copied = !v->owned;
+  srt_value owned = *v;
+
+  if (copied) {
+    owned.owned = true;
+    owned.array = srt_array_new(v->array->data, v->array->len, NULL);
+  }
+
+  srt_array *array = owned.array;
+
+  if (array && array->len == array->cap) {
+    array = srt_array_grow(array);
+  }
+
+  if (!array) {
+    if (copied) {
+      free(owned.array);
+    }
+
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  //
+  // a grown array may have moved, the var is kept pointing at it.
+  //
+  srt_array_push(array, elem, NULL);
+  owned.array = array;
+
+  if (!copied) {
+    v->array = array;
+  }
+
+  const int32_t result = try_set_value(ctx, key, &owned);
+
+  if (result != SRT_SUCCESS && copied) {
+    free(array);
+  }
+
+  return result;
+}
+
+//
+// int64 array
+//
+
+int32_t srt_task_data_try_get_int64_array_k(const srt_context *ctx,
+                                            srt_key *key,
+                                            const int64_t **values,
+                                            size_t *len) {
+  return try_get_array(ctx, key, SRT_INT64_ARRAY, (const void **)values, len);
+}
+
+int32_t srt_task_data_try_get_int64_array(const srt_context *ctx,
+                                          const char *key,
+                                          const int64_t **values,
+                                          size_t *len) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_get_int64_array_k(ctx, &k, values, len);
+}
+
+const int64_t *srt_task_data_get_int64_array_k(const srt_context *ctx,
+                                               srt_key *key, size_t *len) {
+  const int64_t *values;
+  const int32_t result =
+      srt_task_data_try_get_int64_array_k(ctx, key, &values, len);
+
+  GET_PANIC_UNLESS(result, key->str);
+
+  return values;
+}
+
+const int64_t *srt_task_data_get_int64_array(const srt_context *ctx,
+                                             const char *key, size_t *len) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_get_int64_array_k(ctx, &k, len);
+}
+
+int32_t srt_task_data_try_set_int64_array_k(const srt_context *ctx,
+                                            srt_key *key,
+                                            const int64_t *values,
+                                            size_t len) {
+  return try_set_array(ctx, key, SRT_INT64_ARRAY, values, len);
+}
+
+int32_t srt_task_data_try_set_int64_array(const srt_context *ctx,
+                                          const char *key,
+                                          const int64_t *values, size_t len) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_set_int64_array_k(ctx, &k, values, len);
+}
+
+void srt_task_data_set_int64_array_k(const srt_context *ctx, srt_key *key,
+                                     const int64_t *values, size_t len) {
+  SET_PANIC_UNLESS(srt_task_data_try_set_int64_array_k(ctx, key, values, len),
+                   key->str);
+}
+
+void srt_task_data_set_int64_array(const srt_context *ctx, const char *key,
+                                   const int64_t *values, size_t len) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  srt_task_data_set_int64_array_k(ctx, &k, values, len);
+}
+
+int32_t srt_task_data_try_append_int64_k(const srt_context *ctx,
+                                         srt_key *key, int64_t value) {
+  return try_append(ctx, key, SRT_INT64_ARRAY, &value);
+}
+
+int32_t srt_task_data_try_append_int64(const srt_context *ctx,
+                                       const char *key, int64_t value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_append_int64_k(ctx, &k, value);
+}
+
+void srt_task_data_append_int64_k(const srt_context *ctx, srt_key *key,
+                                  int64_t value) {
+  SET_PANIC_UNLESS(srt_task_data_try_append_int64_k(ctx, key, value),
+                   key->str);
+}
+
+void srt_task_data_append_int64(const srt_context *ctx, const char *key,
+                                int64_t value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  srt_task_data_append_int64_k(ctx, &k, value);
+}
+
+//
+// double array
+//
+
+int32_t srt_task_data_try_get_double_array_k(const srt_context *ctx,
+                                             srt_key *key,
+                                             const double **values,
+                                             size_t *len) {
+  return try_get_array(ctx, key, SRT_DOUBLE_ARRAY, (const void **)values,
+                       len);
+}
+
+int32_t srt_task_data_try_get_double_array(const srt_context *ctx,
+                                           const char *key,
+                                           const double **values,
+                                           size_t *len) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_get_double_array_k(ctx, &k, values, len);
+}
+
+const double *srt_task_data_get_double_array_k(const srt_context *ctx,
+                                               srt_key *key, size_t *len) {
+  const double *values;
+  const int32_t result =
+      srt_task_data_try_get_double_array_k(ctx, key, &values, len);
+
+  GET_PANIC_UNLESS(result, key->str);
+
+  return values;
+}
+
+const double *srt_task_data_get_double_array(const srt_context *ctx,
+                                             const char *key, size_t *len) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_get_double_array_k(ctx, &k, len);
+}
+
+int32_t srt_task_data_try_set_double_array_k(const srt_context *ctx,
+                                             srt_key *key,
+                                             const double *values,
+                                             size_t len) {
+  return try_set_array(ctx, key, SRT_DOUBLE_ARRAY, values, len);
+}
+
+int32_t srt_task_data_try_set_double_array(const srt_context *ctx,
+                                           const char *key,
+                                           const double *values, size_t len) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_set_double_array_k(ctx, &k, values, len);
+}
+
+void srt_task_data_set_double_array_k(const srt_context *ctx, srt_key *key,
+                                      const double *values, size_t len) {
+  SET_PANIC_UNLESS(
+      srt_task_data_try_set_double_array_k(ctx, key, values, len), key->str);
+}
+
+void srt_task_data_set_double_array(const srt_context *ctx, const char *key,
+                                    const double *values, size_t len) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  srt_task_data_set_double_array_k(ctx, &k, values, len);
+}
+
+int32_t srt_task_data_try_append_double_k(const srt_context *ctx,
+                                          srt_key *key, double value) {
+  return try_append(ctx, key, SRT_DOUBLE_ARRAY, &value);
+}
+
+int32_t srt_task_data_try_append_double(const srt_context *ctx,
+                                        const char *key, double value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_append_double_k(ctx, &k, value);
+}
+
+void srt_task_data_append_double_k(const srt_context *ctx, srt_key *key,
+                                   double value) {
+  SET_PANIC_UNLESS(srt_task_data_try_append_double_k(ctx, key, value),
+                   key->str);
+}
+
+void srt_task_data_append_double(const srt_context *ctx, const char *key,
+                                 double value) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  srt_task_data_append_double_k(ctx, &k, value);
+}
+
+//
+// path
+//
+// the first segment is got like any task data var, so it is faulted in from
+// an image or a parent branch and marked as touched, and the rest of the
+// walk happens in the dicts under it.
+//
+
+static int32_t try_get_path_value(const srt_context *ctx, srt_path *path,
+                                  srt_value_tag tag, srt_value **value) {
+  if (path->len == 1) {
+    return try_get_value(ctx, &path->segments[0], tag, value);
+  }
+
+  srt_value *v;
+  int32_t result = try_get_value(ctx, &path->segments[0], SRT_DICT, &v);
+
+  if (result == SRT_SUCCESS) {
+    result = srt_path_resolve(v->dict, path, 1, ctx->overlay != NULL, &v);
+  }
+
+  if (result == SRT_SUCCESS && v->tag != tag) {
+    result = SRT_KEY_TYPE_MISMATCH;
+  }
+
+  if (result != SRT_SUCCESS) {
+    LOG_K(SRT_LOG_DEBUG, "failed to get task_data path", path->str);
+    TRACE(SRT_TRACE_GET, path->str, NULL, result);
+
+    return result;
+  }
+
+  *value = v;
+
+  LOG_KV(SRT_LOG_DEBUG, "did get task_data path", path->str, v);
+  TRACE(SRT_TRACE_GET, path->str, v, SRT_SUCCESS);
+
+  return SRT_SUCCESS;
+}
+
+int32_t srt_task_data_try_get_bool_path(const srt_context *ctx,
+                                        srt_path *path, bool *value) {
+  srt_value *v;
+  const int32_t result = try_get_path_value(ctx, path, SRT_BOOL, &v);
+
+  if (result == SRT_SUCCESS) {
+    *value = v->b;
+  }
+
+  return result;
+}
+
+bool srt_task_data_get_bool_path(const srt_context *ctx, srt_path *path) {
+  bool value;
+  const int32_t result = srt_task_data_try_get_bool_path(ctx, path, &value);
+
+  GET_PANIC_UNLESS(result, path->str);
+
+  return value;
+}
+
+int32_t srt_task_data_try_get_dict_path(const srt_context *ctx,
+                                        srt_path *path, srt_dict **value) {
+  srt_value *v;
+  const int32_t result = try_get_path_value(ctx, path, SRT_DICT, &v);
+
+  if (result == SRT_SUCCESS) {
+    *value = v->dict;
+  }
+
+  return result;
+}
+
+srt_dict *srt_task_data_get_dict_path(const srt_context *ctx,
+                                      srt_path *path) {
+  srt_dict *value;
+  const int32_t result = srt_task_data_try_get_dict_path(ctx, path, &value);
+
+  GET_PANIC_UNLESS(result, path->str);
+
+  return value;
+}
+
+int32_t srt_task_data_try_get_int64_path(const srt_context *ctx,
+                                         srt_path *path, int64_t *value) {
+  srt_value *v;
+  const int32_t result = try_get_path_value(ctx, path, SRT_INT64, &v);
+
+  if (result == SRT_SUCCESS) {
+    *value = v->int64;
+  }
+
+  return result;
+}
+
+int64_t srt_task_data_get_int64_path(const srt_context *ctx,
+                                     srt_path *path) {
+  int64_t value;
+  const int32_t result = srt_task_data_try_get_int64_path(ctx, path, &value);
+
+  GET_PANIC_UNLESS(result, path->str);
+
+  return value;
+}
+
+int32_t srt_task_data_try_get_str_path(const srt_context *ctx,
+                                       srt_path *path, const char **value) {
+  srt_value *v;
+  const int32_t result = try_get_path_value(ctx, path, SRT_STR, &v);
+
+  if (result == SRT_SUCCESS) {
+    *value = srt_value_str(v);
+  }
+
+  return result;
+}
+
+const char *srt_task_data_get_str_path(const srt_context *ctx,
+                                       srt_path *path) {
+  const char *value;
+  const int32_t result = srt_task_data_try_get_str_path(ctx, path, &value);
+
+  GET_PANIC_UNLESS(result, path->str);
+
+  return value;
 }
 
 //
 // delete
 //
 
-int32_t srt_task_data_try_delete(const srt_context *ctx, const char *key) {
-  if (srt_dict_delete(ctx->task_data, key)) {
-    if (ctx->verbose) {
-      printf("delete task_data var '%s'\n", key);
+//
+// with `taken`, the value is handed over rather than dropped. it must be in
+// task data already, so only the copies in an image or a parent are shadowed.
+//
+static int32_t try_delete_value(const srt_context *ctx, srt_key *key,
+                                srt_value *taken) {
+  BRANCH_KEY(key);
+
+  const bool in_image = ctx->image && srt_image_shadow(ctx->image, key);
+  const bool in_parent = ctx->overlay && srt_overlay_visible(ctx, key);
+  const bool in_task_data = taken
+                                ? srt_dict_take_k(ctx->task_data, key, taken)
+                                : srt_dict_delete_k(ctx->task_data, key);
+
+  if (taken && !in_task_data) {
+    return SRT_UNKNOWN_KEY;
+  }
+
+  if (in_task_data || in_image || in_parent) {
+    if (ctx->overlay) {
+      srt_overlay_delete(ctx, key);
+    }
+
+    if (ctx->history) {
+      srt_history_delete(ctx, key);
     }
 
+    if (ctx->journal) {
+      srt_journal_delete(ctx, key);
+    }
+
+    LOG_K(SRT_LOG_DEBUG, "delete task_data var", key->str);
+
+    TRACE(SRT_TRACE_DELETE, key->str, NULL, SRT_SUCCESS);
+
     return SRT_SUCCESS;
   }
 
+  TRACE(SRT_TRACE_DELETE, key->str, NULL, SRT_UNKNOWN_KEY);
+
   return SRT_UNKNOWN_KEY;
 }
 
+int32_t srt_task_data_try_delete_k(const srt_context *ctx, srt_key *key) {
+  return try_delete_value(ctx, key, NULL);
+}
+
+int32_t srt_task_data_try_delete(const srt_context *ctx, const char *key) {
+  srt_key k;
+  srt_key_init(&k, key);
+
+  return srt_task_data_try_delete_k(ctx, &k);
+}
+
+void srt_task_data_delete_k(const srt_context *ctx, srt_key *key) {
+  const int32_t result = srt_task_data_try_delete_k(ctx, key);
+
+  PANIC_UNLESS(result, SRT_SUCCESS, "failed to delete task data var",
+               key->str);
+}
+
 void srt_task_data_delete(const srt_context *ctx, const char *key) {
-  const int32_t result = srt_task_data_try_delete(ctx, key);
+  srt_key k;
+  srt_key_init(&k, key);
+
+  srt_task_data_delete_k(ctx, &k);
+}
+
+//
+// move
+//
+// the value of one var becomes the value of another, as it is. a dict moves
+// with its reference, so a subtree of any size moves in O(1).
+//
+
+int32_t srt_task_data_try_move_k(const srt_context *ctx, srt_key *from,
+                                 srt_key *to) {
+  BRANCH_KEY(from);
+
+  const srt_value *v = find_value(ctx, from);
+
+  if (!v) {
+    LOG_K(SRT_LOG_DEBUG, "unknown task_data var", from->str);
+    TRACE(SRT_TRACE_GET, from->str, NULL, SRT_UNKNOWN_KEY);
+
+    return SRT_UNKNOWN_KEY;
+  }
+
+  if (strcmp(from->str, to->str) == 0) {
+    return SRT_SUCCESS;
+  }
+
+  //
+  // a dict moved onto a var that already holds it leaves two references
+  // there, the one of `from` is dropped.
+  //
+  const srt_value value = *v;
+  const srt_value *at = srt_dict_peek(ctx->task_data, to->str);
+  const bool there = at && at->tag == SRT_DICT && value.tag == SRT_DICT &&
+                     at->dict == value.dict;
+  srt_value taken;
+  int32_t result = try_set_value(ctx, to, &value);
+
+  if (result == SRT_SUCCESS) {
+    result = try_delete_value(ctx, from, &taken);
+  }
+
+  if (result == SRT_SUCCESS && there) {
+    srt_dict_free(taken.dict);
+  }
+
+  return result;
+}
+
+int32_t srt_task_data_try_move(const srt_context *ctx, const char *from,
+                               const char *to) {
+  srt_key f;
+  srt_key t;
+  srt_key_init(&f, from);
+  srt_key_init(&t, to);
+
+  return srt_task_data_try_move_k(ctx, &f, &t);
+}
+
+void srt_task_data_move_k(const srt_context *ctx, srt_key *from,
+                          srt_key *to) {
+  const int32_t result = srt_task_data_try_move_k(ctx, from, to);
+
+  PANIC_UNLESS(result, SRT_SUCCESS, "failed to move task data var",
+               from->str);
+}
+
+void srt_task_data_move(const srt_context *ctx, const char *from,
+                        const char *to) {
+  srt_key f;
+  srt_key t;
+  srt_key_init(&f, from);
+  srt_key_init(&t, to);
+
+  srt_task_data_move_k(ctx, &f, &t);
+}
+
+//
+// save and load
+//
+
+int32_t srt_task_data_save(const srt_context *ctx, const char *path) {
+  if (ctx->image && !srt_image_fault_all(ctx->image, ctx->task_data)) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  const int32_t result = srt_image_save(ctx->task_data, ctx->seed, path);
+
+  if (result == SRT_SUCCESS) {
+    LOG_K(SRT_LOG_INFO, "did save task_data to", path);
+  } else {
+    LOG_K(SRT_LOG_ERROR, "failed to save task_data to", path);
+  }
+
+  return result;
+}
+
+//
+// the image is mapped rather than read. it sits behind task data and each
+// entry is copied out the first time it is touched, so load time does not
+// depend on the size of the instance.
+//
+int32_t srt_task_data_load(srt_context *ctx, const char *path) {
+  srt_image *image;
+  const int32_t result = srt_image_open(path, &image);
+
+  if (result != SRT_SUCCESS) {
+    LOG_K(SRT_LOG_ERROR, "failed to load task_data from", path);
+
+    return result;
+  }
+
+  srt_ctx_reset(ctx);
+  ctx->image = image;
+
+  LOG_K(SRT_LOG_INFO, "did load task_data from", path);
+
+  return SRT_SUCCESS;
+}
+
+//
+// json
+//
+
+int32_t srt_task_data_read_json(const srt_context *ctx, FILE *in) {
+  if (ctx->image && !srt_image_fault_all(ctx->image, ctx->task_data)) {
+    return SRT_UNKNOWN_ERROR;
+  }
+
+  srt_json_error error;
+  const int32_t result = srt_json_read(in, ctx->task_data, &error);
+
+  srt_history_invalidate(ctx->history);
+  srt_journal_reset(ctx->journal);
+
+  if (result == SRT_INVALID_JSON) {
+    SRT_LOG(ctx, SRT_LOG_ERROR,
+            "invalid task_data json at line %zu, column %zu: %s\n", error.line,
+            error.column, error.message);
+  }
+
+  return result;
+}
+
+int32_t srt_task_data_write_json(const srt_context *ctx, FILE *out) {
+  srt_log_flush(ctx->log);
+
+  if (ctx->image && !srt_image_fault_all(ctx->image, ctx->task_data)) {
+    return SRT_UNKNOWN_ERROR;
+  }
 
-  PANIC_UNLESS(result, SRT_SUCCESS, "failed to delete task data var");
+  return srt_json_write(ctx->task_data, out);
 }
@@ -0,0 +1,265 @@
+#pragma once
+
+#include "ctx.h"
+#include "dict.h"
+#include "path.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+int32_t srt_task_data_try_get_bool_k(const srt_context *ctx, srt_key *key,
+                                     bool *value);
+
+int32_t srt_task_data_try_get_bool(const srt_context *ctx, const char *key,
+                                   bool *value);
+
+bool srt_task_data_get_bool_k(const srt_context *ctx, srt_key *key);
+
+bool srt_task_data_get_bool(const srt_context *ctx, const char *key);
+
+int32_t srt_task_data_try_set_bool_k(const srt_context *ctx, srt_key *key,
+                                     bool value);
+
+int32_t srt_task_data_try_set_bool(const srt_context *ctx, const char *key,
+                                   bool value);
+
+void srt_task_data_set_bool_k(const srt_context *ctx, srt_key *key,
+                              bool value);
+
+void srt_task_data_set_bool(const srt_context *ctx, const char *key,
+                            bool value);
+
+int32_t srt_task_data_try_get_dict_k(const srt_context *ctx, srt_key *key,
+                                     srt_dict **value);
+
+int32_t srt_task_data_try_get_dict(const srt_context *ctx, const char *key,
+                                   srt_dict **value);
+
+srt_dict *srt_task_data_get_dict_k(const srt_context *ctx, srt_key *key);
+
+srt_dict *srt_task_data_get_dict(const srt_context *ctx, const char *key);
+
+int32_t srt_task_data_try_set_dict_k(const srt_context *ctx, srt_key *key,
+                                     srt_dict *value);
+
+int32_t srt_task_data_try_set_dict(const srt_context *ctx, const char *key,
+                                   srt_dict *value);
+
+void srt_task_data_set_dict_k(const srt_context *ctx, srt_key *key,
+                              srt_dict *value);
+
+void srt_task_data_set_dict(const srt_context *ctx, const char *key,
+                            srt_dict *value);
+
+int32_t srt_task_data_try_take_dict_k(const srt_context *ctx, srt_key *key,
+                                      srt_dict **value);
+
+int32_t srt_task_data_try_take_dict(const srt_context *ctx, const char *key,
+                                    srt_dict **value);
+
+srt_dict *srt_task_data_take_dict_k(const srt_context *ctx, srt_key *key);
+
+srt_dict *srt_task_data_take_dict(const srt_context *ctx, const char *key);
+
+int32_t srt_task_data_try_share_dict_k(const srt_context *ctx, srt_key *key,
+                                       srt_dict **value);
+
+int32_t srt_task_data_try_share_dict(const srt_context *ctx, const char *key,
+                                     srt_dict **value);
+
+srt_dict *srt_task_data_share_dict_k(const srt_context *ctx, srt_key *key);
+
+srt_dict *srt_task_data_share_dict(const srt_context *ctx, const char *key);
+
+int32_t srt_task_data_try_get_int64_k(const srt_context *ctx, srt_key *key,
+                                      int64_t *value);
+
+int32_t srt_task_data_try_get_int64(const srt_context *ctx, const char *key,
+                                    int64_t *value);
+
+int64_t srt_task_data_get_int64_k(const srt_context *ctx, srt_key *key);
+
+int64_t srt_task_data_get_int64(const srt_context *ctx, const char *key);
+
+int32_t srt_task_data_try_set_int64_k(const srt_context *ctx, srt_key *key,
+                                      int64_t value);
+
+int32_t srt_task_data_try_set_int64(const srt_context *ctx, const char *key,
+                                    int64_t value);
+
+void srt_task_data_set_int64_k(const srt_context *ctx, srt_key *key,
+                               int64_t value);
+
+void srt_task_data_set_int64(const srt_context *ctx, const char *key,
+                             int64_t value);
+
+int32_t srt_task_data_try_get_str_k(const srt_context *ctx, srt_key *key,
+                                    const char **value);
+
+int32_t srt_task_data_try_get_str(const srt_context *ctx, const char *key,
+                                  const char **value);
+
+const char *srt_task_data_get_str_k(const srt_context *ctx, srt_key *key);
+
+const char *srt_task_data_get_str(const srt_context *ctx, const char *key);
+
+int32_t srt_task_data_try_set_str_k(const srt_context *ctx, srt_key *key,
+                                    const char *value);
+
+int32_t srt_task_data_try_set_str(const srt_context *ctx, const char *key,
+                                  const char *value);
+
+void srt_task_data_set_str_k(const srt_context *ctx, srt_key *key,
+                             const char *value);
+
+void srt_task_data_set_str(const srt_context *ctx, const char *key,
+                           const char *value);
+
+int32_t srt_task_data_try_set_str_take_k(const srt_context *ctx,
+                                         srt_key *key, char *value);
+
+int32_t srt_task_data_try_set_str_take(const srt_context *ctx,
+                                       const char *key, char *value);
+
+void srt_task_data_set_str_take_k(const srt_context *ctx, srt_key *key,
+                                  char *value);
+
+void srt_task_data_set_str_take(const srt_context *ctx, const char *key,
+                                char *value);
+
+int32_t srt_task_data_try_get_int64_array_k(const srt_context *ctx,
+                                            srt_key *key,
+                                            const int64_t **values,
+                                            size_t *len);
+
+int32_t srt_task_data_try_get_int64_array(const srt_context *ctx,
+                                          const char *key,
+                                          const int64_t **values,
+                                          size_t *len);
+
+const int64_t *srt_task_data_get_int64_array_k(const srt_context *ctx,
+                                               srt_key *key, size_t *len);
+
+const int64_t *srt_task_data_get_int64_array(const srt_context *ctx,
+                                             const char *key, size_t *len);
+
+int32_t srt_task_data_try_set_int64_array_k(const srt_context *ctx,
+                                            srt_key *key,
+                                            const int64_t *values,
+                                            size_t len);
+
+int32_t srt_task_data_try_set_int64_array(const srt_context *ctx,
+                                          const char *key,
+                                          const int64_t *values, size_t len);
+
+void srt_task_data_set_int64_array_k(const srt_context *ctx, srt_key *key,
+                                     const int64_t *values, size_t len);
+
+void srt_task_data_set_int64_array(const srt_context *ctx, const char *key,
+                                   const int64_t *values, size_t len);
+
+int32_t srt_task_data_try_append_int64_k(const srt_context *ctx,
+                                         srt_key *key, int64_t value);
+
+int32_t srt_task_data_try_append_int64(const srt_context *ctx,
+                                       const char *key, int64_t value);
+
+void srt_task_data_append_int64_k(const srt_context *ctx, srt_key *key,
+                                  int64_t value);
+
+void srt_task_data_append_int64(const srt_context *ctx, const char *key,
+                                int64_t value);
+
+int32_t srt_task_data_try_get_double_array_k(const srt_context *ctx,
+                                             srt_key *key,
+                                             const double **values,
+                                             size_t *len);
+
+int32_t srt_task_data_try_get_double_array(const srt_context *ctx,
+                                           const char *key,
+                                           const double **values,
+                                           size_t *len);
+
+const double *srt_task_data_get_double_array_k(const srt_context *ctx,
+                                               srt_key *key, size_t *len);
+
+const double *srt_task_data_get_double_array(const srt_context *ctx,
+                                             const char *key, size_t *len);
+
+int32_t srt_task_data_try_set_double_array_k(const srt_context *ctx,
+                                             srt_key *key,
+                                             const double *values,
+                                             size_t len);
+
+int32_t srt_task_data_try_set_double_array(const srt_context *ctx,
+                                           const char *key,
+                                           const double *values, size_t len);
+
+void srt_task_data_set_double_array_k(const srt_context *ctx, srt_key *key,
+                                      const double *values, size_t len);
+
+void srt_task_data_set_double_array(const srt_context *ctx, const char *key,
+                                    const double *values, size_t len);
+
+int32_t srt_task_data_try_append_double_k(const srt_context *ctx,
+                                          srt_key *key, double value);
+
+int32_t srt_task_data_try_append_double(const srt_context *ctx,
+                                        const char *key, double value);
+
+void srt_task_data_append_double_k(const srt_context *ctx, srt_key *key,
+                                   double value);
+
+void srt_task_data_append_double(const srt_context *ctx, const char *key,
+                                 double value);
+
+int32_t srt_task_data_try_get_bool_path(const srt_context *ctx,
+                                        srt_path *path, bool *value);
+
+bool srt_task_data_get_bool_path(const srt_context *ctx, srt_path *path);
+
+int32_t srt_task_data_try_get_dict_path(const srt_context *ctx,
+                                        srt_path *path, srt_dict **value);
+
+srt_dict *srt_task_data_get_dict_path(const srt_context *ctx,
+                                      srt_path *path);
+
+int32_t srt_task_data_try_get_int64_path(const srt_context *ctx,
+                                         srt_path *path, int64_t *value);
+
+int64_t srt_task_data_get_int64_path(const srt_context *ctx,
+                                     srt_path *path);
+
+int32_t srt_task_data_try_get_str_path(const srt_context *ctx,
+                                       srt_path *path, const char **value);
+
+const char *srt_task_data_get_str_path(const srt_context *ctx,
+                                       srt_path *path);
+
+int32_t srt_task_data_try_delete_k(const srt_context *ctx, srt_key *key);
+
+int32_t srt_task_data_try_delete(const srt_context *ctx, const char *key);
+
+void srt_task_data_delete_k(const srt_context *ctx, srt_key *key);
+
+void srt_task_data_delete(const srt_context *ctx, const char *key);
+
+int32_t srt_task_data_try_move_k(const srt_context *ctx, srt_key *from,
+                                 srt_key *to);
+
+int32_t srt_task_data_try_move(const srt_context *ctx, const char *from,
+                               const char *to);
+
+void srt_task_data_move_k(const srt_context *ctx, srt_key *from,
+                          srt_key *to);
+
+void srt_task_data_move(const srt_context *ctx, const char *from,
+                        const char *to);
+
+int32_t srt_task_data_save(const srt_context *ctx, const char *path);
+
+int32_t srt_task_data_load(srt_context *ctx, const char *path);
+
+int32_t srt_task_data_read_json(const srt_context *ctx, FILE *in);
+
+int32_t srt_task_data_write_json(const srt_context *ctx, FILE *out);
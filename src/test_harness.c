@@ -1,7 +1,26 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "srt.h"
+#include "array.h"
+#include "batch.h"
+#include "fixed_dict.h"
+#include "hamt.h"
+#include "hash.h"
+#include "pool.h"
+#include "server.h"
+#include "trace.h"
+#include "value.h"
 #include <assert.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #define START_TESTS printf("%s...\n", __func__)
 
@@ -21,6 +40,196 @@
 
 #define END_TESTS printf("\n")
 
+#define IMAGE_PATH "/tmp/srt_test_task_data.img"
+#define TRACE_PATH "/tmp/srt_test.trace"
+#define JOURNAL_PATH "/tmp/srt_test.journal"
+#define SOCKET_PATH "/tmp/srt_test.sock"
+
+//
+// a stand in for generated code: fails when task data leaks in from the
+// previous instance, and returns its input as the result past 2.
+//
+static int32_t batch_start(srt_context *ctx) {
+  int64_t doubled;
+
+  if (srt_task_data_try_get_int64(ctx, "doubled", &doubled) !=
+      SRT_UNKNOWN_KEY) {
+    return 99;
+  }
+
+  const int64_t n = srt_task_data_get_int64(ctx, "n");
+  srt_task_data_set_int64(ctx, "doubled", n * 2);
+
+  return n > 2 ? n : 0;
+}
+
+//
+// names its manual task after the instance, so the output of each instance
+// can be told apart.
+//
+static int32_t pool_start(srt_context *ctx) {
+  char element[32];
+  const int64_t n = srt_task_data_get_int64(ctx, "n");
+
+  snprintf(element, sizeof(element), "Task_%ld", n);
+  srt_will_run_element(ctx, "Process_1", element);
+  srt_handle_manual_task(ctx, element, "check it");
+  srt_did_run_element(ctx, "Process_1", element);
+
+  return 0;
+}
+
+//
+// checks that the results of the instances before the last have already gone
+// out by the time the last one runs.
+//
+static FILE *streamed_out;
+static size_t *streamed_len;
+
+static int32_t streamed_start(srt_context *ctx) {
+  if (srt_task_data_get_int64(ctx, "n") == 3) {
+    fflush(streamed_out);
+    assert(*streamed_len > 0);
+  }
+
+  return 0;
+}
+
+//
+// a manual task between two script tasks, re-entered at the manual task when
+// the instance resumes like generated code would.
+//
+static int32_t review_start(srt_context *ctx) {
+  const char *resume = srt_ctx_resume_point(ctx);
+
+  if (!resume) {
+    const int64_t n = srt_task_data_get_int64(ctx, "n");
+    srt_task_data_set_int64(ctx, "total", n * 10);
+  } else {
+    assert(strcmp(resume, "Task_review") == 0);
+  }
+
+  const int32_t result =
+      srt_handle_manual_task(ctx, "Task_review", "approve the total");
+
+  if (result != SRT_SUCCESS) {
+    return result;
+  }
+
+  srt_task_data_set_bool(ctx, "paid", srt_task_data_get_bool(ctx, "approved"));
+
+  return 0;
+}
+
+//
+// generated code without resume points, which starts over at its first
+// element whatever it is resumed at.
+//
+static int32_t restart_start(srt_context *ctx) {
+  srt_will_run_element(ctx, "Process_1", "Task_first");
+  const int64_t runs = srt_task_data_get_int64(ctx, "runs");
+  srt_task_data_set_int64(ctx, "runs", runs + 1);
+  srt_did_run_element(ctx, "Process_1", "Task_first");
+
+  return 0;
+}
+
+static char *run_lines(const char *lines, size_t jobs, srt_batch_start start) {
+  char *results;
+  size_t results_len;
+  FILE *in = fmemopen((void *)lines, strlen(lines), "r");
+  FILE *out = open_memstream(&results, &results_len);
+  srt_context *ctx = srt_ctx_new_seeded(false, 7);
+  srt_batch_stats stats;
+
+  const int32_t result =
+      jobs ? srt_pool_run(ctx, in, out, start, jobs, &stats)
+           : srt_batch_run(ctx, in, out, start, &stats);
+  assert(result == SRT_SUCCESS);
+
+  srt_ctx_free(ctx);
+  fclose(in);
+  fclose(out);
+
+  return results;
+}
+
+static void *serve(void *server) {
+  srt_batch_stats stats;
+  assert(srt_server_run(server, &stats) == SRT_SUCCESS);
+  return NULL;
+}
+
+static int connect_to_server(void) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  strcpy(addr.sun_path, SOCKET_PATH);
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  assert(fd >= 0);
+  assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+  return fd;
+}
+
+static void send_requests(int fd, const char *requests) {
+  assert(write(fd, requests, strlen(requests)) == (ssize_t)strlen(requests));
+  assert(shutdown(fd, SHUT_WR) == 0);
+}
+
+//
+// everything the server sends until it closes the connection.
+//
+static char *read_replies(int fd) {
+  char *replies;
+  size_t replies_len;
+  FILE *out = open_memstream(&replies, &replies_len);
+  char chunk[4096];
+  ssize_t n;
+
+  while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+    fwrite(chunk, 1, n, out);
+  }
+
+  assert(n == 0);
+  fclose(out);
+  close(fd);
+
+  return replies;
+}
+
+static srt_hamt_value hamt_int64(int64_t x) {
+  return (srt_hamt_value){.tag = SRT_INT64, .int64 = x};
+}
+
+static srt_hamt *hamt_set(srt_hamt *root, const char *key, uint64_t hash,
+                          int64_t x) {
+  srt_hamt *next;
+  assert(srt_hamt_set(root, key, hash, hamt_int64(x), &next));
+  return next;
+}
+
+static int64_t hamt_get(const srt_hamt *root, const char *key, uint64_t hash) {
+  const srt_hamt_value *v = srt_hamt_get(root, key, hash);
+  return v ? v->int64 : -1;
+}
+
+static srt_context *journaled_ctx(size_t group) {
+  srt_context *ctx = srt_ctx_new(false);
+  assert(srt_ctx_journal(ctx, JOURNAL_PATH, SRT_JOURNAL_SYNC_NONE, group) ==
+         SRT_SUCCESS);
+  return ctx;
+}
+
+static void run_element(srt_context *ctx, const char *element) {
+  srt_will_run_element(ctx, "Process_1", element);
+  assert(srt_did_run_element(ctx, "Process_1", element) == SRT_SUCCESS);
+}
+
+static off_t file_size(const char *path) {
+  struct stat st;
+  return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
 static void test_ctx() {
   START_TESTS;
 
@@ -38,26 +247,1245 @@ static void test_ctx() {
     srt_ctx_free(ctx);
   });
 
-  END_TESTS;
+  TEST("logs only up to the level of the context", {
+    char *log;
+    size_t log_len;
+    FILE *out = open_memstream(&log, &log_len);
+    srt_context *ctx = srt_ctx_new(false);
+    assert(srt_ctx_log(ctx, SRT_LOG_WARN, out));
+    assert(srt_ctx_verbose(ctx) == false);
+
+    srt_will_run_element(ctx, "Process_1", "Task_a");
+    srt_task_data_set_int64(ctx, "order_total", 42);
+    assert(srt_task_data_try_get_bool(ctx, "order_total", NULL) ==
+           SRT_KEY_TYPE_MISMATCH);
+
+    srt_ctx_free(ctx);
+    fclose(out);
+
+    assert(strcmp(log, "type mismatch for task_data var 'order_total'\n") ==
+           0);
+    free(log);
+  });
+
+  TEST("buffers log output until it is full or the context is freed", {
+    char *log;
+    size_t log_len;
+    FILE *out = open_memstream(&log, &log_len);
+    srt_context *ctx = srt_ctx_new(false);
+    assert(srt_ctx_log(ctx, SRT_LOG_DEBUG, out));
+
+    srt_task_data_set_int64(ctx, "order_total", -7);
+    fflush(out);
+    assert(log_len == 0);
+
+    for (int i = 0; i < 1000; ++i) {
+      srt_will_run_element(ctx, "Process_1", "Task_a");
+    }
+    fflush(out);
+    assert(log_len > 0);
+
+    srt_ctx_free(ctx);
+    fclose(out);
+
+    const char *head = "will set task_data var 'order_total: int64 = -7'\n"
+                       "did set task_data var 'order_total: int64 = -7'\n"
+                       "will run Process_1_Task_a\n";
+    assert(strncmp(log, head, strlen(head)) == 0);
+
+    int lines = 0;
+    for (const char *c = log; *c; ++c) {
+      lines += *c == '\n';
+    }
+    assert(lines == 1002);
+    free(log);
+  });
+
+  TEST("can be seeded", {
+    srt_context *ctx = srt_ctx_new_seeded(false, 42);
+    srt_key x = SRT_KEY("x");
+
+    srt_task_data_set_int64_k(ctx, &x, 11);
+    assert(srt_task_data_get_int64(ctx, "x") == 11);
+
+    srt_context *other = srt_ctx_new_seeded(false, 43);
+    srt_task_data_set_int64_k(other, &x, 22);
+    assert(srt_task_data_get_int64_k(ctx, &x) == 11);
+    assert(srt_task_data_get_int64_k(other, &x) == 22);
+
+    srt_ctx_free(other);
+    srt_ctx_free(ctx);
+  });
+
+  TEST_WITH_CTX("reset clears task data", {
+    srt_key x = SRT_KEY("x");
+    char key[32];
+
+    for (int64_t i = 0; i < 10000; ++i) {
+      snprintf(key, sizeof(key), "a_long_task_data_var_%ld", i);
+      srt_task_data_set_int64(ctx, key, i);
+    }
+
+    srt_task_data_set_int64_k(ctx, &x, 11);
+    assert(srt_task_data_get_int64_k(ctx, &x) == 11);
+
+    srt_ctx_reset(ctx);
+
+    assert(srt_task_data_try_get_int64_k(ctx, &x, NULL) == SRT_UNKNOWN_KEY);
+    assert(srt_task_data_try_get_int64(ctx, key, NULL) == SRT_UNKNOWN_KEY);
+
+    srt_task_data_set_int64_k(ctx, &x, 22);
+    assert(srt_task_data_get_int64_k(ctx, &x) == 22);
+  });
+
+  TEST_WITH_CTX("owns dicts it creates", {
+    srt_dict *d = srt_ctx_dict_new(ctx, 2);
+    assert(d != NULL);
+    assert(srt_dict_set(d, "y", srt_value_new_int64(13)));
+
+    srt_task_data_set_dict(ctx, "x", d);
+    srt_dict *value = srt_task_data_get_dict(ctx, "x");
+    assert(srt_dict_get(value, "y")->int64 == 13);
+  });
+
+  TEST("profiles elements run through the life-cycle hooks", {
+    char *report;
+    size_t report_len;
+    FILE *out = open_memstream(&report, &report_len);
+    srt_context *ctx = srt_ctx_new(false);
+    assert(srt_ctx_profile(ctx, out));
+
+    //
+    // the same ids through another pointer are merged into one row.
+    //
+    char task_a[] = "Task_a";
+
+    for (int i = 0; i < 3; ++i) {
+      srt_will_run_element(ctx, "Process_1", "Task_a");
+      srt_did_run_element(ctx, "Process_1", "Task_a");
+    }
+    srt_will_run_element(ctx, "Process_1", task_a);
+    srt_did_run_element(ctx, "Process_1", task_a);
+
+    srt_will_run_element(ctx, "Process_1", "Call_b");
+    srt_will_run_element(ctx, "Process_1", "Call_b");
+    srt_did_run_element(ctx, "Process_1", "Call_b");
+    srt_did_run_element(ctx, "Process_1", "Call_b");
+
+    srt_did_run_element(ctx, "Process_1", "Never_started");
+
+    srt_ctx_free(ctx);
+    fclose(out);
+
+    char process[32];
+    char element[32];
+    unsigned long count;
+    int rows = 0;
+
+    for (char *line = strchr(report, '\n'); line; line = strchr(line, '\n')) {
+      line++;
+      if (sscanf(line, "%31s %31s %lu", process, element, &count) != 3) {
+        continue;
+      }
+
+      rows++;
+      assert(strcmp(process, "Process_1") == 0);
+      assert(strcmp(element, "Task_a") == 0 || strcmp(element, "Call_b") == 0);
+      assert(count == (strcmp(element, "Task_a") == 0 ? 4 : 1));
+    }
+
+    assert(rows == 2);
+    free(report);
+  });
+
+  TEST("profiles elements again after an instance left them early", {
+    char *report;
+    size_t report_len;
+    FILE *out = open_memstream(&report, &report_len);
+    srt_context *ctx = srt_ctx_new(false);
+    assert(srt_ctx_profile(ctx, out));
+
+    srt_will_run_element(ctx, "Process_1", "Task_a");
+    srt_ctx_reset(ctx);
+
+    for (int i = 0; i < 2; ++i) {
+      srt_will_run_element(ctx, "Process_1", "Task_a");
+      srt_did_run_element(ctx, "Process_1", "Task_a");
+    }
+
+    srt_ctx_free(ctx);
+    fclose(out);
+
+    char *row = strstr(report, "Process_1");
+    unsigned long count = 0;
+    assert(row && sscanf(row, "%*s %*s %lu", &count) == 1 && count == 2);
+    free(report);
+  });
+
+  TEST("traces events to a binary file", {
+    srt_trace *trace = srt_trace_open(TRACE_PATH, 1024);
+    assert(trace != NULL);
+
+    srt_context *ctx = srt_ctx_new(false);
+    srt_ctx_trace(ctx, trace);
+
+    srt_will_run_element(ctx, "Process_1", "Activity_with_a_long_name");
+    srt_task_data_set_int64(ctx, "order_total", 42);
+    assert(srt_task_data_try_get_bool(ctx, "order_total", NULL) ==
+           SRT_KEY_TYPE_MISMATCH);
+    srt_task_data_delete(ctx, "order_total");
+    srt_did_run_element(ctx, "Process_1", "Activity_with_a_long_name");
+
+    srt_ctx_free(ctx);
+    assert(srt_trace_close(trace));
+
+    FILE *f = fopen(TRACE_PATH, "rb");
+    srt_trace_header header;
+    srt_trace_record r[6];
+    assert(fread(&header, sizeof(header), 1, f) == 1);
+    assert(memcmp(header.magic, SRT_TRACE_MAGIC, 4) == 0);
+    assert(fread(r, sizeof(*r), 6, f) == 5);
+    fclose(f);
+    remove(TRACE_PATH);
+
+    assert(r[0].type == SRT_TRACE_WILL_RUN);
+    assert(strcmp(r[0].a, "Process_1") == 0);
+    assert(r[0].flags & SRT_TRACE_B_TRUNCATED);
+    assert(memcmp(r[0].b, "Activity_with_a_long", SRT_TRACE_STR) == 0);
+
+    assert(r[1].type == SRT_TRACE_SET && r[1].tag == SRT_INT64);
+    assert(r[1].value == 42 && strcmp(r[1].a, "order_total") == 0);
+    assert(r[2].type == SRT_TRACE_GET);
+    assert(r[2].result == SRT_KEY_TYPE_MISMATCH);
+    assert(r[3].type == SRT_TRACE_DELETE && r[3].result == SRT_SUCCESS);
+    assert(r[4].type == SRT_TRACE_DID_RUN);
+
+    for (int i = 1; i < 5; ++i) {
+      assert(r[i].ns >= r[i - 1].ns);
+    }
+  });
+
+  TEST("trace accounts for every event when the ring overflows", {
+    srt_trace *trace = srt_trace_open(TRACE_PATH, 16);
+    srt_context *ctx = srt_ctx_new(false);
+    srt_ctx_trace(ctx, trace);
+
+    for (int i = 0; i < 100000; ++i) {
+      srt_will_run_element(ctx, "Process_1", "Task_a");
+    }
+
+    srt_ctx_free(ctx);
+    assert(srt_trace_close(trace));
+
+    FILE *f = fopen(TRACE_PATH, "rb");
+    srt_trace_header header;
+    srt_trace_record r;
+    int64_t events = 0;
+    assert(fread(&header, sizeof(header), 1, f) == 1);
+
+    while (fread(&r, sizeof(r), 1, f) == 1) {
+      events += r.type == SRT_TRACE_DROPPED ? r.value : 1;
+    }
+
+    fclose(f);
+    remove(TRACE_PATH);
+
+    assert(events == 100000);
+  });
+
+  TEST("runs a batch of instances on one context", {
+    const char lines[] = "{\"n\": 1}\n"
+                         "\n"
+                         "{\"n\": 2}\n"
+                         "{\"n\": [2, \"a\"]}\n"
+                         "{\"n\": 3}";
+    FILE *in = fmemopen((void *)lines, sizeof(lines) - 1, "r");
+    char *results;
+    size_t results_len;
+    FILE *out = open_memstream(&results, &results_len);
+    srt_context *ctx = srt_ctx_new(false);
+    srt_batch_stats stats;
+
+    assert(srt_batch_run(ctx, in, out, batch_start, &stats) == SRT_SUCCESS);
+    assert(stats.instances == 4);
+    assert(stats.failed == 2);
+
+    srt_ctx_free(ctx);
+    fclose(in);
+    fclose(out);
+
+    char *line = strtok(results, "\n");
+    assert(strstr(line, "{\"line\":1,\"result\":0,\"task_data\":{") == line);
+    assert(strstr(line, "\"doubled\":2"));
+
+    line = strtok(NULL, "\n");
+    assert(strstr(line, "{\"line\":3,\"result\":0,") == line);
+    assert(strstr(line, "\"doubled\":4"));
+
+    line = strtok(NULL, "\n");
+    assert(strstr(line, "{\"line\":4,\"result\":6,\"error\":") == line);
+
+    line = strtok(NULL, "\n");
+    assert(strstr(line, "{\"line\":5,\"result\":3,") == line);
+    assert(strstr(line, "\"doubled\":6"));
+
+    assert(strtok(NULL, "\n") == NULL);
+    free(results);
+  });
+
+  TEST("a batch ends only the instance whose var is missing", {
+    const char lines[] = "{\"n\": 1}\n{\"n\": 2}\n{}\n{\"n\": 4}\n";
+    FILE *in = fmemopen((void *)lines, sizeof(lines) - 1, "r");
+    char *results;
+    size_t results_len;
+    FILE *out = open_memstream(&results, &results_len);
+    srt_context *ctx = srt_ctx_new(false);
+    srt_batch_stats stats;
+
+    assert(srt_batch_run(ctx, in, out, batch_start, &stats) == SRT_SUCCESS);
+    assert(stats.instances == 4);
+    assert(stats.failed == 2);
+
+    srt_ctx_free(ctx);
+    fclose(in);
+    fclose(out);
+
+    char *line = strtok(results, "\n");
+    assert(strstr(line, "{\"line\":1,\"result\":0,") == line);
+
+    line = strtok(NULL, "\n");
+    assert(strstr(line, "{\"line\":2,\"result\":0,") == line);
+
+    line = strtok(NULL, "\n");
+    assert(strcmp(line, "{\"line\":3,\"result\":1,\"error\":\"failed to get "
+                        "task data var\",\"key\":\"n\"}") == 0);
+
+    line = strtok(NULL, "\n");
+    assert(strstr(line, "{\"line\":4,\"result\":4,") == line);
+    assert(strstr(line, "\"doubled\":8"));
+
+    assert(strtok(NULL, "\n") == NULL);
+    free(results);
+  });
+
+  TEST("a pool writes the output of a sequential batch", {
+    char *lines = malloc(300 * 16);
+    size_t len = 0;
+
+    for (int i = 0; i < 300; ++i) {
+      len += sprintf(lines + len,
+                     i % 11 == 5 ? "{}\n"
+                     : i % 7     ? "{\"n\": %d}\n"
+                                 : "{\"n\": %d\n",
+                     i);
+    }
+
+    char *sequential = run_lines(lines, 0, batch_start);
+
+    for (size_t jobs = 1; jobs <= 8; jobs *= 2) {
+      char *pooled = run_lines(lines, jobs, batch_start);
+      assert(strcmp(sequential, pooled) == 0);
+      free(pooled);
+    }
+
+    free(sequential);
+    free(lines);
+  });
+
+  TEST("a pool writes results out while later instances run", {
+    const char lines[] = "{\"n\": 1}\n{\"n\": 2}\n{\"n\": 3}\n";
+    FILE *in = fmemopen((void *)lines, sizeof(lines) - 1, "r");
+    char *results;
+    size_t results_len;
+    FILE *out = open_memstream(&results, &results_len);
+    srt_context *ctx = srt_ctx_new(false);
+    srt_batch_stats stats;
+
+    streamed_out = out;
+    streamed_len = &results_len;
+    assert(srt_pool_run(ctx, in, out, streamed_start, 1, &stats) ==
+           SRT_SUCCESS);
+    assert(stats.instances == 3);
+
+    srt_ctx_free(ctx);
+    fclose(in);
+    fclose(out);
+    free(results);
+  });
+
+  TEST("a pool keeps the output of each instance together", {
+    char *lines = malloc(200 * 16);
+    size_t len = 0;
+
+    for (int i = 0; i < 200; ++i) {
+      len += sprintf(lines + len, "{\"n\": %d}\n", i);
+    }
+
+    char *results = run_lines(lines, 4, pool_start);
+    char expected[64];
+    char *line = strtok(results, "\n");
+
+    for (int i = 0; i < 200; ++i) {
+      snprintf(expected, sizeof(expected), "Manual Task Task_%d", i);
+      assert(strcmp(line, expected) == 0);
+      assert(strcmp(strtok(NULL, "\n"), "  * check it") == 0);
+      assert(strstr(strtok(NULL, "\n"), "Not in interactive mode"));
+
+      snprintf(expected, sizeof(expected), "{\"line\":%d,\"result\":0,", i + 1);
+      line = strtok(NULL, "\n");
+      assert(strstr(line, expected) == line);
+
+      line = strtok(NULL, "\n");
+    }
+
+    assert(line == NULL);
+    free(results);
+    free(lines);
+  });
+
+  TEST("a server answers each of its clients", {
+    enum { CLIENTS = 4 };
+    enum { REQUESTS = 50 };
+    srt_context *ctx = srt_ctx_new_seeded(false, 7);
+    srt_server *server = srt_server_open(ctx, SOCKET_PATH, batch_start, 3);
+    pthread_t thread;
+    int fds[CLIENTS];
+    char requests[REQUESTS * 16];
+
+    assert(server);
+    assert(pthread_create(&thread, NULL, serve, server) == 0);
+
+    for (int c = 0; c < CLIENTS; ++c) {
+      size_t len = 0;
+
+      for (int i = 0; i < REQUESTS; ++i) {
+        len += sprintf(requests + len, "{\"n\": %d}\n", c * REQUESTS + i);
+      }
+
+      send_requests(fds[c] = connect_to_server(), requests);
+    }
+
+    for (int c = 0; c < CLIENTS; ++c) {
+      char *replies = read_replies(fds[c]);
+      char expected[64];
+      size_t lines = 0;
+
+      for (char *p = replies; (p = strchr(p, '\n')); ++p) {
+        ++lines;
+      }
+
+      assert(lines == REQUESTS);
+
+      for (int i = 0; i < REQUESTS; ++i) {
+        const int n = c * REQUESTS + i;
+        snprintf(expected, sizeof(expected), "{\"line\":%d,\"result\":%d,",
+                 i + 1, n > 2 ? n : 0);
+        char *line = strstr(replies, expected);
+
+        assert(line);
+        snprintf(expected, sizeof(expected), "\"doubled\":%d", n * 2);
+        assert(strstr(line, expected) < strchr(line, '\n'));
+      }
+
+      free(replies);
+    }
+
+    srt_server_stop(server);
+    assert(pthread_join(thread, NULL) == 0);
+    srt_server_close(server);
+    srt_ctx_free(ctx);
+
+    assert(access(SOCKET_PATH, F_OK) != 0);
+  });
+
+  TEST("a server answers requests after one missing a var", {
+    srt_context *ctx = srt_ctx_new_seeded(false, 7);
+    srt_server *server = srt_server_open(ctx, SOCKET_PATH, batch_start, 2);
+    pthread_t thread;
+
+    assert(server);
+    assert(pthread_create(&thread, NULL, serve, server) == 0);
+
+    int fd = connect_to_server();
+    send_requests(fd, "{}\n{\"n\": 2}\n");
+    char *replies = read_replies(fd);
+    assert(strstr(replies, "{\"line\":1,\"result\":1,\"error\":\"failed to get "
+                           "task data var\",\"key\":\"n\"}\n"));
+    assert(strstr(replies, "{\"line\":2,\"result\":0,"));
+    assert(strstr(replies, "\"doubled\":4"));
+    free(replies);
+
+    srt_server_stop(server);
+    assert(pthread_join(thread, NULL) == 0);
+    srt_server_close(server);
+    srt_ctx_free(ctx);
+  });
+
+  TEST("a server resumes suspended instances", {
+    srt_context *ctx = srt_ctx_new(false);
+    assert(srt_ctx_suspendable(ctx));
+    srt_server *server = srt_server_open(ctx, SOCKET_PATH, review_start, 2);
+    pthread_t thread;
+
+    assert(server);
+    assert(pthread_create(&thread, NULL, serve, server) == 0);
+
+    int fd = connect_to_server();
+    send_requests(fd, "{\"n\": 3}\n");
+    char *replies = read_replies(fd);
+    assert(strstr(replies, "\"result\":9,\"suspended\":\"Task_review\""));
+    assert(strstr(replies, "\"total\":30"));
+    free(replies);
+
+    fd = connect_to_server();
+    send_requests(fd, "resume Task_review {\"n\": 3, \"total\": 30, "
+                      "\"approved\": true}\nresume {}\n");
+    replies = read_replies(fd);
+    assert(strstr(replies, "{\"line\":1,\"result\":0,"));
+    assert(strstr(replies, "\"paid\":true"));
+    assert(strstr(replies, "{\"line\":2,\"result\":6,\"error\":"));
+    free(replies);
+
+    srt_server_stop(server);
+    assert(pthread_join(thread, NULL) == 0);
+    srt_server_close(server);
+    srt_ctx_free(ctx);
+  });
+
+  TEST("suspended instances resume at their manual task", {
+    enum { N = 100 };
+    srt_continuation *waiting[N];
+    srt_context *ctx = srt_ctx_new(false);
+    assert(srt_ctx_suspendable(ctx));
+
+    for (int64_t i = 0; i < N; ++i) {
+      srt_ctx_reset(ctx);
+      srt_task_data_set_int64(ctx, "n", i);
+      assert(review_start(ctx) == SRT_SUSPENDED);
+      assert((waiting[i] = srt_ctx_suspend(ctx)));
+      assert(srt_ctx_suspend(ctx) == NULL);
+    }
+
+    assert(strcmp(srt_continuation_element(waiting[7]), "Task_review") == 0);
+    assert(strcmp(srt_continuation_instructions(waiting[7]),
+                  "approve the total") == 0);
+    srt_ctx_free(ctx);
+
+    ctx = srt_ctx_new(false);
+
+    for (int64_t i = N - 1; i >= 0; --i) {
+      assert(srt_ctx_resume(ctx, waiting[i]) == SRT_SUCCESS);
+      assert(strcmp(srt_ctx_resume_point(ctx), "Task_review") == 0);
+      srt_task_data_set_bool(ctx, "approved", i % 2);
+
+      assert(review_start(ctx) == SRT_SUCCESS);
+      assert(srt_ctx_resume_point(ctx) == NULL);
+      assert(srt_task_data_get_int64(ctx, "total") == i * 10);
+      assert(srt_task_data_get_bool(ctx, "paid") == i % 2);
+      srt_continuation_free(waiting[i]);
+    }
+
+    srt_ctx_reset(ctx);
+    assert(srt_ctx_resume_point(ctx) == NULL);
+    srt_ctx_free(ctx);
+  });
+
+  TEST("a resumed instance without resume points is not run again", {
+    static const char line[] = "{\"runs\": 1}";
+    char *results;
+    size_t results_len;
+    FILE *out = open_memstream(&results, &results_len);
+    srt_context *ctx = srt_ctx_new(false);
+    int32_t result;
+
+    assert(srt_batch_resume_line(ctx, "Task_review", line, strlen(line), 1,
+                                 out, restart_start, &result));
+    assert(result == SRT_UNKNOWN_ERROR);
+    assert(srt_batch_run_line(ctx, line, strlen(line), 2, out, restart_start,
+                              &result));
+    assert(result == SRT_SUCCESS);
+    srt_ctx_free(ctx);
+    fclose(out);
+
+    char *second = strchr(results, '\n') + 1;
+    assert(strstr(results, "{\"line\":1,\"result\":3,\"error\":") ==
+           results);
+    assert(strstr(results, "\"key\":\"Task_first\"}\n") < second);
+    assert(strstr(second, "\"runs\":2"));
+    free(results);
+  });
+
+  TEST("a batch names the task an instance suspended at", {
+    static const char line[] = "{\"n\": 4}";
+    char *results;
+    size_t results_len;
+    FILE *out = open_memstream(&results, &results_len);
+    srt_context *ctx = srt_ctx_new(false);
+    int32_t result;
+
+    assert(srt_ctx_suspendable(ctx));
+    assert(srt_batch_run_line(ctx, line, strlen(line), 3, out, review_start,
+                              &result));
+    fclose(out);
+
+    assert(result == SRT_SUSPENDED);
+    assert(strstr(results, "{\"line\":3,\"result\":9,"
+                           "\"suspended\":\"Task_review\","
+                           "\"task_data\":{") == results);
+    assert(strstr(results, "\"total\":40"));
+
+    srt_batch_stats stats = {0};
+    srt_batch_count(&stats, result);
+    assert(stats.suspended == 1 && stats.failed == 0);
+
+    free(results);
+    srt_ctx_free(ctx);
+  });
+
+  END_TESTS;
+}
+
+//
+// branches for the parallel gateway tests
+//
+
+static int32_t branch_a(srt_context *ctx) {
+  srt_task_data_set_int64(ctx, "a", srt_task_data_get_int64(ctx, "base") + 1);
+  srt_task_data_set_int64(ctx, "shared", 1);
+  srt_task_data_delete(ctx, "doomed");
+  assert(srt_task_data_try_get_int64(ctx, "doomed", &(int64_t){0}) ==
+         SRT_UNKNOWN_KEY);
+
+  return 0;
+}
+
+static int32_t branch_b(srt_context *ctx) {
+  srt_task_data_set_int64(ctx, "b", srt_task_data_get_int64(ctx, "base") + 2);
+  srt_task_data_set_int64(ctx, "shared", 2);
+
+  srt_dict *order = srt_task_data_get_dict(ctx, "order");
+  srt_dict_set(order, "total", srt_value_new_int64(99));
+
+  return 0;
+}
+
+static int32_t branch_reader(srt_context *ctx) {
+  srt_dict *order = srt_task_data_get_dict(ctx, "order");
+  assert(srt_dict_get(order, "total")->int64 == 10);
+  assert(srt_task_data_get_int64(ctx, "shared") == 0);
+
+  return 0;
+}
+
+static int32_t branch_same(srt_context *ctx) {
+  srt_task_data_set_int64(ctx, "shared", 7);
+
+  return 0;
+}
+
+static int32_t branch_fails(srt_context *ctx) {
+  srt_task_data_set_int64(ctx, "shared", 3);
+
+  return 42;
+}
+
+static const srt_branch inner_branches[] = {branch_a, branch_same};
+
+static int32_t branch_nested(srt_context *ctx) {
+  srt_task_data_set_int64(ctx, "base", 100);
+
+  return srt_run_parallel(ctx, inner_branches, 2, SRT_MERGE_LAST_WINS);
+}
+
+static const srt_branch merging_branches[] = {branch_a, branch_reader,
+                                              branch_b};
+static const srt_branch conflicting_branches[] = {branch_a, branch_b};
+static const srt_branch agreeing_branches[] = {branch_same, branch_reader,
+                                               branch_same};
+static const srt_branch failing_branches[] = {branch_a, branch_fails};
+static const srt_branch nesting_branches[] = {branch_nested, branch_reader};
+
+static srt_context *gateway_ctx(void) {
+  srt_context *ctx = srt_ctx_new(false);
+  srt_dict *order = srt_ctx_dict_new(ctx, 16);
+  srt_dict_set(order, "total", srt_value_new_int64(10));
+
+  srt_task_data_set_int64(ctx, "base", 10);
+  srt_task_data_set_int64(ctx, "shared", 0);
+  srt_task_data_set_int64(ctx, "doomed", 1);
+  srt_task_data_set_dict(ctx, "order", order);
+
+  return ctx;
+}
+
+static void test_parallel() {
+  START_TESTS;
+
+  TEST("merges the writes of parallel branches", {
+    srt_context *ctx = gateway_ctx();
+
+    assert(srt_run_parallel(ctx, merging_branches, 3, SRT_MERGE_LAST_WINS) ==
+           SRT_SUCCESS);
+
+    assert(srt_task_data_get_int64(ctx, "a") == 11);
+    assert(srt_task_data_get_int64(ctx, "b") == 12);
+    assert(srt_task_data_get_int64(ctx, "shared") == 2);
+    assert(srt_task_data_try_delete(ctx, "doomed") == SRT_UNKNOWN_KEY);
+
+    srt_dict *order = srt_task_data_get_dict(ctx, "order");
+    assert(srt_dict_get(order, "total")->int64 == 99);
+
+    srt_ctx_free(ctx);
+  });
+
+  TEST("resolves conflicting writes by policy", {
+    const srt_branch *branches = conflicting_branches;
+    srt_context *ctx = gateway_ctx();
+
+    assert(srt_run_parallel(ctx, branches, 2, SRT_MERGE_FAIL) ==
+           SRT_MERGE_CONFLICT);
+    assert(srt_task_data_get_int64(ctx, "shared") == 0);
+    assert(srt_task_data_try_get_int64(ctx, "a", &(int64_t){0}) ==
+           SRT_UNKNOWN_KEY);
+
+    assert(srt_run_parallel(ctx, branches, 2, SRT_MERGE_FIRST_WINS) ==
+           SRT_SUCCESS);
+    assert(srt_task_data_get_int64(ctx, "shared") == 1);
+    srt_ctx_free(ctx);
+
+    ctx = gateway_ctx();
+    assert(srt_run_parallel(ctx, agreeing_branches, 3, SRT_MERGE_FAIL) ==
+           SRT_SUCCESS);
+    assert(srt_task_data_get_int64(ctx, "shared") == 7);
+    srt_ctx_free(ctx);
+  });
+
+  TEST("merges nothing when a branch fails", {
+    srt_context *ctx = gateway_ctx();
+
+    assert(srt_run_parallel(ctx, failing_branches, 2, SRT_MERGE_LAST_WINS) ==
+           42);
+    assert(srt_task_data_get_int64(ctx, "shared") == 0);
+    assert(srt_task_data_get_int64(ctx, "doomed") == 1);
+
+    srt_ctx_free(ctx);
+  });
+
+  TEST("tells branches apart in a shared trace", {
+    srt_trace *trace = srt_trace_open(TRACE_PATH, 1024);
+    srt_context *ctx = gateway_ctx();
+    srt_ctx_trace(ctx, trace);
+
+    srt_will_run_element(ctx, "Process_1", "Gateway_1");
+    assert(srt_run_parallel(ctx, merging_branches, 3, SRT_MERGE_LAST_WINS) ==
+           SRT_SUCCESS);
+
+    srt_ctx_free(ctx);
+    assert(srt_trace_close(trace));
+
+    FILE *f = fopen(TRACE_PATH, "rb");
+    srt_trace_header header;
+    srt_trace_record r;
+    uint32_t a = 0;
+    uint32_t b = 0;
+    assert(fread(&header, sizeof(header), 1, f) == 1);
+    assert(header.version == SRT_TRACE_VERSION);
+
+    while (fread(&r, sizeof(r), 1, f) == 1) {
+      if (r.type == SRT_TRACE_WILL_RUN) {
+        assert(r.ctx == 0);
+      } else if (r.type == SRT_TRACE_SET && strcmp(r.a, "a") == 0) {
+        a = r.ctx;
+      } else if (r.type == SRT_TRACE_SET && strcmp(r.a, "b") == 0) {
+        b = r.ctx;
+      }
+    }
+
+    fclose(f);
+    remove(TRACE_PATH);
+
+    assert(a && b && a != b);
+  });
+
+  TEST("a verbose gateway logs nothing more when its branches join", {
+    char *log;
+    size_t log_len;
+    FILE *out = open_memstream(&log, &log_len);
+    srt_context *ctx = gateway_ctx();
+    assert(srt_ctx_log(ctx, SRT_LOG_INFO, out));
+
+    srt_will_run_element(ctx, "Process_1", "Gateway_1");
+    assert(srt_run_parallel(ctx, merging_branches, 3, SRT_MERGE_LAST_WINS) ==
+           SRT_SUCCESS);
+    srt_did_run_element(ctx, "Process_1", "Gateway_1");
+
+    srt_ctx_free(ctx);
+    fclose(out);
+
+    assert(strcmp(log, "will run Process_1_Gateway_1\n"
+                       "did run Process_1_Gateway_1\n") == 0);
+    free(log);
+  });
+
+  TEST("nests parallel gateways", {
+    srt_context *ctx = gateway_ctx();
+
+    assert(srt_run_parallel(ctx, nesting_branches, 2, SRT_MERGE_FAIL) ==
+           SRT_SUCCESS);
+    assert(srt_task_data_get_int64(ctx, "base") == 100);
+    assert(srt_task_data_get_int64(ctx, "a") == 101);
+    assert(srt_task_data_get_int64(ctx, "shared") == 7);
+    assert(srt_task_data_try_delete(ctx, "doomed") == SRT_UNKNOWN_KEY);
+
+    srt_ctx_free(ctx);
+  });
+
+  END_TESTS;
+}
+
+static const char *const duplicate_keys[] = {"a", "b", "a"};
+static const char *const owning_keys[] = {"name", "totals"};
+static const int64_t totals[] = {1, 2, 3};
+
+//
+// builds a fixed dict of `len` keys and checks every one of them, and a few
+// that are not in the set, lands where it should.
+//
+static void check_fixed_dict(size_t len) {
+  char(*names)[16] = malloc(len * sizeof(*names));
+  const char **keys = malloc(len * sizeof(*keys));
+
+  for (size_t i = 0; i < len; ++i) {
+    snprintf(names[i], sizeof(names[i]), "field_%zu", i);
+    keys[i] = names[i];
+  }
+
+  srt_fixed_dict *d = srt_fixed_dict_new(keys, len);
+  assert(d && srt_fixed_dict_len(d) == len);
+  assert(srt_fixed_dict_get(d, keys[0]) == NULL);
+
+  for (size_t i = 0; i < len; ++i) {
+    assert(srt_fixed_dict_set(d, keys[i], srt_value_new_int64(i)));
+  }
+
+  for (size_t i = 0; i < len; ++i) {
+    srt_key k = SRT_KEY(keys[i]);
+    assert(srt_fixed_dict_get(d, keys[i])->int64 == (int64_t)i);
+    assert(srt_fixed_dict_get_k(d, &k)->int64 == (int64_t)i);
+  }
+
+  assert(srt_fixed_dict_get(d, "field_") == NULL);
+  assert(srt_fixed_dict_get(d, "other") == NULL);
+  srt_value *v = srt_value_new_int64(1);
+  assert(!srt_fixed_dict_set(d, "other", v));
+  srt_value_free(v);
+
+  srt_fixed_dict_free(d);
+  free(keys);
+  free(names);
+}
+
+static void test_dict() {
+  START_TESTS;
+
+  TEST("can new and free", {
+    srt_dict *d = srt_dict_new(2);
+    srt_dict_free(d);
+  });
+
+  TEST("can new with kvs and free", {
+    srt_dict *d = srt_dict_new_with_kvs(3, "key1", srt_value_new_bool(true),
+                                        "key2", srt_value_new_int64(13), "key3",
+                                        srt_value_new_bool(false));
+    assert(srt_dict_len(d) == 3);
+    srt_dict_free(d);
+  });
+
+  TEST("key handle misses in a new dict reusing a freed one", {
+    srt_dict *d = srt_dict_new(1024);
+    char key[32];
+    for (int64_t i = 0; i < 500; ++i) {
+      snprintf(key, sizeof(key), "var_%ld", i);
+      srt_dict_set(d, key, srt_value_new_int64(i));
+    }
+
+    srt_key k = SRT_KEY("var_499");
+    assert(srt_dict_get_k(d, &k)->int64 == 499);
+    srt_dict_free(d);
+
+    d = srt_dict_new(2);
+    assert(srt_dict_get_k(d, &k) == NULL);
+    srt_dict_set(d, "var_499", srt_value_new_int64(1));
+    assert(srt_dict_get_k(d, &k)->int64 == 1);
+    srt_dict_free(d);
+  });
+
+  TEST("keeps the long keys it is handed", {
+    srt_dict *d = srt_dict_new(4);
+    char *long_key = strdup("a_task_data_variable_with_a_long_name");
+
+    assert(srt_dict_set_take(d, long_key, srt_value_new_int64(1)));
+    assert(srt_dict_set_take(d, strdup("id"), srt_value_new_int64(2)));
+    assert(srt_dict_set_take(d, strdup("id"), srt_value_new_int64(3)));
+
+    assert(srt_dict_len(d) == 2);
+    assert(srt_dict_get(d, "id")->int64 == 3);
+    assert(srt_dict_get(d, "a_task_data_variable_with_a_long_name")->int64 ==
+           1);
+    srt_dict_free(d);
+  });
+
+  TEST("drops the dicts it holds", {
+    srt_dict *root = srt_dict_new(4);
+    srt_dict *a = srt_dict_new(4);
+    srt_dict *b = srt_dict_new(4);
+    srt_value taken;
+
+    assert(srt_dict_set(a, "n", srt_value_new_int64(1)));
+    assert(srt_dict_set(b, "n", srt_value_new_int64(2)));
+    assert(srt_dict_set(root, "a", srt_value_new_dict(a)));
+    assert(srt_dict_set(root, "b", srt_value_new_dict(srt_dict_share(b))));
+
+    assert(srt_dict_set(root, "a", srt_value_new_dict(b)));
+    assert(srt_dict_delete(root, "b"));
+    assert(srt_dict_take(root, "a", &taken));
+    assert(taken.dict == b);
+    assert(srt_dict_get(b, "n")->int64 == 2);
+
+    assert(srt_dict_set(root, "a", srt_value_new_dict(taken.dict)));
+    srt_dict_free(root);
+  });
+
+  TEST("fixed dicts find every key of their set", {
+    for (size_t len = 1; len <= 300; len += len < 20 ? 1 : 37) {
+      check_fixed_dict(len);
+    }
+
+    assert(srt_fixed_dict_new(duplicate_keys, 3) == NULL);
+    assert(srt_fixed_dict_new(duplicate_keys, 0) == NULL);
+
+    srt_dict *nested = srt_dict_new(4);
+    srt_fixed_dict *d = srt_fixed_dict_new_with_kvs(
+        3, "id", srt_value_new_int64(42), "vip", srt_value_new_bool(true),
+        "address", srt_value_new_dict(nested));
+    assert(srt_fixed_dict_get(d, "id")->int64 == 42);
+    assert(srt_fixed_dict_get(d, "vip")->b);
+    assert(srt_fixed_dict_get(d, "address")->dict == nested);
+    assert(srt_fixed_dict_set(d, "address", srt_value_new_int64(0)));
+    srt_fixed_dict_free(d);
+  });
+
+  TEST("fixed dicts free the strs and arrays they own", {
+    srt_fixed_dict *d = srt_fixed_dict_new(owning_keys, 2);
+    srt_value v;
+
+    assert(srt_value_set_str(&v, "a str too long to be inline", 27, NULL));
+    assert(v.owned && srt_fixed_dict_put(d, "name", v));
+    assert(srt_fixed_dict_put(d, "name", v));
+    assert(strcmp(srt_value_str(srt_fixed_dict_get(d, "name")),
+                  "a str too long to be inline") == 0);
+
+    assert(srt_value_set_str(&v, "another str too long to be inline", 33,
+                             NULL));
+    assert(srt_fixed_dict_put(d, "name", v));
+
+    v.tag = SRT_INT64_ARRAY;
+    v.owned = true;
+    assert((v.array = srt_array_new(totals, 3, NULL)));
+    assert(srt_fixed_dict_put(d, "totals", v));
+    assert(srt_fixed_dict_put(d, "totals", v));
+    assert(srt_fixed_dict_get(d, "totals")->array == v.array);
+
+    srt_fixed_dict_free(d);
+  });
+
+  TEST("reports how full dicts are and how far lookups go", {
+    srt_dict *d = srt_dict_new(4);
+    srt_dict_stats stats;
+    char key[32];
+
+    for (int i = 0; i < 1000; ++i) {
+      snprintf(key, sizeof(key), "var_%d", i);
+      assert(srt_dict_set(d, key, srt_value_new_int64(i)));
+    }
+
+    for (int i = 0; i < 1000; i += 3) {
+      snprintf(key, sizeof(key), "var_%d", i);
+      assert(srt_dict_delete(d, key));
+    }
+
+    srt_dict_get_stats(d, &stats);
+    assert(stats.len == 666 && stats.capacity >= stats.len);
+    assert(stats.load_factor > 0 && stats.load_factor <= 1);
+    assert(stats.avg_probe >= 1 && stats.max_probe >= 1);
+    assert(stats.bytes > stats.capacity);
+
+    size_t probed = 0;
+
+    for (int i = 0; i < SRT_DICT_PROBE_HISTOGRAM; ++i) {
+      probed += stats.probe_histogram[i];
+    }
+
+    assert(probed + stats.migrating == stats.len);
+    srt_dict_free(d);
+  });
+
+  TEST("copies short strs with their value", {
+    srt_value a;
+    assert(srt_value_set_str(&a, "APPROVED", 8, NULL));
+    srt_value b = a;
+
+    assert(srt_value_str(&b) != srt_value_str(&a));
+    assert(strcmp(srt_value_str(&b), "APPROVED") == 0);
+
+    assert(srt_value_set_str(&a, "a str too long to be inline", 27, NULL));
+    assert(strcmp(srt_value_str(&a), "a str too long to be inline") == 0);
+    free(a.str);
+
+    assert(srt_value_set_str(&a, NULL, 0, NULL));
+    assert(a.tag == SRT_STR && srt_value_str(&a) == NULL);
+  });
+
+  TEST("can hold short and long keys", {
+    srt_dict *d = srt_dict_new(4);
+    const char *long_key = "a_task_data_variable_with_a_long_name";
+
+    assert(srt_dict_set(d, "id", srt_value_new_int64(1)));
+    assert(srt_dict_set(d, long_key, srt_value_new_int64(2)));
+    assert(srt_dict_set(d, "id", srt_value_new_int64(3)));
+
+    assert(srt_dict_len(d) == 2);
+    assert(srt_dict_get(d, "id")->int64 == 3);
+    assert(srt_dict_get(d, long_key)->int64 == 2);
+
+    assert(srt_dict_delete(d, long_key));
+    assert(srt_dict_get(d, long_key) == NULL);
+
+    srt_dict_free(d);
+  });
+
+  TEST("hashes every byte of a key", {
+    assert(srt_hash_str("ax", 0) != srt_hash_str("bx", 0));
+    assert(srt_hash_str("x", 0) != srt_hash_str("", 0));
+    assert(srt_hash_str("customer_order_id", 0) !=
+           srt_hash_str("customer_order_ie", 0));
+    assert(srt_hash_str("ax", 1) != srt_hash_str("ax", 2));
+  });
+
+  TEST("seeds keys whose words match the hash constants", {
+    uint8_t a[40] = {0};
+    uint8_t b[40] = {0};
+    const uint64_t p1 = 0xe7037ed1a0b428dbull;
+    memcpy(a, &p1, sizeof(p1));
+    memcpy(b, &p1, sizeof(p1));
+    b[8] = 1;
+
+    for (uint64_t seed = 1; seed < 5; ++seed) {
+      assert(srt_hash_bytes(a, sizeof(a), seed) !=
+             srt_hash_bytes(b, sizeof(b), seed));
+    }
+  });
+
+  TEST("hamt versions stay as they were built", {
+    char key[16];
+    srt_hamt *v1 = NULL;
+
+    for (int64_t i = 0; i < 1000; ++i) {
+      snprintf(key, sizeof(key), "k%ld", i);
+      srt_hamt *next = hamt_set(v1, key, srt_hash_str(key, 0), i);
+      srt_hamt_release(v1);
+      v1 = next;
+    }
+
+    // held twice, so the set copies v1 rather than change it in place
+    srt_hamt_retain(v1);
+    srt_hamt *v2 = hamt_set(v1, "k0", srt_hash_str("k0", 0), -2);
+    srt_hamt *v3;
+    assert(srt_hamt_delete(v2, "k500", srt_hash_str("k500", 0), &v3));
+
+    assert(srt_hamt_len(v1) == 1000 && srt_hamt_len(v3) == 999);
+    assert(hamt_get(v1, "k0", srt_hash_str("k0", 0)) == 0);
+    assert(hamt_get(v2, "k0", srt_hash_str("k0", 0)) == -2);
+    assert(hamt_get(v2, "k500", srt_hash_str("k500", 0)) == 500);
+    assert(hamt_get(v3, "k500", srt_hash_str("k500", 0)) == -1);
+    assert(hamt_get(v3, "k999", srt_hash_str("k999", 0)) == 999);
+
+    srt_hamt_release(v1);
+    srt_hamt_release(v1);
+    srt_hamt_release(v2);
+    srt_hamt_release(v3);
+  });
+
+  TEST("hamt keeps keys with colliding hashes apart", {
+    const uint64_t top = UINT64_C(1) << 62;
+    srt_hamt *a = hamt_set(NULL, "a", 7, 1);
+    srt_hamt *b = hamt_set(a, "b", 7, 2);
+    srt_hamt *c = hamt_set(b, "c", 7 | top, 3);
+    srt_hamt *d = hamt_set(c, "d", 8, 4);
+    srt_hamt *e;
+    assert(srt_hamt_delete(d, "b", 7, &e));
+
+    assert(hamt_get(d, "a", 7) == 1 && hamt_get(d, "b", 7) == 2);
+    assert(hamt_get(d, "c", 7 | top) == 3 && hamt_get(d, "c", 7) == -1);
+    assert(hamt_get(e, "b", 7) == -1 && hamt_get(e, "a", 7) == 1);
+    assert(srt_hamt_len(d) == 4 && srt_hamt_len(e) == 3);
+
+    srt_hamt *f = hamt_set(e, "c", 7 | top, 5);
+    assert(hamt_get(f, "c", 7 | top) == 5 && srt_hamt_len(f) == 3);
+
+    srt_hamt_release(a);
+    srt_hamt_release(b);
+    srt_hamt_release(c);
+    srt_hamt_release(d);
+    srt_hamt_release(e);
+    srt_hamt_release(f);
+  });
+
+  TEST("grows past its initial capacity", {
+    srt_dict *d = srt_dict_new(2);
+    char key[32];
+
+    for (int64_t i = 0; i < 100000; ++i) {
+      snprintf(key, sizeof(key), "key%ld", i);
+      assert(srt_dict_set(d, key, srt_value_new_int64(i)));
+    }
+
+    assert(srt_dict_len(d) == 100000);
+
+    for (int64_t i = 0; i < 100000; ++i) {
+      snprintf(key, sizeof(key), "key%ld", i);
+      srt_value *v = srt_dict_get(d, key);
+      assert(v != NULL);
+      assert(v->int64 == i);
+    }
+
+    srt_dict_free(d);
+  });
+
+  TEST("can overwrite and delete while growing", {
+    srt_dict *d = srt_dict_new(4);
+    char key[32];
+
+    for (int64_t i = 0; i < 100000; ++i) {
+      snprintf(key, sizeof(key), "key%ld", i);
+      assert(srt_dict_set(d, key, srt_value_new_int64(i)));
+      assert(srt_dict_set(d, key, srt_value_new_int64(-i)));
+
+      if (i % 2) {
+        assert(srt_dict_delete(d, key));
+      }
+    }
+
+    assert(srt_dict_len(d) == 50000);
+
+    for (int64_t i = 0; i < 100000; ++i) {
+      snprintf(key, sizeof(key), "key%ld", i);
+      srt_value *v = srt_dict_get(d, key);
+
+      if (i % 2) {
+        assert(v == NULL);
+      } else {
+        assert(v != NULL);
+        assert(v->int64 == -i);
+      }
+    }
+
+    srt_dict_free(d);
+  });
+
+  END_TESTS;
+}
+
+static const char *invalid_json[] = {
+    "[]",
+    "{\"x\": 1.5}",
+    "{\"x\": [1, \"a\"]}",
+    "{\"x\": [[1]]}",
+    "{\"x\": [1,]}",
+    "{\"x\": [01]}",
+    "{\"x\": 99999999999999999999}",
+    "{\"x\": 01}",
+    "{\"x\": \"\\u0000\"}",
+    "{\"x\": \"\\ud800\"}",
+    "{\"x\": tru}",
+    "{\"x\": 1,}",
+    "{\"x\": 1} {}",
+    "{\"x\": \"unterminated",
+};
+
+static const int64_t line_totals[] = {1250, -40, 990, 0, 310};
+
+static const double line_weights[] = {0.5, 2.25, -1e300, 0.125};
+
+//
+// the aggregates against plain loops, over lengths that leave every possible
+// tail after the vector loops.
+//
+static void check_int64_aggregates(const int64_t *v, size_t len) {
+  int64_t sum = 0;
+  int64_t min = INT64_MAX;
+  int64_t max = INT64_MIN;
+
+  for (size_t i = 0; i < len; ++i) {
+    sum = (int64_t)((uint64_t)sum + (uint64_t)v[i]);
+    min = v[i] < min ? v[i] : min;
+    max = v[i] > max ? v[i] : max;
+  }
+
+  assert(srt_int64_array_sum(v, len) == sum);
+  assert(srt_int64_array_min(v, len) == min);
+  assert(srt_int64_array_max(v, len) == max);
+
+  for (int64_t x = -2; x <= 2; ++x) {
+    size_t n[6] = {0};
+
+    for (size_t i = 0; i < len; ++i) {
+      n[SRT_CMP_LT] += v[i] < x;
+      n[SRT_CMP_LE] += v[i] <= x;
+      n[SRT_CMP_EQ] += v[i] == x;
+      n[SRT_CMP_NE] += v[i] != x;
+      n[SRT_CMP_GE] += v[i] >= x;
+      n[SRT_CMP_GT] += v[i] > x;
+    }
+
+    for (srt_cmp cmp = SRT_CMP_LT; cmp <= SRT_CMP_GT; ++cmp) {
+      assert(srt_int64_array_count_if(v, len, cmp, x) == n[cmp]);
+    }
+  }
 }
 
-static void test_dict() {
-  START_TESTS;
+static void check_double_aggregates(const double *v, size_t len) {
+  double min = INFINITY;
+  double max = -INFINITY;
+  double sum = 0;
 
-  TEST("can new and free", {
-    srt_dict *d = srt_dict_new(2);
-    srt_dict_free(d);
-  });
+  for (size_t i = 0; i < len; ++i) {
+    min = v[i] < min ? v[i] : min;
+    max = v[i] > max ? v[i] : max;
+    sum += v[i];
+  }
 
-  TEST("can new with kvs and free", {
-    srt_dict *d = srt_dict_new_with_kvs(3, "key1", srt_value_new_bool(true),
-                                        "key2", srt_value_new_int64(13), "key3",
-                                        srt_value_new_bool(false));
-    assert(srt_dict_len(d) == 3);
-    srt_dict_free(d);
-  });
+  assert(srt_double_array_min(v, len) == min);
+  assert(srt_double_array_max(v, len) == max);
+  assert(isnan(sum) ? isnan(srt_double_array_sum(v, len))
+                    : fabs(srt_double_array_sum(v, len) - sum) < 1e-9);
 
-  END_TESTS;
+  for (double x = -1; x <= 1; x += 0.5) {
+    size_t n[6] = {0};
+
+    for (size_t i = 0; i < len; ++i) {
+      n[SRT_CMP_LT] += v[i] < x;
+      n[SRT_CMP_LE] += v[i] <= x;
+      n[SRT_CMP_EQ] += v[i] == x;
+      n[SRT_CMP_NE] += v[i] != x;
+      n[SRT_CMP_GE] += v[i] >= x;
+      n[SRT_CMP_GT] += v[i] > x;
+    }
+
+    for (srt_cmp cmp = SRT_CMP_LT; cmp <= SRT_CMP_GT; ++cmp) {
+      assert(srt_double_array_count_if(v, len, cmp, x) == n[cmp]);
+    }
+  }
 }
 
 static void test_task_data() {
@@ -98,8 +1526,6 @@ static void test_task_data() {
     const int32_t result = srt_task_data_try_get_dict(ctx, "x", &value);
     assert(result == SRT_SUCCESS);
     assert(value == d);
-
-    srt_dict_free(d);
   });
 
   TEST_WITH_CTX("can set and get int64", {
@@ -174,6 +1600,793 @@ static void test_task_data() {
     assert(srt_task_data_get_int64(ctx, "x") == 13);
   });
 
+  TEST_WITH_CTX("can set and get int64 with a key handle", {
+    srt_key x = SRT_KEY("x");
+    srt_task_data_set_int64_k(ctx, &x, 11);
+    assert(srt_task_data_get_int64_k(ctx, &x) == 11);
+    assert(srt_task_data_get_int64(ctx, "x") == 11);
+
+    srt_task_data_set_int64(ctx, "x", 22);
+    assert(srt_task_data_get_int64_k(ctx, &x) == 22);
+  });
+
+  TEST_WITH_CTX("key handle survives growth and delete", {
+    srt_key x = SRT_KEY("x");
+    srt_task_data_set_int64_k(ctx, &x, 11);
+    assert(srt_task_data_get_int64_k(ctx, &x) == 11);
+
+    char key[32];
+    for (int64_t i = 0; i < 1000; ++i) {
+      snprintf(key, sizeof(key), "var_%ld", i);
+      srt_task_data_set_int64(ctx, key, i);
+      assert(srt_task_data_get_int64_k(ctx, &x) == 11);
+    }
+
+    srt_task_data_delete_k(ctx, &x);
+    assert(srt_task_data_try_get_int64_k(ctx, &x, NULL) == SRT_UNKNOWN_KEY);
+
+    srt_task_data_set_bool_k(ctx, &x, true);
+    assert(srt_task_data_get_bool_k(ctx, &x) == true);
+  });
+
+  TEST_WITH_CTX("can hold 100k int64", {
+    char key[32];
+
+    for (int64_t i = 0; i < 100000; ++i) {
+      snprintf(key, sizeof(key), "var_%ld", i);
+      srt_task_data_set_int64(ctx, key, i * 3);
+    }
+
+    for (int64_t i = 0; i < 100000; ++i) {
+      snprintf(key, sizeof(key), "var_%ld", i);
+      assert(srt_task_data_get_int64(ctx, key) == i * 3);
+    }
+  });
+
+  TEST("can save and load nested dicts and strings", {
+    srt_context *ctx = srt_ctx_new(false);
+    char name[] = "Jane Doe";
+    char city[] = "a city name longer than an inline key";
+
+    srt_dict *address = srt_ctx_dict_new(ctx, 4);
+    srt_dict_set(address, "city", srt_value_new_str(city));
+    srt_dict_set(address, "zip", srt_value_new_int64(12345));
+
+    srt_dict *customer = srt_ctx_dict_new(ctx, 4);
+    srt_dict_set(customer, "name", srt_value_new_str(name));
+    srt_dict_set(customer, "address", srt_value_new_dict(address));
+    srt_dict_set(customer, "nickname", srt_value_new_str(NULL));
+
+    srt_task_data_set_int64(ctx, "order_total", -42);
+    srt_task_data_set_bool(ctx, "approved", true);
+    srt_task_data_set_dict(ctx, "customer", customer);
+    assert(srt_task_data_save(ctx, IMAGE_PATH) == SRT_SUCCESS);
+    srt_ctx_free(ctx);
+
+    ctx = srt_ctx_new(false);
+    assert(srt_task_data_load(ctx, IMAGE_PATH) == SRT_SUCCESS);
+    assert(srt_task_data_get_int64(ctx, "order_total") == -42);
+    assert(srt_task_data_get_bool(ctx, "approved") == true);
+
+    srt_dict *c = srt_task_data_get_dict(ctx, "customer");
+    assert(strcmp(srt_value_str(srt_dict_get(c, "name")), "Jane Doe") == 0);
+    assert(srt_value_str(srt_dict_get(c, "nickname")) == NULL);
+
+    srt_dict *a = srt_dict_get(c, "address")->dict;
+    assert(strcmp(srt_value_str(srt_dict_get(a, "city")), city) == 0);
+    assert(srt_dict_get(a, "zip")->int64 == 12345);
+    assert(srt_dict_len(a) == 2);
+
+    srt_ctx_free(ctx);
+    remove(IMAGE_PATH);
+  });
+
+  TEST("load hides overwritten and deleted keys", {
+    srt_context *ctx = srt_ctx_new(false);
+    char key[32];
+
+    for (int64_t i = 0; i < 1000; ++i) {
+      snprintf(key, sizeof(key), "var_%ld", i);
+      srt_task_data_set_int64(ctx, key, i);
+    }
+
+    assert(srt_task_data_save(ctx, IMAGE_PATH) == SRT_SUCCESS);
+    assert(srt_task_data_load(ctx, IMAGE_PATH) == SRT_SUCCESS);
+
+    srt_task_data_set_int64(ctx, "var_1", -1);
+    srt_task_data_delete(ctx, "var_2");
+    assert(srt_task_data_get_int64(ctx, "var_1") == -1);
+    assert(srt_task_data_try_get_int64(ctx, "var_2", NULL) == SRT_UNKNOWN_KEY);
+    assert(srt_task_data_try_delete(ctx, "var_2") == SRT_UNKNOWN_KEY);
+
+    assert(srt_task_data_save(ctx, IMAGE_PATH) == SRT_SUCCESS);
+    srt_ctx_free(ctx);
+
+    ctx = srt_ctx_new(false);
+    assert(srt_task_data_load(ctx, IMAGE_PATH) == SRT_SUCCESS);
+    assert(srt_task_data_get_int64(ctx, "var_1") == -1);
+    assert(srt_task_data_try_get_int64(ctx, "var_2", NULL) == SRT_UNKNOWN_KEY);
+
+    for (int64_t i = 3; i < 1000; ++i) {
+      snprintf(key, sizeof(key), "var_%ld", i);
+      assert(srt_task_data_get_int64(ctx, key) == i);
+    }
+
+    srt_ctx_free(ctx);
+    remove(IMAGE_PATH);
+  });
+
+  TEST_WITH_CTX("load rejects missing and damaged images", {
+    srt_task_data_set_int64(ctx, "x", 11);
+
+    remove(IMAGE_PATH);
+    assert(srt_task_data_load(ctx, IMAGE_PATH) == SRT_IO_ERROR);
+
+    FILE *f = fopen(IMAGE_PATH, "wb");
+    fputs("definitely not a task data image", f);
+    fclose(f);
+
+    assert(srt_task_data_load(ctx, IMAGE_PATH) == SRT_INVALID_IMAGE);
+    assert(srt_task_data_get_int64(ctx, "x") == 11);
+
+    remove(IMAGE_PATH);
+  });
+
+  TEST_WITH_CTX("snapshots restore task data as it was", {
+    char name[] = "Jane Doe";
+    srt_dict *order = srt_ctx_dict_new(ctx, 4);
+
+    srt_task_data_set_int64(ctx, "n", 1);
+    srt_task_data_set_bool(ctx, "flag", true);
+    srt_task_data_set_dict(ctx, "order", order);
+    srt_dict_set(order, "total", srt_value_new_int64(1));
+    srt_dict_set(order, "name", srt_value_new_str(name));
+    srt_snapshot *first = srt_ctx_snapshot(ctx);
+
+    srt_task_data_set_int64(ctx, "n", 2);
+    srt_task_data_delete(ctx, "flag");
+    order = srt_task_data_get_dict(ctx, "order");
+    srt_dict_set(order, "total", srt_value_new_int64(2));
+    srt_task_data_set_int64(ctx, "new", 3);
+    srt_snapshot *second = srt_ctx_snapshot(ctx);
+    assert(first && second);
+
+    assert(srt_ctx_restore(ctx, first) == SRT_SUCCESS);
+    assert(srt_task_data_get_int64(ctx, "n") == 1);
+    assert(srt_task_data_get_bool(ctx, "flag"));
+    assert(srt_task_data_try_get_int64(ctx, "new", NULL) == SRT_UNKNOWN_KEY);
+    order = srt_task_data_get_dict(ctx, "order");
+    assert(srt_dict_get(order, "total")->int64 == 1);
+    assert(strcmp(srt_value_str(srt_dict_get(order, "name")), "Jane Doe") ==
+           0);
+
+    srt_task_data_set_int64(ctx, "n", 5);
+    srt_snapshot *third = srt_ctx_snapshot(ctx);
+
+    assert(srt_ctx_restore(ctx, second) == SRT_SUCCESS);
+    assert(srt_task_data_get_int64(ctx, "n") == 2);
+    assert(srt_task_data_try_get_bool(ctx, "flag", NULL) == SRT_UNKNOWN_KEY);
+    assert(srt_task_data_get_int64(ctx, "new") == 3);
+    order = srt_task_data_get_dict(ctx, "order");
+    assert(srt_dict_get(order, "total")->int64 == 2);
+
+    assert(srt_ctx_restore(ctx, third) == SRT_SUCCESS);
+    assert(srt_task_data_get_int64(ctx, "n") == 5);
+    assert(srt_task_data_get_bool(ctx, "flag"));
+
+    srt_snapshot_free(first);
+    srt_snapshot_free(second);
+    srt_snapshot_free(third);
+  });
+
+  TEST("snapshots outlive the context they were taken of", {
+    srt_context *ctx = srt_ctx_new_seeded(false, 3);
+    srt_task_data_set_int64(ctx, "n", 1);
+    srt_snapshot *taken = srt_ctx_snapshot(ctx);
+    srt_ctx_free(ctx);
+
+    ctx = srt_ctx_new_seeded(false, 4);
+    assert(srt_ctx_restore(ctx, taken) == SRT_SUCCESS);
+    assert(srt_task_data_get_int64(ctx, "n") == 1);
+    srt_snapshot_free(taken);
+
+    srt_task_data_set_int64(ctx, "n", 2);
+    srt_snapshot *again = srt_ctx_snapshot(ctx);
+    srt_task_data_set_int64(ctx, "n", 3);
+    assert(srt_ctx_restore(ctx, again) == SRT_SUCCESS);
+    assert(srt_task_data_get_int64(ctx, "n") == 2);
+
+    srt_snapshot_free(again);
+    srt_ctx_free(ctx);
+  });
+
+  TEST("journal recovers the committed elements", {
+    remove(JOURNAL_PATH);
+    srt_context *ctx = journaled_ctx(1);
+    srt_dict *order = srt_ctx_dict_new(ctx, 4);
+
+    srt_task_data_set_int64(ctx, "n", 1);
+    srt_task_data_set_bool(ctx, "doomed", true);
+    srt_task_data_set_dict(ctx, "order", order);
+    srt_dict_set(order, "total", srt_value_new_int64(10));
+    run_element(ctx, "Task_a");
+
+    srt_task_data_delete(ctx, "doomed");
+    srt_dict_set(srt_task_data_get_dict(ctx, "order"), "total",
+                 srt_value_new_int64(20));
+    run_element(ctx, "Task_b");
+
+    srt_task_data_set_int64(ctx, "n", 2);
+    srt_ctx_free(ctx);
+
+    ctx = journaled_ctx(1);
+    assert(srt_task_data_get_int64(ctx, "n") == 1);
+    assert(srt_task_data_try_get_bool(ctx, "doomed", NULL) == SRT_UNKNOWN_KEY);
+    order = srt_task_data_get_dict(ctx, "order");
+    assert(srt_dict_get(order, "total")->int64 == 20);
+    srt_ctx_free(ctx);
+
+    ctx = journaled_ctx(1);
+    assert(srt_task_data_get_int64(ctx, "n") == 1);
+    srt_ctx_free(ctx);
+    remove(JOURNAL_PATH);
+  });
+
+  TEST("journal drops a torn last transaction", {
+    remove(JOURNAL_PATH);
+    srt_context *ctx = journaled_ctx(1);
+
+    srt_task_data_set_int64(ctx, "n", 1);
+    run_element(ctx, "Task_a");
+    srt_task_data_set_int64(ctx, "n", 2);
+    run_element(ctx, "Task_b");
+    srt_ctx_free(ctx);
+
+    assert(truncate(JOURNAL_PATH, file_size(JOURNAL_PATH) - 3) == 0);
+
+    ctx = journaled_ctx(1);
+    assert(srt_task_data_get_int64(ctx, "n") == 1);
+    srt_ctx_free(ctx);
+    remove(JOURNAL_PATH);
+  });
+
+  TEST("journal writes once per group of commits", {
+    remove(JOURNAL_PATH);
+    srt_context *ctx = journaled_ctx(3);
+    const off_t compacted = file_size(JOURNAL_PATH);
+
+    for (int64_t i = 0; i < 2; ++i) {
+      srt_task_data_set_int64(ctx, "n", i);
+      run_element(ctx, "Task_a");
+    }
+
+    assert(file_size(JOURNAL_PATH) == compacted);
+
+    srt_task_data_set_int64(ctx, "n", 2);
+    run_element(ctx, "Task_a");
+    assert(file_size(JOURNAL_PATH) > compacted);
+
+    srt_ctx_free(ctx);
+    remove(JOURNAL_PATH);
+  });
+
+  TEST("journal rejects files it did not write", {
+    FILE *f = fopen(JOURNAL_PATH, "wb");
+    fputs("definitely not a journal", f);
+    fclose(f);
+
+    srt_context *ctx = srt_ctx_new(false);
+    assert(srt_ctx_journal(ctx, JOURNAL_PATH, SRT_JOURNAL_SYNC_GROUP, 1) ==
+           SRT_INVALID_JOURNAL);
+    srt_ctx_free(ctx);
+    remove(JOURNAL_PATH);
+  });
+
+  TEST_WITH_CTX("can set and get strs", {
+    const char *note = "approved by the regional manager on a second look";
+
+    srt_task_data_set_str(ctx, "status", "APPROVED");
+    srt_task_data_set_str(ctx, "note", note);
+    srt_task_data_set_str(ctx, "nickname", NULL);
+
+    assert(strcmp(srt_task_data_get_str(ctx, "status"), "APPROVED") == 0);
+    assert(strcmp(srt_task_data_get_str(ctx, "note"), note) == 0);
+    assert(srt_task_data_get_str(ctx, "note") != note);
+    assert(srt_task_data_get_str(ctx, "nickname") == NULL);
+
+    srt_task_data_set_str(ctx, "status", srt_task_data_get_str(ctx, "note"));
+    assert(strcmp(srt_task_data_get_str(ctx, "status"), note) == 0);
+
+    srt_task_data_set_int64(ctx, "n", 1);
+    assert(srt_task_data_try_get_str(ctx, "n", &(const char *){NULL}) ==
+           SRT_KEY_TYPE_MISMATCH);
+  });
+
+  TEST_WITH_CTX("owns the dicts set in task data", {
+    srt_dict *order = srt_dict_new(4);
+    srt_dict *customer = srt_dict_new(4);
+    srt_dict *d;
+
+    srt_dict_set(customer, "id", srt_value_new_int64(42));
+    srt_dict_set(order, "customer", srt_value_new_dict(customer));
+    srt_task_data_set_dict(ctx, "order", order);
+
+    srt_task_data_move(ctx, "order", "archived");
+    assert(srt_task_data_try_get_dict(ctx, "order", &d) == SRT_UNKNOWN_KEY);
+    assert(srt_task_data_get_dict(ctx, "archived") == order);
+
+    srt_dict *shared = srt_task_data_share_dict(ctx, "archived");
+    srt_task_data_set_int64(ctx, "archived", 1);
+    assert(srt_dict_get(srt_dict_get(shared, "customer")->dict, "id")->int64 ==
+           42);
+
+    srt_task_data_set_dict(ctx, "order", shared);
+    assert(srt_task_data_take_dict(ctx, "order") == order);
+    assert(srt_task_data_try_take_dict(ctx, "order", &d) == SRT_UNKNOWN_KEY);
+    srt_task_data_set_dict(ctx, "kept", order);
+
+    srt_task_data_set_dict(ctx, "twice", srt_task_data_share_dict(ctx, "kept"));
+    srt_task_data_move(ctx, "kept", "kept");
+    srt_task_data_move(ctx, "kept", "twice");
+    assert(srt_task_data_try_get_dict(ctx, "kept", &d) == SRT_UNKNOWN_KEY);
+    assert(srt_task_data_get_dict(ctx, "twice") == order);
+
+    srt_task_data_move(ctx, "archived", "n");
+    assert(srt_task_data_get_int64(ctx, "n") == 1);
+    assert(srt_task_data_try_move(ctx, "archived", "n") == SRT_UNKNOWN_KEY);
+
+    srt_ctx_reset(ctx);
+    srt_task_data_set_dict(ctx, "order", srt_dict_new(4));
+  });
+
+  TEST_WITH_CTX("set_str_take keeps the str it is given", {
+    char *note = strdup("approved by the regional manager on a second look");
+
+    srt_task_data_set_str_take(ctx, "note", note);
+    srt_task_data_set_str_take(ctx, "status", strdup("APPROVED"));
+    srt_task_data_set_str_take(ctx, "nickname", NULL);
+
+    assert(srt_task_data_get_str(ctx, "note") == note);
+    assert(strcmp(srt_task_data_get_str(ctx, "status"), "APPROVED") == 0);
+    assert(srt_task_data_get_str(ctx, "nickname") == NULL);
+
+    srt_ctx_reset(ctx);
+    srt_task_data_set_str_take(ctx, "note", strdup("freed with the context"));
+  });
+
+  TEST_WITH_CTX("sets strs over and over in bounded memory", {
+    srt_ctx_stats before;
+    srt_ctx_stats after;
+    char status[48];
+
+    srt_task_data_set_str(ctx, "status", "waiting for the approval step");
+    srt_task_data_set_str_take(ctx, "note", strdup("reminded them twice"));
+    srt_ctx_get_stats(ctx, &before);
+
+    for (int i = 0; i < 100000; ++i) {
+      snprintf(status, sizeof(status), "approved after %d reminders", i);
+      srt_task_data_set_str(ctx, "status", status);
+      srt_task_data_set_str_take(ctx, "note", strdup(status));
+    }
+
+    srt_ctx_get_stats(ctx, &after);
+    assert(after.allocs == before.allocs);
+    assert(after.arena_bytes == before.arena_bytes);
+    assert(after.value_bytes == 2 * (strlen(status) + 1));
+    assert(strcmp(srt_task_data_get_str(ctx, "note"), status) == 0);
+
+    srt_task_data_delete(ctx, "note");
+    srt_task_data_set_str(ctx, "status", NULL);
+  });
+
+  TEST_WITH_CTX("can set, get and append arrays", {
+    const int64_t *totals;
+    const double *weights;
+    size_t len;
+
+    srt_task_data_set_int64_array(ctx, "totals", line_totals, 5);
+    totals = srt_task_data_get_int64_array(ctx, "totals", &len);
+    assert(len == 5 && memcmp(totals, line_totals, sizeof(line_totals)) == 0);
+
+    for (int64_t i = 0; i < 100; ++i) {
+      srt_task_data_append_int64(ctx, "totals", i);
+    }
+
+    totals = srt_task_data_get_int64_array(ctx, "totals", &len);
+    assert(len == 105 && totals[2] == 990 && totals[104] == 99);
+
+    for (int i = 0; i < 3; ++i) {
+      srt_task_data_append_double(ctx, "weights", line_weights[i]);
+    }
+
+    weights = srt_task_data_get_double_array(ctx, "weights", &len);
+    assert(len == 3 && weights[1] == 2.25);
+
+    assert(srt_task_data_try_get_double_array(ctx, "totals", &weights, &len) ==
+           SRT_KEY_TYPE_MISMATCH);
+    assert(srt_task_data_try_append_int64(ctx, "weights", 1) ==
+           SRT_KEY_TYPE_MISMATCH);
+    assert(srt_task_data_try_get_int64_array(ctx, "none", &totals, &len) ==
+           SRT_UNKNOWN_KEY);
+
+    srt_task_data_set_double_array(ctx, "weights", NULL, 0);
+    srt_task_data_get_double_array(ctx, "weights", &len);
+    assert(len == 0);
+  });
+
+  TEST_WITH_CTX("reports the memory of an instance", {
+    srt_ctx_stats stats;
+    srt_dict *address = srt_ctx_dict_new(ctx, 4);
+
+    srt_task_data_set_int64(ctx, "id", 1);
+    srt_task_data_set_str(ctx, "a_task_data_variable_with_a_long_name",
+                          "a str too long to be inline");
+    srt_task_data_set_int64_array(ctx, "totals", line_totals, 5);
+    srt_dict_set(address, "city", srt_value_new_int64(0));
+    srt_task_data_set_dict(ctx, "address", address);
+
+    srt_ctx_get_stats(ctx, &stats);
+    assert(stats.vars == 4 && stats.dicts == 2);
+    assert(stats.key_bytes == 38);
+    assert(stats.value_bytes >= 28 + 5 * sizeof(int64_t));
+    assert(stats.dict_bytes > 0 && stats.allocs > 0);
+    assert(stats.arena_bytes > 0 && stats.reserved_bytes >= stats.arena_bytes);
+    assert(stats.peak_bytes >= stats.arena_bytes);
+
+    const size_t peak = stats.peak_bytes;
+    srt_ctx_reset(ctx);
+    srt_ctx_get_stats(ctx, &stats);
+    assert(stats.vars == 0 && stats.key_bytes == 0 && stats.value_bytes == 0);
+    assert(stats.peak_bytes == peak && stats.arena_bytes < peak);
+  });
+
+  TEST_WITH_CTX("sets and appends arrays in bounded memory", {
+    static const char doc[] = "{\"scores\": [1, 2]}";
+    FILE *in = fmemopen((void *)doc, sizeof(doc) - 1, "r");
+    srt_ctx_stats before;
+    srt_ctx_stats after;
+    const int64_t *totals;
+    const double *weights;
+    size_t len;
+
+    assert(srt_task_data_read_json(ctx, in) == SRT_SUCCESS);
+    fclose(in);
+    srt_task_data_set_int64_array(ctx, "totals", line_totals, 5);
+    srt_task_data_append_double(ctx, "weights", 0.5);
+    srt_task_data_append_int64(ctx, "scores", 3);
+    srt_ctx_get_stats(ctx, &before);
+
+    for (int i = 0; i < 100000; ++i) {
+      srt_task_data_set_int64_array(ctx, "totals", line_totals, 1 + i % 5);
+      srt_task_data_append_double(ctx, "weights", i);
+    }
+
+    srt_ctx_get_stats(ctx, &after);
+    assert(after.allocs == before.allocs);
+    assert(after.arena_bytes == before.arena_bytes);
+
+    weights = srt_task_data_get_double_array(ctx, "weights", &len);
+    assert(len == 100001 && weights[100000] == 99999);
+    assert(srt_task_data_get_int64_array(ctx, "scores", &len)[2] == 3);
+
+    totals = srt_task_data_get_int64_array(ctx, "totals", &len);
+    srt_task_data_set_int64_array(ctx, "totals", totals + 1, len - 1);
+    totals = srt_task_data_get_int64_array(ctx, "totals", &len);
+    assert(len == 4 && totals[0] == -40 && totals[3] == 310);
+
+    srt_task_data_set_double_array(ctx, "weights", NULL, 0);
+    srt_task_data_delete(ctx, "totals");
+  });
+
+  TEST("array aggregates agree with plain loops", {
+    int64_t int64s[37];
+    double doubles[37];
+
+    for (size_t i = 0; i < 37; ++i) {
+      int64s[i] = (int64_t)(i * 7 % 5) - 2;
+      doubles[i] = ((double)(i * 7 % 5) - 2) / 2;
+    }
+
+    int64s[11] = INT64_MAX;
+    int64s[12] = INT64_MIN;
+
+    for (size_t len = 0; len <= 37; ++len) {
+      check_int64_aggregates(int64s, len);
+      check_double_aggregates(doubles, len);
+    }
+
+    doubles[0] = NAN;
+    doubles[5] = NAN;
+    doubles[36] = NAN;
+
+    for (size_t len = 0; len <= 37; ++len) {
+      check_double_aggregates(doubles, len);
+    }
+
+    assert(srt_double_array_min(doubles, 1) == INFINITY);
+    assert(srt_double_array_count_if(doubles, 1, SRT_CMP_NE, 0) == 1);
+  });
+
+  TEST("arrays survive snapshots, images, json and journals", {
+    srt_context *ctx = srt_ctx_new(false);
+    size_t len;
+
+    srt_task_data_set_int64_array(ctx, "totals", line_totals, 5);
+    srt_task_data_set_double_array(ctx, "weights", line_weights, 4);
+    srt_task_data_append_double(ctx, "weights", NAN);
+    srt_snapshot *snapshot = srt_ctx_snapshot(ctx);
+    assert(srt_task_data_save(ctx, IMAGE_PATH) == SRT_SUCCESS);
+
+    char *json;
+    size_t json_len;
+    FILE *out = open_memstream(&json, &json_len);
+    assert(srt_task_data_write_json(ctx, out) == SRT_SUCCESS);
+    fclose(out);
+
+    srt_task_data_append_int64(ctx, "totals", 7);
+    srt_snapshot *appended = srt_ctx_snapshot(ctx);
+
+    for (int how = 0; how < 3; ++how) {
+      srt_context *to = srt_ctx_new(false);
+      FILE *in = fmemopen(json, json_len, "r");
+
+      assert(how != 0 || srt_ctx_restore(to, snapshot) == SRT_SUCCESS);
+      assert(how != 1 || srt_task_data_load(to, IMAGE_PATH) == SRT_SUCCESS);
+      assert(how != 2 || srt_task_data_read_json(to, in) == SRT_SUCCESS);
+      fclose(in);
+
+      const int64_t *totals = srt_task_data_get_int64_array(to, "totals", &len);
+      assert(len == 5 && memcmp(totals, line_totals, sizeof(line_totals)) == 0);
+
+      const double *weights =
+          srt_task_data_get_double_array(to, "weights", &len);
+      assert(len == 5 && memcmp(weights, line_weights, 4 * sizeof(double)) ==
+                             0);
+      assert(isnan(weights[4]));
+
+      srt_task_data_append_int64(to, "totals", 8);
+      totals = srt_task_data_get_int64_array(to, "totals", &len);
+      assert(len == 6 && totals[0] == 1250 && totals[5] == 8);
+      srt_ctx_free(to);
+    }
+
+    assert(srt_ctx_restore(ctx, appended) == SRT_SUCCESS);
+    assert(srt_task_data_get_int64_array(ctx, "totals", &len)[5] == 7);
+
+    free(json);
+    srt_snapshot_free(snapshot);
+    srt_snapshot_free(appended);
+    srt_ctx_free(ctx);
+    remove(IMAGE_PATH);
+
+    remove(JOURNAL_PATH);
+    ctx = journaled_ctx(1);
+    srt_task_data_set_int64_array(ctx, "totals", line_totals, 5);
+    run_element(ctx, "Task_a");
+    srt_task_data_append_int64(ctx, "totals", 7);
+    run_element(ctx, "Task_b");
+    srt_task_data_append_int64(ctx, "totals", 8);
+    srt_ctx_free(ctx);
+
+    ctx = journaled_ctx(1);
+    const int64_t *totals = srt_task_data_get_int64_array(ctx, "totals", &len);
+    assert(len == 6 && totals[0] == 1250 && totals[5] == 7);
+    srt_ctx_free(ctx);
+    remove(JOURNAL_PATH);
+  });
+
+  TEST("strs survive snapshots, images and json", {
+    const char *note = "approved by the regional manager on a second look";
+    srt_context *ctx = srt_ctx_new(false);
+
+    srt_task_data_set_str(ctx, "status", "APPROVED");
+    srt_task_data_set_str(ctx, "note", note);
+    srt_snapshot *snapshot = srt_ctx_snapshot(ctx);
+    assert(srt_task_data_save(ctx, IMAGE_PATH) == SRT_SUCCESS);
+
+    char *json;
+    size_t json_len;
+    FILE *out = open_memstream(&json, &json_len);
+    assert(srt_task_data_write_json(ctx, out) == SRT_SUCCESS);
+    fclose(out);
+
+    for (int how = 0; how < 3; ++how) {
+      srt_context *to = srt_ctx_new(false);
+      FILE *in = fmemopen(json, json_len, "r");
+
+      assert(how != 0 || srt_ctx_restore(to, snapshot) == SRT_SUCCESS);
+      assert(how != 1 || srt_task_data_load(to, IMAGE_PATH) == SRT_SUCCESS);
+      assert(how != 2 || srt_task_data_read_json(to, in) == SRT_SUCCESS);
+      fclose(in);
+
+      assert(strcmp(srt_task_data_get_str(to, "status"), "APPROVED") == 0);
+      assert(strcmp(srt_task_data_get_str(to, "note"), note) == 0);
+      srt_ctx_free(to);
+    }
+
+    free(json);
+    srt_snapshot_free(snapshot);
+    srt_ctx_free(ctx);
+    remove(IMAGE_PATH);
+  });
+
+  TEST("json round trips nested objects", {
+    static const char doc[] =
+        "{\n"
+        "  \"order_total\": -9223372036854775808,\n"
+        "  \"approved\": true, \"rejected\": false, \"note\": null,\n"
+        "  \"customer\": {\"name\": \"Zo\\u00eb \\\"Z\\\" \\ud83d\\ude00\",\n"
+        "    \"address\": {\"zip\": 12345, \"lines\": \"a\\nb\"}}\n"
+        "}\n";
+    srt_context *ctx = srt_ctx_new(false);
+    FILE *in = fmemopen((void *)doc, sizeof(doc) - 1, "r");
+    assert(srt_task_data_read_json(ctx, in) == SRT_SUCCESS);
+    fclose(in);
+
+    char *json;
+    size_t json_len;
+    FILE *out = open_memstream(&json, &json_len);
+    assert(srt_task_data_write_json(ctx, out) == SRT_SUCCESS);
+    fclose(out);
+    srt_ctx_free(ctx);
+
+    ctx = srt_ctx_new(false);
+    in = fmemopen(json, json_len, "r");
+    assert(srt_task_data_read_json(ctx, in) == SRT_SUCCESS);
+    fclose(in);
+    free(json);
+
+    assert(srt_task_data_get_int64(ctx, "order_total") == INT64_MIN);
+    assert(srt_task_data_get_bool(ctx, "approved") == true);
+    assert(srt_task_data_get_bool(ctx, "rejected") == false);
+
+    srt_dict *c = srt_task_data_get_dict(ctx, "customer");
+    assert(strcmp(srt_value_str(srt_dict_get(c, "name")),
+                  "Zo\xc3\xab \"Z\" \xf0\x9f\x98\x80") == 0);
+
+    srt_dict *a = srt_dict_get(c, "address")->dict;
+    assert(srt_dict_get(a, "zip")->int64 == 12345);
+    assert(strcmp(srt_value_str(srt_dict_get(a, "lines")), "a\nb") == 0);
+
+    srt_ctx_free(ctx);
+  });
+
+  TEST("paths read nested task data", {
+    static const char doc[] =
+        "{\"order\": {\"customer\": {\"id\": 42, \"name\": \"Zoe\",\n"
+        "  \"vip\": true, \"address\": {}}}, \"other\": {\"id\": 7}}\n";
+    srt_context *ctx = srt_ctx_new(false);
+    FILE *in = fmemopen((void *)doc, sizeof(doc) - 1, "r");
+    assert(srt_task_data_read_json(ctx, in) == SRT_SUCCESS);
+    fclose(in);
+
+    assert(srt_path_compile("") == NULL);
+    assert(srt_path_compile("order..id") == NULL);
+    assert(srt_path_compile(".order") == NULL);
+    assert(srt_path_compile("order.") == NULL);
+
+    srt_path *id = srt_path_compile("order.customer.id");
+    srt_path *name = srt_path_compile("order.customer.name");
+    srt_path *vip = srt_path_compile("order.customer.vip");
+    srt_path *address = srt_path_compile("order.customer.address");
+    srt_path *order = srt_path_compile("order");
+    srt_path *missing = srt_path_compile("order.customer.id.x");
+    int64_t n;
+
+    for (int i = 0; i < 2; ++i) {
+      assert(srt_task_data_get_int64_path(ctx, id) == 42);
+      assert(strcmp(srt_task_data_get_str_path(ctx, name), "Zoe") == 0);
+      assert(srt_task_data_get_bool_path(ctx, vip));
+      assert(srt_dict_len(srt_task_data_get_dict_path(ctx, address)) == 0);
+    }
+
+    assert(srt_task_data_try_get_int64_path(ctx, name, &n) ==
+           SRT_KEY_TYPE_MISMATCH);
+    assert(srt_task_data_try_get_int64_path(ctx, missing, &n) ==
+           SRT_KEY_TYPE_MISMATCH);
+
+    //
+    // a nested dict that is replaced is walked into, not the one cached.
+    //
+    srt_dict *o = srt_task_data_get_dict_path(ctx, order);
+    srt_dict_set(o, "customer", srt_value_new_int64(1));
+    assert(srt_task_data_try_get_int64_path(ctx, id, &n) ==
+           SRT_KEY_TYPE_MISMATCH);
+
+    srt_dict_set(o, "customer",
+                 srt_value_new_dict(srt_task_data_get_dict(ctx, "other")));
+    assert(srt_task_data_get_int64_path(ctx, id) == 7);
+    assert(srt_dict_get_path(o, id) == NULL);
+    assert(srt_task_data_try_get_str_path(ctx, name, &(const char *){NULL}) ==
+           SRT_UNKNOWN_KEY);
+
+    srt_task_data_delete(ctx, "order");
+    assert(srt_task_data_try_get_int64_path(ctx, id, &n) == SRT_UNKNOWN_KEY);
+
+    srt_path_free(id);
+    srt_path_free(name);
+    srt_path_free(vip);
+    srt_path_free(address);
+    srt_path_free(order);
+    srt_path_free(missing);
+    srt_ctx_free(ctx);
+  });
+
+  TEST_WITH_CTX("paths stop at NULL dicts", {
+    srt_path *id = srt_path_compile("order.customer.id");
+    srt_path *customer_id = srt_path_compile("customer.id");
+    srt_dict *order = srt_ctx_dict_new(ctx, 4);
+    int64_t n;
+
+    srt_task_data_set_dict(ctx, "order", NULL);
+    assert(srt_task_data_try_get_int64_path(ctx, id, &n) == SRT_UNKNOWN_KEY);
+
+    srt_dict_set(order, "customer", srt_value_new_dict(NULL));
+    srt_task_data_set_dict(ctx, "order", order);
+    assert(srt_task_data_try_get_int64_path(ctx, id, &n) == SRT_UNKNOWN_KEY);
+    assert(srt_dict_get_path(order, customer_id) == NULL);
+    assert(srt_dict_get_path(NULL, customer_id) == NULL);
+
+    srt_path_free(id);
+    srt_path_free(customer_id);
+  });
+
+  TEST_WITH_CTX("paths see a nested dict replaced between resolves", {
+    srt_path *id = srt_path_compile("order.customer.id");
+    srt_dict *order = srt_dict_new(4);
+    srt_dict *customer = srt_dict_new(4);
+    char key[32];
+
+    srt_dict_set(customer, "id", srt_value_new_int64(1));
+    srt_dict_set(order, "customer", srt_value_new_dict(customer));
+    srt_task_data_set_dict(ctx, "order", order);
+    assert(srt_task_data_get_int64_path(ctx, id) == 1);
+
+    //
+    // the old customer goes first, so the new one may reuse its memory.
+    //
+    srt_dict_set(order, "customer", srt_value_new_int64(0));
+    customer = srt_dict_new(4);
+    for (int64_t i = 0; i < 3; ++i) {
+      snprintf(key, sizeof(key), "var_%ld", i);
+      srt_dict_set(customer, key, srt_value_new_int64(i));
+    }
+    srt_dict_set(customer, "id", srt_value_new_int64(2));
+    srt_dict_set(order, "customer", srt_value_new_dict(customer));
+    assert(srt_task_data_get_int64_path(ctx, id) == 2);
+
+    srt_path_free(id);
+  });
+
+  TEST("json errors go to the log of the context", {
+    char *log;
+    size_t log_len;
+    FILE *out = open_memstream(&log, &log_len);
+    srt_context *ctx = srt_ctx_new(false);
+    assert(srt_ctx_log(ctx, SRT_LOG_ERROR, out));
+
+    FILE *in = fmemopen((void *)"{\n\"x\": tru}", 11, "r");
+    assert(srt_task_data_read_json(ctx, in) == SRT_INVALID_JSON);
+    fclose(in);
+
+    srt_ctx_free(ctx);
+    fclose(out);
+
+    assert(strncmp(log, "invalid task_data json at line 2, column ", 41) == 0);
+    free(log);
+  });
+
+  TEST("json rejects what task data cannot hold", {
+    for (size_t i = 0; i < sizeof(invalid_json) / sizeof(*invalid_json); ++i) {
+      srt_context *ctx = srt_ctx_new(false);
+      const char *doc = invalid_json[i];
+      FILE *in = fmemopen((void *)doc, strlen(doc), "r");
+      assert(srt_task_data_read_json(ctx, in) == SRT_INVALID_JSON);
+      fclose(in);
+      srt_ctx_free(ctx);
+    }
+  });
+
   END_TESTS;
 }
 
@@ -182,6 +2395,7 @@ int main(int argc, char **argv) {
   printf("running tests...\n\n");
 
   test_ctx();
+  test_parallel();
   test_dict();
   test_task_data();
 
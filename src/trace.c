@@ -0,0 +1,266 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+#include "array.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DRAIN_BATCH 256
+#define IDLE_NS (1000 * 1000)
+
+static uint64_t clock_ns(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//
+// producers
+//
+
+static uint8_t copy_str(char dst[SRT_TRACE_STR], const char *src,
+                        uint8_t truncated) {
+  if (!src) {
+    return 0;
+  }
+
+  const size_t len = strnlen(src, SRT_TRACE_STR);
+  memcpy(dst, src, len);
+
+  return len == SRT_TRACE_STR ? truncated : 0;
+}
+
+uint32_t srt_trace_new_id(srt_trace *trace) {
+  return atomic_fetch_add_explicit(&trace->ids, 1, memory_order_relaxed);
+}
+
+//
+// claims a slot by moving head past it. a slot whose sequence lags the
+// position still holds a record the writer has not drained, so the ring is
+// full and the event is counted as dropped.
+//
+void srt_trace_event(srt_trace *trace, uint32_t ctx, srt_trace_type type,
+                     const char *a, const char *b, const srt_value *value,
+                     int32_t result) {
+  size_t pos = atomic_load_explicit(&trace->head, memory_order_relaxed);
+
+  for (;;) {
+    const size_t seq = atomic_load_explicit(&trace->seq[pos & trace->mask],
+                                            memory_order_acquire);
+    const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&trace->head, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      atomic_fetch_add_explicit(&trace->dropped, 1, memory_order_relaxed);
+      return;
+    } else {
+      pos = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    }
+  }
+
+  srt_trace_record *r = &trace->records[pos & trace->mask];
+  *r = (srt_trace_record){
+      .ns = clock_ns(CLOCK_MONOTONIC),
+      .ctx = ctx,
+      .type = type,
+      .result = result,
+  };
+
+  r->flags |= copy_str(r->a, a, SRT_TRACE_A_TRUNCATED);
+
+  if (value) {
+    r->tag = value->tag;
+    r->flags |= SRT_TRACE_HAS_VALUE;
+
+    switch (value->tag) {
+    case SRT_BOOL:
+      r->value = value->b;
+      break;
+    case SRT_INT64:
+      r->value = value->int64;
+      break;
+    case SRT_STR:
+      b = srt_value_str(value);
+      break;
+    case SRT_DICT:
+      break;
+    case SRT_INT64_ARRAY:
+    case SRT_DOUBLE_ARRAY:
+      r->value = (int64_t)value->array->len;
+      break;
+    }
+  }
+
+  r->flags |= copy_str(r->b, b, SRT_TRACE_B_TRUNCATED);
+
+  atomic_store_explicit(&trace->seq[pos & trace->mask], pos + 1,
+                        memory_order_release);
+}
+
+//
+// writer
+//
+
+static void write_records(srt_trace *trace, const srt_trace_record *records,
+                          size_t count) {
+  if (fwrite(records, sizeof(*records), count, trace->out) != count) {
+    trace->failed = true;
+  }
+}
+
+static size_t drain(srt_trace *trace, srt_trace_record *batch) {
+  size_t n = 0;
+
+  while (n < DRAIN_BATCH) {
+    const size_t pos = trace->tail;
+    _Atomic size_t *seq = &trace->seq[pos & trace->mask];
+
+    if (atomic_load_explicit(seq, memory_order_acquire) != pos + 1) {
+      break;
+    }
+
+    batch[n++] = trace->records[pos & trace->mask];
+    atomic_store_explicit(seq, pos + trace->mask + 1, memory_order_release);
+    trace->tail = pos + 1;
+  }
+
+  const uint64_t dropped =
+      atomic_exchange_explicit(&trace->dropped, 0, memory_order_relaxed);
+
+  if (dropped && n < DRAIN_BATCH) {
+    batch[n++] = (srt_trace_record){.ns = clock_ns(CLOCK_MONOTONIC),
+                                    .type = SRT_TRACE_DROPPED,
+                                    .value = dropped};
+  } else if (dropped) {
+    atomic_fetch_add_explicit(&trace->dropped, dropped, memory_order_relaxed);
+  }
+
+  if (n) {
+    write_records(trace, batch, n);
+  }
+
+  return n;
+}
+
+//
+// polls rather than waits on a condition so producers never make a system
+// call. an idle trace costs one wakeup per millisecond.
+//
+static void *writer_main(void *arg) {
+  srt_trace *trace = arg;
+  srt_trace_record *batch = malloc(DRAIN_BATCH * sizeof(*batch));
+  const struct timespec idle = {.tv_nsec = IDLE_NS};
+
+  if (!batch) {
+    trace->failed = true;
+    return NULL;
+  }
+
+  for (;;) {
+    const bool stop = atomic_load_explicit(&trace->stop, memory_order_acquire);
+
+    if (drain(trace, batch)) {
+      continue;
+    }
+
+    if (stop) {
+      break;
+    }
+
+    nanosleep(&idle, NULL);
+  }
+
+  free(batch);
+
+  return NULL;
+}
+
+srt_trace *srt_trace_open(const char *path, size_t capacity) {
+  if (!capacity || capacity & (capacity - 1)) {
+    return NULL;
+  }
+
+  srt_trace *trace = calloc(1, sizeof(*trace));
+  if (!trace) {
+    return NULL;
+  }
+
+  trace->mask = capacity - 1;
+  trace->records = calloc(capacity, sizeof(*trace->records));
+  trace->seq = calloc(capacity, sizeof(*trace->seq));
+
+  if (!trace->records || !trace->seq || !(trace->out = fopen(path, "wb"))) {
+    free(trace->records);
+    free(trace->seq);
+    free(trace);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < capacity; ++i) {
+    atomic_init(&trace->seq[i], i);
+  }
+
+  const srt_trace_header header = {
+      .magic = SRT_TRACE_MAGIC,
+      .version = SRT_TRACE_VERSION,
+      .record_size = sizeof(srt_trace_record),
+      .start_ns = clock_ns(CLOCK_MONOTONIC),
+      .start_unix_ns = clock_ns(CLOCK_REALTIME),
+  };
+
+  if (fwrite(&header, sizeof(header), 1, trace->out) != 1 ||
+      pthread_create(&trace->writer, NULL, writer_main, trace) != 0) {
+    fclose(trace->out);
+    free(trace->records);
+    free(trace->seq);
+    free(trace);
+    return NULL;
+  }
+
+  return trace;
+}
+
+bool srt_trace_close(srt_trace *trace) {
+  if (!trace) {
+    return true;
+  }
+
+  atomic_store_explicit(&trace->stop, true, memory_order_release);
+  pthread_join(trace->writer, NULL);
+
+  bool ok = !trace->failed;
+  ok = fclose(trace->out) == 0 && ok;
+
+  free(trace->records);
+  free(trace->seq);
+  free(trace);
+
+  return ok;
+}
+
+const char *srt_trace_type_name(uint8_t type) {
+  switch (type) {
+  case SRT_TRACE_WILL_RUN:
+    return "will_run";
+  case SRT_TRACE_DID_RUN:
+    return "did_run";
+  case SRT_TRACE_GET:
+    return "get";
+  case SRT_TRACE_SET:
+    return "set";
+  case SRT_TRACE_DELETE:
+    return "delete";
+  case SRT_TRACE_MANUAL_TASK:
+    return "manual_task";
+  case SRT_TRACE_DROPPED:
+    return "dropped";
+  }
+
+  return "unknown";
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "value.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//
+// binary event trace. hooks fill fixed size records into a bounded lock free
+// ring that any number of threads may write to, and a background thread
+// drains it to a file. when the ring is full events are dropped rather than
+// stalling the runtime, and the writer records how many were lost.
+//
+// a trace file is a srt_trace_header followed by srt_trace_records, both in
+// native byte order. build/trace_decode turns one back into text.
+//
+
+#define SRT_TRACE_MAGIC "SRTT"
+#define SRT_TRACE_VERSION 2
+#define SRT_TRACE_STR 18
+
+typedef enum srt_trace_type {
+  SRT_TRACE_WILL_RUN = 1,
+  SRT_TRACE_DID_RUN,
+  SRT_TRACE_GET,
+  SRT_TRACE_SET,
+  SRT_TRACE_DELETE,
+  SRT_TRACE_MANUAL_TASK,
+  SRT_TRACE_DROPPED,
+} srt_trace_type;
+
+//
+// `a` and `b` hold the process and element id, or the key and a string value,
+// cut to SRT_TRACE_STR bytes. they are nul terminated unless the matching
+// truncated flag is set. `ctx` is the id of the context that recorded the
+// event, so that the instances of pool and server workers and the branches
+// of parallel gateways sharing a trace can be told apart.
+//
+
+#define SRT_TRACE_A_TRUNCATED 0x1
+#define SRT_TRACE_B_TRUNCATED 0x2
+#define SRT_TRACE_HAS_VALUE 0x4
+
+typedef struct srt_trace_record {
+  uint64_t ns;
+  int64_t value;
+  int32_t result;
+  uint32_t ctx;
+  uint8_t type;
+  uint8_t tag;
+  uint8_t flags;
+  uint8_t pad;
+  char a[SRT_TRACE_STR];
+  char b[SRT_TRACE_STR];
+} srt_trace_record;
+
+_Static_assert(sizeof(srt_trace_record) == 64, "one record per cache line");
+
+typedef struct srt_trace_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t pad;
+  uint64_t start_ns;
+  uint64_t start_unix_ns;
+} srt_trace_header;
+
+//
+// records[i] is published by storing i + 1 into seq[i & mask] and released
+// back to producers by storing i + capacity.
+//
+
+typedef struct srt_trace {
+  FILE *out;
+  size_t mask;
+  srt_trace_record *records;
+  _Atomic size_t *seq;
+  _Alignas(64) _Atomic size_t head;
+  _Alignas(64) size_t tail;
+  _Atomic uint64_t dropped;
+  _Atomic uint32_t ids;
+  _Atomic bool stop;
+  bool failed;
+  pthread_t writer;
+} srt_trace;
+
+//
+// `capacity` is the number of records the ring holds and must be a power of
+// two.
+//
+
+srt_trace *srt_trace_open(const char *path, size_t capacity);
+
+//
+// drains what is left in the ring, stops the writer and closes the file.
+// false when any write failed.
+//
+
+bool srt_trace_close(srt_trace *trace);
+
+//
+// an id for a context writing to the trace, unique within it. the first
+// context attached gets 0.
+//
+
+uint32_t srt_trace_new_id(srt_trace *trace);
+
+void srt_trace_event(srt_trace *trace, uint32_t ctx, srt_trace_type type,
+                     const char *a, const char *b, const srt_value *value,
+                     int32_t result);
+
+const char *srt_trace_type_name(uint8_t type);
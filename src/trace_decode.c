@@ -0,0 +1,145 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+//
+// turns a binary trace back into text, one event per line with its time in
+// seconds since the trace was opened and the id of the context it came from:
+//
+//   trace_decode run.trace
+//   trace_decode - < run.trace
+//
+
+static void print_str(const char *str, bool truncated) {
+  printf(" %.*s%s", SRT_TRACE_STR, str, truncated ? "..." : "");
+}
+
+static const char *result_name(int32_t result) {
+  switch (result) {
+  case 0:
+    return "ok";
+  case 1:
+    return "unknown_key";
+  case 2:
+    return "type_mismatch";
+  }
+
+  return "error";
+}
+
+static void print_value(const srt_trace_record *r) {
+  const bool b_truncated = r->flags & SRT_TRACE_B_TRUNCATED;
+
+  switch (r->tag) {
+  case SRT_BOOL:
+    printf(" bool %s", r->value ? "true" : "false");
+    break;
+  case SRT_DICT:
+    printf(" dict");
+    break;
+  case SRT_INT64:
+    printf(" int64 %" PRId64, r->value);
+    break;
+  case SRT_STR:
+    printf(" str \"%.*s%s\"", SRT_TRACE_STR, r->b, b_truncated ? "..." : "");
+    break;
+  case SRT_INT64_ARRAY:
+    printf(" int64 array [%" PRId64 "]", r->value);
+    break;
+  case SRT_DOUBLE_ARRAY:
+    printf(" double array [%" PRId64 "]", r->value);
+    break;
+  }
+}
+
+static void print_record(const srt_trace_record *r, uint64_t start_ns) {
+  const uint64_t ns = r->ns - start_ns;
+
+  printf("%6" PRIu64 ".%09" PRIu64, ns / 1000000000, ns % 1000000000);
+
+  //
+  // a dropped record is written by the trace rather than a context.
+  //
+  if (r->type == SRT_TRACE_DROPPED) {
+    printf("  %5s", "-");
+  } else {
+    printf("  %5" PRIu32, r->ctx);
+  }
+
+  printf("  %-11s", srt_trace_type_name(r->type));
+
+  switch (r->type) {
+  case SRT_TRACE_WILL_RUN:
+  case SRT_TRACE_DID_RUN:
+  case SRT_TRACE_MANUAL_TASK:
+    print_str(r->a, r->flags & SRT_TRACE_A_TRUNCATED);
+    print_str(r->b, r->flags & SRT_TRACE_B_TRUNCATED);
+    break;
+  case SRT_TRACE_GET:
+  case SRT_TRACE_SET:
+  case SRT_TRACE_DELETE:
+    print_str(r->a, r->flags & SRT_TRACE_A_TRUNCATED);
+    if (r->flags & SRT_TRACE_HAS_VALUE) {
+      print_value(r);
+    }
+    printf(" %s", result_name(r->result));
+    break;
+  case SRT_TRACE_DROPPED:
+    printf(" %" PRId64 " events", r->value);
+    break;
+  }
+
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s trace-file|-\n", argv[0]);
+    return 1;
+  }
+
+  FILE *in = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "cannot open '%s'\n", argv[1]);
+    return 1;
+  }
+
+  srt_trace_header header;
+
+  if (fread(&header, sizeof(header), 1, in) != 1 ||
+      memcmp(header.magic, SRT_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != SRT_TRACE_VERSION ||
+      header.record_size != sizeof(srt_trace_record)) {
+    fprintf(stderr, "'%s' is not a version %d trace\n", argv[1],
+            SRT_TRACE_VERSION);
+    return 1;
+  }
+
+  const time_t secs = header.start_unix_ns / 1000000000;
+  struct tm tm;
+  char started[32];
+
+  gmtime_r(&secs, &tm);
+  strftime(started, sizeof(started), "%Y-%m-%dT%H:%M:%S", &tm);
+  printf("# trace started %s.%06" PRIu64 "Z\n", started,
+         header.start_unix_ns % 1000000000 / 1000);
+
+  srt_trace_record records[256];
+  size_t n;
+
+  while ((n = fread(records, sizeof(*records), 256, in)) > 0) {
+    for (size_t i = 0; i < n; ++i) {
+      print_record(&records[i], header.start_ns);
+    }
+  }
+
+  if (in != stdin) {
+    fclose(in);
+  }
+
+  return 0;
+}
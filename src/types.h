@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+//
+// the types srt.h shares with the internal headers, defined once so a
+// translation unit can include both. the rest of srt.h stays opaque.
+//
+
+typedef struct srt_dict srt_dict;
+
+//
+// a key whose hash is computed once per seed. the slot of the last successful
+// lookup is remembered along with the dict generation, which changes whenever
+// items are added, removed or moved, so a repeat lookup can skip the probe.
+//
+
+typedef struct srt_key {
+  const char *str;
+  uint64_t hash;
+  uint64_t seed;
+  bool hashed;
+  const srt_dict *dict;
+  uint64_t gen;
+  size_t slot;
+} srt_key;
+
+#define SRT_KEY(s) ((srt_key){.str = (s)})
+
+typedef enum srt_log_level {
+  SRT_LOG_OFF,
+  SRT_LOG_ERROR,
+  SRT_LOG_WARN,
+  SRT_LOG_INFO,
+  SRT_LOG_DEBUG
+} srt_log_level;
+
+typedef struct srt_ctx_stats {
+  size_t vars;
+  size_t dicts;
+  size_t key_bytes;
+  size_t value_bytes;
+  size_t dict_bytes;
+  size_t allocs;
+  size_t arena_bytes;
+  size_t reserved_bytes;
+  size_t peak_bytes;
+} srt_ctx_stats;
+
+#define SRT_DICT_PROBE_HISTOGRAM 8
+
+typedef struct srt_dict_stats {
+  size_t len;
+  size_t capacity;
+  double load_factor;
+  size_t tombstones;
+  size_t migrating;
+  double avg_probe;
+  size_t max_probe;
+  size_t probe_histogram[SRT_DICT_PROBE_HISTOGRAM];
+  size_t bytes;
+} srt_dict_stats;
+
+typedef enum srt_journal_sync {
+  SRT_JOURNAL_SYNC_NONE,
+  SRT_JOURNAL_SYNC_GROUP
+} srt_journal_sync;
+
+typedef enum srt_merge_policy {
+  SRT_MERGE_FAIL,
+  SRT_MERGE_FIRST_WINS,
+  SRT_MERGE_LAST_WINS
+} srt_merge_policy;
+
+typedef enum srt_cmp {
+  SRT_CMP_LT,
+  SRT_CMP_LE,
+  SRT_CMP_EQ,
+  SRT_CMP_NE,
+  SRT_CMP_GE,
+  SRT_CMP_GT
+} srt_cmp;
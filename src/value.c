@@ -1,6 +1,9 @@
 #include "value.h"
+#include "arena.h"
+#include "array.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define NEW(t, f)                                                              \
   do {                                                                         \
@@ -20,6 +23,40 @@ srt_value *srt_value_new_str(char *value) { NEW(SRT_STR, str); }
 
 void srt_value_free(srt_value *value) { free(value); }
 
+bool srt_value_in_place(const srt_value *value) {
+  return value->tag == SRT_DICT || value->tag == SRT_INT64_ARRAY ||
+         value->tag == SRT_DOUBLE_ARRAY;
+}
+
+const char *srt_value_str(const srt_value *value) {
+  return value->str_inline ? value->str_buf : value->str;
+}
+
+bool srt_value_set_str(srt_value *value, const char *str, size_t len,
+                       srt_arena *arena) {
+  *value = SRT_VALUE(SRT_STR, str, NULL);
+
+  if (!str) {
+    return true;
+  }
+
+  char *copy = value->str_buf;
+
+  if (len < SRT_VALUE_STR_INLINE) {
+    value->str_inline = true;
+  } else if (!(copy = value->str = arena ? srt_arena_alloc(arena, len + 1)
+                                         : malloc(len + 1))) {
+    return false;
+  } else {
+    value->owned = !arena;
+  }
+
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+
+  return true;
+}
+
 void srt_value_print(srt_value *value) {
   if (!value) {
     printf("<NULL>\n");
@@ -37,7 +74,13 @@ void srt_value_print(srt_value *value) {
     printf("int64 = %ld", value->int64);
     break;
   case SRT_STR:
-    printf("str = %s", value->str);
+    printf("str = %s", srt_value_str(value));
+    break;
+  case SRT_INT64_ARRAY:
+    printf("int64 array = [%zu]", value->array->len);
+    break;
+  case SRT_DOUBLE_ARRAY:
+    printf("double array = [%zu]", value->array->len);
     break;
   }
 }
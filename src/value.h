@@ -1,22 +1,48 @@
+#pragma once
+
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+typedef struct srt_arena srt_arena;
+typedef struct srt_array srt_array;
 typedef struct srt_dict srt_dict;
 
+//
+// tags are written out in images, journals and traces, new ones go last.
+//
+
 typedef enum srt_value_tag {
   SRT_BOOL,
   SRT_DICT,
   SRT_INT64,
-  SRT_STR
+  SRT_STR,
+  SRT_INT64_ARRAY,
+  SRT_DOUBLE_ARRAY
 } srt_value_tag;
 
+//
+// strs shorter than SRT_VALUE_STR_INLINE are kept in the value itself, so a
+// status code or an id needs no allocation of its own and goes along when the
+// value is copied. longer ones point elsewhere. either way they are read
+// through srt_value_str. an owned str or array is from malloc and belongs to
+// the value, a dict holding the value frees it when the value is replaced or
+// deleted or the dict goes.
+//
+
+#define SRT_VALUE_STR_INLINE 16
+
 typedef struct srt_value {
   srt_value_tag tag;
+  bool str_inline;
+  bool owned;
   union {
     bool b;
+    srt_array *array;
     srt_dict *dict;
     int64_t int64;
     char *str;
+    char str_buf[SRT_VALUE_STR_INLINE];
   };
 } srt_value;
 
@@ -25,6 +51,8 @@ srt_value *srt_value_new_dict(srt_dict *value);
 srt_value *srt_value_new_int64(int64_t value);
 srt_value *srt_value_new_str(char *value);
 
+#define SRT_VALUE(t, f, v) ((srt_value){.tag = (t), .f = (v)})
+
 #define srt_value_new(X)                                                       \
   _Generic((X), \
     bool: srt_value_new_bool, \
@@ -34,4 +62,20 @@ srt_value *srt_value_new_str(char *value);
 
 void srt_value_free(srt_value *value);
 
+//
+// dicts and arrays are changed in place rather than set anew, so whatever
+// keeps a copy of task data copies them again once they have been touched.
+//
+bool srt_value_in_place(const srt_value *value);
+
+const char *srt_value_str(const srt_value *value);
+
+//
+// makes `value` the str of the `len` bytes at `str`, inline when they fit and
+// otherwise copied into `arena`, or into an owned str when `arena` is NULL. a
+// NULL `str` is the NULL str.
+//
+bool srt_value_set_str(srt_value *value, const char *str, size_t len,
+                       srt_arena *arena);
+
 void srt_value_print(srt_value *value);